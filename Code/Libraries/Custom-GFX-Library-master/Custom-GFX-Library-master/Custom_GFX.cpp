@@ -32,7 +32,11 @@ POSSIBILITY OF SUCH DAMAGE.
  */
 
 #include "Custom_GFX.h"
+#ifdef GFX_FONT_SUBSET
+#include "glcdfont_subset.c"
+#else
 #include "glcdfont.c"
+#endif
 #ifdef __AVR__
 #include <avr/pgmspace.h>
 #elif defined(ESP8266) || defined(ESP32)
@@ -247,6 +251,29 @@ void Custom_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
 
 // TEXT- AND CHARACTER-HANDLING FUNCTIONS ----------------------------------
 
+/**************************************************************************/
+/*!
+   @brief   Find a character's glyph
+    @param    c   Font index, after the classic charset adjustment
+    @returns  The glyph's 5 column bytes in flash, or NULL if GFX_FONT_SUBSET
+   left it out
+*/
+/**************************************************************************/
+static const unsigned char *fontGlyph(unsigned char c) {
+#ifdef GFX_FONT_SUBSET
+  for (uint8_t i = 0; i < FONT_SUBSET_RUNS; i++) { // sorted, and only a few
+    uint8_t first = pgm_read_byte(&fontSubsetRuns[i][0]);
+    if (c < first)
+      break;
+    if (c <= pgm_read_byte(&fontSubsetRuns[i][1]))
+      return &fontSubset[(pgm_read_byte(&fontSubsetRuns[i][2]) + c - first) * 5];
+  }
+  return NULL;
+#else
+  return &font[c * 5];
+#endif
+}
+
 // Draw a character
 /**************************************************************************/
 /*!
@@ -292,9 +319,11 @@ void Custom_GFX::drawChar(int16_t x, int16_t y, unsigned char c,
   if (!_cp437 && (c >= 176))
     c++; // Handle 'classic' charset behavior
 
+  const unsigned char *glyph = fontGlyph(c);
+
   startWrite();
   for (int8_t i = 0; i < 5; i++) { // Char bitmap = 5 columns
-    uint8_t line = pgm_read_byte(&font[c * 5 + i]);
+    uint8_t line = glyph ? pgm_read_byte(&glyph[i]) : 0;
     for (int8_t j = 0; j < 8; j++, line >>= 1) {
       if (line & 1) {
         if (size_x == 1 && size_y == 1)
@@ -370,6 +399,18 @@ void Custom_GFX::setTextSize(uint8_t s_x, uint8_t s_y) {
 /**************************************************************************/
 void Custom_GFX::setRotation(uint8_t x) {
   rotation = (x & 3);
+  switch (rotation) {
+  case 0:
+  case 2:
+    _width = WIDTH;
+    _height = HEIGHT;
+    break;
+  case 1:
+  case 3:
+    _width = HEIGHT;
+    _height = WIDTH;
+    break;
+  }
 }
 
 /**************************************************************************/
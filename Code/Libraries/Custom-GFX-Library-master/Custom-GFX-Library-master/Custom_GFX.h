@@ -8,6 +8,12 @@
 #include "WProgram.h"
 #endif
 
+/// Link only the glyphs the sketch uses, from glcdfont_subset.c, instead of
+/// all 256 in glcdfont.c. Others draw blank, and cp437(true) needs the subset
+/// generated with --cp437. Regenerate it with scripts/make_font.py when the
+/// sketch's text changes. Comment out for the full font
+#define GFX_FONT_SUBSET
+
 /// A generic graphics superclass that can handle all sorts of drawing. At a
 /// minimum you can subclass and provide drawPixel(). At a maximum you can do a
 /// ton of overriding to optimize. Used for any/all Adafruit displays!
@@ -0,0 +1,114 @@
+// Generated by scripts/make_font.py from glcdfont.c, do not edit.
+// 73 of 256 glyphs: \x18 "%()+,-./0123456789:ABCDEFGHIKLMNOPRSTUVWYZ_abcdefghijklmnopqrstuvwxyz\xf7
+
+#ifndef FONT5X7_SUBSET_H
+#define FONT5X7_SUBSET_H
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#endif
+
+// glyphs in font index order, 5 bytes each
+static const unsigned char fontSubset[] PROGMEM = {
+    0x08, 0x04, 0x7E, 0x04, 0x08, // 24
+    0x00, 0x00, 0x00, 0x00, 0x00, // 32
+    0x00, 0x07, 0x00, 0x07, 0x00, // 34
+    0x23, 0x13, 0x08, 0x64, 0x62, // 37
+    0x00, 0x1C, 0x22, 0x41, 0x00, // 40
+    0x00, 0x41, 0x22, 0x1C, 0x00, // 41
+    0x08, 0x08, 0x3E, 0x08, 0x08, // 43
+    0x00, 0x80, 0x70, 0x30, 0x00, // 44
+    0x08, 0x08, 0x08, 0x08, 0x08, // 45
+    0x00, 0x00, 0x60, 0x60, 0x00, // 46
+    0x20, 0x10, 0x08, 0x04, 0x02, // 47
+    0x3E, 0x51, 0x49, 0x45, 0x3E, // 48
+    0x00, 0x42, 0x7F, 0x40, 0x00, // 49
+    0x72, 0x49, 0x49, 0x49, 0x46, // 50
+    0x21, 0x41, 0x49, 0x4D, 0x33, // 51
+    0x18, 0x14, 0x12, 0x7F, 0x10, // 52
+    0x27, 0x45, 0x45, 0x45, 0x39, // 53
+    0x3C, 0x4A, 0x49, 0x49, 0x31, // 54
+    0x41, 0x21, 0x11, 0x09, 0x07, // 55
+    0x36, 0x49, 0x49, 0x49, 0x36, // 56
+    0x46, 0x49, 0x49, 0x29, 0x1E, // 57
+    0x00, 0x00, 0x14, 0x00, 0x00, // 58
+    0x7C, 0x12, 0x11, 0x12, 0x7C, // 65
+    0x7F, 0x49, 0x49, 0x49, 0x36, // 66
+    0x3E, 0x41, 0x41, 0x41, 0x22, // 67
+    0x7F, 0x41, 0x41, 0x41, 0x3E, // 68
+    0x7F, 0x49, 0x49, 0x49, 0x41, // 69
+    0x7F, 0x09, 0x09, 0x09, 0x01, // 70
+    0x3E, 0x41, 0x41, 0x51, 0x73, // 71
+    0x7F, 0x08, 0x08, 0x08, 0x7F, // 72
+    0x00, 0x41, 0x7F, 0x41, 0x00, // 73
+    0x7F, 0x08, 0x14, 0x22, 0x41, // 75
+    0x7F, 0x40, 0x40, 0x40, 0x40, // 76
+    0x7F, 0x02, 0x1C, 0x02, 0x7F, // 77
+    0x7F, 0x04, 0x08, 0x10, 0x7F, // 78
+    0x3E, 0x41, 0x41, 0x41, 0x3E, // 79
+    0x7F, 0x09, 0x09, 0x09, 0x06, // 80
+    0x7F, 0x09, 0x19, 0x29, 0x46, // 82
+    0x26, 0x49, 0x49, 0x49, 0x32, // 83
+    0x03, 0x01, 0x7F, 0x01, 0x03, // 84
+    0x3F, 0x40, 0x40, 0x40, 0x3F, // 85
+    0x1F, 0x20, 0x40, 0x20, 0x1F, // 86
+    0x3F, 0x40, 0x38, 0x40, 0x3F, // 87
+    0x03, 0x04, 0x78, 0x04, 0x03, // 89
+    0x61, 0x59, 0x49, 0x4D, 0x43, // 90
+    0x40, 0x40, 0x40, 0x40, 0x40, // 95
+    0x20, 0x54, 0x54, 0x78, 0x40, // 97
+    0x7F, 0x28, 0x44, 0x44, 0x38, // 98
+    0x38, 0x44, 0x44, 0x44, 0x28, // 99
+    0x38, 0x44, 0x44, 0x28, 0x7F, // 100
+    0x38, 0x54, 0x54, 0x54, 0x18, // 101
+    0x00, 0x08, 0x7E, 0x09, 0x02, // 102
+    0x18, 0xA4, 0xA4, 0x9C, 0x78, // 103
+    0x7F, 0x08, 0x04, 0x04, 0x78, // 104
+    0x00, 0x44, 0x7D, 0x40, 0x00, // 105
+    0x20, 0x40, 0x40, 0x3D, 0x00, // 106
+    0x7F, 0x10, 0x28, 0x44, 0x00, // 107
+    0x00, 0x41, 0x7F, 0x40, 0x00, // 108
+    0x7C, 0x04, 0x78, 0x04, 0x78, // 109
+    0x7C, 0x08, 0x04, 0x04, 0x78, // 110
+    0x38, 0x44, 0x44, 0x44, 0x38, // 111
+    0xFC, 0x18, 0x24, 0x24, 0x18, // 112
+    0x18, 0x24, 0x24, 0x18, 0xFC, // 113
+    0x7C, 0x08, 0x04, 0x04, 0x08, // 114
+    0x48, 0x54, 0x54, 0x54, 0x24, // 115
+    0x04, 0x04, 0x3F, 0x44, 0x24, // 116
+    0x3C, 0x40, 0x40, 0x20, 0x7C, // 117
+    0x1C, 0x20, 0x40, 0x20, 0x1C, // 118
+    0x3C, 0x40, 0x30, 0x40, 0x3C, // 119
+    0x44, 0x28, 0x10, 0x28, 0x44, // 120
+    0x4C, 0x90, 0x90, 0x90, 0x7C, // 121
+    0x44, 0x64, 0x54, 0x4C, 0x44, // 122
+    0x06, 0x0F, 0x09, 0x0F, 0x06, // 248
+};
+
+// runs of consecutive font indexes: first, last, where the first one is in fontSubset
+static const unsigned char fontSubsetRuns[][3] PROGMEM = {
+    {24, 24, 0},
+    {32, 32, 1},
+    {34, 34, 2},
+    {37, 37, 3},
+    {40, 41, 4},
+    {43, 58, 6},
+    {65, 73, 22},
+    {75, 80, 31},
+    {82, 87, 37},
+    {89, 90, 43},
+    {95, 95, 45},
+    {97, 122, 46},
+    {248, 248, 72},
+};
+
+#define FONT_SUBSET_RUNS (sizeof(fontSubsetRuns) / sizeof(fontSubsetRuns[0]))
+
+static inline void avoid_unused_const_variable_compiler_warning(void) {
+  (void)fontSubset;
+  (void)fontSubsetRuns;
+}
+
+#endif // FONT5X7_SUBSET_H
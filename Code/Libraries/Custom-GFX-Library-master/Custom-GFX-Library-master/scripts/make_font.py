@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+# Cuts glcdfont.c down to the characters a sketch can actually draw, and
+# writes them out as glcdfont_subset.c for GFX_FONT_SUBSET builds (see
+# Custom_GFX.h). The characters are taken from every string and character
+# literal in the given sources, printf conversions left out, plus the ones
+# formatted numbers are made of. Anything drawn that isn't in the subset
+# comes out blank, so regenerate whenever the sketch's text changes:
+#   python3 make_font.py ../glcdfont.c sketch/*.ino sketch/*.h sketch/*.cpp > ../glcdfont_subset.c
+#   python3 make_font.py --extra 'XYZ' ...   characters built at run time
+# Every code from 0 to 255 counts, escapes like "\x18" included, except the
+# newline and carriage return that write() acts on instead of drawing.
+#
+# --check reads an existing subset instead of writing one, and fails
+# listing each character the sources use that its runs don't cover, and
+# where it's used, or any glyph that differs from the font:
+#   python3 make_font.py --check ../glcdfont_subset.c ../glcdfont.c sketch/*.ino ...
+
+import argparse
+import re
+import sys
+
+NUMBERS = '0123456789 +-.,:' # what printf and displayNumber() produce
+UNDRAWN = '\n\r' # write() moves the cursor for these, they never reach drawChar()
+TOKEN = re.compile(r'"((?:[^"\\\n]|\\.)*)"|\'((?:[^\'\\\n]|\\.)+)\'|//[^\n]*|/\*.*?\*/', re.S)
+CONVERSION = re.compile(r'%[-+ #0]*(?:\d+|\*)?(?:\.\d+)?(?:hh|h|ll|l)?[diouxXcsSfeEgGp]')
+
+def unescape(literal):
+  return literal.encode('latin-1', 'backslashreplace').decode('unicode_escape')
+
+def used_characters(sources):
+  # code: where it's first used
+  used = {ord(c): 'numbers' for c in NUMBERS}
+  for name in sources:
+    with open(name, encoding='latin-1') as f:
+      text = f.read()
+    # strings, characters and comments in one pass, so quotes in comments and // in strings are left alone
+    for m in TOKEN.finditer(text):
+      if m.group(1) is not None:
+        characters = CONVERSION.sub('', unescape(m.group(1))).replace('%%', '%')
+      elif m.group(2) is not None:
+        characters = unescape(m.group(2))
+      else:
+        continue
+      where = '{}:{}'.format(name, text.count('\n', 0, m.start()) + 1)
+      for c in characters:
+        if ord(c) < 256 and c not in UNDRAWN:
+          used.setdefault(ord(c), where)
+  return used
+
+def read_font(name):
+  with open(name) as f:
+    text = f.read()
+  body = text[text.index('font[] PROGMEM = {') + len('font[] PROGMEM = {'):]
+  body = body[:body.index('};')]
+  values = [int(v, 16) for v in re.findall(r'0x[0-9A-Fa-f]{2}', body)]
+  if len(values) != 256 * 5:
+    sys.exit('expected 256 glyphs of 5 bytes in {}, found {} bytes'.format(name, len(values)))
+  return values
+
+def font_index(code, cp437):
+  if not cp437 and code >= 176:
+    return code + 1 # the 'classic' charset is off by one from 176 up, like drawChar()
+  return code
+
+def read_subset(name):
+  with open(name) as f:
+    text = f.read()
+  body = text[text.index('fontSubset[] PROGMEM = {') + len('fontSubset[] PROGMEM = {'):]
+  glyphs = [int(v, 16) for v in re.findall(r'0x[0-9A-Fa-f]{2}', body[:body.index('};')])]
+  body = text[text.index('fontSubsetRuns[][3] PROGMEM = {'):]
+  table = [tuple(int(v) for v in run) for run in re.findall(r'\{(\d+), (\d+), (\d+)\}', body[:body.index('};')])]
+  return glyphs, table
+
+def describe(code):
+  return repr(chr(code)) if 32 <= code < 127 else '\\x{:02x}'.format(code)
+
+def check(subset, font, used, cp437):
+  glyphs, table = read_subset(subset)
+  failed = 0
+  for code, where in sorted(used.items()):
+    index = font_index(code, cp437)
+    run = next((run for run in table if run[0] <= index <= run[1]), None)
+    if run is None:
+      print('{}: {} (font index {}) is not in {}'.format(where, describe(code), index, subset), file=sys.stderr)
+      failed += 1
+      continue
+    glyph = (run[2] + index - run[0]) * 5
+    if glyphs[glyph:glyph + 5] != font[index * 5:index * 5 + 5]:
+      print('{}: {} (font index {}) differs from the font in {}'.format(where, describe(code), index, subset), file=sys.stderr)
+      failed += 1
+  if failed:
+    sys.exit('{} characters missing or wrong, regenerate {} with make_font.py'.format(failed, subset))
+  print('{}: all {} characters the sources use are there'.format(subset, len(used)), file=sys.stderr)
+
+def runs(indexes):
+  result = []
+  for index in sorted(indexes):
+    if result and result[-1][1] == index - 1:
+      result[-1][1] = index
+    else:
+      result.append([index, index])
+  return result
+
+def main():
+  parser = argparse.ArgumentParser(description='subset glcdfont.c to the characters a sketch uses')
+  parser.add_argument('font', help='glcdfont.c')
+  parser.add_argument('sources', nargs='+', help='sketch sources to collect characters from')
+  parser.add_argument('--extra', default='', help='more characters to keep')
+  parser.add_argument('--cp437', action='store_true', help='the sketch calls cp437(true)')
+  parser.add_argument('--check', metavar='SUBSET', help='check this glcdfont_subset.c covers the sources instead')
+  args = parser.parse_args()
+
+  font = read_font(args.font)
+  used = used_characters(args.sources)
+  for c in args.extra:
+    used.setdefault(ord(c), '--extra')
+  if args.check:
+    check(args.check, font, used, args.cp437)
+    return
+  codes = set(used)
+  indexes = {font_index(code, args.cp437) for code in codes if font_index(code, args.cp437) < 256}
+  if len(indexes) > 255:
+    sys.exit('{} glyphs, the subset holds 255 at most'.format(len(indexes)))
+
+  print('// Generated by scripts/make_font.py from glcdfont.c, do not edit.')
+  print('// {} of 256 glyphs: {}'.format(len(indexes),
+    ''.join(chr(c) if 32 <= c < 127 and c not in (92,) else '\\x{:02x}'.format(c) for c in sorted(codes))))
+  print()
+  print('#ifndef FONT5X7_SUBSET_H')
+  print('#define FONT5X7_SUBSET_H')
+  print()
+  print('#ifdef __AVR__')
+  print('#include <avr/pgmspace.h>')
+  print('#else')
+  print('#define PROGMEM')
+  print('#endif')
+  print()
+  print('// glyphs in font index order, 5 bytes each')
+  print('static const unsigned char fontSubset[] PROGMEM = {')
+  for index in sorted(indexes):
+    print('    ' + ', '.join('0x{:02X}'.format(b) for b in font[index * 5:index * 5 + 5]) +
+          ', // {}'.format(index))
+  print('};')
+  print()
+  print('// runs of consecutive font indexes: first, last, where the first one is in fontSubset')
+  print('static const unsigned char fontSubsetRuns[][3] PROGMEM = {')
+  glyph = 0
+  for first, last in runs(indexes):
+    print('    {{{}, {}, {}}},'.format(first, last, glyph))
+    glyph += last - first + 1
+  print('};')
+  print()
+  print('#define FONT_SUBSET_RUNS (sizeof(fontSubsetRuns) / sizeof(fontSubsetRuns[0]))')
+  print()
+  print('static inline void avoid_unused_const_variable_compiler_warning(void) {')
+  print('  (void)fontSubset;')
+  print('  (void)fontSubsetRuns;')
+  print('}')
+  print()
+  print('#endif // FONT5X7_SUBSET_H')
+  print('{} glyphs in {} runs, {} bytes instead of {}'.format(len(indexes), len(runs(indexes)),
+        len(indexes) * 5 + len(runs(indexes)) * 3, len(font)), file=sys.stderr)
+
+if __name__ == '__main__':
+  main()
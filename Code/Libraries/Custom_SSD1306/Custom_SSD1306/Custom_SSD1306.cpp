@@ -53,23 +53,9 @@
 
 // SOME DEFINES AND STATIC VARIABLES USED INTERNALLY -----------------------
 
-#if defined(BUFFER_LENGTH)
- #define WIRE_MAX BUFFER_LENGTH          ///< AVR or similar Wire lib
-#elif defined(SERIAL_BUFFER_SIZE)
- #define WIRE_MAX (SERIAL_BUFFER_SIZE-1) ///< Newer Wire uses RingBuffer
-#else
- #define WIRE_MAX 32                     ///< Use common Arduino core default
-#endif
-
 #define ssd1306_swap(a, b) \
   (((a) ^= (b)), ((b) ^= (a)), ((a) ^= (b))) ///< No-temp-var swap operation
 
-#if ARDUINO >= 100
- #define WIRE_WRITE wire->write ///< Wire write function in recent Arduino lib
-#else
- #define WIRE_WRITE wire->send  ///< Wire write function in older Arduino lib
-#endif
-
 #ifdef HAVE_PORTREG
  #define SSD1306_SELECT       *csPort &= ~csPinMask; ///< Device select
  #define SSD1306_DESELECT     *csPort |=  csPinMask; ///< Device deselect
@@ -82,34 +68,9 @@
  #define SSD1306_MODE_DATA    digitalWrite(dcPin, HIGH); ///< Data mode
 #endif
 
-#if (ARDUINO >= 157) && !defined(ARDUINO_STM32_FEATHER)
- #define SETWIRECLOCK wire->setClock(wireClk)    ///< Set before I2C transfer
- #define RESWIRECLOCK wire->setClock(restoreClk) ///< Restore after I2C xfer
-#else // setClock() is not present in older Arduino Wire lib (or WICED)
- #define SETWIRECLOCK ///< Dummy stand-in define
- #define RESWIRECLOCK ///< keeps compiler happy
-#endif
-
-#if defined(SPI_HAS_TRANSACTION)
- #define SPI_TRANSACTION_START spi->beginTransaction(spiSettings) ///< Pre-SPI
- #define SPI_TRANSACTION_END   spi->endTransaction()              ///< Post-SPI
-#else // SPI transactions likewise not present in older Arduino SPI lib
- #define SPI_TRANSACTION_START ///< Dummy stand-in define
- #define SPI_TRANSACTION_END   ///< keeps compiler happy
-#endif
-
-// The definition of 'transaction' is broadened a bit in the context of
-// this library -- referring not just to SPI transactions (if supported
-// in the version of the SPI library being used), but also chip select
-// (if SPI is being used, whether hardware or soft), and also to the
-// beginning and end of I2C transfers (the Wire clock may be sped up before
-// issuing data to the display, then restored to the default rate afterward
-// so other I2C device types still work).  All of these are encapsulated
-// in the TRANSACTION_* macros.
-
-// Check first if Wire, then hardware SPI, then soft SPI:
-#define TRANSACTION_START   SETWIRECLOCK;
-#define TRANSACTION_END     RESWIRECLOCK;
+// All I2C traffic goes through the Custom_TWI queue. Every transaction
+// carries the display's own bit rate, so there is no need to speed the bus
+// up before a transfer and restore it afterward for other devices.
 
 // CONSTRUCTORS, DESTRUCTOR ------------------------------------------------
 
@@ -120,39 +81,29 @@
     @param  h
             Display height in pixels
     @param  twi
-            Pointer to an existing TwoWire instance (e.g. &Wire, the
-            microcontroller's primary I2C bus).
+            Pointer to the Custom_TWI bus the display is on (e.g. &Twi).
     @param  rst_pin
             Reset pin (using Arduino pin numbering), or -1 if not used
             (some displays might be wired to share the microcontroller's
             reset pin).
-    @param  clkDuring
-            Speed (in Hz) for Wire transmissions in SSD1306 library calls.
-            Defaults to 400000 (400 KHz), a known 'safe' value for most
-            microcontrollers, and meets the SSD1306 datasheet spec.
-            Some systems can operate I2C faster (800 KHz for ESP32, 1 MHz
-            for many other 32-bit MCUs), and some (perhaps not all)
-            SSD1306's can work with this -- so it's optionally be specified
-            here and is not a default behavior. (Ignored if using pre-1.5.7
-            Arduino software, which operates I2C at a fixed 100 KHz.)
-    @param  clkAfter
-            Speed (in Hz) for Wire transmissions following SSD1306 library
-            calls. Defaults to 100000 (100 KHz), the default Arduino Wire
-            speed. This is done rather than leaving it at the 'during' speed
-            because other devices on the I2C bus might not be compatible
-            with the faster rate. (Ignored if using pre-1.5.7 Arduino
-            software, which operates I2C at a fixed 100 KHz.)
+    @param  clk
+            Speed (in Hz) of I2C transfers to this display. Defaults to
+            400000 (400 KHz), which meets the SSD1306 datasheet spec. Other
+            devices on the bus keep their own speed, since the bit rate is
+            set per transaction.
+    @param  frame
+            Buffer of at least w * ((h + 7) / 8) bytes to draw into, or
+            NULL to have begin() malloc() one. Custom_SSD1306_Static
+            passes its own array here.
     @return Custom_SSD1306 object.
     @note   Call the object's begin() function before use -- buffer
-            allocation is performed there!
+            allocation, if any, is performed there!
 */
-Custom_SSD1306::Custom_SSD1306(uint8_t w, uint8_t h, TwoWire *twi,
-  int8_t rst_pin, uint32_t clkDuring, uint32_t clkAfter) :
-  Custom_GFX(w, h), spi(NULL), wire(twi ? twi : &Wire), buffer(NULL),
+Custom_SSD1306::Custom_SSD1306(uint8_t w, uint8_t h, Custom_TWI *twi,
+  int8_t rst_pin, uint32_t clk, uint8_t *frame) :
+  Custom_GFX(w, h), spi(NULL), heapBuffer(false), wire(twi ? twi : &Twi),
+  buffer(frame), twbr(Custom_TWI::bitRate(clk)),
   mosiPin(-1), clkPin(-1), dcPin(-1), csPin(-1), rstPin(rst_pin)
-#if ARDUINO >= 157
-  , wireClk(clkDuring), restoreClk(clkAfter)
-#endif
 {
 }
 
@@ -161,7 +112,7 @@ Custom_SSD1306::Custom_SSD1306(uint8_t w, uint8_t h, TwoWire *twi,
     @brief  Destructor for Custom_SSD1306 object.
 */
 Custom_SSD1306::~Custom_SSD1306(void) {
-  if(buffer) {
+  if(heapBuffer) {
     free(buffer);
     buffer = NULL;
   }
@@ -190,36 +141,28 @@ inline void Custom_SSD1306::SPIwrite(uint8_t d) {
   }
 }
 
-// Issue single command to SSD1306, using I2C or hard/soft SPI as needed.
-// Because command calls are often grouped, SPI transaction and selection
-// must be started/ended in calling function for efficiency.
+// Queue a single command to the SSD1306. Returns straight away; the
+// command goes out in order with everything else queued for the display.
 // This is a private function, not exposed (see ssd1306_command() instead).
 void Custom_SSD1306::ssd1306_command1(uint8_t c) {
-  //if(wire) { // I2C. this if statement removed
-  wire->beginTransmission(i2caddr);
-  WIRE_WRITE((uint8_t)0x00); // Co = 0, D/C = 0
-  WIRE_WRITE(c);
-  wire->endTransmission();
+  uint8_t cmd[2] = { 0x00, c }; // Co = 0, D/C = 0
+  wire->queue(i2caddr, twbr, cmd, sizeof(cmd));
 }
 
-// Issue list of commands to SSD1306, same rules as above re: transactions.
+// Queue a list of commands from PROGMEM, as few transactions as the
+// transaction header size allows.
 // This is a private function, not exposed.
 void Custom_SSD1306::ssd1306_commandList(const uint8_t *c, uint8_t n) {
-  //if(wire) { // I2C. this if statement removed
-  wire->beginTransmission(i2caddr);
-  WIRE_WRITE((uint8_t)0x00); // Co = 0, D/C = 0
-  uint8_t bytesOut = 1;
-  while(n--) {
-    if(bytesOut >= WIRE_MAX) {
-      wire->endTransmission();
-      wire->beginTransmission(i2caddr);
-      WIRE_WRITE((uint8_t)0x00); // Co = 0, D/C = 0
-      bytesOut = 1;
+  uint8_t cmd[TWI_HEADER_MAX];
+  cmd[0] = 0x00; // Co = 0, D/C = 0
+  while(n) {
+    uint8_t bytesOut = 1;
+    while(n && (bytesOut < TWI_HEADER_MAX)) {
+      cmd[bytesOut++] = pgm_read_byte(c++);
+      n--;
     }
-    WIRE_WRITE(pgm_read_byte(c++));
-    bytesOut++;
+    wire->queue(i2caddr, twbr, cmd, bytesOut);
   }
-  wire->endTransmission();
 }
 
 // A public version of ssd1306_command1(), for existing user code that
@@ -233,9 +176,8 @@ void Custom_SSD1306::ssd1306_commandList(const uint8_t *c, uint8_t n) {
     @return None (void).
 */
 void Custom_SSD1306::ssd1306_command(uint8_t c) {
-  TRANSACTION_START
+  TWI_TRACE_SCOPE(wire, "ssd1306_command");
   ssd1306_command1(c);
-  TRANSACTION_END
 }
 
 // ALLOCATE & INIT DISPLAY -------------------------------------------------
@@ -268,8 +210,7 @@ void Custom_SSD1306::ssd1306_command(uint8_t c) {
             Cases where false might be used include multiple displays or
             other devices sharing a common bus, or situations on some
             platforms where a nonstandard begin() function is available
-            (e.g. a TwoWire interface on non-default pins, as can be done
-            on the ESP8266 and perhaps others).
+            (e.g. another device on the same bus already began it).
     @return true on successful allocation/init, false otherwise.
             Well-behaved code should check the return value before
             proceeding.
@@ -277,9 +218,13 @@ void Custom_SSD1306::ssd1306_command(uint8_t c) {
 */
 boolean Custom_SSD1306::begin(uint8_t vcs, uint8_t addr, boolean reset,
   boolean periphBegin) {
+  TWI_TRACE_SCOPE(wire, "begin");
 
-  if((!buffer) && !(buffer = (uint8_t *)malloc(WIDTH * ((HEIGHT + 7) / 8))))
-    return false;
+  if(!buffer) {
+    if(!(buffer = (uint8_t *)malloc(WIDTH * ((HEIGHT + 7) / 8))))
+      return false;
+    heapBuffer = true;
+  }
 
   clearDisplay();
 
@@ -290,10 +235,9 @@ boolean Custom_SSD1306::begin(uint8_t vcs, uint8_t addr, boolean reset,
   // If I2C address is unspecified, use default
   // (0x3C for 32-pixel-tall displays, 0x3D for all others).
   i2caddr = 0x3C;
-  // TwoWire begin() function might be already performed by the calling
-  // function if it has unusual circumstances (e.g. TWI variants that
-  // can accept different SDA/SCL pins, or if two SSD1306 instances
-  // with different addresses -- only a single begin() is needed).
+  // Custom_TWI begin() might already have been performed by the calling
+  // function (e.g. if two SSD1306 instances or other devices share the
+  // bus -- only a single begin() is needed).
   if(periphBegin) wire->begin();
 
   // Reset SSD1306 if requested and reset pin specified in constructor
@@ -306,8 +250,6 @@ boolean Custom_SSD1306::begin(uint8_t vcs, uint8_t addr, boolean reset,
     digitalWrite(rstPin, HIGH); // Bring out of reset
   }
 
-  TRANSACTION_START
-
   // Init sequence
   static const uint8_t PROGMEM init1[] = {
     SSD1306_DISPLAYOFF,                   // 0xAE
@@ -356,8 +298,6 @@ boolean Custom_SSD1306::begin(uint8_t vcs, uint8_t addr, boolean reset,
     SSD1306_DISPLAYON };                 // Main screen turn on
   ssd1306_commandList(init5, sizeof(init5));
 
-  TRANSACTION_END
-
   return true; // Success
 }
 
@@ -407,6 +347,142 @@ void Custom_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
   }
 }
 
+/*!
+    @brief  Fill a rectangle, a whole buffer byte at a time where possible.
+            Partial pages at the top and bottom are masked, the full pages
+            in between are set with memset(). This is what the scaled font
+            in drawChar() and the other Custom_GFX primitives end up
+            calling, so it replaces a drawPixel() call per pixel.
+    @param  x
+            Leftmost column -- 0 at left to (screen width - 1) at right.
+    @param  y
+            Top row -- 0 at top to (screen height -1) at bottom.
+    @param  w
+            Width in pixels.
+    @param  h
+            Height in pixels.
+    @param  color
+            Fill color, one of: SSD1306_BLACK, SSD1306_WHITE or SSD1306_INVERT.
+    @return None (void).
+    @note   Changes buffer contents only, no immediate effect on display.
+            Under rotation the rectangle is turned into buffer coordinates
+            the same way drawPixel() turns a pixel, so every rotation takes
+            the byte path. It must not hand off to Custom_GFX::fillRect(),
+            which comes back here through writeFastVLine().
+*/
+void Custom_SSD1306::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+  uint16_t color) {
+  if((w <= 0) || (h <= 0)) return;
+
+  // Rotate the rectangle into buffer coordinates, see drawPixel()
+  int16_t t;
+  switch(getRotation()) {
+  case 1:
+    t = x;
+    x = WIDTH - y - h;
+    y = t;
+    ssd1306_swap(w, h);
+    break;
+  case 2:
+    x = WIDTH - x - w;
+    y = HEIGHT - y - h;
+    break;
+  case 3:
+    t = y;
+    y = HEIGHT - x - w;
+    x = t;
+    ssd1306_swap(w, h);
+    break;
+  }
+
+  // Clip to the buffer
+  if(x < 0) { w += x; x = 0; }
+  if(y < 0) { h += y; y = 0; }
+  if(x + w > WIDTH)  w = WIDTH - x;
+  if(y + h > HEIGHT) h = HEIGHT - y;
+  if((w <= 0) || (h <= 0)) return;
+
+  uint8_t *pBuf = &buffer[(y / 8) * WIDTH + x];
+
+  // Partial page at the top
+  uint8_t mod = (y & 7);
+  if(mod) {
+    mod = 8 - mod;                      // rows left in this page
+    uint8_t mask = ~(0xFF >> mod);      // those rows, at the top of the byte
+    if(h < mod) mask &= (0xFF >> (mod - h)); // run ends inside this page
+    maskColumns(pBuf, w, mask, color);
+    if(h <= mod) return;
+    h    -= mod;
+    pBuf += WIDTH;
+  }
+
+  // Whole pages
+  while(h >= 8) {
+    if(color == SSD1306_INVERSE) maskColumns(pBuf, w, 0xFF, color);
+    else if(color == SSD1306_WHITE) memset(pBuf, 0xFF, w);
+    else if(color == SSD1306_BLACK) memset(pBuf, 0x00, w);
+    pBuf += WIDTH;
+    h    -= 8;
+  }
+
+  // Partial page at the bottom
+  if(h) maskColumns(pBuf, w, (1 << h) - 1, color);
+}
+
+/*!
+    @brief  Same as fillRect(), there is no write transaction to set up.
+    @param  x      Leftmost column.
+    @param  y      Top row.
+    @param  w      Width in pixels.
+    @param  h      Height in pixels.
+    @param  color  SSD1306_BLACK, SSD1306_WHITE or SSD1306_INVERT.
+*/
+void Custom_SSD1306::writeFillRect(int16_t x, int16_t y, int16_t w,
+  int16_t h, uint16_t color) {
+  fillRect(x, y, w, h, color);
+}
+
+/*!
+    @brief  Draw a vertical line, one masked byte per page.
+    @param  x      Column.
+    @param  y      Top row.
+    @param  h      Height in pixels.
+    @param  color  SSD1306_BLACK, SSD1306_WHITE or SSD1306_INVERT.
+*/
+void Custom_SSD1306::drawFastVLine(int16_t x, int16_t y, int16_t h,
+  uint16_t color) {
+  fillRect(x, y, 1, h, color);
+}
+
+/*!
+    @brief  Same as drawFastVLine().
+    @param  x      Column.
+    @param  y      Top row.
+    @param  h      Height in pixels.
+    @param  color  SSD1306_BLACK, SSD1306_WHITE or SSD1306_INVERT.
+*/
+void Custom_SSD1306::writeFastVLine(int16_t x, int16_t y, int16_t h,
+  uint16_t color) {
+  fillRect(x, y, 1, h, color);
+}
+
+// Apply the same bit mask to w consecutive columns of one page
+void Custom_SSD1306::maskColumns(uint8_t *p, int16_t w, uint8_t mask,
+  uint16_t color) {
+  switch(color) {
+  case SSD1306_WHITE:
+    while(w--) *p++ |= mask;
+    break;
+  case SSD1306_BLACK:
+    mask = ~mask;
+    while(w--) *p++ &= mask;
+    break;
+  case SSD1306_INVERSE:
+    while(w--) *p++ ^= mask;
+    break;
+  }
+}
+
 
 
 /*!
@@ -417,61 +493,98 @@ void Custom_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
             commands as needed by one's own application.
 */
 void Custom_SSD1306::clearDisplay(void) {
+  wire->flush(); // the previous frame may still be going out of this buffer
   memset(buffer, 0, WIDTH * ((HEIGHT + 7) / 8));
 }
 
+/*!
+    @brief  Get the base address of the display buffer, for direct reading
+            or writing.
+    @return Pointer to the buffer, one byte per column of each 8-pixel
+            page, pages in order. NULL until begin() has allocated it.
+*/
+uint8_t *Custom_SSD1306::getBuffer(void) {
+  return buffer;
+}
+
 
 
 // REFRESH DISPLAY ---------------------------------------------------------
 
 /*!
     @brief  Push data currently in RAM to SSD1306 display.
+    @param  done
+            Called from the TWI interrupt once the last page has gone out
+            (or failed), or NULL. Lets a caller see when the frame is
+            actually on the glass.
     @return None (void).
     @note   Drawing operations are not visible until this function is
             called. Call after each graphics command, or after a whole set
             of graphics commands, as best needed by one's own application.
+            The frame is queued and sent in the background one page at a
+            time, so other I2C traffic can get in between pages. The buffer
+            must not be drawn to until the transfer is done: clearDisplay()
+            waits for that, or check busy() on the bus.
 */
-void Custom_SSD1306::display(void) {
-  TRANSACTION_START
-  static const uint8_t PROGMEM dlist1[] = {
+void Custom_SSD1306::display(TWICallback done) {
+  TWI_TRACE_SCOPE(wire, "display");
+  uint8_t dlist1[] = {
+    0x00,                      // Co = 0, D/C = 0
     SSD1306_PAGEADDR,
     0,                         // Page start address
     0xFF,                      // Page end (not really, but works here)
     SSD1306_COLUMNADDR,
-    0 };                       // Column start address
-  ssd1306_commandList(dlist1, sizeof(dlist1));
-  ssd1306_command1(WIDTH - 1); // Column end address
-
-#if defined(ESP8266)
-  // ESP8266 needs a periodic yield() call to avoid watchdog reset.
-  // With the limited size of SSD1306 displays, and the fast bitrate
-  // being used (1 MHz or more), I think one yield() immediately before
-  // a screen write and one immediately after should cover it.  But if
-  // not, if this becomes a problem, yields() might be added in the
-  // 32-byte transfer condition below.
-  yield();
-#endif
-  uint16_t count = WIDTH * ((HEIGHT + 7) / 8);
-  uint8_t *ptr   = buffer;
-  //if(wire) { // I2C. this if statement removed
-  wire->beginTransmission(i2caddr);
-  WIRE_WRITE((uint8_t)0x40);
-  uint8_t bytesOut = 1;
-  while(count--) {
-    if(bytesOut >= WIRE_MAX) {
-      wire->endTransmission();
-      wire->beginTransmission(i2caddr);
-      WIRE_WRITE((uint8_t)0x40);
-      bytesOut = 1;
-    }
-    WIRE_WRITE(*ptr++);
-    bytesOut++;
+    0,                         // Column start address
+    (uint8_t)(WIDTH - 1) };    // Column end address
+  wire->queue(i2caddr, twbr, dlist1, sizeof(dlist1));
+
+  static const uint8_t dataMode = 0x40; // Co = 0, D/C = 1
+  uint8_t pages = (HEIGHT + 7) / 8;
+  for(uint8_t page = 0; page < pages; page++) {
+    wire->queue(i2caddr, twbr, &dataMode, 1, buffer + page * WIDTH, WIDTH,
+      NULL, 0, page == pages - 1 ? done : NULL);
+  }
+}
+
+
+/*!
+    @brief  Push one block of the buffer to the display, leaving the rest
+            of the display's memory as it was.
+    @param  x0
+            First column of the block.
+    @param  page0
+            First page (8 pixel row) of the block.
+    @param  x1
+            Last column of the block, inclusive.
+    @param  page1
+            Last page of the block, inclusive.
+    @param  done
+            Called from the TWI interrupt once the last page has gone out
+            (or failed), or NULL.
+    @return None (void).
+    @note   Uses the display's column and page address window, so only
+            (x1 - x0 + 1) bytes per page go over the bus. The next
+            display() sets the window back to the whole screen. The same
+            rule about not drawing until the transfer is done applies.
+*/
+void Custom_SSD1306::displayRegion(uint8_t x0, uint8_t page0, uint8_t x1,
+  uint8_t page1, TWICallback done) {
+  TWI_TRACE_SCOPE(wire, "displayRegion");
+  uint8_t dlist1[] = {
+    0x00,                      // Co = 0, D/C = 0
+    SSD1306_PAGEADDR,
+    page0,
+    page1,
+    SSD1306_COLUMNADDR,
+    x0,
+    x1 };
+  wire->queue(i2caddr, twbr, dlist1, sizeof(dlist1));
+
+  static const uint8_t dataMode = 0x40; // Co = 0, D/C = 1
+  for(uint8_t page = page0; page <= page1; page++) {
+    wire->queue(i2caddr, twbr, &dataMode, 1, buffer + page * WIDTH + x0,
+      x1 - x0 + 1, NULL, 0, page == page1 ? done : NULL);
   }
-  wire->endTransmission();
-  TRANSACTION_END
-#if defined(ESP8266)
-  yield();
-#endif
 }
 
 
@@ -491,9 +604,8 @@ void Custom_SSD1306::display(void) {
             SSD1306_WHITE (value 1) will draw black.
 */
 void Custom_SSD1306::invertDisplay(boolean i) {
-  TRANSACTION_START
+  TWI_TRACE_SCOPE(wire, "invertDisplay");
   ssd1306_command1(i ? SSD1306_INVERTDISPLAY : SSD1306_NORMALDISPLAY);
-  TRANSACTION_END
 }
 
 /*!
@@ -505,10 +617,28 @@ void Custom_SSD1306::invertDisplay(boolean i) {
             display() function -- buffer contents are not changed.
 */
 void Custom_SSD1306::dim(boolean dim, uint8_t customContrast) {
+  TWI_TRACE_SCOPE(wire, "dim");
   // the range of contrast to too small to be really useful
   // it is useful to dim the display
-  TRANSACTION_START
-  ssd1306_command1(SSD1306_SETCONTRAST);
-  ssd1306_command1(dim ? 0 : customContrast);
-  TRANSACTION_END
+  uint8_t cmd[3] = { 0x00, SSD1306_SETCONTRAST, dim ? (uint8_t)0 : customContrast };
+  wire->queue(i2caddr, twbr, cmd, sizeof(cmd));
+}
+
+/*!
+    @brief  Turn the picture upside down in the display hardware, by
+            reversing the segment remap and COM scan direction.
+    @param  flipped
+            true to show the picture rotated 180 degrees, false for the
+            normal orientation set up by begin().
+    @return None (void).
+    @note   Drawing stays at rotation 0, so drawPixel() does no coordinate
+            math for a flipped display. The segment remap only applies to
+            data written afterward, so call display() after changing this.
+*/
+void Custom_SSD1306::flip(boolean flipped) {
+  TWI_TRACE_SCOPE(wire, "flip");
+  uint8_t cmd[3] = { 0x00,
+    (uint8_t)(flipped ? SSD1306_SEGREMAP : SSD1306_SEGREMAP | 0x1),
+    (uint8_t)(flipped ? SSD1306_COMSCANINC : SSD1306_COMSCANDEC) };
+  wire->queue(i2caddr, twbr, cmd, sizeof(cmd));
 }
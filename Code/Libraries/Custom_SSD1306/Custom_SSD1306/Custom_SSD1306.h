@@ -36,7 +36,7 @@
   typedef class HardwareSPI SPIClass;
 #endif
 
-#include <Wire.h>
+#include <Custom_TWI.h>
 #include <SPI.h>
 #include <Custom_GFX.h>
 
@@ -80,7 +80,7 @@
 #define SSD1306_SETMULTIPLEX        0xA8 ///< See datasheet
 #define SSD1306_DISPLAYOFF          0xAE ///< See datasheet
 #define SSD1306_DISPLAYON           0xAF ///< See datasheet
-#define SSD1306_COMSCANINC          0xC0 ///< Not currently used
+#define SSD1306_COMSCANINC          0xC0 ///< See datasheet
 #define SSD1306_COMSCANDEC          0xC8 ///< See datasheet
 #define SSD1306_SETDISPLAYOFFSET    0xD3 ///< See datasheet
 #define SSD1306_SETDISPLAYCLOCKDIV  0xD5 ///< See datasheet
@@ -124,38 +124,51 @@
 class Custom_SSD1306 : public Custom_GFX {
  public:
   // NEW CONSTRUCTORS -- recommended for new projects
-  Custom_SSD1306(uint8_t w, uint8_t h, TwoWire *twi=&Wire, int8_t rst_pin=-1,
-    uint32_t clkDuring=400000UL, uint32_t clkAfter=100000UL);
+  Custom_SSD1306(uint8_t w, uint8_t h, Custom_TWI *twi=&Twi, int8_t rst_pin=-1,
+    uint32_t clk=400000UL, uint8_t *frame=NULL);
 
   ~Custom_SSD1306(void);
 
   boolean      begin(uint8_t switchvcc=SSD1306_SWITCHCAPVCC,
                  uint8_t i2caddr=0, boolean reset=true,
                  boolean periphBegin=true);
-  void         display(void);
-  void         clearDisplay(void);
+  virtual void display(TWICallback done=NULL);
+  void         displayRegion(uint8_t x0, uint8_t page0, uint8_t x1,
+                 uint8_t page1, TWICallback done=NULL);
+  virtual void clearDisplay(void);
+  uint8_t     *getBuffer(void);
   void         invertDisplay(boolean i);
   void         dim(boolean dim, uint8_t customContrast);
+  void         flip(boolean flipped);
   void         drawPixel(int16_t x, int16_t y, uint16_t color);
+  void         fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                 uint16_t color);
+  void         writeFillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                 uint16_t color);
+  void         drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+  void         writeFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
   void         ssd1306_command(uint8_t c);
 
  private:
   inline void  SPIwrite(uint8_t d) __attribute__((always_inline));
   void         ssd1306_command1(uint8_t c);
   void         ssd1306_commandList(const uint8_t *c, uint8_t n);
+  static void  maskColumns(uint8_t *p, int16_t w, uint8_t mask,
+                 uint16_t color);
 
   SPIClass    *spi;
-  TwoWire     *wire;
+  boolean      heapBuffer;  // buffer was malloc()ed by begin()
+ protected:
+  Custom_TWI  *wire;
   uint8_t     *buffer;
-  int8_t       i2caddr, vccstate, page_end;
+  int8_t       i2caddr;
+  uint8_t      twbr;        // TWI bit rate for SSD1306 transfers
+ private:
+  int8_t       vccstate, page_end;
   int8_t       mosiPin    ,  clkPin    ,  dcPin    ,  csPin, rstPin;
 #ifdef HAVE_PORTREG
   PortReg     *mosiPort   , *clkPort   , *dcPort   , *csPort;
   PortMask     mosiPinMask,  clkPinMask,  dcPinMask,  csPinMask;
-#endif
-#if ARDUINO >= 157
-  uint32_t     wireClk;    // Wire speed for SSD1306 transfers
-  uint32_t     restoreClk; // Wire speed following SSD1306 transfers
 #endif
   uint8_t      contrast;    // normal contrast setting for this device
 #if defined(SPI_HAS_TRANSACTION)
@@ -165,4 +178,63 @@ protected:
 #endif
 };
 
+/*!
+    @brief  SSD1306 display whose buffer is a member array sized at compile
+            time, instead of being malloc()ed by begin(). The buffer shows
+            up in the linker's memory report, it can't fragment the heap,
+            and clearDisplay()/display() loop over constant bounds. They
+            override the base versions, so calls through a Custom_SSD1306
+            reference or pointer, and begin()'s own clearDisplay(), get
+            them too.
+    @tparam W  Display width in pixels.
+    @tparam H  Display height in pixels.
+*/
+template <uint8_t W, uint8_t H>
+class Custom_SSD1306_Static : public Custom_SSD1306 {
+ public:
+  static const uint8_t PAGES = (H + 7) / 8; ///< 8-pixel pages in the buffer
+
+  /*!
+      @brief  Constructor, see Custom_SSD1306 for the arguments.
+  */
+  Custom_SSD1306_Static(Custom_TWI *twi=&Twi, int8_t rst_pin=-1,
+    uint32_t clk=400000UL) :
+    Custom_SSD1306(W, H, twi, rst_pin, clk, frame) {
+  }
+
+  /*!
+      @brief  Clear the buffer, see Custom_SSD1306::clearDisplay().
+  */
+  void clearDisplay(void) override {
+    wire->flush(); // the previous frame may still be going out of this buffer
+    memset(frame, 0, sizeof(frame));
+  }
+
+  /*!
+      @brief  Push the buffer to the display, see Custom_SSD1306::display().
+      @param  done  Called once the last page has gone out, or NULL.
+  */
+  void display(TWICallback done=NULL) override {
+    TWI_TRACE_SCOPE(wire, "display");
+    uint8_t dlist1[] = {
+      0x00,                    // Co = 0, D/C = 0
+      SSD1306_PAGEADDR,
+      0,                       // Page start address
+      0xFF,                    // Page end (not really, but works here)
+      SSD1306_COLUMNADDR,
+      0,                       // Column start address
+      (uint8_t)(W - 1) };      // Column end address
+    wire->queue(i2caddr, twbr, dlist1, sizeof(dlist1));
+
+    static const uint8_t dataMode = 0x40; // Co = 0, D/C = 1
+    for(uint8_t page = 0; page < PAGES; page++) {
+      wire->queue(i2caddr, twbr, &dataMode, 1, frame + page * W, W,
+        NULL, 0, page == PAGES - 1 ? done : NULL);
+    }
+  }
+
+ private:
+  uint8_t frame[W * PAGES];
+};
+
 #endif // _Adafruit_SSD1306_H_
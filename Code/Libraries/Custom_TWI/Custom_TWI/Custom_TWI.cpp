@@ -0,0 +1,423 @@
+/*!
+ * @file Custom_TWI.cpp
+ *
+ * Interrupt-driven I2C master, see Custom_TWI.h.
+ *
+ * The TWI interrupt walks the active transaction through the standard AVR
+ * master-transmitter / master-receiver state machine (datasheet section
+ * "2-wire Serial Interface"). When a transaction finishes, its callback is
+ * run and the next queued one is started straight from the interrupt, so
+ * back-to-back transfers need no help from loop().
+ *
+ * Every wait for the bus goes through poll(), which times out a stuck
+ * transaction and recovers the bus, so no call here can block forever.
+ *
+ */
+
+#include <util/twi.h>
+#include "Custom_TWI.h"
+
+// Hardware control values for TWCR
+#define TWCR_IDLE  (_BV(TWEN) | _BV(TWIE))                  ///< Enabled, interrupts on
+#define TWCR_NEXT  (TWCR_IDLE | _BV(TWINT))                 ///< Continue, NACK reads
+#define TWCR_ACK   (TWCR_NEXT | _BV(TWEA))                  ///< Continue, ACK reads
+#define TWCR_START (TWCR_NEXT | _BV(TWSTA))                 ///< (Repeated) START
+#define TWCR_STOP  (TWCR_NEXT | _BV(TWSTO))                 ///< STOP
+
+Custom_TWI Twi;
+volatile uint8_t Custom_TWI::syncStatus;
+
+/*!
+    @brief  Constructor. Call begin() before queueing transfers.
+*/
+Custom_TWI::Custom_TWI(void) :
+  active(NULL), head(0), count(0), urgentQueued(false),
+  activeUrgent(false), reading(false), index(0), byteCount(0)
+#ifdef TWI_TRACE
+  , tag(NULL), traceHead(0), traceCount(0), traceDropped(0)
+#endif
+  {
+}
+
+/*!
+    @brief  Enable the TWI peripheral and the internal pull-ups on SDA/SCL,
+            same as Wire.begin() does.
+*/
+void Custom_TWI::begin(void) {
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  TWSR = 0;           // prescaler 1, bitRate() assumes this
+  TWBR = bitRate(100000UL);
+  TWCR = TWCR_IDLE;
+}
+
+/*!
+    @brief  Work out the TWBR value for an SCL frequency.
+    @param  frequency  SCL frequency in Hz.
+    @return TWBR value, to be passed with each transaction.
+*/
+uint8_t Custom_TWI::bitRate(uint32_t frequency) {
+  return ((F_CPU / frequency) - 16) / 2;
+}
+
+/*!
+    @brief  Queue a transfer and return straight away. If the queue is
+            full, waits for a slot to free up.
+    @param  address       7-bit I2C address.
+    @param  twbr          Bit rate for this device, see bitRate().
+    @param  header        Bytes sent first. Copied, so may be temporary.
+    @param  headerLength  Up to TWI_HEADER_MAX bytes.
+    @param  data          Bytes sent after the header. NOT copied: must
+                          stay untouched until the transfer completes.
+    @param  dataLength    Number of data bytes.
+    @param  readBuffer    If readLength is not 0, read bytes go here after
+                          a repeated start.
+    @param  readLength    Number of bytes to read.
+    @param  callback      Called from the interrupt when done, or NULL.
+    @note   Must be called with interrupts enabled.
+*/
+void Custom_TWI::queue(uint8_t address, uint8_t twbr,
+  const uint8_t *header, uint8_t headerLength,
+  const uint8_t *data, uint16_t dataLength,
+  uint8_t *readBuffer, uint8_t readLength, TWICallback callback) {
+
+  while(count >= TWI_QUEUE_LENGTH) poll(); // the interrupt frees a slot
+
+  uint8_t sreg = SREG;
+  cli();
+  TWITransaction *t = &slots[(head + count) % TWI_QUEUE_LENGTH];
+  t->address      = address;
+  t->twbr         = twbr;
+  t->headerLength = min(headerLength, (uint8_t)TWI_HEADER_MAX);
+  memcpy(t->header, header, t->headerLength);
+  t->data         = data;
+  t->dataLength   = data ? dataLength : 0;
+  t->readBuffer   = readBuffer;
+  t->readLength   = readBuffer ? readLength : 0;
+  t->callback     = callback;
+  byteCount += t->headerLength + t->dataLength + t->readLength;
+#ifdef TWI_TRACE
+  t->tag          = tag;
+#endif
+  count++;
+  if(!active) startNext();
+  SREG = sreg;
+}
+
+/*!
+    @brief  Blocking transfer that goes ahead of anything still queued
+            once the current transaction finishes.
+    @param  address    7-bit I2C address.
+    @param  twbr       Bit rate for this device, see bitRate().
+    @param  out        Bytes to write, up to TWI_HEADER_MAX.
+    @param  outLength  Number of bytes to write.
+    @param  in         Buffer for bytes read after a repeated start.
+    @param  inLength   Number of bytes to read, 0 for write only.
+    @return TWI_OK or one of the TWI_ error codes.
+    @note   Must be called with interrupts enabled, never from a callback.
+*/
+uint8_t Custom_TWI::transfer(uint8_t address, uint8_t twbr,
+  const uint8_t *out, uint8_t outLength, uint8_t *in, uint8_t inLength) {
+
+  syncStatus = TWI_PENDING;
+
+  uint8_t sreg = SREG;
+  cli();
+  urgent.address      = address;
+  urgent.twbr         = twbr;
+  urgent.headerLength = min(outLength, (uint8_t)TWI_HEADER_MAX);
+  memcpy(urgent.header, out, urgent.headerLength);
+  urgent.data         = NULL;
+  urgent.dataLength   = 0;
+  urgent.readBuffer   = in;
+  urgent.readLength   = in ? inLength : 0;
+  urgent.callback     = syncDone;
+  byteCount += urgent.headerLength + urgent.readLength;
+#ifdef TWI_TRACE
+  urgent.tag          = tag;
+#endif
+  urgentQueued = true;
+  if(!active) startNext();
+  SREG = sreg;
+
+  while(syncStatus == TWI_PENDING) poll();
+  return syncStatus;
+}
+
+/*!
+    @brief  Wait until every queued transfer has completed, or failed.
+*/
+void Custom_TWI::flush(void) {
+  while(active) poll();
+}
+
+/*!
+    @brief  Check the running transaction against TWI_TIMEOUT_MS and
+            recover the bus if it has overrun. Call regularly from loop();
+            the blocking calls here do so while they wait.
+    @note   Must be called with interrupts enabled, never from a callback.
+*/
+void Custom_TWI::poll(void) {
+  uint8_t sreg = SREG;
+  cli();
+  bool stuck = active && (millis() - startMs > TWI_TIMEOUT_MS);
+  SREG = sreg;
+  if(stuck) recover();
+}
+
+// Fail everything queued, clear the bus and start the TWI again
+void Custom_TWI::recover(void) {
+  uint8_t sreg = SREG;
+  cli();
+  TWCR = 0;           // hand the pins back to the port
+  faultCounts.timeouts++;
+  faultCounts.recoveries++;
+#ifdef TWI_TRACE
+  if(active) record(TWI_TIMEOUT);
+#endif
+  if(urgentQueued && urgent.callback) urgent.callback(TWI_TIMEOUT);
+  while(count) {
+    TWICallback callback = slots[head].callback;
+    head = (head + 1) % TWI_QUEUE_LENGTH;
+    count--;
+    if(callback) callback(TWI_TIMEOUT);
+  }
+  urgentQueued = false;
+  active = NULL;
+  SREG = sreg;
+
+  clearBus();
+  begin();
+}
+
+// Free a slave that is holding SDA low partway through a byte: clock SCL
+// until it lets go (at most 9 clocks), then send a STOP by hand. See the
+// I2C specification, "Bus clear".
+void Custom_TWI::clearBus(void) {
+  pinMode(SDA, INPUT_PULLUP);
+  digitalWrite(SCL, HIGH);
+  pinMode(SCL, OUTPUT);
+  for(uint8_t i = 0; i < TWI_RECOVERY_CLOCKS && !digitalRead(SDA); i++) {
+    digitalWrite(SCL, LOW);
+    delayMicroseconds(5);
+    digitalWrite(SCL, HIGH);
+    delayMicroseconds(5);
+  }
+  // STOP: SDA rises while SCL is high
+  digitalWrite(SCL, LOW);
+  pinMode(SDA, OUTPUT);
+  digitalWrite(SDA, LOW);
+  delayMicroseconds(5);
+  digitalWrite(SCL, HIGH);
+  delayMicroseconds(5);
+  pinMode(SDA, INPUT_PULLUP);
+  pinMode(SCL, INPUT_PULLUP);
+}
+
+// Completion callback for transfer()
+void Custom_TWI::syncDone(uint8_t status) {
+  syncStatus = status;
+}
+
+// Start the next transaction, priority slot first. Interrupts must be off
+// (or we're in the ISR).
+void Custom_TWI::startNext(void) {
+  if(urgentQueued) {
+    active = &urgent;
+    activeUrgent = true;
+  } else if(count) {
+    active = &slots[head];
+    activeUrgent = false;
+  } else {
+    active = NULL;
+    return;
+  }
+  reading = false;
+  index = 0;
+  startMs = millis();
+#ifdef TWI_TRACE
+  startUs = micros();
+#endif
+  TWBR = active->twbr;
+  TWCR = TWCR_START;
+}
+
+// Send STOP, wait for it to go out, then finish the transaction. If a
+// device holds SCL low the STOP never goes out; leave the transaction
+// active so poll() times it out and recovers the bus.
+void Custom_TWI::stop(uint8_t status) {
+  TWCR = TWCR_STOP;
+  uint8_t wait = 255; // a STOP takes a few microseconds at most
+  while((TWCR & _BV(TWSTO)) && --wait);
+  if(!wait) return;
+  complete(status);
+}
+
+// Release the slot, move on to the next transaction and then report the
+// result. Starting the next one first means a callback that queues a
+// transfer finds the bus busy and leaves it to the interrupt, instead of
+// starting it here only for startNext() to start it again.
+void Custom_TWI::complete(uint8_t status) {
+  TWICallback callback = active->callback;
+  if(status == TWI_NACK_ADDRESS || status == TWI_NACK_DATA) faultCounts.nacks++;
+  else if(status == TWI_ERROR) faultCounts.busErrors++;
+#ifdef TWI_TRACE
+  record(status);
+#endif
+  if(activeUrgent) {
+    urgentQueued = false;
+  } else {
+    head = (head + 1) % TWI_QUEUE_LENGTH;
+    count--;
+  }
+  startNext();
+  if(callback) callback(status);
+}
+
+/*!
+    @brief  Advance the active transaction by one bus event.
+*/
+void Custom_TWI::handleInterrupt(void) {
+  TWITransaction *t = active;
+  if(!t) {            // nothing to do, just release the bus
+    TWCR = TWCR_IDLE;
+    return;
+  }
+
+  switch(TW_STATUS) {
+  case TW_START:
+  case TW_REP_START:
+    TWDR = (t->address << 1) | (reading ? TW_READ : TW_WRITE);
+    TWCR = TWCR_NEXT;
+    break;
+
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK:
+    if(index < t->headerLength) {
+      TWDR = t->header[index++];
+      TWCR = TWCR_NEXT;
+    } else if(index - t->headerLength < t->dataLength) {
+      TWDR = t->data[index++ - t->headerLength];
+      TWCR = TWCR_NEXT;
+    } else if(t->readLength) {
+      reading = true;
+      index = 0;
+      TWCR = TWCR_START;
+    } else {
+      stop(TWI_OK);
+    }
+    break;
+
+  case TW_MT_SLA_NACK:
+  case TW_MR_SLA_NACK:
+    stop(TWI_NACK_ADDRESS);
+    break;
+
+  case TW_MT_DATA_NACK:
+    stop(TWI_NACK_DATA);
+    break;
+
+  case TW_MR_DATA_ACK:
+    t->readBuffer[index++] = TWDR;
+    // fall through, decide whether to ACK the next byte
+  case TW_MR_SLA_ACK:
+    TWCR = (index + 1 < t->readLength) ? TWCR_ACK : TWCR_NEXT;
+    break;
+
+  case TW_MR_DATA_NACK:
+    t->readBuffer[index++] = TWDR;
+    stop(TWI_OK);
+    break;
+
+  case TW_MT_ARB_LOST:
+    TWCR = TWCR_NEXT; // release the bus, no STOP
+    complete(TWI_ERROR);
+    break;
+
+  case TW_BUS_ERROR:
+  default:
+    stop(TWI_ERROR);
+    break;
+  }
+}
+
+#ifdef TWI_TRACE
+/*!
+    @brief  Set the call site name that transactions queued from now on
+            are traced under. TWI_TRACE_SCOPE() is the easier way.
+    @param  tag  Name in flash, or NULL.
+    @return The previous name.
+*/
+PGM_P Custom_TWI::traceTag(PGM_P tag) {
+  PGM_P previous = this->tag;
+  this->tag = tag;
+  return previous;
+}
+
+/*!
+    @brief  Print and remove traced transactions, oldest first, one line
+            each: "TWI start_us duration_us address written read status
+            tag". Only prints what fits in out's transmit buffer, so it
+            never waits and is safe to call on every pass of loop(). When
+            transactions were dropped because the trace was full, a
+            "TWI-DROPPED count" line comes just before the first one
+            traced after them, where they happened in the stream, so a
+            reader can tell the time they took from an idle bus.
+    @param  out  Where to print, normally Serial. Needs a working
+                 availableForWrite().
+*/
+void Custom_TWI::dumpTrace(Print &out) {
+  char line[64];
+
+  // the interrupt only ever adds entries after the oldest one, so the
+  // oldest can be printed with interrupts on and changed or removed
+  // afterwards
+  uint8_t sreg = SREG;
+  while(traceCount) {
+    cli();
+    TWITraceEntry *e = &trace[(traceHead + TWI_TRACE_LENGTH - traceCount) % TWI_TRACE_LENGTH];
+    SREG = sreg;
+    if(e->dropped) {
+      uint8_t length = snprintf_P(line, sizeof(line), PSTR("TWI-DROPPED %u\n"), e->dropped);
+      if(out.availableForWrite() < length) return;
+      out.print(line);
+      e->dropped = 0;
+    }
+    uint8_t length = snprintf_P(line, sizeof(line), PSTR("TWI %lu %u %02x %u %u %u %S\n"),
+      e->start, e->duration, e->address, e->written, e->read, e->status,
+      e->tag ? e->tag : PSTR("-"));
+    if(out.availableForWrite() < length) return;
+    out.print(line);
+    cli();
+    traceCount--;
+    SREG = sreg;
+  }
+}
+
+// Add the active transaction to the trace, or count it as dropped if the
+// trace is full. The first entry after a run of drops carries their count.
+// Interrupts must be off (or we're in the ISR).
+void Custom_TWI::record(uint8_t status) {
+  if(traceCount >= TWI_TRACE_LENGTH) {
+    traceDropped++;
+    return;
+  }
+  TWITraceEntry *e = &trace[traceHead];
+  unsigned long duration = micros() - startUs;
+  e->start    = startUs;
+  e->duration = duration > 0xFFFF ? 0xFFFF : duration;
+  e->written  = active->headerLength + active->dataLength;
+  e->read     = active->readLength;
+  e->address  = active->address;
+  e->status   = status;
+  e->tag      = active->tag;
+  e->dropped  = traceDropped;
+  traceDropped = 0;
+  traceHead = (traceHead + 1) % TWI_TRACE_LENGTH;
+  traceCount++;
+}
+#endif
+
+ISR(TWI_vect) {
+  Twi.handleInterrupt();
+}
@@ -0,0 +1,232 @@
+/*!
+ * @file Custom_TWI.h
+ *
+ * Interrupt-driven, non-blocking I2C (TWI) master for the ATmega328's
+ * hardware TWI peripheral. Shared by the SSD1306 displays and the SPL06-007
+ * pressure sensor in place of the blocking Arduino Wire library.
+ *
+ * Transfers are queued and then run from the TWI interrupt, so a whole
+ * display frame goes out in the background while loop() keeps running.
+ * Each transaction carries its own bit rate, so devices with different
+ * clock speeds share the bus without re-programming TWBR around every
+ * call. A single priority slot lets short blocking transfers (sensor
+ * register reads) jump ahead of queued display data.
+ *
+ * No transaction can hold the bus for more than TWI_TIMEOUT_MS. When one
+ * does (a device stuck holding SDA low, a glitch that leaves the TWI
+ * waiting for an interrupt that never comes), poll() clears the bus with
+ * clock pulses and a STOP, restarts the peripheral and fails everything
+ * that was queued. The owner can watch faults().recoveries to know when
+ * its devices need setting up again.
+ *
+ * Uncomment TWI_TRACE below to record every transaction (address, bytes,
+ * start time, duration, result and the call site that queued it) in a
+ * small ring buffer. dumpTrace() prints it for scripts/twi_trace.py in the
+ * sketch folder, which works out where the bus time goes. Mark call sites
+ * with TWI_TRACE_SCOPE(), which compiles to nothing without TWI_TRACE.
+ *
+ */
+
+#ifndef _Custom_TWI_H_
+#define _Custom_TWI_H_
+
+#include <Arduino.h>
+
+#define TWI_QUEUE_LENGTH 8 ///< Normal-priority transactions that can be queued, a whole display frame (5) plus the commands sent with it
+#define TWI_HEADER_MAX   8 ///< Bytes copied into a transaction ahead of its data
+#define TWI_TIMEOUT_MS   25 ///< Longest a transaction may take, a full display page at 100 KHz is ~12ms
+#define TWI_RECOVERY_CLOCKS 9 ///< SCL pulses used to free a device holding SDA low
+
+//#define TWI_TRACE              ///< Record every transaction, see dumpTrace()
+#define TWI_TRACE_LENGTH 24      ///< Transactions the trace ring buffer holds, 15 bytes each
+
+#define TWI_OK           0 ///< Transaction completed
+#define TWI_NACK_ADDRESS 2 ///< Device did not acknowledge its address
+#define TWI_NACK_DATA    3 ///< Device did not acknowledge a data byte
+#define TWI_ERROR        4 ///< Bus error or lost arbitration
+#define TWI_TIMEOUT      5 ///< Transaction did not finish in time, the bus was recovered
+#define TWI_PENDING      0xFF ///< Transaction queued or still running
+
+/*!
+    @brief  Completion callback. Runs in interrupt context, so it must be
+            short and must not wait for the bus.
+    @param  status  TWI_OK or one of the TWI_ error codes.
+*/
+typedef void (*TWICallback)(uint8_t status);
+
+/*!
+    @brief  One queued I2C transfer: a write of header bytes (copied) and
+            then data bytes (by pointer), optionally followed by a repeated
+            start and a read.
+*/
+struct TWITransaction {
+  uint8_t        address;               ///< 7-bit device address
+  uint8_t        twbr;                  ///< TWBR value for this device's clock
+  uint8_t        headerLength;          ///< Number of valid bytes in header
+  uint8_t        header[TWI_HEADER_MAX];///< Sent first, copied at queue time
+  const uint8_t *data;                  ///< Sent after the header, NOT copied
+  uint16_t       dataLength;            ///< Number of bytes at data
+  uint8_t       *readBuffer;            ///< Where read bytes are stored
+  uint8_t        readLength;            ///< Bytes to read, 0 for write only
+  TWICallback    callback;              ///< Called on completion, may be NULL
+#ifdef TWI_TRACE
+  PGM_P          tag;                   ///< Call site that queued it, in flash
+#endif
+};
+
+#ifdef TWI_TRACE
+/*!
+    @brief  One finished transaction in the trace, see
+            Custom_TWI::dumpTrace().
+*/
+struct TWITraceEntry {
+  unsigned long  start;                 ///< micros() when the START went out
+  uint16_t       duration;              ///< Microseconds to the STOP, saturates
+  uint16_t       written;               ///< Header and data bytes to write
+  uint8_t        read;                  ///< Bytes to read
+  uint8_t        address;               ///< 7-bit device address
+  uint8_t        status;                ///< TWI_OK or one of the TWI_ error codes
+  PGM_P          tag;                   ///< Call site, in flash, or NULL
+  uint16_t       dropped;               ///< Transactions dropped just before this one, the trace was full
+};
+#endif
+
+/*!
+    @brief  Running totals of failed transactions, see Custom_TWI::faults().
+*/
+struct TWIFaults {
+  uint16_t nacks;      ///< Transactions a device did not acknowledge
+  uint16_t busErrors;  ///< Bus errors and lost arbitration
+  uint16_t timeouts;   ///< Transactions that did not finish in time
+  uint8_t  recoveries; ///< Times the bus was cleared and the TWI restarted
+
+  /*!
+      @brief  Total of all failed transactions.
+      @return nacks + busErrors + timeouts, wraps around.
+  */
+  uint16_t total(void) const { return nacks + busErrors + timeouts; }
+};
+
+/*!
+    @brief  Class that stores state and functions for the TWI transaction
+            queue.
+*/
+class Custom_TWI {
+ public:
+  Custom_TWI(void);
+
+  void           begin(void);
+  static uint8_t bitRate(uint32_t frequency);
+
+  void           queue(uint8_t address, uint8_t twbr,
+                   const uint8_t *header, uint8_t headerLength,
+                   const uint8_t *data=NULL, uint16_t dataLength=0,
+                   uint8_t *readBuffer=NULL, uint8_t readLength=0,
+                   TWICallback callback=NULL);
+  uint8_t        transfer(uint8_t address, uint8_t twbr,
+                   const uint8_t *out, uint8_t outLength,
+                   uint8_t *in=NULL, uint8_t inLength=0);
+  void           flush(void);
+  void           poll(void);
+
+  /*!
+      @brief  Check whether a transaction is running or queued.
+      @return true while the bus has work to do.
+  */
+  bool           busy(void) const { return active != NULL; }
+
+  /*!
+      @brief  Fault counters, for diagnostics and for noticing that the bus
+              was recovered and the devices on it need re-initializing.
+      @return Reference to the running totals.
+  */
+  const TWIFaults &faults(void) const { return faultCounts; }
+
+  /*!
+      @brief  Bytes handed to queue() and transfer() so far, written and
+              read, not counting addresses. For measuring what a piece of
+              code costs on the bus.
+      @return Running total, wraps around.
+  */
+  uint32_t       bytes(void) const { return byteCount; }
+
+  /*!
+      @brief  The clock device drivers written against a bus time their
+              waits with, so a stand-in bus can bring its own.
+      @return millis().
+  */
+  unsigned long  millis(void) const { return ::millis(); }
+
+  void           handleInterrupt(void); // Called from the TWI ISR only
+
+#ifdef TWI_TRACE
+  PGM_P          traceTag(PGM_P tag);
+  void           dumpTrace(Print &out);
+#else
+  PGM_P          traceTag(PGM_P tag) { return tag; } // Nothing to tag without the trace
+#endif
+
+ private:
+  void           startNext(void);
+  void           stop(uint8_t status);
+  void           complete(uint8_t status);
+  void           recover(void);
+  static void    clearBus(void);
+  static void    syncDone(uint8_t status);
+#ifdef TWI_TRACE
+  void           record(uint8_t status);
+#endif
+
+  TWITransaction           slots[TWI_QUEUE_LENGTH];
+  TWITransaction           urgent;
+  TWITransaction *volatile active;
+  volatile uint8_t         head, count;
+  volatile bool            urgentQueued;
+  volatile bool            activeUrgent;
+  volatile bool            reading;
+  volatile uint16_t        index;
+  volatile unsigned long   startMs;
+  TWIFaults                faultCounts;
+  uint32_t                 byteCount;
+  static volatile uint8_t  syncStatus;
+#ifdef TWI_TRACE
+  PGM_P                    tag;
+  volatile unsigned long   startUs;
+  TWITraceEntry            trace[TWI_TRACE_LENGTH];
+  volatile uint8_t         traceHead, traceCount;
+  volatile uint16_t        traceDropped;
+#endif
+};
+
+#ifdef TWI_TRACE
+/*!
+    @brief  Tags every transaction queued while it is in scope with a call
+            site name, and puts the previous tag back when it goes out of
+            scope. Use it through TWI_TRACE_SCOPE().
+*/
+class TWITraceScope {
+ public:
+  /*!
+      @brief  Start tagging.
+      @param  twi  Bus the transactions go out on.
+      @param  tag  Call site name, in flash.
+  */
+  TWITraceScope(Custom_TWI *twi, PGM_P tag) :
+    twi(twi), previous(twi->traceTag(tag)) {
+  }
+  ~TWITraceScope(void) { twi->traceTag(previous); }
+
+ private:
+  Custom_TWI *twi;
+  PGM_P       previous;
+};
+
+/// Tag the rest of the enclosing block's transactions on twi with name
+#define TWI_TRACE_SCOPE(twi, name) TWITraceScope twiTraceScope(twi, PSTR(name))
+#else
+#define TWI_TRACE_SCOPE(twi, name)
+#endif
+
+extern Custom_TWI Twi; ///< The one hardware TWI bus
+
+#endif // _Custom_TWI_H_
@@ -1,98 +1,65 @@
 #include <SPL06-007.h>
-#include <Wire.h>
+#include <Custom_TWI.h>
 
+SPL06<Custom_TWI> spl(Twi); // one sensor at SPL_ADDRESS, 2 pressure and 1 temperature measurements a second, 8x oversampled
+
+double altitude(double pressure, double seaLevelhPa) {
+  return 44330 * (1.0 - pow(pressure / seaLevelhPa, 0.1903)); // meters
+}
 
 void setup() {
-  Wire.begin();    // begin Wire(I2C)
+  Twi.begin();     // begin TWI(I2C)
   Serial.begin(115200); // begin Serial
 
   Serial.println("\nGoertek-SPL06-007 Demo\n");
 
-  SPL_init(); // Setup initial SPL chip registers   
+  if (!spl.begin()) // Setup initial SPL chip registers
+    Serial.println("SPL06 not ready");
 }
 
 void loop() {
 
   // ---- Register Values ----------------
   Serial.print("ID: ");
-  Serial.println(get_spl_id());
+  Serial.println(spl.readRegister(0x0D));
 
   Serial.print("PRS_CFG: ");
-  Serial.println(get_spl_prs_cfg(),BIN);
+  Serial.println(spl.readRegister(0x06),BIN);
 
   Serial.print("TMP_CFG: ");
-  Serial.println(get_spl_tmp_cfg(),BIN);
+  Serial.println(spl.readRegister(0x07),BIN);
 
   Serial.print("MEAS_CFG: ");
-  Serial.println(get_spl_meas_cfg(),BIN);
+  Serial.println(spl.readRegister(0x08),BIN);
 
   Serial.print("CFG_REG: ");
-  Serial.println(get_spl_cfg_reg(),BIN);
+  Serial.println(spl.readRegister(0x09),BIN);
 
   Serial.print("INT_STS: ");
-  Serial.println(get_spl_int_sts(),BIN);
+  Serial.println(spl.readRegister(0x0A),BIN);
 
   Serial.print("FIFO_STS: ");
-  Serial.println(get_spl_fifo_sts(),BIN);
-
-
-  // ---- Coefficients ----------------
-  Serial.print("c0: ");
-  Serial.println(get_c0());
-
-  Serial.print("c1: ");
-  Serial.println(get_c1());
-
-  Serial.print("c00: ");
-  Serial.println(get_c00());
-
-  Serial.print("c10: ");
-  Serial.println(get_c10());
-
-  Serial.print("c01: ");
-  Serial.println(get_c01());
+  Serial.println(spl.readRegister(0x0B),BIN);
 
-  Serial.print("c11: ");
-  Serial.println(get_c11());
-  
-  Serial.print("c20: ");
-  Serial.println(get_c20());
-  
-  Serial.print("c21: ");
-  Serial.println(get_c21());
 
-  Serial.print("c30: ");
-  Serial.println(get_c30());
+  // ---- Measurement ----------------
+  // Wait for the next pressure conversion, so each pass reads a fresh one
+  if (!spl.waitStatus(SPL_PRS_RDY, SPL_FIRST_SAMPLE_TIMEOUT) || !spl.readSample()) {
+    Serial.println("SPL06 read failed\n");
+    delay(2000);
+    return;
+  }
 
-
-  // ---- Temperature Values ----------------  
-  Serial.print("traw: ");
-  Serial.println(get_traw());
-
-  Serial.print("traw_sc: ");
-  Serial.println(get_traw_sc(),3);
-  
   Serial.print("Temperature: ");
-  Serial.print(get_temp_c());
+  Serial.print(spl.tempC());
   Serial.println(" C");
-  
+
   Serial.print("Temperature: ");
-  Serial.print(get_temp_f());
+  Serial.print(spl.tempF());
   Serial.println(" F");
-  
-
-  // ---- Pressure Values ----------------
-  Serial.print("praw: ");
-  Serial.println(get_praw());
-  
-  Serial.print("praw_sc: ");
-  Serial.println(get_praw_sc(),3);
-
-  Serial.print("pcomp: ");
-  Serial.println(get_pcomp(),2);
 
   Serial.print("Measured Air Pressure: ");
-  Serial.print(get_pressure(),2);
+  Serial.print(spl.pressure(),2);
   Serial.println(" mb");
 
 
@@ -101,13 +68,13 @@ void loop() {
   Serial.print("Local Airport Sea Level Pressure: ");
   Serial.print(local_pressure,2);
   Serial.println(" mb");
-  
+
   Serial.print("altitude: ");
-  Serial.print(get_altitude(get_pressure(),local_pressure),1);
+  Serial.print(altitude(spl.pressure(),local_pressure),1);
   Serial.println(" m");
 
   Serial.print("altitude: ");
-  Serial.print(get_altitude_f(get_pressure(),local_pressure),1); // convert from meters to feet
+  Serial.print(altitude(spl.pressure(),local_pressure) * 3.28084,1); // convert from meters to feet
   Serial.println(" ft");
 
 
@@ -115,4 +82,3 @@ void loop() {
   Serial.println("\n");
   delay(2000);
 }
-
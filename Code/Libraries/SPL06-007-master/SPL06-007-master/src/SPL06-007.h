@@ -1,40 +1,230 @@
-#include "Arduino.h"
-
-void SPL_init();
-
-uint8_t get_spl_id();		// Get ID Register 		0x0D
-uint8_t get_spl_prs_cfg();	// Get PRS_CFG Register	0x06
-uint8_t get_spl_tmp_cfg();	// Get TMP_CFG Register	0x07
-uint8_t get_spl_meas_cfg();	// Get MEAS_CFG Register	0x08
-uint8_t get_spl_cfg_reg();	// Get CFG_REG Register	0x09
-uint8_t get_spl_int_sts();	// Get INT_STS Register	0x0A
-uint8_t get_spl_fifo_sts();	// Get FIFO_STS Register	0x0B
-
-double get_altitude(double pressure, double seaLevelhPa);	// get altitude in meters
-double get_altitude_f(double pressure, double seaLevelhPa);	// get altitude in feet
-
-int32_t get_traw();
-double get_traw_sc();
-double get_temp_c();
-double get_temp_f();
-double get_temperature_scale_factor();
-
-int32_t get_praw();
-double get_praw_sc();
-double get_pcomp();
-double get_pressure_scale_factor();
-double get_pressure();
-
-int16_t get_c0();
-int16_t get_c1();
-int32_t get_c00();
-int32_t get_c10();
-int16_t get_c01();
-int16_t get_c11();
-int16_t get_c20();
-int16_t get_c21();
-int16_t get_c30();
-
-void i2c_eeprom_write_uint8_t(  uint8_t deviceaddress, uint8_t eeaddress, uint8_t data );
-uint8_t i2c_eeprom_read_uint8_t(  uint8_t deviceaddress, uint8_t eeaddress );
+#ifndef _SPL06_007_H_
+#define _SPL06_007_H_
 
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#define SPL_ADDRESS             0x76	// SDO tied to ground
+#define SPL_ADDRESS_ALT         0x77	// SDO high, the second sensor on a bus
+
+#define SPL_BUS_OK              0	// what Bus::transfer() returns on success, Custom_TWI's TWI_OK
+
+#define SPL_I2C_CLOCK 400000UL	// SPL06 supports fast mode (and faster)
+#define SPL_TWBR (((F_CPU / SPL_I2C_CLOCK) - 16) / 2)	// same as Custom_TWI::bitRate(), folded at compile time
+
+// MEAS_CFG (0x08) measurement control values
+#define SPL_MEAS_STANDBY        0x00	// Idle, no conversions running
+#define SPL_MEAS_TEMP_ONCE      0x02	// Single temperature measurement, then back to idle
+#define SPL_MEAS_CONT_TEMP      0x06	// Continuous temperature measurement
+#define SPL_MEAS_CONT_PRS_TEMP  0x07	// Continuous pressure and temperature measurement
+
+// MEAS_CFG (0x08) status bits
+#define SPL_COEF_RDY            0x80	// Calibration coefficients can be read
+#define SPL_SENSOR_RDY          0x40	// Sensor initialization complete
+#define SPL_TMP_RDY             0x20	// New temperature measurement ready
+#define SPL_PRS_RDY             0x10	// New pressure measurement ready
+
+// CFG_REG (0x09) result shift bits, needed for more than 8x oversampling
+#define SPL_P_SHIFT             0x04
+#define SPL_T_SHIFT             0x08
+
+#define SPL_STARTUP_TIMEOUT     100	// ms, the datasheet gives 40ms from power-on to SENSOR_RDY
+#define SPL_FIRST_SAMPLE_TIMEOUT 1000	// ms, longer than one measurement period at the slowest rate SPL06 allows
+
+// Measurement rate (PRS_CFG/TMP_CFG bits 6-4), measurements per second in continuous mode
+enum SPLRate : uint8_t { SPL_RATE_1, SPL_RATE_2, SPL_RATE_4, SPL_RATE_8, SPL_RATE_16, SPL_RATE_32, SPL_RATE_64, SPL_RATE_128 };
+
+// Oversampling (PRS_CFG/TMP_CFG bits 3-0), conversions averaged into each measurement
+enum SPLOversampling : uint8_t { SPL_OVERSAMPLE_1, SPL_OVERSAMPLE_2, SPL_OVERSAMPLE_4, SPL_OVERSAMPLE_8, SPL_OVERSAMPLE_16, SPL_OVERSAMPLE_32, SPL_OVERSAMPLE_64, SPL_OVERSAMPLE_128 };
+
+// Compensation scale factor kP/kT for an oversampling setting, datasheet table 4
+constexpr double spl_scale_factor(SPLOversampling oversampling)
+{
+	return oversampling == SPL_OVERSAMPLE_1 ? 524288.0 :
+		oversampling == SPL_OVERSAMPLE_2 ? 1572864.0 :
+		oversampling == SPL_OVERSAMPLE_4 ? 3670016.0 :
+		oversampling == SPL_OVERSAMPLE_8 ? 7864320.0 :
+		oversampling == SPL_OVERSAMPLE_16 ? 253952.0 :
+		oversampling == SPL_OVERSAMPLE_32 ? 516096.0 :
+		oversampling == SPL_OVERSAMPLE_64 ? 1040384.0 : 2088960.0;
+}
+
+// Time one measurement takes, in 1/10 ms, datasheet table 5
+constexpr uint16_t spl_measurement_time(SPLOversampling oversampling)
+{
+	return oversampling == SPL_OVERSAMPLE_1 ? 36 :
+		oversampling == SPL_OVERSAMPLE_2 ? 52 :
+		oversampling == SPL_OVERSAMPLE_4 ? 84 :
+		oversampling == SPL_OVERSAMPLE_8 ? 148 :
+		oversampling == SPL_OVERSAMPLE_16 ? 276 :
+		oversampling == SPL_OVERSAMPLE_32 ? 532 :
+		oversampling == SPL_OVERSAMPLE_64 ? 1044 : 2068;
+}
+
+// One SPL06-007 on a bus. The measurement setup is fixed at compile time, so the register values
+// and the scale factors are constants and the compensation is compiled for exactly that setup.
+// Bus is anything with Custom_TWI's
+//   uint8_t transfer(address, twbr, out, outLength, in, inLength)	SPL_BUS_OK on success
+//   unsigned long millis()	the clock begin() times the sensor's startup against
+//   PGM_P traceTag(PGM_P tag)	tags the transactions that follow, returns the tag it replaces
+// so a mock bus can stand in for it off the target, with nothing else from the Arduino core.
+//
+// Data-ready driven reads: poll newData() (a single byte read) and only call readSample() when it
+// reports a new conversion. Reading the results clears the ready flags, so every conversion is read
+// and compensated exactly once. Coefficients are cached by begin().
+#define SPL_TRACE_SCOPE(name) TraceScope splTraceScope(bus, PSTR(name))
+
+template <class Bus, SPLRate prsRate = SPL_RATE_2, SPLOversampling prsOversampling = SPL_OVERSAMPLE_8,
+	SPLRate tmpRate = SPL_RATE_1, SPLOversampling tmpOversampling = SPL_OVERSAMPLE_8>
+class SPL06
+{
+public:
+	static constexpr uint8_t PRS_CFG = (prsRate << 4) | prsOversampling;
+	static constexpr uint8_t TMP_CFG = 0x80 | (tmpRate << 4) | tmpOversampling;	// bit 7: the MEMS element, the one the coefficients are for
+	static constexpr uint8_t CFG_REG = (prsOversampling > SPL_OVERSAMPLE_8 ? SPL_P_SHIFT : 0) | (tmpOversampling > SPL_OVERSAMPLE_8 ? SPL_T_SHIFT : 0);
+
+	// Tags the bus transactions in the enclosing block with a call site name, for Custom_TWI's trace
+	class TraceScope
+	{
+	public:
+		TraceScope(Bus &bus, PGM_P tag) : bus(bus), previous(bus.traceTag(tag)) {}
+		~TraceScope() { bus.traceTag(previous); }
+
+	private:
+		Bus &bus;
+		PGM_P previous;
+	};
+
+	static_assert((uint32_t(1) << prsRate) * spl_measurement_time(prsOversampling) + (uint32_t(1) << tmpRate) * spl_measurement_time(tmpOversampling) <= 10000,
+		"SPL06 rate and oversampling need more than one second of measuring per second");
+
+	constexpr SPL06(Bus &bus, uint8_t address = SPL_ADDRESS) :
+		bus(bus), address(address), c0(0), c1(0), c01(0), c11(0), c20(0), c21(0), c30(0), c00(0), c10(0),
+		lastPressure(0), lastTempC(0) {}
+
+	// Wait for the sensor to come up, then configure it. false if it never became ready
+	bool begin()
+	{
+		SPL_TRACE_SCOPE("SPL06::begin");
+		// The sensor needs some time after power-on. Poll for it instead of waiting a fixed time
+		bool ready = waitStatus(SPL_SENSOR_RDY | SPL_COEF_RDY, SPL_STARTUP_TIMEOUT);
+		writeRegister(0x06, PRS_CFG);
+		writeRegister(0x07, TMP_CFG);
+		setMeasCtrl(SPL_MEAS_CONT_PRS_TEMP);	// continuous temp and pressure measurement
+		writeRegister(0x09, CFG_REG);	// result shifts for more than 8x oversampling, no FIFO
+		return readCoefficients() && ready;
+	}
+
+	// SPL_PRS_RDY and/or SPL_TMP_RDY if a new conversion is waiting, 0 otherwise
+	uint8_t newData()
+	{
+		SPL_TRACE_SCOPE("SPL06::newData");
+		uint8_t meas_cfg = readRegister(0x08);
+		if (meas_cfg == 0xFF)	// failed read
+			return 0;
+		return meas_cfg & (SPL_PRS_RDY | SPL_TMP_RDY);
+	}
+
+	// Burst read the results and compensate them. false if the read failed
+	bool readSample()
+	{
+		SPL_TRACE_SCOPE("SPL06::readSample");
+		uint8_t b[6];	// PSR_B2..B0, TMP_B2..B0
+		if (!readBurst(0x00, b, sizeof(b)))
+			return false;
+
+		// kP and kT are constants, so these are multiplications by folded reciprocals, not divisions
+		double praw_sc = signExtend(((uint32_t)b[0] << 16) | ((uint32_t)b[1] << 8) | b[2], 24) * (1.0 / spl_scale_factor(prsOversampling));
+		double traw_sc = signExtend(((uint32_t)b[3] << 16) | ((uint32_t)b[4] << 8) | b[5], 24) * (1.0 / spl_scale_factor(tmpOversampling));
+
+		lastTempC = (double(c0) * 0.5f) + (double(c1) * traw_sc);
+		lastPressure = (double(c00) + praw_sc * (double(c10) + praw_sc * (double(c20) + praw_sc * double(c30))) + traw_sc * double(c01) + traw_sc * praw_sc * ( double(c11) + praw_sc * double(c21))) / 100;	// convert to mb
+		return true;
+	}
+
+	double pressure() const { return lastPressure; }	// Pressure in mb from the last readSample()
+	double tempC() const { return lastTempC; }	// Temperature in C from the last readSample()
+	double tempF() const { return (lastTempC * 9/5) + 32; }	// Temperature in F from the last readSample()
+
+	// Poll MEAS_CFG until all the given status bits are set
+	bool waitStatus(uint8_t bits, uint16_t timeout_ms)
+	{
+		SPL_TRACE_SCOPE("SPL06::waitStatus");
+		unsigned long start = bus.millis();
+		do {
+			uint8_t meas_cfg = readRegister(0x08);
+			if (meas_cfg != 0xFF && (meas_cfg & bits) == bits)	// 0xFF is a failed read, the register can't read back like that
+				return true;
+		} while (bus.millis() - start < timeout_ms);
+		return false;
+	}
+
+	// Set measurement mode in MEAS_CFG Register 0x08
+	void setMeasCtrl(uint8_t meas_ctrl)
+	{
+		SPL_TRACE_SCOPE("SPL06::setMeasCtrl");
+		// Only the MEAS_CTRL bits (2-0) are writable, the status bits are read-only
+		writeRegister(0x08, meas_ctrl & 0B0111);
+	}
+
+	void writeRegister(uint8_t reg, uint8_t data)
+	{
+		uint8_t out[2] = { reg, data };
+		// The SPL06 registers take writes back to back, unlike an EEPROM there's no write cycle to wait out
+		bus.transfer(address, SPL_TWBR, out, sizeof(out));
+	}
+
+	// 0xFF if the read failed
+	uint8_t readRegister(uint8_t reg)
+	{
+		uint8_t rdata = 0xFF;
+		// Register address write, repeated start, 1 byte read. Jumps ahead of any queued display data
+		if (bus.transfer(address, SPL_TWBR, &reg, 1, &rdata, 1) != SPL_BUS_OK)
+			rdata = 0xFF;
+		return rdata;
+	}
+
+	bool readBurst(uint8_t reg, uint8_t *data, uint8_t length)
+	{
+		// The register address auto-increments, so one transaction reads a whole block
+		return bus.transfer(address, SPL_TWBR, &reg, 1, data, length) == SPL_BUS_OK;
+	}
+
+private:
+	static int32_t signExtend(int32_t value, uint8_t bits)
+	{
+		if (value & ((int32_t)1 << (bits - 1)))
+			value |= -((int32_t)1 << bits);	// Set left bits to one for 2's complement conversion of negitive number
+		return value;
+	}
+
+	// Read all the calibration coefficients (0x10-0x21) in one burst
+	bool readCoefficients()
+	{
+		SPL_TRACE_SCOPE("SPL06::readCoefficients");
+		uint8_t b[18];
+		if (!readBurst(0x10, b, sizeof(b)))
+			return false;
+
+		c0  = signExtend(((uint16_t)b[0] << 4) | (b[1] >> 4), 12);
+		c1  = signExtend(((uint16_t)(b[1] & 0x0F) << 8) | b[2], 12);
+		c00 = signExtend(((uint32_t)b[3] << 12) | ((uint32_t)b[4] << 4) | (b[5] >> 4), 20);
+		c10 = signExtend(((uint32_t)(b[5] & 0x0F) << 16) | ((uint32_t)b[6] << 8) | b[7], 20);
+		c01 = (b[8] << 8) | b[9];
+		c11 = (b[10] << 8) | b[11];
+		c20 = (b[12] << 8) | b[13];
+		c21 = (b[14] << 8) | b[15];
+		c30 = (b[16] << 8) | b[17];
+		return true;
+	}
+
+	Bus &bus;
+	uint8_t address;
+	int16_t c0, c1, c01, c11, c20, c21, c30;
+	int32_t c00, c10;
+	double lastPressure, lastTempC;
+};
+
+#undef SPL_TRACE_SCOPE
+
+#endif // _SPL06_007_H_
@@ -0,0 +1,237 @@
+#include "AltitudeAlarm.h"
+
+//////////////////////////////////////////////////////////////////////////
+AltitudeAlarm::AltitudeAlarm() :
+  trueAltitudeFloor(0), trueAltitudeCeil(0), selectedAltitude(0), minimumsAltitude(0),
+  sensorMode(SensorModeOff), minimumsOn(false), minimumsSilenced(true),
+  lastRightRotaryActionTs(0), lastMinimumsAltitudeTs(0),
+  mode(AlarmDisabled), buzzCount(0), nextBuzzTs(0), lastAlarmTs(0),
+  powerUpSilence(cPowerUpSilence), minimumsTriggered(true), minimumsTriggeredTs(0),
+  buzzerOn(false), flashScreen(false), updateScreen(false) {
+  setThresholds();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void AltitudeAlarm::setThresholds() {
+  thresholdsAltitude = selectedAltitude;
+  below1000 = selectedAltitude - cAlarm1000ToGo;
+  above1000 = selectedAltitude + cAlarm1000ToGo;
+  below200 = selectedAltitude - cAlarm200ToGo;
+  above200 = selectedAltitude + cAlarm200ToGo;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// the buzzer stays quiet in silent mode, but the screen still flashes
+//////////////////////////////////////////////////////////////////////////
+void AltitudeAlarm::buzz(bool on) {
+  buzzerOn = on && sensorMode != SensorModeSilent;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// the thresholds are whole numbers, so for the true altitude x:
+//   x >= t  is  floor(x) >= t       x <= t  is  ceil(x) <= t
+//   x >  t  is  ceil(x) > t         x <  t  is  floor(x) < t
+//////////////////////////////////////////////////////////////////////////
+void AltitudeAlarm::update(unsigned long now) {
+  if (selectedAltitude != thresholdsAltitude) {
+    setThresholds();
+  }
+
+  //Handle changing of minimums altitude selection
+  if (sensorMode != SensorModeOff
+      && minimumsOn
+      && !minimumsSilenced
+      && !minimumsTriggered
+      && trueAltitudeCeil <= minimumsAltitude
+      && now - lastMinimumsAltitudeTs >= cDisableAlarmKnobMovementTime) {
+    mode = MinimumsAlarm;
+    minimumsTriggered = true;
+    minimumsTriggeredTs = now;
+  }
+
+  switch (mode) {
+    case Climbing1000ToGo:
+    {
+      if (trueAltitudeFloor >= below1000) {
+        mode = LongAlarm;
+        nextBuzzTs = now; //next buzz time is now
+      }
+      break;
+    }
+
+    case Descending1000ToGo:
+    {
+      if (trueAltitudeCeil <= above1000) {
+        mode = LongAlarm;
+        nextBuzzTs = now; //next buzz time is now
+      }
+      break;
+    }
+
+    case Climbing200ToGo:
+    {
+      if (trueAltitudeFloor >= below200) {
+        mode = UrgentAlarm;
+        nextBuzzTs = now; //next buzz time is now
+      }
+      else if (trueAltitudeFloor < below1000) {
+        mode = Climbing1000ToGo;
+      }
+      break;
+    }
+
+    case Descending200ToGo:
+    {
+      if (trueAltitudeCeil <= above200) {
+        mode = UrgentAlarm;
+        nextBuzzTs = now; //next buzz time is now
+      }
+      else if (trueAltitudeCeil > above1000) {
+        mode = Descending1000ToGo;
+      }
+      break;
+    }
+
+    case AltitudeDeviate: //We're looking to sound the alarm if pilot deviates from his altitude he already reached
+    {
+      if (trueAltitudeCeil > above200 || trueAltitudeFloor < below200) {
+        mode = UrgentAlarm; //initiate beeping the alarm on the next pass
+        nextBuzzTs = now; //next buzz time is now
+      }
+      break;
+    }
+
+    case UrgentAlarm:
+    {
+      if (buzzCount == 0) {
+        lastAlarmTs = now;
+        buzzCount = cUrgentBuzzNumberOfBeeps * 2;
+        flashScreen = true;
+      }
+      if (now >= nextBuzzTs) {
+        buzzCount--;
+        if (buzzCount % 2 == 1) {
+          buzz(true);
+          nextBuzzTs = now + cShortBuzzOnDuration;
+        }
+        else if (buzzCount != 0 && buzzCount % 2 == 0) {
+          buzz(false);
+          nextBuzzTs = now + cShortBuzzOffDuration;
+        }
+        else { //last cycle, turning everything off
+          mode = AlarmDisabled;
+          buzz(false);
+          flashScreen = false;
+        }
+        updateScreen = true;
+      }
+      break;
+    }
+
+    case MinimumsAlarm:
+    {
+      if (buzzCount == 0) {
+        lastAlarmTs = now;
+        /* each cycle of the pattern has 4 elements to it. short beep, short pause, long beep, pause between
+         * the next cycle of beeps. subtract 1 for the last cycle not having a long pause at the end */
+        buzzCount = cMinimumsNumberOfBeepCylces * 4;
+        flashScreen = true;
+        updateScreen = true;
+      }
+      if (now >= nextBuzzTs) {
+        buzzCount--;
+        if (buzzCount % 4 == 3) {
+          buzz(true);
+          nextBuzzTs = now + cMinimumsShortBuzzOnDuration;
+        }
+        else if (buzzCount % 4 == 2) {
+          buzz(false);
+          nextBuzzTs = now + cMinimumsBuzzOffDuration;
+        }
+        else if (buzzCount % 4 == 1) {
+          buzz(true);
+          nextBuzzTs = now + cMinimumsLongBuzzOnDuration;
+        }
+        else if (buzzCount != 0 && buzzCount % 4 == 0) {
+          buzz(false);
+          nextBuzzTs = now + cMinimumsOffBetweenCycleDuration;
+        }
+        else {
+          mode = AlarmDisabled;
+          buzz(false);
+          flashScreen = false;
+          updateScreen = true;
+        }
+      }
+      break;
+    }
+
+    case LongAlarm:
+      if (buzzCount == 0) {
+        lastAlarmTs = now;
+        buzzCount = 2;
+      }
+      if (now >= nextBuzzTs) {
+        buzzCount--;
+        if (buzzCount == 1) {
+          buzz(true);
+          nextBuzzTs = now + cLongBuzzDuration;
+          flashScreen = true;
+        }
+        else {
+          mode = AlarmDisabled;
+          buzz(false);
+          flashScreen = false;
+        }
+        updateScreen = true;
+      }
+      break;
+
+    case AlarmDisabled:
+    {
+      if (now - lastAlarmTs < cDisableAlarmAfterAlarmTime || now < powerUpSilence) {
+        //if alarm disabled or pressure sensor failed, do nothing
+      }
+      else if (sensorMode != SensorModeOff && selectedAltitude <= cHighestAltitudeAlert && now - lastRightRotaryActionTs >= cDisableAlarmKnobMovementTime) {
+        mode = DetermineAlarmState;
+        powerUpSilence = 0;
+      }
+      break;
+    }
+
+    default: //default case
+    case DetermineAlarmState:
+    {
+      //the selection minus the true altitude, cut to a whole number, used to be compared against the
+      //thresholds. It's over 1000 exactly when the altitude is a whole foot or more below
+      //selectedAltitude - 1000, i.e. ceil(x) < below1000, and likewise for the others
+      if (now - lastRightRotaryActionTs < cDisableAlarmKnobMovementTime) {
+        buzz(false); //stop the buzzer
+        flashScreen = false;
+        buzzCount = 0;
+      }
+      else if (sensorMode == SensorModeOff || selectedAltitude > cHighestAltitudeAlert) {
+        mode = AlarmDisabled;
+        buzz(false); //stop the buzzer
+        flashScreen = false;
+        buzzCount = 0;
+      }
+      else if (trueAltitudeCeil < below1000) {
+        mode = Climbing1000ToGo;
+      }
+      else if (trueAltitudeFloor > above1000) {
+        mode = Descending1000ToGo;
+      }
+      else if (trueAltitudeCeil < below200) {
+        mode = Climbing200ToGo;
+      }
+      else if (trueAltitudeFloor > above200) {
+        mode = Descending200ToGo;
+      }
+      else { //within 200ft either way, the only remaining logical choice
+        mode = AltitudeDeviate;
+      }
+      break;
+    }
+  }
+}
@@ -0,0 +1,82 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Altitude alarm state machine used by altitude_heading_reminder.ino.
+
+Everything the buzzer logic reads or writes lives inside one AltitudeAlarm
+object. It has no dependency on the sketch's globals or on the Arduino core:
+the sketch copies its inputs in, calls update() with the current time, and
+then drives the buzzer pin and the right screen from the outputs. Because of
+that, any number of independent copies can run side by side, for example on
+a host machine replaying many flight profiles at once.
+
+All of it is integer math. The true altitude comes in rounded both down and
+up, which is all it takes to compare it exactly against the whole-foot
+thresholds, and the thresholds around the selected altitude are only worked
+out again when the selection changes.
+*/
+#ifndef _ALTITUDE_ALARM_H_
+#define _ALTITUDE_ALARM_H_
+
+#include <stdint.h>
+#include "Units.h" //cAlarm200ToGo, cAlarm1000ToGo and cHighestAltitudeAlert
+
+enum SensorMode {SensorModeOff, SensorModeSilent, SensorModeOnHide, SensorModeOnShow, cNumberOfSensorModes};
+enum BuzzAlarmMode : uint8_t {Climbing1000ToGo, Climbing200ToGo, Descending1000ToGo, Descending200ToGo, AltitudeDeviate, UrgentAlarm, MinimumsAlarm, LongAlarm, AlarmDisabled, DetermineAlarmState};
+
+#define cLongBuzzDuration                     1000
+#define cShortBuzzOnDuration                  250
+#define cShortBuzzOffDuration                 100
+#define cMinimumsLongBuzzOnDuration           375
+#define cMinimumsShortBuzzOnDuration          125
+#define cMinimumsBuzzOffDuration              125
+#define cMinimumsOffBetweenCycleDuration      125
+#define cMinimumsNumberOfBeepCylces           5
+#define cUrgentBuzzNumberOfBeeps              3
+#define cDisableAlarmKnobMovementTime         1200
+#define cDisableAlarmAfterAlarmTime           1800
+#define cPowerUpSilence                       7000 //wait 7 seconds after start-up before alarm can begin making sounds. this is so you don't scare anyone with a loud alarm as soon as they start it up at home.
+
+struct AltitudeAlarm {
+  //Inputs. The owner copies these in before each call to update()
+  long          trueAltitudeFloor; //ft, the true altitude rounded down
+  long          trueAltitudeCeil;  //and rounded up, the same when it is a whole number
+  long          selectedAltitude;
+  long          minimumsAltitude;
+  SensorMode    sensorMode       : 3;
+  bool          minimumsOn       : 1;
+  bool          minimumsSilenced : 1;
+  unsigned long lastRightRotaryActionTs;
+  unsigned long lastMinimumsAltitudeTs;
+
+  //State. The knob interrupts write mode and minimumsTriggered, so those
+  //two are volatile and keep a byte each instead of sharing one with the
+  //bitfields
+  volatile BuzzAlarmMode mode;
+  int           buzzCount;
+  unsigned long nextBuzzTs;
+  unsigned long lastAlarmTs;
+  unsigned long powerUpSilence; //set to 0 once the start-up silence has passed
+  volatile bool minimumsTriggered;
+  unsigned long minimumsTriggeredTs;
+  long          thresholdsAltitude; //selected altitude the thresholds below belong to
+  long          below1000;          //selectedAltitude - cAlarm1000ToGo
+  long          above1000;          //selectedAltitude + cAlarm1000ToGo
+  long          below200;           //selectedAltitude - cAlarm200ToGo
+  long          above200;           //selectedAltitude + cAlarm200ToGo
+
+  //Outputs
+  bool          buzzerOn     : 1; //level the buzzer pin should be driven to
+  bool          flashScreen  : 1; //right screen should be shown inverted
+  bool          updateScreen : 1; //right screen needs a redraw. The owner clears this once it has been handled
+
+  AltitudeAlarm();
+  void update(unsigned long now);
+
+private:
+  void buzz(bool on);
+  void setThresholds();
+};
+
+#endif //_ALTITUDE_ALARM_H_
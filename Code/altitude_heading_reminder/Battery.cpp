@@ -0,0 +1,49 @@
+#include "Battery.h"
+#include <avr/sleep.h>
+#include <Custom_TWI.h>
+#include "BatteryTable.h" //battery percentage per raw ADC code, regenerate with scripts/make_battery_table.py
+
+//////////////////////////////////////////////////////////////////////////
+// averages a burst of battery readings, each one taken in ADC noise
+// reduction sleep so the CPU and I/O clocks are quiet during the
+// conversion. timer0 is paused while asleep, so millis() falls behind by
+// about 0.1ms per reading, which is nothing at one burst every 3 seconds.
+//////////////////////////////////////////////////////////////////////////
+int readBatteryAdc(uint8_t pin) {
+  unsigned int sum = 0;
+  Twi.flush(); //the TWI clock stops in ADC noise reduction mode, so don't leave a transfer hanging
+  analogRead(pin); //selects the channel & reference. The first conversion after a switch is thrown away
+
+  set_sleep_mode(SLEEP_MODE_ADC);
+  ADCSRA |= bit(ADIE);
+  for (int i = 0; i < cBatteryOversampleCount; i++) {
+    sleep_enable();
+    do {
+      sleep_cpu(); //entering ADC noise reduction mode starts the conversion
+    } while (bit_is_set(ADCSRA, ADSC)); //woken up by something other than the ADC, so go back to sleep until it's done
+    sleep_disable();
+    sum += ADC;
+  }
+  ADCSRA &= ~bit(ADIE);
+
+  return sum / cBatteryOversampleCount;
+}
+
+//////////////////////////////////////////////////////////////////////////
+EMPTY_INTERRUPT(ADC_vect); //only used to wake the CPU up once a battery reading is done
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t batteryLevelFromAdc(int adc) {
+  if (adc < cBatteryAdcTableStart) {
+    return 0; //set to 0% min.
+  }
+  if (adc >= cBatteryAdcTableStart + cBatteryAdcTableLength) {
+    return 100; //set to 100% max.
+  }
+  return pgm_read_byte(&cBatteryLevelTable[adc - cBatteryAdcTableStart]);
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool batteryChargingFromAdc(int adc) {
+  return adc >= cBatteryChargingAdc; //the battery can't be 4.16V, that's only possible when charging
+}
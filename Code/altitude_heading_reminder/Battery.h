@@ -0,0 +1,24 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Battery readings for altitude_heading_reminder.ino.
+
+readBatteryAdc() averages a burst of conversions of the battery voltage
+divider, and batteryLevelFromAdc() turns the result into a percentage with
+one lookup in the table from BatteryTable.h. The sketch keeps track of the
+charging state and of when to redraw; what is here only touches the ADC, so
+the host tests in sim/ can feed it conversions of their own.
+*/
+#ifndef _BATTERY_H_
+#define _BATTERY_H_
+
+#include <Arduino.h>
+
+#define cBatteryOversampleCount 8 //ADC readings averaged per battery update
+
+int     readBatteryAdc(uint8_t pin);
+uint8_t batteryLevelFromAdc(int adc);
+bool    batteryChargingFromAdc(int adc);
+
+#endif //_BATTERY_H_
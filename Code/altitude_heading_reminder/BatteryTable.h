@@ -0,0 +1,39 @@
+// Generated by scripts/make_battery_table.py, do not edit by hand.
+// Worst-case error against the discharge curve: 0.99%
+#ifndef _BATTERY_TABLE_H_
+#define _BATTERY_TABLE_H_
+
+#define cBatteryAdcTableStart  559  //ADC codes below this are 0%
+#define cBatteryAdcTableLength 407  //ADC codes at or past the end are 100%
+#define cBatteryChargingAdc    969  //4.16V, only possible while charging
+
+const uint8_t PROGMEM cBatteryLevelTable[cBatteryAdcTableLength] = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,
+    2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+    2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+    2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   3,   3,   3,
+    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
+    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,
+    3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   3,   4,   4,   4,   4,
+    4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,
+    4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,
+    4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   4,   5,   5,   5,   6,   6,
+    6,   6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  10,  11,  11,
+   11,  12,  12,  12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,
+   18,  19,  19,  20,  20,  21,  22,  22,  23,  23,  24,  24,  25,  25,  26,  26,
+   26,  27,  27,  28,  28,  29,  29,  29,  30,  31,  31,  32,  32,  33,  33,  34,
+   34,  35,  35,  36,  36,  36,  37,  37,  38,  38,  39,  39,  39,  40,  41,  42,
+   42,  43,  44,  44,  45,  46,  47,  47,  48,  49,  49,  51,  52,  53,  54,  55,
+   55,  56,  57,  58,  58,  59,  60,  60,  61,  61,  62,  62,  63,  63,  64,  65,
+   65,  66,  67,  67,  68,  69,  70,  70,  71,  71,  72,  72,  73,  73,  74,  74,
+   75,  76,  76,  77,  78,  79,  79,  80,  81,  82,  84,  85,  85,  86,  87,  87,
+   88,  89,  90,  90,  91,  92,  92,  93,  94,  95,  95,  95,  96,  96,  96,  97,
+   97,  97,  98,  98,  98,  99,  99,
+};
+
+#endif //_BATTERY_TABLE_H_
@@ -0,0 +1,90 @@
+#include "Benchmark.h"
+#include <Custom_TWI.h>
+
+#ifdef BENCHMARK
+
+static volatile uint16_t gBenchOverflows;
+static uint32_t gBenchCallCycles; //what timing an empty function costs, taken off every result
+
+ISR(TIMER1_OVF_vect) {
+  gBenchOverflows++;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// cycles since benchmarkBegin(). An overflow that hasn't been counted yet
+// shows up as a pending flag with a small TCNT1
+//////////////////////////////////////////////////////////////////////////
+static uint32_t benchCycles() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t low = TCNT1;
+  uint16_t high = gBenchOverflows;
+  if ((TIFR1 & _BV(TOV1)) && low < 0x8000) {
+    high++;
+  }
+  SREG = sreg;
+  return ((uint32_t)high << 16) | low;
+}
+
+//////////////////////////////////////////////////////////////////////////
+static uint32_t benchTime(uint16_t iterations, BenchFunction run, BenchFunction prepare) {
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < iterations; i++) {
+    if (prepare) {
+      prepare();
+    }
+    uint32_t start = benchCycles();
+    run();
+    total += benchCycles() - start;
+  }
+  return total;
+}
+
+//////////////////////////////////////////////////////////////////////////
+static void benchEmpty() {
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchmarkBegin() {
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); //no prescaler, one count per CPU cycle
+  TCNT1 = 0;
+  TIFR1 = _BV(TOV1);
+  TIMSK1 = _BV(TOIE1);
+  gBenchOverflows = 0;
+
+  gBenchCallCycles = 0;
+  gBenchCallCycles = benchTime(100, benchEmpty, NULL) / 100;
+  Serial.print(F("BENCH-BEGIN "));
+  Serial.println(F_CPU);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchmark(PGM_P name, uint16_t iterations, BenchFunction run, BenchFunction prepare) {
+  uint32_t bytes = Twi.bytes();
+  uint32_t cycles = benchTime(iterations, run, prepare);
+  bytes = Twi.bytes() - bytes;
+
+  uint32_t overhead = gBenchCallCycles * iterations;
+  cycles = cycles > overhead ? cycles - overhead : 0;
+
+  Serial.print(F("BENCH "));
+  Serial.print((const __FlashStringHelper *)name);
+  Serial.print(' ');
+  Serial.print(iterations);
+  Serial.print(' ');
+  Serial.print(cycles);
+  Serial.print(' ');
+  Serial.println(bytes);
+  Serial.flush(); //so the serial interrupt doesn't land in the next benchmark
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchmarkEnd() {
+  Serial.println(F("BENCH-END"));
+  Serial.flush();
+  TIMSK1 = 0;
+  TCCR1B = 0;
+}
+
+#endif //BENCHMARK
@@ -0,0 +1,31 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+On-target microbenchmarks, built in by uncommenting BENCHMARK below. The
+sketch then runs them at the end of setup() and carries on as normal.
+
+Timer1 runs at the CPU clock while a benchmark runs, so it counts cycles
+directly. benchmark() calls a function a number of times, adds up the
+cycles spent in it (minus the cost of the call itself) and the I2C bytes it
+queued, and prints one line over serial:
+  BENCH <name> <iterations> <cycles> <i2c bytes>
+scripts/bench.py compares those lines against a stored baseline.
+
+Interrupts stay on, since the I2C transfers need them, so the odd timer0
+tick lands in the numbers. Keep the iteration counts the same between runs.
+*/
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <Arduino.h>
+
+//#define BENCHMARK //run the benchmarks at boot, see runBenchmarks() in the sketch
+
+typedef void (*BenchFunction)();
+
+void benchmarkBegin();
+void benchmark(PGM_P name, uint16_t iterations, BenchFunction run, BenchFunction prepare = NULL);
+void benchmarkEnd();
+
+#endif //_BENCHMARK_H_
@@ -0,0 +1,102 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Everything the pilot sets on the device, in one packed struct.
+
+The knob interrupts change it and the main loop reads it, saves it and
+draws it. The booleans and small enums are bitfields, so a few of them
+share a byte. That means nobody can change one of them with a plain
+read-modify-write while an interrupt might change the byte's neighbour.
+So every change is made while holding a DeviceStateChange, which keeps
+interrupts off until it goes out of scope. Inside an interrupt that costs
+nothing, they are off already.
+
+A change also bumps the state's version numbers on the way out: version
+for any change at all, settingsVersion when something saved in EEPROM
+changed. The EEPROM save and the screens remember the version they last
+handled, so finding out whether there is anything new is one compare.
+
+The main loop reads the state through deviceStateSnapshot(), a copy taken
+with interrupts off, so a frame or a save never sees half of a knob turn.
+*/
+#ifndef _DEVICE_STATE_H_
+#define _DEVICE_STATE_H_
+
+#include <Arduino.h>
+#include "AltitudeAlarm.h" //SensorMode
+
+enum Cursor {
+    CursorSelectHeading,
+    CursorSelectAltimeter,
+    CursorSelectMinimumsOn,
+    CursorSelectMinimumsAltitude,
+    CursorSelectTimer,
+    CursorSelectBrightness, //starting here, values won't stay on the screen for more than a few seconds unless there is a rotary action
+    CursorSelectOffset,
+    CursorSelectSensor,
+    CursorSelectFlipDevice,
+    CursorViewSensorTemp,
+    CursorViewAltitude,
+    CursorViewBatteryLevel,
+    CursorViewMemory,
+    cNumberOfCursorModes };
+
+struct DeviceState {
+  //Settings, saved in EEPROM
+  long          selectedAltitude;
+  long          minimumsAltitude;
+  int           altimeterSetting;                  //in cAltimeterLabel units, see Units.h
+  int           calibratedAltitudeOffset;
+  int           permanentCalibratedAltitudeOffset;
+  int           selectedHeading;                   //degrees
+  SensorMode    sensorMode       : 3;
+  bool          oledDim          : 1;
+  bool          deviceFlipped    : 1;
+
+  //Selections that start over at power-up
+  bool          minimumsOn       : 1;
+  bool          minimumsSilenced : 1;
+  Cursor        cursor           : 4;
+
+  uint8_t       settingsVersion; //bumped by every change to the settings
+  uint8_t       version;         //bumped by every change
+
+  DeviceState() : minimumsOn(false), minimumsSilenced(true), cursor(CursorSelectHeading) {}
+};
+
+//Hold one of these while changing the state, see above
+class DeviceStateChange {
+ public:
+  DeviceStateChange(volatile DeviceState &state) : state(state), settingChanged(false), sreg(SREG) {
+    cli();
+  }
+
+  ~DeviceStateChange() {
+    state.version++;
+    if (settingChanged) {
+      state.settingsVersion++;
+    }
+    SREG = sreg;
+  }
+
+  //one of the settings changed, so the state needs saving
+  void setting() { settingChanged = true; }
+
+ private:
+  volatile DeviceState &state;
+  bool                  settingChanged;
+  uint8_t               sreg;
+};
+
+//////////////////////////////////////////////////////////////////////////
+static inline DeviceState deviceStateSnapshot(const volatile DeviceState &state) {
+  DeviceState snapshot;
+  uint8_t sreg = SREG;
+  cli();
+  memcpy(&snapshot, const_cast<const DeviceState *>(&state), sizeof(snapshot));
+  SREG = sreg;
+  return snapshot;
+}
+
+#endif //_DEVICE_STATE_H_
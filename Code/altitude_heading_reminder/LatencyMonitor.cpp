@@ -0,0 +1,136 @@
+#include "LatencyMonitor.h"
+#include <Custom_TWI.h>
+
+#ifdef LATENCY
+
+static volatile unsigned long gLatencyInputUs;  //first detent the screen doesn't show yet
+static volatile bool          gLatencyInputPending;
+static volatile unsigned long gLatencyFrameInputUs; //the detent the frame going out now will show
+static volatile unsigned long gLatencyFrameStartUs;
+static volatile bool          gLatencyFrameInFlight;
+static volatile unsigned long gLatencyResult[3];    //total, wait and frame of the last measurement, for the LATENCY line
+static volatile bool          gLatencyResultReady;
+static volatile uint16_t      gLatencyHistogram[cLatencyBuckets];
+static volatile uint16_t      gLatencyCount;
+static volatile unsigned long gLatencyMaxUs;
+static volatile uint16_t      gLatencyFailed;
+static unsigned long          gLatencyReportTs;
+static uint16_t               gLatencyReportedCount;
+
+//////////////////////////////////////////////////////////////////////////
+// called from the pin change interrupt on each detent. Only the first one
+// counts until a frame picks it up; later ones can't have waited longer
+//////////////////////////////////////////////////////////////////////////
+void latencyInput() {
+  if (!gLatencyInputPending) {
+    gLatencyInputUs = micros();
+    gLatencyInputPending = true;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// called just before the right screen is drawn. Detents that come in
+// after this may be too late for the frame, so they wait for the next one
+//////////////////////////////////////////////////////////////////////////
+void latencyFrameStart() {
+  noInterrupts();
+  if (gLatencyInputPending) {
+    gLatencyFrameInputUs = gLatencyInputUs;
+    gLatencyFrameStartUs = micros();
+    gLatencyFrameInFlight = true;
+    gLatencyInputPending = false;
+  }
+  interrupts();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// TWI callback on the last page of the right screen's frame
+//////////////////////////////////////////////////////////////////////////
+void latencyFrameDone(uint8_t status) {
+  if (!gLatencyFrameInFlight) {
+    return; //a frame nobody was waiting for
+  }
+  gLatencyFrameInFlight = false;
+
+  if (status != TWI_OK) {
+    gLatencyFailed++;
+    if (!gLatencyInputPending) { //the detent still isn't on the screen, keep timing it
+      gLatencyInputUs = gLatencyFrameInputUs;
+      gLatencyInputPending = true;
+    }
+    return;
+  }
+
+  unsigned long now = micros();
+  unsigned long total = now - gLatencyFrameInputUs;
+  gLatencyResult[0] = total;
+  gLatencyResult[1] = gLatencyFrameStartUs - gLatencyFrameInputUs;
+  gLatencyResult[2] = now - gLatencyFrameStartUs;
+  gLatencyResultReady = true;
+
+  unsigned long bucket = total / (cLatencyBucketMs * 1000UL);
+  gLatencyHistogram[min(bucket, cLatencyBuckets - 1UL)]++;
+  gLatencyCount++;
+  if (total > gLatencyMaxUs) {
+    gLatencyMaxUs = total;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// upper edge of the bucket holding the given percentile, in ms
+//////////////////////////////////////////////////////////////////////////
+static uint16_t latencyPercentile(uint16_t count, uint8_t percent) {
+  unsigned long needed = ((unsigned long)count * percent + 99) / 100;
+  unsigned long seen = 0;
+  for (uint8_t i = 0; i < cLatencyBuckets; i++) {
+    noInterrupts();
+    seen += gLatencyHistogram[i];
+    interrupts();
+    if (seen >= needed) {
+      return (i + 1) * cLatencyBucketMs;
+    }
+  }
+  return cLatencyBuckets * cLatencyBucketMs;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// sends the latest measurement, and the summary when there's something
+// new in it, as long as they fit in the serial transmit buffer
+//////////////////////////////////////////////////////////////////////////
+void latencyReport(Print &out) {
+  char line[64];
+
+  if (gLatencyResultReady) {
+    noInterrupts();
+    unsigned long total = gLatencyResult[0];
+    unsigned long wait = gLatencyResult[1];
+    unsigned long frame = gLatencyResult[2];
+    interrupts();
+    uint8_t length = snprintf_P(line, sizeof(line), PSTR("LATENCY %lu %lu %lu\n"), total, wait, frame);
+    if (out.availableForWrite() >= length) {
+      out.print(line);
+      gLatencyResultReady = false; //a newer one may overwrite it before then, the histogram still has it
+    }
+  }
+
+  if (millis() - gLatencyReportTs >= cLatencyReportInterval) {
+    noInterrupts();
+    uint16_t count = gLatencyCount;
+    unsigned long maxUs = gLatencyMaxUs;
+    uint16_t failed = gLatencyFailed;
+    interrupts();
+    if (count == gLatencyReportedCount) {
+      gLatencyReportTs = millis(); //nothing new, don't bother
+      return;
+    }
+    uint8_t length = snprintf_P(line, sizeof(line), PSTR("LATENCY-SUMMARY %u %u %u %lu %u\n"),
+      count, latencyPercentile(count, 50), latencyPercentile(count, 99), maxUs, failed);
+    if (out.availableForWrite() >= length) {
+      out.print(line);
+      gLatencyReportTs = millis();
+      gLatencyReportedCount = count;
+    }
+  }
+}
+
+#endif //LATENCY
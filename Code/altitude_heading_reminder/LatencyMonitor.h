@@ -0,0 +1,42 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Knob-to-pixel latency monitor, built in by uncommenting LATENCY below.
+
+Measures how long it takes a turn of the right knob to show up on the
+screen: from the pin change interrupt that saw the detent to the moment
+the last page of the first frame drawn after it has gone out over I2C.
+Time spent waiting behind the frame rate limit, sensor reads or EEPROM
+writes all counts, since the pilot sees all of it. Each measurement goes
+out over serial as it happens, and a summary every cLatencyReportInterval:
+  LATENCY <total us> <wait us> <frame us>
+  LATENCY-SUMMARY <count> <p50 ms> <p99 ms> <max us> <failed frames>
+wait is detent to starting the frame, frame is drawing plus the transfer.
+The percentiles come from a histogram of cLatencyBucketMs wide buckets, so
+they are upper bounds rounded to that. scripts/latency.py reads the lines
+from the device or from the simulator and checks them against a budget.
+*/
+#ifndef _LATENCY_MONITOR_H_
+#define _LATENCY_MONITOR_H_
+
+#include <Arduino.h>
+
+//#define LATENCY //time knob detents to the frame that shows them
+
+#define cLatencyBucketMs       4     //histogram resolution
+#define cLatencyBuckets        32    //the last one collects everything from 124ms up
+#define cLatencyReportInterval 10000 //ms between LATENCY-SUMMARY lines
+
+void latencyInput();
+void latencyFrameStart();
+void latencyFrameDone(uint8_t status);
+void latencyReport(Print &out);
+
+#ifdef LATENCY
+#define LATENCY_FRAME_DONE latencyFrameDone //pass to display() for the frames that show knob input
+#else
+#define LATENCY_FRAME_DONE NULL
+#endif
+
+#endif //_LATENCY_MONITOR_H_
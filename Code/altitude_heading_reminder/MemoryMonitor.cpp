@@ -0,0 +1,74 @@
+#include "MemoryMonitor.h"
+
+#ifdef __AVR__
+extern uint8_t __heap_start; //end of .bss/.noinit, where the heap begins
+extern uint8_t __stack;      //last byte of SRAM
+extern char   *__brkval;     //end of the heap, NULL until the first malloc()
+#endif //on the host these come from sim/host/Arduino.h
+
+MemoryStats gMemoryStats = { 0xFFFF, 0, 0, 0, 0 };
+
+#ifdef __AVR__
+//////////////////////////////////////////////////////////////////////////
+// paints the canary from the start of the heap to the top of SRAM. This
+// runs from .init1, before the stack pointer and r1 are set up, so it has
+// to be assembly and mustn't call anything
+//////////////////////////////////////////////////////////////////////////
+void paintStack() __attribute__((naked, used, section(".init1")));
+void paintStack() {
+  __asm volatile (
+    "    ldi r30, lo8(__heap_start)\n"
+    "    ldi r31, hi8(__heap_start)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M" (cStackCanary));
+}
+#endif
+
+#ifdef MEMORY_COUNT_ALLOCATIONS
+//////////////////////////////////////////////////////////////////////////
+// with the link made with --wrap, every malloc() and realloc() call comes
+// through here on its way to avr-libc's own. free() isn't counted, the
+// heap end in gMemoryStats already shows what comes back
+//////////////////////////////////////////////////////////////////////////
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_realloc(void *ptr, size_t size);
+
+extern "C" void *__wrap_malloc(size_t size) {
+  gMemoryStats.allocations++;
+  return __real_malloc(size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size) {
+  gMemoryStats.allocations++;
+  return __real_realloc(ptr, size);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+// counts the untouched canary bytes above the heap. Takes about 1ms per
+// kilobyte still free, so don't call it more than once a second or so
+//////////////////////////////////////////////////////////////////////////
+void updateMemoryStats() {
+  uint8_t *heapEnd = __brkval ? (uint8_t *)__brkval : &__heap_start;
+  uint8_t *stackTop = (uint8_t *)SP; //the stack pointer, the next byte a push will write
+
+  const uint8_t *p = heapEnd;
+  while (p < stackTop && *p == cStackCanary) {
+    p++;
+  }
+  unsigned int stackFree = p - heapEnd;
+
+  if (stackFree < gMemoryStats.stackFreeMin) {
+    gMemoryStats.stackFreeMin = stackFree;
+  }
+  gMemoryStats.freeNow = stackTop - heapEnd;
+  gMemoryStats.heapUsed = heapEnd - &__heap_start;
+  gMemoryStats.heapEnd = (uintptr_t)heapEnd;
+}
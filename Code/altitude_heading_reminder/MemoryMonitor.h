@@ -0,0 +1,39 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Stack and heap high-water-mark monitor.
+
+All SRAM between the end of the static data and the top of the stack is
+painted with a canary byte before anything else runs at boot. The stack
+overwrites the canary as it grows, so counting the canary bytes still left
+above the heap gives the smallest gap there has ever been between the
+stack and the heap. updateMemoryStats() does that count; call it every so
+often and read the results from gMemoryStats.
+
+With MEMORY_COUNT_ALLOCATIONS defined, malloc() and realloc() are also
+counted, so a heap that keeps growing can be told apart from one that was
+set up once at boot. That needs the link to be made with
+-Wl,--wrap=malloc,--wrap=realloc as well, which the breadboard board
+definition in boards.txt does along with defining the macro.
+*/
+#ifndef _MEMORY_MONITOR_H_
+#define _MEMORY_MONITOR_H_
+
+#include <Arduino.h>
+
+#define cStackCanary 0xC5 //unlikely to be written by real code, unlike 0x00 or 0xFF
+
+struct MemoryStats {
+  unsigned int stackFreeMin; //smallest gap ever seen between the heap and the stack, in bytes
+  unsigned int freeNow;      //gap between the heap and the stack pointer right now
+  unsigned int heapUsed;     //bytes handed out by malloc(), 0 while nothing uses the heap
+  uintptr_t    heapEnd;      //address the heap currently ends at
+  unsigned int allocations;  //malloc() and realloc() calls since power-up, with MEMORY_COUNT_ALLOCATIONS
+};
+
+extern MemoryStats gMemoryStats;
+
+void updateMemoryStats();
+
+#endif //_MEMORY_MONITOR_H_
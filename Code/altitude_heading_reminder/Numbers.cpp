@@ -0,0 +1,73 @@
+#include "Numbers.h"
+#include "Units.h"
+
+//////////////////////////////////////////////////////////////////////////
+// standard atmosphere altitude for a pressure in mb, in cAltitudeLabel
+// units. The SPL06-007 example's altitude() formula, with the unit
+// conversion folded into the scale
+//////////////////////////////////////////////////////////////////////////
+double pressureAltitude(double pressure) {
+  return cPressureAltitudeScale * (1.0 - pow(pressure / cSeaLevelPressureHPa, 0.1903));
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Prints number with commas, but only supports [0, 99999]. The result
+// lives in a static buffer, so it's only good until the next call
+//////////////////////////////////////////////////////////////////////////
+char* displayNumber(const long &number, bool sign) {
+  int thousands = static_cast<int>(number / 1000);
+  int ones = static_cast<int>(number % 1000);
+  static char result[8]; //"-99,999" plus the terminator
+
+  if (number >= 10000) {
+    if (sign) {
+      sprintf_P(result, PSTR("%c%d,%03d"), '+', thousands, ones);
+    }
+    else {
+      sprintf_P(result, PSTR("%01d,%03d"), thousands, ones);
+    }
+  }
+  else if (number >= 1000) {
+    if (sign) {
+      sprintf_P(result, PSTR("% 2c%d,%03d"), '+', thousands, ones);
+    }
+    else {
+      sprintf_P(result, PSTR("% 2d,%03d"), thousands, ones);
+    }
+  }
+  else if (number <= -1000) {
+    sprintf_P(result, PSTR("%d,%03d"), thousands, abs(ones));
+  }
+  else if (sign && number >= 100) {
+    sprintf_P(result, PSTR("% 4c%d"), '+', ones);
+  }
+  else if (sign && number > 0) {
+    sprintf_P(result, PSTR("% 5c%d"), '+', ones);
+  }
+  else if (sign && number == 0) {
+    sprintf_P(result, PSTR("% 6c%d"), '+', ones);
+  }
+  else {
+    sprintf_P(result, PSTR("% 4d"), ones);
+  }
+
+  return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+long roundNumber(const long &number, const int &roundNearest) {
+  int sign = (number < 0) ? -1 : 1; //positive or negative number
+  return (number + sign * roundNearest / 2) / roundNearest * roundNearest;
+}
+
+//////////////////////////////////////////////////////////////////////////
+long roundNumber(const double &number, const int &roundNearest) {
+  int sign = (number < 0) ? -1 : 1; //positive or negative number
+  return static_cast<long>((number + sign * roundNearest / 2) / roundNearest) * roundNearest;
+}
+
+//////////////////////////////////////////////////////////////////////////
+int roundNumber(const int &number, const int &roundNearest) {
+  int sign = (number < 0) ? -1 : 1; //positive or negative number
+  return (number + sign * roundNearest / 2) / roundNearest * roundNearest;
+}
@@ -0,0 +1,24 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+The arithmetic behind the readouts for altitude_heading_reminder.ino: the
+standard atmosphere altitude for a pressure, rounding to a knob step, and
+altitudes formatted with a thousands separator. None of it touches the
+hardware or the sketch's state, so the host benchmarks in sim/ time the
+same code the device runs.
+*/
+#ifndef _NUMBERS_H_
+#define _NUMBERS_H_
+
+#include <Arduino.h>
+
+#define cSeaLevelPressureHPa 1013.25 //standard sea level pressure in millibars
+
+double pressureAltitude(double pressure);
+char*  displayNumber(const long &number, bool sign);
+long   roundNumber(const long &number, const int &roundNearest);
+long   roundNumber(const double &number, const int &roundNearest);
+int    roundNumber(const int &number, const int &roundNearest);
+
+#endif //_NUMBERS_H_
@@ -0,0 +1,112 @@
+#include "Profiler.h"
+
+#ifdef PROFILE
+
+#define cProfilePrescaler   8 //timer1 ticks once every 8 CPU cycles
+#define cProfileLineSamples 8 //samples per P line
+
+volatile uint16_t        gProfilePc; //handed from the naked vector to the sampling handler
+static volatile uint16_t gProfileSamples[cProfileBufferLength];
+static volatile uint8_t  gProfileHead;
+static volatile uint8_t  gProfileCount;
+static volatile uint32_t gProfileTaken;
+static volatile uint16_t gProfileDropped;
+static volatile uint32_t gProfileIsrTicks; //timer1 ticks from the compare match to the end of the handler, summed
+static volatile uint16_t gProfileIsrTicksMax;
+static unsigned long     gProfileStatsTs;
+
+//////////////////////////////////////////////////////////////////////////
+// the return address the interrupt pushed is the PC we want. Before
+// anything else touches the stack it sits just above the two registers
+// saved here, high byte first. Nothing here changes SREG. The rest is
+// ordinary C, in a handler named like a vector so the compiler gives it
+// the full interrupt prologue and reti
+//////////////////////////////////////////////////////////////////////////
+extern "C" void __vector_profile_sample() __attribute__((signal, used));
+
+ISR(TIMER1_COMPA_vect, ISR_NAKED) {
+  __asm__ volatile (
+    "push r28                 \n"
+    "push r29                 \n"
+    "in   r28, __SP_L__       \n"
+    "in   r29, __SP_H__       \n"
+    "push r0                  \n"
+    "ldd  r0, Y+3             \n"
+    "sts  gProfilePc+1, r0    \n"
+    "ldd  r0, Y+4             \n"
+    "sts  gProfilePc, r0      \n"
+    "pop  r0                  \n"
+    "pop  r29                 \n"
+    "pop  r28                 \n"
+    "jmp  __vector_profile_sample\n"
+  );
+}
+
+//////////////////////////////////////////////////////////////////////////
+extern "C" void __vector_profile_sample() {
+  gProfileTaken++;
+  if (gProfileCount < cProfileBufferLength) {
+    gProfileSamples[(gProfileHead + gProfileCount) % cProfileBufferLength] = gProfilePc;
+    gProfileCount++;
+  }
+  else {
+    gProfileDropped++; //serial can't keep up
+  }
+
+  uint16_t ticks = TCNT1; //CTC mode, the timer restarted from 0 at the compare match
+  gProfileIsrTicks += ticks;
+  if (ticks > gProfileIsrTicksMax) {
+    gProfileIsrTicksMax = ticks;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+void profileBegin() {
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11); //CTC on OCR1A, clock / 8
+  OCR1A = (F_CPU / cProfilePrescaler / 1000000UL) * cProfilePeriodUs - 1;
+  TCNT1 = 0;
+  TIMSK1 = _BV(OCIE1A);
+  gProfileStatsTs = millis();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// sends whole lines of samples, and the stats once a second, as long as
+// they fit in the serial transmit buffer. Never waits for it to drain
+//////////////////////////////////////////////////////////////////////////
+void profileDump(Print &out) {
+  char line[64];
+
+  if (millis() - gProfileStatsTs >= cProfileStatsInterval) {
+    noInterrupts();
+    uint32_t taken = gProfileTaken;
+    uint16_t dropped = gProfileDropped;
+    uint32_t isrTicks = gProfileIsrTicks;
+    uint16_t isrTicksMax = gProfileIsrTicksMax;
+    interrupts();
+    uint8_t length = snprintf_P(line, sizeof(line), PSTR("PROFILE-STATS %lu %u %lu %u %u\n"),
+      taken, dropped, isrTicks, isrTicksMax, OCR1A + 1);
+    if (out.availableForWrite() >= length) {
+      out.print(line);
+      gProfileStatsTs = millis();
+    }
+  }
+
+  while (gProfileCount >= cProfileLineSamples && out.availableForWrite() >= 2 + cProfileLineSamples * 5) {
+    char *p = line;
+    *p++ = 'P';
+    for (uint8_t i = 0; i < cProfileLineSamples; i++) {
+      noInterrupts();
+      uint16_t pc = gProfileSamples[gProfileHead];
+      gProfileHead = (gProfileHead + 1) % cProfileBufferLength;
+      gProfileCount--;
+      interrupts();
+      p += sprintf_P(p, PSTR(" %04x"), pc);
+    }
+    *p++ = '\n';
+    *p = 0;
+    out.print(line);
+  }
+}
+
+#endif //PROFILE
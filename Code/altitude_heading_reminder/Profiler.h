@@ -0,0 +1,33 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Statistical PC-sampling profiler, built in by uncommenting PROFILE below.
+
+Timer1 interrupts the program every cProfilePeriodUs and notes where it
+was. The samples queue up in a small ring buffer and profileDump() sends
+them out over serial, several to a line:
+  P <pc> <pc> ...             word addresses, in hex
+  PROFILE-STATS <samples> <dropped> <isr ticks> <max isr ticks> <period ticks>
+scripts/profile.py matches the addresses to functions in the ELF and
+reports where the time goes, and what the sampling itself costs.
+
+Samples can't land inside other interrupt handlers, since those run with
+interrupts off. Time spent in them shows up on whatever instruction was
+interrupted. Time asleep shows up on the sleep instruction.
+*/
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <Arduino.h>
+
+//#define PROFILE //sample the program counter, see profileBegin()
+
+#define cProfilePeriodUs      3989 //~250 samples a second. Not a multiple of any loop period, so the samples don't lock onto one
+#define cProfileBufferLength  32   //samples waiting to be sent
+#define cProfileStatsInterval 1000 //ms between PROFILE-STATS lines
+
+void profileBegin();
+void profileDump(Print &out);
+
+#endif //_PROFILER_H_
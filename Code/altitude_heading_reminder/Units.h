@@ -0,0 +1,104 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Units the device works in, chosen at build time by uncommenting UNITS_HPA
+and/or UNITS_METRES below. The default is inches of mercury and feet.
+
+Everything that depends on them is here: the altimeter setting's range,
+knob step and label, the altitude knob increments and limits, the alarm
+distances, and the constants that turn a pressure into an altitude. The
+altitude is worked out in the chosen unit from the start, so no sample is
+ever converted, and each build only carries the formatting for its own
+units.
+
+The settings saved in EEPROM are plain numbers in whatever units the
+device was built with, and cUnits is saved next to them. A build with
+other units converts the altimeter setting, the selected altitude, the
+minimums and both calibration offsets when it reads them, and saves them
+back in its own. EEPROM saved before the marker existed is taken to be in
+inches of mercury and feet, the only units there were then.
+*/
+#ifndef _UNITS_H_
+#define _UNITS_H_
+
+//#define UNITS_HPA    //altimeter setting (QNH) in hPa instead of inches of mercury
+//#define UNITS_METRES //altitudes in metres instead of feet
+
+#ifdef UNITS_HPA
+#define cAltimeterLabel                     "hPa"
+#define cAltimeterSettingStandard           1013    //hPa, the nearest knob step to standard pressure
+#define cAltimeterSettingStandardDouble     1013.25 //hPa
+#define cAltimeterSettingMin                931     //hPa, 27.50 inHg
+#define cAltimeterSettingMax                1067    //hPa, 31.50 inHg
+#define cAltimeterSettingInterval           1       //hPa
+#else
+#define cAltimeterLabel                     "\""
+#define cAltimeterSettingStandard           2992    //inHg * 100
+#define cAltimeterSettingStandardDouble     2992.0  //inHg * 100
+#define cAltimeterSettingMin                2750    //inHg * 100
+#define cAltimeterSettingMax                3150    //inHg * 100
+#define cAltimeterSettingInterval           1       //inHg * 100
+#endif
+
+#ifdef UNITS_METRES
+#define cAltitudeLabel                      "m"
+#define cPressureAltitudeScale              44330.0    //m, standard atmosphere pressure altitude = scale * (1 - (p / p0)^0.1903)
+#define cAltimeterCorrectionScale           44307.694  //m, altimeter setting correction = scale * (1 - (setting / standard)^0.190284)
+#define cAltitudeSelectIncrement            50    //m
+#define cAltitudeFineSelectIncrement        5     //m
+#define cAltitudeHighSelectIncrement        300   //m
+#define cMinimumsSelectIncrement            10    //m
+#define cHighAltitude                       6000  //m
+#define cDefaultSelectedAltitude            3000  //m
+#define cDefaultMinimumsAltitude            300   //m
+#define cLowestAltitudeSelect               -300  //m
+#define cHighestAltitudeSelect              18000 //m
+#define cCalibrationOffsetMin               -1500 //m
+#define cCalibrationOffsetMax               1500  //m
+#define cCalibrationOffsetInterval          5     //m
+#define cTrueAltitudeRoundToNearest         5     //m
+#define cMinimumsSilencedAutoOnAltitudeDiff 30    //m
+#define cHighestAltitudeAlert               7300  //m, the pressure sensor will only measure so high. No point in alerting above a certain pressure level
+#define cAlarm200ToGo                       60    //m
+#define cAlarm1000ToGo                      300   //m
+#else
+#define cAltitudeLabel                      "ft"
+#define cPressureAltitudeScale              (44330.0 * 3.28084) //ft
+#define cAltimeterCorrectionScale           145366.45  //ft
+#define cAltitudeSelectIncrement            100   //ft
+#define cAltitudeFineSelectIncrement        10    //ft
+#define cAltitudeHighSelectIncrement        1000  //ft
+#define cMinimumsSelectIncrement            50    //ft
+#define cHighAltitude                       18000 //ft
+#define cDefaultSelectedAltitude            10000 //ft
+#define cDefaultMinimumsAltitude            1000  //ft
+#define cLowestAltitudeSelect               -1000 //ft
+#define cHighestAltitudeSelect              60000 //ft
+#define cCalibrationOffsetMin               -5000 //ft
+#define cCalibrationOffsetMax               5000  //ft
+#define cCalibrationOffsetInterval          10    //ft
+#define cTrueAltitudeRoundToNearest         10    //ft
+#define cMinimumsSilencedAutoOnAltitudeDiff 100   //ft
+#define cHighestAltitudeAlert               24000 //ft, the pressure sensor will only measure so high. No point in alerting above a certain pressure level
+#define cAlarm200ToGo                       200   //ft
+#define cAlarm1000ToGo                      1000  //ft
+#endif
+
+//cUnits, the marker saved in EEPROM, is cUnitsMarker with a bit set for each unit that isn't the default
+#define cUnitsMarker                        0xA0
+#define cUnitsMarkerHpa                     0x01
+#define cUnitsMarkerMetres                  0x02
+#ifdef UNITS_HPA
+#define cUnitsAltimeter                     cUnitsMarkerHpa
+#else
+#define cUnitsAltimeter                     0
+#endif
+#ifdef UNITS_METRES
+#define cUnitsAltitude                      cUnitsMarkerMetres
+#else
+#define cUnitsAltitude                      0
+#endif
+#define cUnits                              (cUnitsMarker | cUnitsAltimeter | cUnitsAltitude)
+
+#endif //_UNITS_H_
@@ -0,0 +1,150 @@
+#include "Widgets.h"
+
+#define cWidgetPanelWidth  128
+#define cWidgetPanelHeight 32
+
+//////////////////////////////////////////////////////////////////////////
+// fills in the widget's text and returns its offset
+//////////////////////////////////////////////////////////////////////////
+static uint8_t widgetText(const Widget &widget, char *text) {
+  if (widget.format == NULL) {
+    strncpy_P(text, widget.label, cWidgetTextLength - 1);
+    text[cWidgetTextLength - 1] = 0;
+    return 0;
+  }
+  text[0] = 0;
+  return widget.format(text);
+}
+
+//////////////////////////////////////////////////////////////////////////
+static uint8_t widgetBottom(const Widget &widget) {
+  if (widget.size == 0) {
+    return widget.y;
+  }
+  return min(widget.y + 8 * widget.size - 1, cWidgetPanelHeight - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// draws a widget into the buffer, on top of what's there
+//////////////////////////////////////////////////////////////////////////
+static void widgetRender(Custom_SSD1306 &oled, const Widget &widget, const char *text, uint8_t offset) {
+  if (text[0] == 0) {
+    return;
+  }
+  if (widget.size == 0) {
+    oled.fillRect(widget.x + offset, widget.y, widget.width, 1, SSD1306_WHITE);
+  }
+  else { //like print(), but text that runs off the right edge is cut off instead of wrapping outside the widget
+    uint8_t x = widget.x + offset;
+    for (const char *c = text; *c && x + 6 * widget.size <= cWidgetPanelWidth; c++) {
+      oled.drawChar(x, widget.y, *c, SSD1306_WHITE, SSD1306_WHITE, widget.size);
+      x += 6 * widget.size;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+static void widgetExtent(const Widget &widget, const char *text, uint8_t offset, uint8_t &left, uint8_t &right) {
+  if (text[0] == 0) {
+    left = 1;
+    right = 0;
+    return;
+  }
+  uint16_t width = widget.size == 0 ? widget.width : strlen(text) * 6 * widget.size;
+  left = widget.x + offset;
+  right = min(left + width - 1, cWidgetPanelWidth - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void WidgetScreen::draw(Custom_SSD1306 &oled, const WidgetLayout &newLayout, const uint8_t *newVersions, TWICallback done) {
+  bool full = (newLayout.widgets != layout || millis() - fullFrameTs >= cWidgetRefreshInterval);
+  layout = newLayout.widgets;
+  uint8_t count = newLayout.count;
+  char text[cWidgetMax][cWidgetTextLength]; //each widget's, once formatted, so none is formatted twice a frame
+  uint8_t offset[cWidgetMax];
+  uint8_t formatted = 0; //bit i set once text[i] holds widget i's text
+  Widget widget;
+
+  uint8_t changedSources = 0;
+  for (uint8_t n = 0; n < cWidgetSources; n++) {
+    if (newVersions[n] != versions[n]) {
+      changedSources |= 1 << n;
+      versions[n] = newVersions[n];
+    }
+  }
+
+  if (full) {
+    oled.clearDisplay();
+    fullFrameTs = millis();
+  }
+
+  //find what changed, and the block of the panel that covers it before and after
+  uint8_t x0 = cWidgetPanelWidth, x1 = 0, page0 = cWidgetPanelHeight / 8, page1 = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    memcpy_P(&widget, layout + i, sizeof(widget));
+    if (!full && !(widget.sources & changedSources)) {
+      continue;
+    }
+    offset[i] = widgetText(widget, text[i]);
+    formatted |= 1 << i;
+
+    uint8_t newLeft, newRight;
+    widgetExtent(widget, text[i], offset[i], newLeft, newRight);
+    if (full) {
+      widgetRender(oled, widget, text[i], offset[i]);
+    }
+    else {
+      uint8_t changeLeft = newLeft, changeRight = newRight;
+      if (left[i] <= right[i]) { //what it drew before has to go too
+        if (changeLeft > changeRight) {
+          changeLeft = left[i];
+          changeRight = right[i];
+        }
+        else {
+          changeLeft = min(changeLeft, left[i]);
+          changeRight = max(changeRight, right[i]);
+        }
+      }
+      if (changeLeft <= changeRight) {
+        x0 = min(x0, changeLeft);
+        x1 = max(x1, changeRight);
+        page0 = min(page0, widget.y / 8);
+        page1 = max(page1, widgetBottom(widget) / 8);
+      }
+    }
+    left[i] = newLeft;
+    right[i] = newRight;
+  }
+
+  if (full) {
+    oled.display(done);
+    return;
+  }
+
+  if (x0 > x1) {
+    if (done) {
+      done(TWI_OK); //nothing to send, the panel already shows all of it
+    }
+    return;
+  }
+
+  oled.fillRect(x0, page0 * 8, x1 - x0 + 1, (page1 - page0 + 1) * 8, SSD1306_BLACK);
+  for (uint8_t i = 0; i < count; i++) {
+    memcpy_P(&widget, layout + i, sizeof(widget));
+    if (left[i] > right[i] || left[i] > x1 || right[i] < x0 || widget.y / 8 > page1 || widgetBottom(widget) / 8 < page0) {
+      continue;
+    }
+    if (!(formatted & (1 << i))) { //unchanged, so it comes out as it did last time
+      offset[i] = widgetText(widget, text[i]);
+    }
+    widgetRender(oled, widget, text[i], offset[i]);
+  }
+  oled.displayRegion(x0, page0, x1, page1, done);
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t WidgetScreen::settingsChanged(uint8_t newSettings) {
+  uint8_t changed = (settings == cWidgetSettingsUnknown) ? 0xFF : newSettings ^ settings;
+  settings = newSettings;
+  return changed;
+}
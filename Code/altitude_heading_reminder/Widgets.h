@@ -0,0 +1,101 @@
+/*
+Author: Trevor Bartlett
+Email: aviatortrevor@gmail.com
+
+Retained widget layer for the two screens.
+
+A layout is a table in flash of widgets: a piece of text at a fixed place
+(or a one pixel rule), whose content comes from a fixed label or a format
+function. Each widget also names the inputs its text depends on, as bits
+of sources. The caller hands draw() a version for each input, a number
+that moves whenever that input changes. A WidgetScreen remembers, for one
+panel, which layout it is showing, the versions it last drew from and the
+extent of what each widget last drew. draw() formats only the widgets
+whose inputs moved on, once each, and leaves the rest alone. The pages
+and columns the changed ones cover (before and after) are cleared and
+redrawn, and only that block is sent, through the panel's column and page
+address window. The panel keeps the rest from before.
+
+Both panels draw into the same frame buffer, so outside the block being
+sent it holds the other panel's picture. That's why every widget that
+overlaps the block is redrawn, not just the changed ones. A different
+layout, or invalidate(), gets a full frame.
+
+A widget whose text depends on something its sources don't cover would go
+stale, and noise on the bus can spoil the panel's memory. So each screen
+also gets a full frame at least every cWidgetRefreshInterval.
+
+The screen also remembers the panel's display settings (flip, dim,
+invert), so the commands for them only go out when they change.
+*/
+#ifndef _WIDGETS_H_
+#define _WIDGETS_H_
+
+#include <Arduino.h>
+#include <Custom_SSD1306.h>
+
+#define cWidgetTextLength 22 //21 characters fit across a panel at text size 1
+#define cWidgetMax        8  //most widgets in one layout
+#define cWidgetRefreshInterval 5000 //ms, longest a panel goes without a full frame
+#define cWidgetSources    8  //inputs a widget can depend on, one bit of Widget::sources each
+
+//writes the widget's text, an empty string hides it. Returns how many
+//pixels right of the widget's x the text starts, usually 0
+typedef uint8_t (*WidgetFormat)(char *text);
+
+struct Widget {
+  uint8_t      x;
+  uint8_t      y;
+  uint8_t      size;   //text size, or 0 for a rule width pixels long, shown while the text isn't empty
+  uint8_t      width;  //rules only
+  const char  *label;  //text in flash, used when format is NULL
+  WidgetFormat format;
+  uint8_t      sources; //bit n set when the text depends on input n, see draw(). 0 for a label
+};
+
+struct WidgetLayout {
+  const Widget *widgets; //table in flash
+  uint8_t       count;
+};
+
+//the widget count of a layout table, checked against cWidgetMax at compile time
+template <size_t count> constexpr uint8_t widgetCount() {
+  static_assert(count <= cWidgetMax, "more widgets in a layout than a WidgetScreen keeps track of");
+  return count;
+}
+
+#define WIDGET_LAYOUT(table) { table, widgetCount<sizeof(table) / sizeof(table[0])>() }
+
+class WidgetScreen {
+ public:
+  WidgetScreen() : layout(NULL), settings(cWidgetSettingsUnknown) {}
+
+  //versions has cWidgetSources entries, versions[n] being the version of
+  //input n right now
+  void draw(Custom_SSD1306 &oled, const WidgetLayout &layout, const uint8_t *versions, TWICallback done=NULL);
+
+  //the panel's display settings as bits of the caller's choosing. Returns
+  //the bits that differ from the last ones, all of them after invalidate(),
+  //and remembers these. Only those commands need sending
+  uint8_t settingsChanged(uint8_t newSettings);
+
+  //the panel no longer shows what we last sent it, e.g. after it was
+  //re-initialized or the picture was flipped. The next draw() sends it all,
+  //and settingsChanged() reports every setting
+  void invalidate() {
+    layout = NULL;
+    settings = cWidgetSettingsUnknown;
+  }
+
+ private:
+  static const uint16_t cWidgetSettingsUnknown = 0x100; //no uint8_t of settings matches it
+
+  const Widget *layout;
+  unsigned long fullFrameTs;
+  uint8_t       versions[cWidgetSources]; //of each input, as of the last draw()
+  uint8_t       left[cWidgetMax];  //columns each widget drew in, left > right when it drew nothing
+  uint8_t       right[cWidgetMax];
+  uint16_t      settings;
+};
+
+#endif //_WIDGETS_H_
@@ -16,10 +16,38 @@ selected altitude, or departed from it.
 *     https://learn.adafruit.com/adafruit-gfx-graphics-library/using-fonts
 */
 #include <EEPROM.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
 #include <SPL06-007.h>
-#include <Wire.h>
+#include <Custom_TWI.h>
 #include <Custom_GFX.h>
 #include <Custom_SSD1306.h>
+#include "Units.h"
+#include "AltitudeAlarm.h"
+#include "Battery.h"
+#include "Numbers.h"
+#include "MemoryMonitor.h"
+#include "Benchmark.h"
+#include "Profiler.h"
+#include "LatencyMonitor.h"
+#include "Widgets.h"
+#include "DeviceState.h"
+
+//#define DEBUG //print diagnostics over serial at 9600 baud
+
+//Diagnostics over serial. Without DEBUG they compile to nothing, arguments and all, so print
+//each piece on its own (F() strings, numbers) instead of building a String to pass in
+#ifdef DEBUG
+#define debugPrint(x)   Serial.print(x)
+#define debugPrintln(x) Serial.println(x)
+#else
+#define debugPrint(x)
+#define debugPrintln(x)
+#endif
+
+#if defined(BENCHMARK) && defined(PROFILE)
+#error "BENCHMARK and PROFILE both need timer1, build with one at a time"
+#endif
 
 #define cAppCodeNumberOfDigits         6
 #define cAppCodeOne                    8
@@ -32,33 +60,10 @@ selected altitude, or departed from it.
 #define cOneSecondBeforeOverflow       (unsigned long)(pow(2, sizeof(unsigned long) * 8) - cOneSecond)
 #define cTenSeconds                    10000
 #define cLeftRotaryTimeoutSeconds      cTenSeconds
-#define cFeetInMeters                  3.28084
-#define cSeaLevelPressureHPa           1013.25 //standard sea level pressure in millibars
-#define cMbInHg                        33.8639
-#define cSeaLevelPressureInHg          2992 //standard sea level pressure in inches of mercury (x100)
-#define cSeaLevelPressureInHgDouble    29.92
-#define cFtLabel                       "ft"
-#define cInLabel                       "\""
 #define cDegFLabel                     'F'
-#define cAltitudeSelectIncrement       100   //ft
-#define cAltitudeFineSelectIncrement   10    //ft
-#define cAltitudeHighSelectIncrement   1000  //ft
-#define cMinimumsSelectIncrement       50    //ft
-#define cHighAltitude                  18000 //ft
-#define cDefaultSelectedAltitude       10000 //ft
-#define cDefaultMinimumsAltitude       1000  //ft
-#define cLowestAltitudeSelect          -1000 //ft
-#define cHighestAltitudeSelect         60000 //ft
-#define cHighestAltitudeAlert          24000 //ft, the pressure sensor will only measure so high. No point in alerting above a certain pressure level
-#define cAltimeterSettingInHgMin       2750  //inHg * 100
-#define cAltimeterSettingInHgMax       3150  //inHg * 100
-#define cAltimeterSettingInHgInterval  1     //inHg
-#define cCalibrationOffsetMin          -5000 //ft
-#define cCalibrationOffsetMax          5000  //ft
-#define cCalibrationOffsetInterval     10    //ft
 #define cHeadingSelectIncrement        5     //degrees
 #define cDefaultSelectedHeading        360   //degrees
-#define cTrueAltitudeRoundToNearestFt  10    //ft
+//altitude and altimeter setting units, and everything that depends on them, are in Units.h
 
 //EEPROM
 #define         cSizeOfEeprom                       EEPROM.length() //1024
@@ -75,26 +80,28 @@ selected altitude, or departed from it.
 #define         cEepromSelectedHeadingAddr          28
 #define         cEepromSelectedMinimumsAddr         30
 #define         cEepromLastAddr                     cEepromSelectedMinimumsAddr
-volatile bool   gNeedToWriteToEeprom;
+#define         cEepromUnitsAddr                    (cSizeOfEeprom - 1) //cUnits from Units.h, what the settings are saved in. The blocks values move into stop short of it
+uint8_t         gSavedSettingsVersion; //gState.settingsVersion as of the last save
 
 //SPL06-007 Sensor variables
 #define    cSensorLoopCycle               2 //2Hz
 #define    cSensorLoopPeriod              (cOneSecond / cSensorLoopCycle)
+#define    cSensorPollPeriod              50 //ms between one-byte MEAS_CFG polls. Samples are only read when the sensor has a new one
+#define    cSensorAddr                    SPL_ADDRESS
+SPL06<Custom_TWI, SPL_RATE_2, SPL_OVERSAMPLE_8, SPL_RATE_1, SPL_OVERSAMPLE_8> gSensor(Twi, cSensorAddr); //pressure at cSensorLoopCycle
+unsigned long gTemperatureRequestTs;      //last one-off temperature measurement asked for while the sensor is in standby
 double     gSensorTemperatureDouble;      //farhenheit
-enum SensorMode {SensorModeOff, SensorModeSilent, SensorModeOnHide, SensorModeOnShow, cNumberOfSensorModes};
-volatile SensorMode gSensorMode;
+uint8_t    gSampleCount;                  //bumped for every sample read, so the screens can tell the readings moved on
 
 //Main program variables
+volatile DeviceState gState; //everything set with the knobs, see DeviceState.h
 double          gTrueAltitudeDouble;
-volatile long   gSelectedAltitudeLong;
-volatile int    gAltimeterSettingInHgInt;
-volatile int    gCalibratedAltitudeOffsetInt;
-volatile int    gPermanentCalibratedAltitudeOffsetInt;
-volatile int    gSelectedHeadingInt; //degrees
-volatile bool   gMinimumsOn;
-volatile long   gMinimumsAltitudeLong;
-volatile bool   gMinimumsTriggered = true;
-volatile bool   gMinimumsSilenced = true;
+long            gTrueAltitudeFloorLong;   //gTrueAltitudeDouble rounded down and up, for the alarm's integer compares
+long            gTrueAltitudeCeilLong;
+double          gAltitudeCorrectionDouble; //what the altimeter setting and both offsets add to the pressure altitude, see altitudeCorrected()
+int             gCorrectionAltimeterSettingInt = -1; //the settings gAltitudeCorrectionDouble was worked out for
+int             gCorrectionOffsetInt;
+int             gCorrectionPermanentOffsetInt;
 
 //Anti-piracy
 volatile int    gSelectAppCode = 0;
@@ -102,27 +109,11 @@ volatile int    gAppCodeSequence = 0;
 bool            gLegitimate = true;
 
 //Buzzer
-#define            cAlarm200ToGo                         200  //ft
-#define            cAlarm1000ToGo                        1000 //ft
 #define            cBuzzPin                              6
-#define            cLongBuzzDuration                     1000
-#define            cShortBuzzOnDuration                  250
-#define            cShortBuzzOffDuration                 100
-#define            cMinimumsLongBuzzOnDuration           375
-#define            cMinimumsShortBuzzOnDuration          125
-#define            cMinimumsBuzzOffDuration              125
-#define            cMinimumsOffBetweenCycleDuration      125
-#define            cMinimumsNumberOfBeepCylces           5
-#define            cUrgentBuzzNumberOfBeeps              3
-#define            cDisableAlarmKnobMovementTime         1200
-#define            cDisableAlarmAfterAlarmTime           1800
-enum BuzzAlarmMode {Climbing1000ToGo, Climbing200ToGo, Descending1000ToGo, Descending200ToGo, AltitudeDeviate, UrgentAlarm, MinimumsAlarm, LongAlarm, AlarmDisabled, DetermineAlarmState};
-BuzzAlarmMode      gAlarmModeEnum = AlarmDisabled;
-int                gBuzzCountInt;
-int                cPowerUpSilence = 7000; //wait 7 seconds after start-up before alarm can begin making sounds. this is so you don't scare anyone with a loud alarm as soon as they start it up at home.
+AltitudeAlarm      gAlarm; //buzzer/alarm state machine, see AltitudeAlarm.h
+bool               gBuzzerPinOn;
 
 //Minimums
-#define            cMinimumsSilencedAutoOnAltitudeDiff   100 //ft
 #define            cMinimumsTriggeredAutoOffTime         30000 //30 seconds
 
 //Top-left corner message for low battery or silent mode
@@ -136,25 +127,35 @@ int                cPowerUpSilence = 7000; //wait 7 seconds after start-up befor
 int           gBatteryLevel;
 bool          gBatteryCharging;
 unsigned long gBatteryUpdateTs;
-#define       cBatteryCapacityArrayLength   21
-#define       cBatteryCapacityArrayInterval 5 //this represents the jump in battery capacity per index in the array
-const double  cBatteryCapacity[2][cBatteryCapacityArrayLength] = {
-  2.40, 3.41, 3.48, 3.54, 3.58, 3.62, 3.67, 3.71, 3.76, 3.79, 3.82, 3.84, 3.87, 3.91, 3.94, 3.98, 4.01, 4.03, 4.06, 4.09, 4.15,
-     0,    5,   10,   15,   20,   25,   30,   35,   40,   45,   50,   55,   60,   65,   70,   75,   80,   85,   90,   95,  100
-};
+//the ADC readings and the percentage per raw ADC code are in Battery.cpp, see Battery.h
+
+//Power management
+#define       cDisplaySleepTimeout    1800000 //30 minutes without touching a knob turns both screens off, unless the sensor is on. Set to 0 to keep them on
+volatile unsigned long gLastKnobEdgeTs;
+bool          gDisplaysAsleep;
+bool          gSensorStandby;
+
+//Fault handling
+#define       cWatchdogTimeout        WDTO_2S //longest the loop may stall before the MCU resets. The loop-overflow case freezes for 1 second
+uint8_t       gResetCause __attribute__((section(".noinit"))); //MCUSR at boot, WDRF set means the watchdog caught a stall
+uint8_t       gBusRecoveries; //last Twi.faults().recoveries we re-initialized the devices for
+
+//Diagnostics
+#define       cMemoryCheckInterval    1000 //how often to look for a new stack high-water mark, see MemoryMonitor.h
+unsigned long gMemoryCheckTs;
+uint8_t       gMemoryVersion; //bumped whenever a figure on the memory page changes
+unsigned long gBootTime; //ms from the start of setup() to the first altitude reading
+#define       cSerialBaudRate         38400 //for TWI_TRACE, BENCHMARK and PROFILE output. Within 0.2% on the 8MHz clock, unlike 57600 and up
 
 //Timing control
 unsigned long          gNextSensorReadyTs;
-unsigned long          gNextBuzzTs;
-unsigned long          gLastAlarmTs; //this value disables the alarm temporarily just at start-up so people's ears aren't blown when they power it on.
 unsigned long          gTimerStartTs;
-unsigned long          gMinimumsTriggeredTs;
 volatile unsigned long gLeftButtonPressedTs;
 volatile unsigned long gRightButtonPressedTs;
 volatile unsigned long gLastRightRotaryActionTs;
 volatile unsigned long gLastMinimumsAltitudeTs;
-volatile unsigned long gLeftRotaryReleaseTs;
-volatile unsigned long gRightRotaryReleaseTs;
+unsigned long          gLeftRotaryReleaseTs;
+unsigned long          gRightRotaryReleaseTs;
 volatile unsigned long gEepromSaveNeededTs;
 volatile unsigned long gLastRotaryActionTs;
 
@@ -171,33 +172,52 @@ volatile unsigned long gLastRotaryActionTs;
 #define cLabelTextYpos   1
 #define cReadoutTextSize 3
 #define cReadoutTextYpos 10
-Custom_SSD1306 gOled(cOledWidth, cOledHeight, &Wire, cOledReset);
-volatile bool gOledDim = false;
-volatile bool gDeviceFlipped = false;
+Custom_SSD1306_Static<cOledWidth, cOledHeight> gOled(&Twi, cOledReset); //the frame buffer is a static array, so it counts toward the linker's SRAM usage
 volatile bool gUpdateLeftScreen = true;
 volatile bool gUpdateRightScreen = true;
+bool gUrgentRightScreen = false; //an alarm flash, drawn without waiting for cMinFrameInterval
+uint8_t gLeftStateVersion;  //gState.version each screen was last drawn from, a screen with an older one is due
+uint8_t gRightStateVersion;
+const DeviceState *gFrame; //the snapshot of gState the screen being drawn shows, on drawLeftScreen()'s or drawRightScreen()'s stack
+#define cMinFrameInterval 50 //ms between two frames on the same screen. Requests in between are merged into the next frame
+unsigned long gLeftFrameTs;
+unsigned long gRightFrameTs;
+unsigned long gTimerSecondShown; //whole seconds of the timer the left screen last showed
 bool gFlashLeftScreen = false;
-bool gFlashRightScreen = false;
-
-char gDisplayTopContent[20];
-char gDisplayBottomContent[10];
-
-//Cursor control
-enum Cursor {
-    CursorSelectHeading,
-    CursorSelectAltimeter,
-    CursorSelectMinimumsOn,
-    CursorSelectMinimumsAltitude,
-    CursorSelectTimer,
-    CursorSelectBrightness, //starting here, values won't stay on the screen for more than a few seconds unless there is a rotary action
-    CursorSelectOffset,
-    CursorSelectSensor,
-    CursorSelectFlipDevice,
-    CursorViewSensorTemp,
-    CursorViewAltitude,
-    CursorViewBatteryLevel,
-    cNumberOfCursorModes }
-    gCursor = CursorSelectHeading;
+WidgetScreen gLeftScreen;  //what each panel shows, so only the readouts that changed get redrawn and sent
+WidgetScreen gRightScreen;
+volatile bool gScreensInvalid = false; //set by the knob interrupt when both panels need a full frame, loop() invalidates them
+
+//what the widgets' texts depend on, see Widgets.h. The screens pass draw() a version of each, see widgetVersions()
+enum WidgetSource {
+    SourceState,   //gState
+    SourceSample,  //the sensor readings
+    SourceBattery, //gBatteryLevel and gBatteryCharging
+    SourceTimer,   //the seconds of the running timer
+    SourceMemory,  //gMemoryStats
+    SourceStatus,  //gRightStatus
+    cNumberOfWidgetSources };
+static_assert(cNumberOfWidgetSources <= cWidgetSources, "one bit of Widget::sources per source");
+#define cFromState   (1 << SourceState)
+#define cFromSample  (1 << SourceSample)
+#define cFromBattery (1 << SourceBattery)
+#define cFromTimer   (1 << SourceTimer)
+#define cFromMemory  (1 << SourceMemory)
+#define cFromStatus  (1 << SourceStatus)
+
+//the panels' display settings, see WidgetScreen::settingsChanged()
+#define cPanelFlipped  0x01
+#define cPanelDim      0x02
+#define cPanelInverted 0x04
+enum RightStatus {
+    RightStatusNone,
+    RightStatusMinimums,
+    RightStatusNotArmed,
+    RightStatusCountdown,
+    RightStatusSilent,
+    RightStatusLowBattery }; //top-left corner of the right screen
+uint8_t gRightStatus;
+
 
 //Rotary Knobs
 #define cRotaryStates              4
@@ -211,20 +231,23 @@ enum Cursor {
 
 
 //Rotary encoder signal pairs, DT CLK - clockwise order
-//When DT & CLK are both 1, the rotary is sitting on a detent
-const int cEncoderValues[2][cRotaryStates] = {
+//When DT & CLK are both 1, the rotary is sitting on a detent. Kept in flash, read with pgm_read_byte()
+const uint8_t cEncoderValues[2][cRotaryStates] PROGMEM = {
   1, 1, 0, 0, //DT
   1, 0, 0, 1  //CLK
 };
 
+//the index, button and direction of each knob are only used by the pin
+//change interrupts once setup() is done, so they don't need to be volatile
+
 //Right Rotary Knob
 #define        cPinRightRotarySignalDt  8
 #define        cPinRightRotarySignalClk 9
 #define        cPinRightRotaryButton    10
-volatile int   gRightRotaryIndex;
-volatile int   gRightRotaryButton = RELEASED;
-volatile int   gRightRotaryButtonPreviousValue = RELEASED;
-volatile int   gRightRotaryDirection;
+int            gRightRotaryIndex;
+int            gRightRotaryButton = RELEASED;
+int            gRightRotaryButtonPreviousValue = RELEASED;
+int            gRightRotaryDirection;
 volatile bool  gRightButtonPossibleLongPress;
 volatile bool  gRightRotaryFineTuningPress;
 volatile bool  gDisableRightRotaryProcessing; //we disable knob processing right after the altitude-sync command until the button is released
@@ -233,26 +256,48 @@ volatile bool  gDisableRightRotaryProcessing; //we disable knob processing right
 #define        cPinLeftRotarySignalDt  2
 #define        cPinLeftRotarySignalClk 3
 #define        cPinLeftRotaryButton    4
-volatile int   gLeftRotaryIndex;
-volatile int   gLeftRotaryButton = RELEASED;
-volatile int   gLeftRotaryButtonPreviousValue = RELEASED;
-volatile int   gLeftRotaryDirection;
+int            gLeftRotaryIndex;
+int            gLeftRotaryButton = RELEASED;
+int            gLeftRotaryButtonPreviousValue = RELEASED;
+int            gLeftRotaryDirection;
 volatile bool  gLeftButtonPossibleLongPress;
 volatile bool  gLeftRotaryFineTuningPress;
 volatile bool  gDisableLeftRotaryProcessing; //we disable knob processing right after the screen changes pages until the button is released
 
 //////////////////////////////////////////////////////////////////////////
 void setup() {
-  #ifdef DEBUG
+  #if defined(TWI_TRACE) || defined(BENCHMARK) || defined(PROFILE) || defined(LATENCY)
+  Serial.begin(cSerialBaudRate); //scripts/twi_trace.py, bench.py, profile.py and latency.py read from here
+  #elif defined(DEBUG)
   Serial.begin(9600);
   #endif
-  initializeDisplayDevice();
+  initializeDisplayDevice(); //the init commands go out in the background while we carry on
   initializeRotaryKnobs();
+  initializePressureSensor(); //started early so its first measurement runs while we read the EEPROM
   initializePiracyCheck();
   initializeValuesFromEeprom();
-  initializePressureSensor();
   initializeBuzzer();
   gBatteryLevel = getBatteryLevel();
+  takeFirstSample();
+  #ifdef BENCHMARK
+  runBenchmarks();
+  #endif
+  wdt_enable(cWatchdogTimeout); //armed last, the piracy screens above wait for much longer than this
+  #ifdef PROFILE
+  profileBegin(); //only the steady state, the boot sequence would skew the profile
+  #endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+// the old bootloader neither clears MCUSR nor turns the watchdog off, so
+// after a watchdog reset it would keep firing every 15ms, long before
+// setup() runs. This runs from .init3, ahead of all constructors.
+//////////////////////////////////////////////////////////////////////////
+void disableWatchdogAtBoot() __attribute__((naked, used, section(".init3")));
+void disableWatchdogAtBoot() {
+  gResetCause = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -263,16 +308,27 @@ void initializeValuesFromEeprom() {
   long tempLong;
   byte tempByte;
   bool tempBool;
+  DeviceStateChange change(gState); //the knob interrupts are running already. This is what EEPROM holds, so nothing needs saving
+
+  //Units the values were saved in. Without a marker they're from before there was one, in inches of mercury and feet
+  byte savedUnits = EEPROM.read(cEepromUnitsAddr);
+  if ((savedUnits & ~(cUnitsMarkerHpa | cUnitsMarkerMetres)) != cUnitsMarker) {
+    savedUnits = cUnitsMarker;
+  }
+  if (savedUnits != cUnits) {
+    change.setting(); //save them back in this build's units
+  }
 
   //Last Altimeter Setting
   EEPROM.get(cEepromAltimeterAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempInt);
-    if (tempInt < cAltimeterSettingInHgMin || tempInt > cAltimeterSettingInHgMax) {
-      gAltimeterSettingInHgInt = cSeaLevelPressureInHg;
+    tempInt = savedAltimeterSetting(tempInt, savedUnits);
+    if (tempInt < cAltimeterSettingMin || tempInt > cAltimeterSettingMax) {
+      gState.altimeterSetting = cAltimeterSettingStandard;
     }
     else {
-      gAltimeterSettingInHgInt = tempInt;
+      gState.altimeterSetting = tempInt;
     }
   }
   
@@ -280,9 +336,9 @@ void initializeValuesFromEeprom() {
   EEPROM.get(cEepromAltitudeOffsetAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempInt);
-    gCalibratedAltitudeOffsetInt = tempInt;
-    if (gCalibratedAltitudeOffsetInt < cCalibrationOffsetMin || gCalibratedAltitudeOffsetInt > cCalibrationOffsetMax) {
-      gCalibratedAltitudeOffsetInt = 0;
+    gState.calibratedAltitudeOffset = savedAltitude(tempInt, savedUnits, cCalibrationOffsetInterval);
+    if (gState.calibratedAltitudeOffset < cCalibrationOffsetMin || gState.calibratedAltitudeOffset > cCalibrationOffsetMax) {
+      gState.calibratedAltitudeOffset = 0;
     }
   }
 
@@ -290,11 +346,12 @@ void initializeValuesFromEeprom() {
   EEPROM.get(cEepromPermanentAltitutdeOffsetAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempInt);
+    tempInt = savedAltitude(tempInt, savedUnits, cCalibrationOffsetInterval);
     if (tempInt >= cCalibrationOffsetMin && tempInt <= cCalibrationOffsetMax) {
-      gPermanentCalibratedAltitudeOffsetInt = tempInt;
+      gState.permanentCalibratedAltitudeOffset = tempInt;
     }
     else {
-      gPermanentCalibratedAltitudeOffsetInt = 0;
+      gState.permanentCalibratedAltitudeOffset = 0;
     }
   }
 
@@ -302,32 +359,33 @@ void initializeValuesFromEeprom() {
   EEPROM.get(cEepromSensorModeAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempByte);
-    gSensorMode = static_cast<SensorMode>(constrain(tempByte, 0, cNumberOfSensorModes));
+    gState.sensorMode = static_cast<SensorMode>(constrain(tempByte, 0, cNumberOfSensorModes));
   }
 
   //Screen Brightness Dim
   EEPROM.get(cEepromScreenDimAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempBool);
-    gOledDim = tempBool;
+    gState.oledDim = tempBool;
   }
 
   //Screen Orientation
   EEPROM.get(cEepromScreenOrientationAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempBool);
-    gDeviceFlipped = tempBool;
+    gState.deviceFlipped = tempBool;
   }
 
   //Selected Altitude
   EEPROM.get(cEepromSelectedAltitudeAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempLong);
-    if (tempLong >= cLowestAltitudeSelect && tempInt <= cHighestAltitudeSelect) {
-      gSelectedAltitudeLong = tempLong;
+    tempLong = savedAltitude(tempLong, savedUnits, cAltitudeFineSelectIncrement);
+    if (tempLong >= cLowestAltitudeSelect && tempLong <= cHighestAltitudeSelect) {
+      gState.selectedAltitude = tempLong;
     }
     else {
-      gSelectedAltitudeLong = cDefaultSelectedAltitude;
+      gState.selectedAltitude = cDefaultSelectedAltitude;
     }
   }
 
@@ -336,10 +394,10 @@ void initializeValuesFromEeprom() {
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempInt);
     if (tempInt < 1 || tempInt > 360) {
-      gCalibratedAltitudeOffsetInt = cDefaultSelectedHeading;
+      gState.calibratedAltitudeOffset = cDefaultSelectedHeading;
     }
     else {
-      gSelectedHeadingInt = tempInt;
+      gState.selectedHeading = tempInt;
     }
   }
 
@@ -347,15 +405,39 @@ void initializeValuesFromEeprom() {
   EEPROM.get(cEepromSelectedMinimumsAddr, eepromIndex);
   if (eepromIndex >= 0 && eepromIndex < cSizeOfEeprom) {
     EEPROM.get(eepromIndex, tempLong);
-    if (tempLong >= cLowestAltitudeSelect && tempInt <= cHighAltitude) {
-      gMinimumsAltitudeLong = tempLong;
+    tempLong = savedAltitude(tempLong, savedUnits, cMinimumsSelectIncrement);
+    if (tempLong >= cLowestAltitudeSelect && tempLong <= cHighAltitude) {
+      gState.minimumsAltitude = tempLong;
     }
     else {
-      gMinimumsAltitudeLong = cDefaultMinimumsAltitude;
+      gState.minimumsAltitude = cDefaultMinimumsAltitude;
     }
   }
 }
 
+//////////////////////////////////////////////////////////////////////////
+// an altitude saved in units (a cUnits value), in this build's unit,
+// rounded to the nearest step
+//////////////////////////////////////////////////////////////////////////
+long savedAltitude(long altitude, byte units, int step) {
+  if ((units & cUnitsMarkerMetres) == cUnitsAltitude) {
+    return altitude;
+  }
+  return lround((cUnitsAltitude ? altitude * 0.3048 : altitude / 0.3048) / step) * step;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// an altimeter setting saved in units, in this build's unit, rounded to
+// the nearest setting. roundNumber() adds half of a step of 1 as 0 and
+// would truncate
+//////////////////////////////////////////////////////////////////////////
+int savedAltimeterSetting(int setting, byte units) {
+  if ((units & cUnitsMarkerHpa) == cUnitsAltimeter) {
+    return setting;
+  }
+  return lround((cUnitsAltimeter ? setting * 0.338639 : setting / 0.338639) / cAltimeterSettingInterval) * cAltimeterSettingInterval; //inHg * 100 to hPa
+}
+
 //////////////////////////////////////////////////////////////////////////
 // because EEPROM memory cells are rated for a maximum of 100,000 writes,
 // and because we aren't using most of the EEPROM, by adding a value to 
@@ -368,7 +450,7 @@ void initializeValuesFromEeprom() {
 void initializeDefaultEeprom() {
   
   EEPROM.put(cEepromAltimeterAddr, cEepromLastAddr + 2); //cEepromLastAddr + 2 is the EEPROM address of where we store the altimeter value
-  EEPROM.put(cEepromLastAddr + 2, (int)cSeaLevelPressureInHg); //default value for altimeter
+  EEPROM.put(cEepromLastAddr + 2, (int)cAltimeterSettingStandard); //default value for altimeter
   EEPROM.put(cEepromLastAddr + 2 + sizeof(int), 0); //write counter is set to 0
   
   EEPROM.put(cEepromAltitudeOffsetAddr, cEepromLastAddr + 6);
@@ -404,6 +486,7 @@ void initializeDefaultEeprom() {
   EEPROM.put(cEepromLastAddr + 33 + sizeof(int), 0);
 
   EEPROM.put(cEepromNextAvailableSlot, cEepromLastAddr + 39);
+  EEPROM.put(cEepromUnitsAddr, (byte)cUnits);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -463,7 +546,7 @@ void initializePiracyCheck() {
   gOled.invertDisplay(true);
   gOled.setCursor(13,3);
   gOled.setTextSize(2);
-  gOled.print("ERROR 69"); //lol, you're not supposed to see this screen
+  gOled.print(F("ERROR 69")); //lol, you're not supposed to see this screen
   gOled.display();
   delay(3000);
   int lastWrittenSequence = 0;
@@ -495,9 +578,9 @@ void initializePiracyCheck() {
           initializeDefaultEeprom();
           gOled.clearDisplay();
           gOled.setCursor(12,1);
-          gOled.print("PLEASE");
+          gOled.print(F("PLEASE"));
           gOled.setCursor(12, 17);
-          gOled.print("RESTART");
+          gOled.print(F("RESTART"));
           gOled.display();
           delay(999999999);
         }
@@ -508,7 +591,21 @@ void initializePiracyCheck() {
 
 //////////////////////////////////////////////////////////////////////////
 void initializePressureSensor() {
-  SPL_init();
+  if (!gSensor.begin()) {
+    debugPrintln(F("Pressure sensor not ready"));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// waits for the sensor's first pressure measurement and reads it straight
+// away, so the very first frame shows a real altitude instead of defaults
+//////////////////////////////////////////////////////////////////////////
+void takeFirstSample() {
+  gSensor.waitStatus(SPL_PRS_RDY | SPL_TMP_RDY, SPL_FIRST_SAMPLE_TIMEOUT);
+  handlePressureSensor();
+  gBootTime = millis();
+  debugPrint(F("Boot time ms: "));
+  debugPrintln(gBootTime);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -547,10 +644,10 @@ void initializeRotaryKnobs() {
 
   //Find what phase the right rotary knobs are in
   for (int i = 0; i < cRotaryStates; i++) {
-    if (rightRotaryDt == cEncoderValues[cDtLookup][i] && rightRotaryClk == cEncoderValues[cClkLookup][i]) {
+    if (rightRotaryDt == pgm_read_byte(&cEncoderValues[cDtLookup][i]) && rightRotaryClk == pgm_read_byte(&cEncoderValues[cClkLookup][i])) {
       gRightRotaryIndex = i;
     }
-    if (leftRotaryDt == cEncoderValues[cDtLookup][i] && leftRotaryClk == cEncoderValues[cClkLookup][i]) {
+    if (leftRotaryDt == pgm_read_byte(&cEncoderValues[cDtLookup][i]) && leftRotaryClk == pgm_read_byte(&cEncoderValues[cClkLookup][i])) {
       gLeftRotaryIndex = i;
     }
   }
@@ -607,8 +704,12 @@ void initializeBuzzer() {
 //Main Loop
 //////////////////////////////////////////////////////////////////////////
 void loop() {
+  wdt_reset();
+  Twi.poll();
+  handleBusFault();
+
   if (millis() > cOneSecondBeforeOverflow) { //this handles the extremely rare case (every ~50 days of uptime) that the clock overflows
-    gNextSensorReadyTs = gNextBuzzTs = 0; //reset timing
+    gNextSensorReadyTs = gAlarm.nextBuzzTs = 0; //reset timing
     delay(cOneSecond); //we take a 1 second frozen penalty for handling this extremely rare situation
     return; //return so that we grab a new currentTime
   }
@@ -629,8 +730,8 @@ void loop() {
 
   //if the left screen has been inactive for too long on a non-priority screen, go back to the heading screen
   /*TODO: debug?
-  if (gCursor > CursorSelectTimer && millis() - gLastRotaryActionTs >= cLeftRotaryTimeoutSeconds) {
-    gCursor = CursorSelectHeading;
+  if (gState.cursor > CursorSelectTimer && millis() - gLastRotaryActionTs >= cLeftRotaryTimeoutSeconds) {
+    gState.cursor = CursorSelectHeading;
     gUpdateLeftScreen = true;
   }*/
 
@@ -639,39 +740,126 @@ void loop() {
     updateBatteryLevel();
   }
 
+  //Track how close the stack has come to the heap
+  if (millis() - gMemoryCheckTs >= cMemoryCheckInterval) {
+    handleMemoryMonitor();
+  }
+
   //Automatically turn off minimums if these conditions are met
-  if (gMinimumsTriggered && millis() - gMinimumsTriggeredTs >= cMinimumsTriggeredAutoOffTime) {
-    gMinimumsOn = false;
-    if (gCursor == CursorSelectMinimumsOn || gCursor == CursorSelectMinimumsAltitude) {
-      gUpdateLeftScreen = true;
-      gCursor = CursorSelectMinimumsOn; //kick us back to this mode, because the "MinimumsAltitude" always says "ON"
+  if (gAlarm.minimumsTriggered && gState.minimumsOn && millis() - gAlarm.minimumsTriggeredTs >= cMinimumsTriggeredAutoOffTime) {
+    DeviceStateChange change(gState); //both screens see the new version and redraw
+    gState.minimumsOn = false;
+    if (gState.cursor == CursorSelectMinimumsOn || gState.cursor == CursorSelectMinimumsAltitude) {
+      gState.cursor = CursorSelectMinimumsOn; //kick us back to this mode, because the "MinimumsAltitude" always says "ON"
     }
-    gUpdateRightScreen = true;
   }
 
   handleBuzzer();
+  handlePowerManagement();
   handleDisplay();
 
-  if (gNeedToWriteToEeprom && millis() - gEepromSaveNeededTs >= cEepromWriteDelay) {
+  if (gState.settingsVersion != gSavedSettingsVersion && millis() - gEepromSaveNeededTs >= cEepromWriteDelay) {
     writeValuesToEeprom();
   }
+
+  #ifdef TWI_TRACE
+  Twi.dumpTrace(Serial); //only as much as fits in the serial buffer, so this doesn't hold up the loop
+  #endif
+  #ifdef PROFILE
+  profileDump(Serial); //same here
+  #endif
+  #ifdef LATENCY
+  latencyReport(Serial);
+  #endif
+
+  sleepUntilNextEvent();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// the TWI clears a hung bus by itself, but the sensor and both screens may
+// have been reset or left half way through a command, so set them up again
+//////////////////////////////////////////////////////////////////////////
+void handleBusFault() {
+  if (Twi.faults().recoveries == gBusRecoveries) {
+    return;
+  }
+  gBusRecoveries = Twi.faults().recoveries;
+  debugPrint(F("I2C bus recovered, faults: "));
+  debugPrintln(Twi.faults().total());
+
+  gSensorStandby = false; //begin() starts continuous measurement, handlePowerManagement() puts it back in standby if needed
+  gSensor.begin();
+
+  digitalWrite(cPinLeftDisplayControl, CONTROL_ON);
+  digitalWrite(cPinRightDisplayControl, CONTROL_ON);
+  gOled.begin(SSD1306_SWITCHCAPVCC, cOledAddr, false, false); //the bus is already running
+  if (gDisplaysAsleep) {
+    gOled.ssd1306_command(SSD1306_DISPLAYOFF);
+  }
+  gLeftScreen.invalidate(); //their memory may have been lost or half written
+  gRightScreen.invalidate();
+  gUpdateLeftScreen = true;
+  gUpdateRightScreen = true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void handleMemoryMonitor() {
+  gMemoryCheckTs = millis();
+  unsigned int stackFreeMin = gMemoryStats.stackFreeMin;
+  unsigned int heapUsed = gMemoryStats.heapUsed;
+  unsigned int allocations = gMemoryStats.allocations;
+  updateMemoryStats();
+
+  if (gMemoryStats.stackFreeMin != stackFreeMin || gMemoryStats.heapUsed != heapUsed || gMemoryStats.allocations != allocations) {
+    gMemoryVersion++;
+    debugPrint(F("Stack free min: "));
+    debugPrint(gMemoryStats.stackFreeMin);
+    debugPrint(F(" heap used: "));
+    debugPrint(gMemoryStats.heapUsed);
+    debugPrint(F(" heap end: "));
+    debugPrint(gMemoryStats.heapEnd);
+    debugPrint(F(" allocations: "));
+    debugPrintln(gMemoryStats.allocations);
+    if (gState.cursor == CursorViewMemory) {
+      gUpdateLeftScreen = true;
+    }
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
 void handlePressureSensor() {
-  gNextSensorReadyTs = millis() + cSensorLoopPeriod;
+  gNextSensorReadyTs = millis() + cSensorPollPeriod;
+  if (gSensorStandby && gState.cursor != CursorViewSensorTemp) {
+    return; //the sensor is idle and nobody is looking at the temperature
+  }
+
+  uint8_t newData = gSensor.newData(); //one byte. Reading the results clears these flags, so each sample is only handled once
+  if (gSensorStandby && !(newData & SPL_TMP_RDY) && millis() - gTemperatureRequestTs >= cSensorLoopPeriod) {
+    gTemperatureRequestTs = millis();
+    gSensor.setMeasCtrl(SPL_MEAS_TEMP_ONCE); //the sensor is idle, so ask it for one fresh temperature reading
+  }
+  if (!newData || !gSensor.readSample()) {
+    return; //nothing new, or the read failed. Keep the last good values
+  }
 
   //get temperature
-  gSensorTemperatureDouble = get_temp_f();
-  if (gCursor == CursorViewSensorTemp || gCursor == CursorViewAltitude) {
+  gSampleCount++;
+  gSensorTemperatureDouble = gSensor.tempF();
+  if (gState.cursor == CursorViewSensorTemp || gState.cursor == CursorViewAltitude) {
      gUpdateLeftScreen = true;
   }
 
-  if (gSensorMode != SensorModeOff) {
+  if (gState.sensorMode != SensorModeOff && (newData & SPL_PRS_RDY)) {
     //get altitude
-    gTrueAltitudeDouble = altitudeCorrected(cFeetInMeters * get_altitude(get_pressure(), cSeaLevelPressureHPa));
-    if (gMinimumsSilenced && gTrueAltitudeDouble - gMinimumsAltitudeLong >= cMinimumsSilencedAutoOnAltitudeDiff) {
-      gMinimumsSilenced = false;
+    gTrueAltitudeDouble = altitudeCorrected(pressureAltitude(gSensor.pressure()));
+    gTrueAltitudeFloorLong = floor(gTrueAltitudeDouble);
+    gTrueAltitudeCeilLong = ceil(gTrueAltitudeDouble);
+    DeviceState state = deviceStateSnapshot(gState);
+    if (state.minimumsSilenced && gTrueAltitudeDouble - state.minimumsAltitude >= cMinimumsSilencedAutoOnAltitudeDiff) {
+      DeviceStateChange change(gState);
+      if (gState.version == state.version) { //unless a knob changed the minimums in the meantime
+        gState.minimumsSilenced = false;
+      }
     }
     gUpdateRightScreen = true;
   }
@@ -715,12 +903,12 @@ void handleLeftRotary(int rotaryButton, int rotaryDt, int rotaryClk) {
   //Handle rotation
   int clockwiseRotationIndex = (gLeftRotaryIndex + 1) % cRotaryStates;
   int counterclockwiseRotationIndexIndex = (gLeftRotaryIndex - 1 + cRotaryStates) % cRotaryStates;
-  if (leftRotaryDt == cEncoderValues[cDtLookup][clockwiseRotationIndex] && leftRotaryClk == cEncoderValues[cClkLookup][clockwiseRotationIndex]) {
+  if (leftRotaryDt == pgm_read_byte(&cEncoderValues[cDtLookup][clockwiseRotationIndex]) && leftRotaryClk == pgm_read_byte(&cEncoderValues[cClkLookup][clockwiseRotationIndex])) {
     gLeftRotaryDirection++;
     gLeftRotaryIndex = clockwiseRotationIndex;
   }
-  else if (leftRotaryDt == cEncoderValues[cDtLookup][counterclockwiseRotationIndexIndex]
-        && leftRotaryClk == cEncoderValues[cClkLookup][counterclockwiseRotationIndexIndex]) {
+  else if (leftRotaryDt == pgm_read_byte(&cEncoderValues[cDtLookup][counterclockwiseRotationIndexIndex])
+        && leftRotaryClk == pgm_read_byte(&cEncoderValues[cClkLookup][counterclockwiseRotationIndexIndex])) {
     gLeftRotaryDirection--;
     gLeftRotaryIndex = counterclockwiseRotationIndexIndex;
   }
@@ -747,42 +935,42 @@ void handleLeftRotaryMovement(int increment) {
   gLeftButtonPossibleLongPress = false;
   gLeftRotaryFineTuningPress = (gLeftRotaryButton == PRESSED); //not all states have a fine-tuning press, but we still have to set this here because we don't want a short-press to register and move cursor
 
-  switch (gCursor) {
+  DeviceStateChange change(gState);
+  switch (gState.cursor) {
     case CursorSelectHeading:
     {
       if (gLeftRotaryFineTuningPress) {
-        gSelectedHeadingInt = (gSelectedHeadingInt + increment + 359) % 360 + 1;
+        gState.selectedHeading = (gState.selectedHeading + increment + 359) % 360 + 1;
       }
       else {
         int incrementMagnitude = cHeadingSelectIncrement;
-        if (gSelectedHeadingInt % cHeadingSelectIncrement != 0) {
+        if (gState.selectedHeading % cHeadingSelectIncrement != 0) {
           incrementMagnitude = cHeadingSelectIncrement / 2; //we are at an in-between cHeadingSelectIncrement state, so the knob movement will increment or decement to the nearest cHeadingSelectIncrement
         }
-        gSelectedHeadingInt = (roundNumber((gSelectedHeadingInt + increment * incrementMagnitude), cHeadingSelectIncrement) + 359) % 360 + 1;
+        gState.selectedHeading = (roundNumber((gState.selectedHeading + increment * incrementMagnitude), cHeadingSelectIncrement) + 359) % 360 + 1;
       }
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true; //save heading to EEPROM
+      change.setting(); //save heading to EEPROM
       break;
     }
     
     case CursorSelectAltimeter:
-      gAltimeterSettingInHgInt = constrain(gAltimeterSettingInHgInt + cAltimeterSettingInHgInterval * increment, cAltimeterSettingInHgMin, cAltimeterSettingInHgMax);
+      gState.altimeterSetting = constrain(gState.altimeterSetting + cAltimeterSettingInterval * increment, cAltimeterSettingMin, cAltimeterSettingMax);
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true;
+      change.setting();
       break;
 
     case CursorSelectMinimumsOn:
-      if (gSensorMode != SensorModeOff) {
-        gUpdateRightScreen = true;
-        if (gMinimumsOn) {
-          gMinimumsOn = false;
-          gMinimumsSilenced = false;
+      if (gState.sensorMode != SensorModeOff) {
+        if (gState.minimumsOn) {
+          gState.minimumsOn = false;
+          gState.minimumsSilenced = false;
         }
         else {
-          gMinimumsOn = true;
-          gMinimumsTriggered = false;
+          gState.minimumsOn = true;
+          gAlarm.minimumsTriggered = false;
           gLastMinimumsAltitudeTs = millis(); //note the time the minimums altitude changed so we silence the alarm/buzzer for a short time
-          gMinimumsSilenced = gMinimumsAltitudeLong > gTrueAltitudeDouble;
+          gState.minimumsSilenced = gState.minimumsAltitude > gTrueAltitudeDouble;
         }
       }
       break;
@@ -797,20 +985,20 @@ void handleLeftRotaryMovement(int increment) {
         incrementMagnitude = cAltitudeFineSelectIncrement;
         rounding = cAltitudeFineSelectIncrement;
       }
-      else if (gMinimumsAltitudeLong % cMinimumsSelectIncrement != 0) {
+      else if (gState.minimumsAltitude % cMinimumsSelectIncrement != 0) {
         incrementMagnitude = cMinimumsSelectIncrement / 2; //we are at an in-between cMinimumsSelectIncrement state, so the knob movement will increment or decement to the nearest cAltitudeSelectIncrement
       }
-      gMinimumsAltitudeLong = max(roundNumber(gMinimumsAltitudeLong + increment * incrementMagnitude, rounding), cLowestAltitudeSelect);
-      if (gMinimumsAltitudeLong > cHighAltitude) {
-        gMinimumsAltitudeLong = cHighAltitude;
+      gState.minimumsAltitude = max(roundNumber(gState.minimumsAltitude + increment * incrementMagnitude, rounding), cLowestAltitudeSelect);
+      if (gState.minimumsAltitude > cHighAltitude) {
+        gState.minimumsAltitude = cHighAltitude;
       }
 
       //set the triggered flag
-      gMinimumsTriggered = false;
-      gMinimumsSilenced = gMinimumsAltitudeLong > gTrueAltitudeDouble;
+      gAlarm.minimumsTriggered = false;
+      gState.minimumsSilenced = gState.minimumsAltitude > gTrueAltitudeDouble;
 
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true; //save heading to EEPROM
+      change.setting(); //save minimums to EEPROM
       break;
     }
 
@@ -824,50 +1012,39 @@ void handleLeftRotaryMovement(int increment) {
       break;
 
     case CursorSelectBrightness:
-      if (gOledDim) {
-        gOledDim = false;
-      }
-      else {
-        gOledDim = true;
-      }
+      gState.oledDim = !gState.oledDim;
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true;
-      gUpdateRightScreen = true; //we have to also update the right screen in this case (both screens need update)
+      change.setting();
       break;
     
     case CursorSelectOffset:
-      gCalibratedAltitudeOffsetInt = constrain(roundNumber(gCalibratedAltitudeOffsetInt + cCalibrationOffsetInterval * increment, cCalibrationOffsetInterval), cCalibrationOffsetMin, cCalibrationOffsetMax);
+      gState.calibratedAltitudeOffset = constrain(roundNumber(gState.calibratedAltitudeOffset + cCalibrationOffsetInterval * increment, cCalibrationOffsetInterval), cCalibrationOffsetMin, cCalibrationOffsetMax);
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true;
+      change.setting();
       break;
       
     case CursorSelectSensor:
-      gSensorMode = static_cast<SensorMode>((gSensorMode + increment + cNumberOfSensorModes) % cNumberOfSensorModes);
-      if (gSensorMode == SensorModeOff) {
-        gMinimumsOn = false;
-        gMinimumsSilenced = false;
-        gAlarmModeEnum = DetermineAlarmState;
+      gState.sensorMode = static_cast<SensorMode>((gState.sensorMode + increment + cNumberOfSensorModes) % cNumberOfSensorModes);
+      if (gState.sensorMode == SensorModeOff) {
+        gState.minimumsOn = false;
+        gState.minimumsSilenced = false;
+        gAlarm.mode = DetermineAlarmState;
       }
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true;
-      gUpdateRightScreen = true; //we have to also update the right screen in this case (both screens need update)
+      change.setting();
       break;
 
     case CursorSelectFlipDevice:
-      if (gDeviceFlipped) {
-        gDeviceFlipped = false;
-      }
-      else {
-        gDeviceFlipped = true;
-      }
+      gState.deviceFlipped = !gState.deviceFlipped;
+      gScreensInvalid = true; //the panels swap places, and the picture has to be rewritten the other way round
       gEepromSaveNeededTs = millis();
-      gNeedToWriteToEeprom = true;
-      gUpdateRightScreen = true; //we have to also update the right screen in this case (both screens need update)
+      change.setting();
       break;
 
     case CursorViewSensorTemp:
     case CursorViewAltitude:
     case CursorViewBatteryLevel:
+    case CursorViewMemory:
     default:
       break; //do nothing for these modes, display only
   }
@@ -875,29 +1052,33 @@ void handleLeftRotaryMovement(int increment) {
 
 //////////////////////////////////////////////////////////////////////////
 void handleLeftRotaryShortPress() {
-  gUpdateLeftScreen = true;
-  gCursor = static_cast<Cursor>((gCursor + 1 + cNumberOfCursorModes) % cNumberOfCursorModes);
-  if (gCursor == CursorSelectMinimumsAltitude && !gMinimumsOn) {
-    gCursor = static_cast<Cursor>((gCursor + 1 + cNumberOfCursorModes) % cNumberOfCursorModes);
+  DeviceStateChange change(gState);
+  gState.cursor = static_cast<Cursor>((gState.cursor + 1 + cNumberOfCursorModes) % cNumberOfCursorModes);
+  if (gState.cursor == CursorSelectMinimumsAltitude && !gState.minimumsOn) {
+    gState.cursor = static_cast<Cursor>((gState.cursor + 1 + cNumberOfCursorModes) % cNumberOfCursorModes);
   }
 }
 
 //////////////////////////////////////////////////////////////////////////
 void handleLeftRotaryLongPress() {
-  gUpdateLeftScreen = true;
   gLeftButtonPossibleLongPress = false;
   gDisableLeftRotaryProcessing = true;
   gLeftRotaryFineTuningPress = false;
-  gCursor = CursorSelectHeading;
-
-  if (gSelectedHeadingInt == 333 && gSelectedAltitudeLong == cLowestAltitudeSelect) { //magic numbers to program offset
-    gPermanentCalibratedAltitudeOffsetInt += gCalibratedAltitudeOffsetInt;
-    gCalibratedAltitudeOffsetInt = 0;
-    gEepromSaveNeededTs = millis();
-    gNeedToWriteToEeprom = true;
+  bool resetEeprom;
+  {
+    DeviceStateChange change(gState);
+    gState.cursor = CursorSelectHeading;
+
+    if (gState.selectedHeading == 333 && gState.selectedAltitude == cLowestAltitudeSelect) { //magic numbers to program offset
+      gState.permanentCalibratedAltitudeOffset += gState.calibratedAltitudeOffset;
+      gState.calibratedAltitudeOffset = 0;
+      gEepromSaveNeededTs = millis();
+      change.setting();
+    }
+    resetEeprom = (gState.selectedHeading == 111 && gState.selectedAltitude == cLowestAltitudeSelect); //magic numbers to reset EEPROM
   }
-  else if (gSelectedHeadingInt == 111 && gSelectedAltitudeLong == cLowestAltitudeSelect) { //magic numbers to reset EEPROM
-    resetAntiPiracyCodes();
+  if (resetEeprom) {
+    resetAntiPiracyCodes(); //with interrupts back on, EEPROM writes take a while
   }
 }
 
@@ -920,17 +1101,18 @@ void handleRightRotary(int rotaryButton, int rotaryDt, int rotaryClk) {
       gDisableRightRotaryProcessing = false;
       gRightRotaryReleaseTs = millis();
     }
+    gUpdateRightScreen = true;
   }
 
   //Handle rotation
   int clockwiseRotationIndex = (gRightRotaryIndex + 1) % cRotaryStates;
   int counterclockwiseRotationIndexIndex = (gRightRotaryIndex - 1 + cRotaryStates) % cRotaryStates;
-  if (rightRotaryDt == cEncoderValues[cDtLookup][clockwiseRotationIndex] && rightRotaryClk == cEncoderValues[cClkLookup][clockwiseRotationIndex]) {
+  if (rightRotaryDt == pgm_read_byte(&cEncoderValues[cDtLookup][clockwiseRotationIndex]) && rightRotaryClk == pgm_read_byte(&cEncoderValues[cClkLookup][clockwiseRotationIndex])) {
     gRightRotaryDirection++;
     gRightRotaryIndex = clockwiseRotationIndex;
   }
-  else if (rightRotaryDt == cEncoderValues[cDtLookup][counterclockwiseRotationIndexIndex]
-        && rightRotaryClk == cEncoderValues[cClkLookup][counterclockwiseRotationIndexIndex]) {
+  else if (rightRotaryDt == pgm_read_byte(&cEncoderValues[cDtLookup][counterclockwiseRotationIndexIndex])
+        && rightRotaryClk == pgm_read_byte(&cEncoderValues[cClkLookup][counterclockwiseRotationIndexIndex])) {
     gRightRotaryDirection--;
     gRightRotaryIndex = counterclockwiseRotationIndexIndex;
   }
@@ -939,9 +1121,8 @@ void handleRightRotary(int rotaryButton, int rotaryDt, int rotaryClk) {
     //either we moved clockwise, counter-clockwise, or wiggled a little back without hitting a neighboring detent
     handleRightRotaryMovement(gRightRotaryDirection / cRotaryStates);
     gRightRotaryDirection = 0;
+    gUpdateRightScreen = true;
   }
-
-  gUpdateRightScreen = true;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -949,22 +1130,26 @@ void handleRightRotaryMovement(int increment) { // +1 indicates rotation to the
   if (increment == 0) {
     return; //if we didn't really move detents, do nothing
   }
+  #ifdef LATENCY
+  latencyInput(); //start the clock on getting this onto the screen
+  #endif
   gLastRightRotaryActionTs = millis(); //note the time the knob moved to a different detent so we silence the alarm/buzzer
   gRightButtonPossibleLongPress = false;
   gRightRotaryFineTuningPress = (gRightRotaryButton == PRESSED);
 
-  gAlarmModeEnum = DetermineAlarmState; //disable alarm if we change selected altitude
-  if (gSelectedAltitudeLong > cHighAltitude || (gSelectedAltitudeLong == cHighAltitude && increment == 1) ) {
+  gAlarm.mode = DetermineAlarmState; //disable alarm if we change selected altitude
+  DeviceStateChange change(gState);
+  if (gState.selectedAltitude > cHighAltitude || (gState.selectedAltitude == cHighAltitude && increment == 1) ) {
     int incrementMagnitude = cAltitudeHighSelectIncrement; //normal increment magnitude indicates the button being released and the current selected altitude being on an interval
     int rounding = cAltitudeHighSelectIncrement;
     if (gRightRotaryFineTuningPress) { //if we're fine-tuning, make the increment magnitude smaller
       incrementMagnitude = cAltitudeSelectIncrement;
       rounding = cAltitudeSelectIncrement;
     }
-    else if (gSelectedAltitudeLong % cAltitudeHighSelectIncrement != 0) { //if we're using the bigger increment but are in-between intervals, then we are going to jump to the nearest interval based on the direction of turn
+    else if (gState.selectedAltitude % cAltitudeHighSelectIncrement != 0) { //if we're using the bigger increment but are in-between intervals, then we are going to jump to the nearest interval based on the direction of turn
       incrementMagnitude = cAltitudeHighSelectIncrement / 2; //we are at an in-between cAltitudeHighSelectIncrement state, so the knob movement will increment or decement to the nearest cAltitudeHighSelectIncrement
     }
-    gSelectedAltitudeLong = min(roundNumber(gSelectedAltitudeLong + increment * incrementMagnitude, rounding), cHighestAltitudeSelect);
+    gState.selectedAltitude = min(roundNumber(gState.selectedAltitude + increment * incrementMagnitude, rounding), cHighestAltitudeSelect);
   }
   else {
     int incrementMagnitude = cAltitudeSelectIncrement;
@@ -973,13 +1158,13 @@ void handleRightRotaryMovement(int increment) { // +1 indicates rotation to the
       incrementMagnitude = cAltitudeFineSelectIncrement;
       rounding = cAltitudeFineSelectIncrement;
     }
-    else if (gSelectedAltitudeLong % cAltitudeSelectIncrement != 0) {
+    else if (gState.selectedAltitude % cAltitudeSelectIncrement != 0) {
       incrementMagnitude = cAltitudeSelectIncrement / 2; //we are at an in-between cAltitudeSelectIncrement state, so the knob movement will increment or decement to the nearest cAltitudeSelectIncrement
     }
-    gSelectedAltitudeLong = max(roundNumber(gSelectedAltitudeLong + increment * incrementMagnitude, rounding), cLowestAltitudeSelect);
+    gState.selectedAltitude = max(roundNumber(gState.selectedAltitude + increment * incrementMagnitude, rounding), cLowestAltitudeSelect);
   }
   gEepromSaveNeededTs = millis();
-  gNeedToWriteToEeprom = true; //save selected altitude to EEPROM
+  change.setting(); //save selected altitude to EEPROM
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -988,638 +1173,688 @@ void handleRightRotaryLongPress() {
   gDisableRightRotaryProcessing = true;
   gRightRotaryFineTuningPress = false;
   gLastRightRotaryActionTs = millis(); //note the time so we silence the alarm/buzzer temporarily
-  gAlarmModeEnum = DetermineAlarmState; //disable alarm
+  gAlarm.mode = DetermineAlarmState; //disable alarm
 
-  if (gSensorMode == SensorModeOff) {
+  if (gState.sensorMode == SensorModeOff) {
     return; //don't sync the altitude if we're not measuring the current altitude
   }
 
-  //if altitude is above 18k (cHighAltitude), then set selected altitude to nearest 1000ft (cAltitudeHighSelectIncrement) of our true altitude
+  //if altitude is above cHighAltitude (18k ft), then set selected altitude to the nearest cAltitudeHighSelectIncrement (1000ft) of our true altitude
+  long selectedAltitude;
   if (gTrueAltitudeDouble >= cHighAltitude) {
-    gSelectedAltitudeLong = roundNumber(gTrueAltitudeDouble, cAltitudeHighSelectIncrement);
+    selectedAltitude = roundNumber(gTrueAltitudeDouble, cAltitudeHighSelectIncrement);
   }
-  else { //else, we're below 18k, so round to the nearest 100ft (cAltitudeSelectIncrement) of our true altitude
-    gSelectedAltitudeLong = roundNumber(gTrueAltitudeDouble, cAltitudeSelectIncrement);
+  else { //else, we're below cHighAltitude, so round to the nearest cAltitudeSelectIncrement (100ft) of our true altitude
+    selectedAltitude = roundNumber(gTrueAltitudeDouble, cAltitudeSelectIncrement);
   }
-  gUpdateRightScreen = true;
+  DeviceStateChange change(gState);
+  gState.selectedAltitude = selectedAltitude;
+  gEepromSaveNeededTs = millis();
+  change.setting(); //a synced altitude is saved like a dialled one
 }
 
 //////////////////////////////////////////////////////////////////////////
 void handleBuzzer() {
-  
-  //Handle changing of minimums altitude selection
-  if (gSensorMode != SensorModeOff
-      && gMinimumsOn
-      && !gMinimumsSilenced
-      && !gMinimumsTriggered
-      && gTrueAltitudeDouble <= gMinimumsAltitudeLong
-      && millis() - gLastMinimumsAltitudeTs >= cDisableAlarmKnobMovementTime) {
-    gAlarmModeEnum = MinimumsAlarm;
-    gMinimumsTriggered = true;
-    gMinimumsTriggeredTs = millis();
-  }
-
-  switch (gAlarmModeEnum) {
-    case Climbing1000ToGo:
-    {
-      if (gTrueAltitudeDouble >= gSelectedAltitudeLong - cAlarm1000ToGo) {
-        gAlarmModeEnum = LongAlarm;
-        gNextBuzzTs = millis(); //next buzz time is now
-      }
-      break;
-    }
-
-    case Descending1000ToGo:
-    {
-      if (gTrueAltitudeDouble <= gSelectedAltitudeLong + cAlarm1000ToGo) {
-        gAlarmModeEnum = LongAlarm;
-        gNextBuzzTs = millis(); //next buzz time is now
-      }
-      break;
-    }
-    
-    case Climbing200ToGo:
-    {
-      if (gTrueAltitudeDouble >= gSelectedAltitudeLong - cAlarm200ToGo) {
-        gAlarmModeEnum = UrgentAlarm;
-        gNextBuzzTs = millis(); //next buzz time is now
-      }
-      else if (gTrueAltitudeDouble < gSelectedAltitudeLong - cAlarm1000ToGo) {
-        gAlarmModeEnum = Climbing1000ToGo;
-      }
-      break;
-    }
-      
-    case Descending200ToGo:
-    {
-      if (gTrueAltitudeDouble <= gSelectedAltitudeLong + cAlarm200ToGo) {
-        gAlarmModeEnum = UrgentAlarm;
-        gNextBuzzTs = millis(); //next buzz time is now
-      }
-      else if (gTrueAltitudeDouble > gSelectedAltitudeLong + cAlarm1000ToGo) {
-        gAlarmModeEnum = Descending1000ToGo;
-      }
-      break;
-    }
-    
-    case AltitudeDeviate: //We're looking to sound the alarm if pilot deviates from his altitude he already reached
-    {
-      if (gTrueAltitudeDouble > gSelectedAltitudeLong + cAlarm200ToGo || gTrueAltitudeDouble < gSelectedAltitudeLong - cAlarm200ToGo) {
-        gAlarmModeEnum = UrgentAlarm; //initiate beeping the alarm on the next pass
-        gNextBuzzTs = millis(); //next buzz time is now
-      }
-      break;
-    }
-      
-    case UrgentAlarm:
-    {
-      if (gBuzzCountInt == 0) {
-        gLastAlarmTs = millis();
-        gBuzzCountInt = cUrgentBuzzNumberOfBeeps * 2;
-        gFlashRightScreen = true;
-      }
-      if (millis() >= gNextBuzzTs) {
-        gBuzzCountInt--;
-        if (gBuzzCountInt % 2 == 1) {
-          if (gSensorMode != SensorModeSilent) {
-            digitalWrite(cBuzzPin, HIGH);
-          }
-          gNextBuzzTs = millis() + cShortBuzzOnDuration;
-        }
-        else if (gBuzzCountInt != 0 && gBuzzCountInt % 2 == 0) {
-          digitalWrite(cBuzzPin, LOW);
-          gNextBuzzTs = millis() + cShortBuzzOffDuration;
-        }
-        else { //last cycle, turning everything off
-          gAlarmModeEnum = AlarmDisabled;
-          digitalWrite(cBuzzPin, LOW);
-          gFlashRightScreen = false;
-        }
-        gUpdateRightScreen = true;
-      }
-      break;
-    }
+  DeviceState state = deviceStateSnapshot(gState);
+  gAlarm.trueAltitudeFloor = gTrueAltitudeFloorLong;
+  gAlarm.trueAltitudeCeil = gTrueAltitudeCeilLong;
+  gAlarm.selectedAltitude = state.selectedAltitude;
+  gAlarm.minimumsAltitude = state.minimumsAltitude;
+  gAlarm.minimumsOn = state.minimumsOn;
+  gAlarm.minimumsSilenced = state.minimumsSilenced;
+  gAlarm.sensorMode = state.sensorMode;
+  gAlarm.lastRightRotaryActionTs = gLastRightRotaryActionTs;
+  gAlarm.lastMinimumsAltitudeTs = gLastMinimumsAltitudeTs;
+
+  gAlarm.update(millis());
+
+  if (gAlarm.buzzerOn != gBuzzerPinOn) {
+    gBuzzerPinOn = gAlarm.buzzerOn;
+    digitalWrite(cBuzzPin, gBuzzerPinOn ? HIGH : LOW);
+  }
+  if (gAlarm.updateScreen) {
+    gAlarm.updateScreen = false;
+    gUpdateRightScreen = true;
+    gUrgentRightScreen = true; //the flash has to keep its rhythm
+  }
+}
 
-    case MinimumsAlarm:
-    {
-      if (gBuzzCountInt == 0) {
-        gLastAlarmTs = millis();
-        /* each cycle of the pattern has 4 elements to it. short beep, short pause, long beep, pause between
-         * the next cycle of beeps. subtract 1 for the last cycle not having a long pause at the end */
-        gBuzzCountInt = cMinimumsNumberOfBeepCylces * 4;
-        gFlashRightScreen = true;
-        gUpdateRightScreen = true;
-      }
-      if (millis() >= gNextBuzzTs) {
-        gBuzzCountInt--;
-        if (gBuzzCountInt % 4 == 3) {
-          if (gSensorMode != SensorModeSilent) {
-            digitalWrite(cBuzzPin, HIGH);
-          }
-          gNextBuzzTs = millis() + cMinimumsShortBuzzOnDuration;
-        }
-        else if (gBuzzCountInt % 4 == 2) {
-          digitalWrite(cBuzzPin, LOW);
-          gNextBuzzTs = millis() + cMinimumsBuzzOffDuration;
-        }
-        else if (gBuzzCountInt % 4 == 1) {
-          if (gSensorMode != SensorModeSilent) {
-            digitalWrite(cBuzzPin, HIGH);
-          }
-          gNextBuzzTs = millis() + cMinimumsLongBuzzOnDuration;
-        }
-        else if (gBuzzCountInt != 0 && gBuzzCountInt % 4 == 0) {
-          digitalWrite(cBuzzPin, LOW);
-          gNextBuzzTs = millis() + cMinimumsOffBetweenCycleDuration;
-        }
-        else {
-          gAlarmModeEnum = AlarmDisabled;
-          digitalWrite(cBuzzPin, LOW);
-          gFlashRightScreen = false;
-          gUpdateRightScreen = true;
-        }
-      }
-      break;
+//////////////////////////////////////////////////////////////////////////
+void handlePowerManagement() {
+  //the pressure sensor idles while it's turned off, it only takes the odd temperature reading for the temperature page
+  bool sensorStandby = (gState.sensorMode == SensorModeOff);
+  if (sensorStandby != gSensorStandby) {
+    gSensorStandby = sensorStandby;
+    gSensor.setMeasCtrl(sensorStandby ? SPL_MEAS_STANDBY : SPL_MEAS_CONT_PRS_TEMP);
+  }
+
+  //turn both screens off after a long time without any knob activity, unless an alarm could go off. Any knob movement turns them back on
+  bool alarmArmed = gState.sensorMode != SensorModeOff || gAlarm.mode != AlarmDisabled || gAlarm.flashScreen;
+  bool displaysIdle = cDisplaySleepTimeout != 0 && millis() - gLastKnobEdgeTs >= cDisplaySleepTimeout && !alarmArmed;
+  if (displaysIdle != gDisplaysAsleep) {
+    gDisplaysAsleep = displaysIdle;
+
+    //both screens listen while both control pins are on, so one command reaches both of them.
+    //Let any frame still going out finish before the pins change
+    Twi.flush();
+    digitalWrite(cPinLeftDisplayControl, CONTROL_ON);
+    digitalWrite(cPinRightDisplayControl, CONTROL_ON);
+    gOled.ssd1306_command(gDisplaysAsleep ? SSD1306_DISPLAYOFF : SSD1306_DISPLAYON);
+
+    if (!gDisplaysAsleep) {
+      gUpdateLeftScreen = true;
+      gUpdateRightScreen = true;
     }
+  }
+}
 
-    case LongAlarm:
-      if (gBuzzCountInt == 0) {
-        gLastAlarmTs = millis();
-        gBuzzCountInt = 2;
-      }
-      if (millis() >= gNextBuzzTs) {
-        gBuzzCountInt--;
-        if (gBuzzCountInt == 1) {
-          if (gSensorMode != SensorModeSilent) {
-            digitalWrite(cBuzzPin, HIGH);
-          }
-          gNextBuzzTs = millis() + cLongBuzzDuration;
-          gFlashRightScreen = true;
-        }
-        else {
-          gAlarmModeEnum = AlarmDisabled;
-          digitalWrite(cBuzzPin, LOW);
-          gFlashRightScreen = false;
-        }
-        gUpdateRightScreen = true;
-      }
-      break;
+//////////////////////////////////////////////////////////////////////////
+// sleeps until the next interrupt once this pass of the loop is done.
+// Normally that's idle mode, which timer0 ends within a millisecond so
+// none of the loop's timing changes. With the screens asleep and nothing
+// being measured, timed or saved, we power down until a knob moves.
+//////////////////////////////////////////////////////////////////////////
+void sleepUntilNextEvent() {
+  if (!gDisplaysAsleep && (leftScreenDue() || rightScreenDue())) {
+    return; //there is more work waiting
+  }
+
+  //the checks run with interrupts off, and sei() only lets them in after the instruction that follows it.
+  //So a knob edge that comes in after the checks still wakes us from the sleep instead of being missed
+  noInterrupts();
+  if (gDisplaysAsleep
+      && millis() - gLastKnobEdgeTs >= cDisplaySleepTimeout
+      && gState.sensorMode == SensorModeOff
+      && gAlarm.mode == AlarmDisabled
+      && !gBuzzerPinOn
+      && gTimerStartTs == 0
+      && gState.settingsVersion == gSavedSettingsVersion
+      && !gLeftButtonPossibleLongPress
+      && !gRightButtonPossibleLongPress
+      && !Twi.busy()) {
+    byte adcControl = ADCSRA;
+    ADCSRA = 0; //the ADC keeps drawing current while powered down
+    wdt_disable(); //the watchdog keeps running while powered down, and we may sleep for hours
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sleep_bod_disable();
+    interrupts();
+    sleep_cpu(); //only a knob pin change wakes us back up. millis() stands still until then
+    sleep_disable();
+    ADCSRA = adcControl;
+    wdt_enable(cWatchdogTimeout);
+  }
+  else {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+  }
+}
 
-    case AlarmDisabled:
-    {
-      if (millis() - gLastAlarmTs < cDisableAlarmAfterAlarmTime || millis() < cPowerUpSilence) {
-        //if alarm disabled or pressure sensor failed, do nothing
-      }
-      else if (gSensorMode != SensorModeOff && gSelectedAltitudeLong <= cHighestAltitudeAlert && millis() - gLastRightRotaryActionTs >= cDisableAlarmKnobMovementTime) {
-        gAlarmModeEnum = DetermineAlarmState;
-        cPowerUpSilence = 0;
-      }
-      break;
-    }
+//////////////////////////////////////////////////////////////////////////
+void handleDisplay() {
+  if (gScreensInvalid) { //left for here by the knob interrupt, which mustn't touch the screens mid-frame
+    gScreensInvalid = false;
+    gLeftScreen.invalidate();
+    gRightScreen.invalidate();
+  }
 
-    default: //default case
-    case DetermineAlarmState:
-    {
-      long diffBetweenSelectionAndTrueAltitude = gSelectedAltitudeLong - gTrueAltitudeDouble;
+  if (gDisplaysAsleep) {
+    return; //keep the update flags set, so both screens are redrawn when they wake up
+  }
 
-      if (millis() - gLastRightRotaryActionTs < cDisableAlarmKnobMovementTime) {
-        digitalWrite(cBuzzPin, LOW); //stop the buzzer
-        gFlashRightScreen = false;
-        gBuzzCountInt = 0;
-      }
-      else if (gSensorMode == SensorModeOff || gSelectedAltitudeLong > cHighestAltitudeAlert) {
-        gAlarmModeEnum = AlarmDisabled;
-        digitalWrite(cBuzzPin, LOW); //stop the buzzer
-        gFlashRightScreen = false;
-        gBuzzCountInt = 0;
-      }
-      else if (diffBetweenSelectionAndTrueAltitude > cAlarm1000ToGo) {
-        gAlarmModeEnum = Climbing1000ToGo;
-      }
-      else if (diffBetweenSelectionAndTrueAltitude < (cAlarm1000ToGo * -1)) {
-        gAlarmModeEnum = Descending1000ToGo;
-      }
-      else if (diffBetweenSelectionAndTrueAltitude > cAlarm200ToGo) {
-        gAlarmModeEnum = Climbing200ToGo;
-      }
-      else if (diffBetweenSelectionAndTrueAltitude < (cAlarm200ToGo * -1)){ 
-        gAlarmModeEnum = Descending200ToGo;
-      }
-      else /*(diffBetweenSelectionAndTrueAltitude > (cAlarm200ToGo * -1) && diffBetweenSelectionAndTrueAltitude < cAlarm200ToGo)*/ { //I commented out the conditional check to save the computation cycles, because it's the only remaining logical choice
-        gAlarmModeEnum = AltitudeDeviate;
-      }
-      break;
+  //update the left screen once each time the running timer reaches a new second
+  if (gTimerStartTs != 0) {
+    unsigned long timerSecond = (millis() - gTimerStartTs) / 1000;
+    if (timerSecond != gTimerSecondShown) {
+      gTimerSecondShown = timerSecond;
+      gUpdateLeftScreen = true;
     }
   }
-}
 
-//////////////////////////////////////////////////////////////////////////
-void handleDisplay() {
-  if (gDeviceFlipped) {
-    if (gUpdateLeftScreen) {
+  //a frame goes out in the background, and the control pins must not change until it's done.
+  //So draw at most one screen per pass and leave the other one for a later pass.
+  //An alarm flash goes first, otherwise the left screen does
+  if (!Twi.busy()) {
+    bool rightDue = rightScreenDue();
+    if (leftScreenDue() && !(rightDue && gUrgentRightScreen)) {
       gUpdateLeftScreen = false;
-      digitalWrite(cPinLeftDisplayControl, CONTROL_OFF);
-      digitalWrite(cPinRightDisplayControl, CONTROL_ON);
+      gLeftFrameTs = millis();
+      digitalWrite(cPinLeftDisplayControl, gState.deviceFlipped ? CONTROL_OFF : CONTROL_ON);
+      digitalWrite(cPinRightDisplayControl, gState.deviceFlipped ? CONTROL_ON : CONTROL_OFF);
       drawLeftScreen();
     }
-    if (gUpdateRightScreen) {
+    else if (rightDue) {
       gUpdateRightScreen = false;
-      digitalWrite(cPinLeftDisplayControl, CONTROL_ON);
-      digitalWrite(cPinRightDisplayControl, CONTROL_OFF);
+      gUrgentRightScreen = false;
+      gRightFrameTs = millis();
+      digitalWrite(cPinLeftDisplayControl, gState.deviceFlipped ? CONTROL_ON : CONTROL_OFF);
+      digitalWrite(cPinRightDisplayControl, gState.deviceFlipped ? CONTROL_OFF : CONTROL_ON);
+      #ifdef LATENCY
+      latencyFrameStart();
+      #endif
       drawRightScreen();
     }
   }
-  else {
-    if (gUpdateLeftScreen) {
-      gUpdateLeftScreen = false;
-      digitalWrite(cPinLeftDisplayControl, CONTROL_ON);
-      digitalWrite(cPinRightDisplayControl, CONTROL_OFF);
-      drawLeftScreen();
+}
+
+//////////////////////////////////////////////////////////////////////////
+// a screen is due once something asked for it to be redrawn, or gState
+// changed since it was drawn, and its last frame is at least
+// cMinFrameInterval old. Everything that happens in the meantime ends up
+// in that one frame
+//////////////////////////////////////////////////////////////////////////
+bool leftScreenDue() {
+  return (gUpdateLeftScreen || gState.version != gLeftStateVersion) && millis() - gLeftFrameTs >= cMinFrameInterval;
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool rightScreenDue() {
+  return (gUpdateRightScreen || gState.version != gRightStateVersion) && (gUrgentRightScreen || millis() - gRightFrameTs >= cMinFrameInterval);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// what the top-left corner of the right screen shows: minimums info and/or
+// a "LOW BATT" or "SILENT" message, taking turns when there's both
+//////////////////////////////////////////////////////////////////////////
+uint8_t rightStatus() {
+  uint8_t status = RightStatusNone;
+  if (gFrame->minimumsOn) {
+    if (gAlarm.minimumsTriggered) { //this displays "MINIMUMS" in small text in the top-left corner for maybe 30 seconds after minimums were triggered
+      status = RightStatusMinimums;
     }
-    if (gUpdateRightScreen) {
-      gUpdateRightScreen = false;
-      digitalWrite(cPinLeftDisplayControl, CONTROL_OFF);
-      digitalWrite(cPinRightDisplayControl, CONTROL_ON);
-      drawRightScreen();
+    else if (gFrame->minimumsSilenced) { //the user selected minimums higher than their current altitude, so minimums aren't armed yet. Once they climb above the minimums altitude by I think 200ft, the minimums become "armed" and can then trigger. This prints "-------ft" if it's in this "not armed" mode.
+      status = RightStatusNotArmed;
+    }
+    else {
+      status = RightStatusCountdown;
     }
   }
+  bool minimumsStatusDisplayed = (status != RightStatusNone);
 
-  //always update the left screen once a second when timer is running. I am giving it a 100 millisecond window at the beginning of each second to allow updates
-  if (gTimerStartTs != 0 && (millis() - gTimerStartTs) % 1000 < 100) {
-    gUpdateLeftScreen = true;
+  unsigned long clockTime = millis();
+  if (millis() < gAlarm.powerUpSilence) {
+    status = RightStatusSilent;
+  }
+  else if (!gBatteryCharging && gBatteryLevel <= cBatteryAlertLevel) { //low battery while not charging
+    if (!minimumsStatusDisplayed || minimumsStatusDisplayed && (clockTime % cAltMessageInterval <= cAltMessageDuration)) {
+      status = RightStatusLowBattery;
+    }
+    if (gFrame->sensorMode == SensorModeSilent && (clockTime % cAltMessageInterval <= cAltMessageDuration) && (clockTime % cAltMessageInterval > cAltMessageDuration)) {
+      status = RightStatusSilent;
+    }
+  }
+  else if (gFrame->sensorMode == SensorModeSilent && (!minimumsStatusDisplayed || minimumsStatusDisplayed && (clockTime % cAltMessageInterval <= cAltMessageDuration))) {
+    status = RightStatusSilent;
   }
+  return status;
 }
 
 //////////////////////////////////////////////////////////////////////////
-void drawLeftScreen() {
-  gOled.clearDisplay();
-  
-  if (gDeviceFlipped) {
-    gOled.setRotation(2);
-  }
-  else {
-    gOled.setRotation(0);
+// the widgets' format functions. Each writes what its widget shows right
+// now, see Widgets.h
+//////////////////////////////////////////////////////////////////////////
+void formatTimer(char *text) {
+  unsigned long seconds = (millis() - gTimerStartTs) / 1000;
+  unsigned long minutes = seconds / 60;
+  while (minutes >= 100) {
+    minutes -= 100;
+  }
+  seconds -= minutes * 60;
+  sprintf_P(text, PSTR("%02d:%02d"), (int)minutes, (int)seconds);
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatTimerBadge(char *text) { //if timer is running while not on timer screen, show the timer
+  if (gFrame->cursor != CursorSelectTimer && gTimerStartTs != 0) {
+    formatTimer(text);
   }
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatHeading(char *text) {
+  sprintf_P(text, PSTR("%03d"), gFrame->selectedHeading);
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatAltimeterSetting(char *text) {
+  #ifdef UNITS_HPA
+  sprintf_P(text, PSTR("%d" cAltimeterLabel), gFrame->altimeterSetting);
+  #else
+  sprintf_P(text, PSTR("%d.%02d" cAltimeterLabel), gFrame->altimeterSetting / 100, gFrame->altimeterSetting % 100);
+  #endif
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// the minimums altitude page can only be reached with minimums turned on
+//////////////////////////////////////////////////////////////////////////
+bool minimumsShown() {
+  return gFrame->sensorMode != SensorModeOff && (gFrame->minimumsOn || gFrame->cursor == CursorSelectMinimumsAltitude);
+}
 
-  if (gOledDim) {
-    gOled.dim(true, 0);
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatMinimumsStatus(char *text) {
+  if (gFrame->sensorMode == SensorModeOff) {
+    strcpy_P(text, PSTR("Sensor Off"));
+  }
+  else if (minimumsShown()) {
+    strcpy_P(text, PSTR("ON"));
+    return 5;
   }
   else {
-    gOled.dim(false, 255);
+    strcpy_P(text, PSTR("OFF"));
   }
+  return 0;
+}
 
-  gOled.invertDisplay(gFlashLeftScreen);
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatSelectionLine(char *text) { //line under the minimums setting being changed
+  if (gFrame->sensorMode != SensorModeOff) {
+    strcpy_P(text, PSTR("-"));
+  }
+  return 0;
+}
 
-  bool overrideBottomContent = false;
-  
-  //If timer is running while not on timer screen, show the timer
-  if (gCursor != CursorSelectTimer && gTimerStartTs != 0) {
-    unsigned long seconds = (millis() - gTimerStartTs) / 1000;
-    unsigned long minutes = seconds / 60;
-    while (minutes >= 100) {
-      minutes -= 100;
-    }
-    seconds -= minutes * 60;
-    sprintf(gDisplayBottomContent, "%02d:%02d", (int)minutes, (int)seconds);
-    gOled.setTextSize(cLabelTextSize);
-    gOled.setCursor(98, cLabelTextYpos);
-    gOled.print(gDisplayBottomContent);
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatMinimumsAltitude(char *text) {
+  if (minimumsShown()) {
+    long minimumtsAltitudeLong = gFrame->minimumsAltitude;
+    char* minimumsAltitude = displayNumber(roundNumber(minimumtsAltitudeLong, cTrueAltitudeRoundToNearest), false);
+    sprintf_P(text, PSTR("%6s"), minimumsAltitude);
   }
+  return 0;
+}
 
-  switch (gCursor) {
-    case CursorSelectHeading: //Display Selected Heading
-    {
-      sprintf(gDisplayTopContent, "%s", "Heading");
-      sprintf(gDisplayBottomContent, "%03d", gSelectedHeadingInt);
-      gOled.setTextSize(2);
-      gOled.setCursor(56, 11);
-      gOled.print((char)(247)); //247 = degree symbol
-      break;
-    }
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatMinimumsFt(char *text) {
+  if (minimumsShown()) {
+    strcpy_P(text, PSTR(cAltitudeLabel));
+  }
+  return 0;
+}
 
-    case CursorSelectAltimeter:
-      sprintf(gDisplayTopContent, "%s", "Altimeter");
-      sprintf(gDisplayBottomContent, "%d.%02d" cInLabel, gAltimeterSettingInHgInt / 100, gAltimeterSettingInHgInt % 100);
-      break;
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatStopwatch(char *text) {
+  if (gTimerStartTs == 0) {
+    strcpy_P(text, PSTR("00:00"));
+  }
+  else {
+    formatTimer(text);
+  }
+  return 0;
+}
 
-    case CursorSelectMinimumsOn:
-    {
-      sprintf(gDisplayTopContent, "%s", "Minimums");
-
-      overrideBottomContent = true;
-      long altitudeDifference = gTrueAltitudeDouble - gSelectedAltitudeLong;
-      gOled.setTextSize(2);
-      gOled.setCursor(1, cReadoutTextYpos + 4);
-      if (gSensorMode == SensorModeOff) {
-        gOled.print("Sensor Off");
-      }
-      else if (gMinimumsOn) {
-        gOled.setCursor(6, cReadoutTextYpos + 4);
-        gOled.print("ON");
-        gOled.writeLine(0, 31, 35, 31, SSD1306_WHITE); //line for selection
-
-        long minimumtsAltitudeLong = gMinimumsAltitudeLong;
-        char* minimumsAltitude = displayNumber(roundNumber(minimumtsAltitudeLong, cTrueAltitudeRoundToNearestFt), false);
-        sprintf(gDisplayBottomContent, "%6s", minimumsAltitude);
-        gOled.setCursor(43, cReadoutTextYpos + 4);
-        gOled.print(gDisplayBottomContent);
-        delete minimumsAltitude;
-
-        gOled.setTextSize(1);
-        gOled.setCursor(116, cReadoutTextYpos + 11);
-        gOled.print(cFtLabel);
-      }
-      else {
-        gOled.print("OFF");
-        gOled.writeLine(0, 31, 35, 31, SSD1306_WHITE); //line for selection
-      }
-      break;
-    }
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatBrightness(char *text) {
+  if (gFrame->oledDim) {
+    strcpy_P(text, PSTR("DIM"));
+  }
+  else {
+    strcpy_P(text, PSTR("BRIGHT"));
+  }
+  return 0;
+}
 
-    case CursorSelectMinimumsAltitude:
-    {
-      sprintf(gDisplayTopContent, "%s", "Minimums");
-
-      overrideBottomContent = true;
-      long altitudeDifference = gTrueAltitudeDouble - gSelectedAltitudeLong;
-      gOled.setTextSize(2);
-      gOled.setCursor(1, cReadoutTextYpos + 4);
-      if (gSensorMode == SensorModeOff) {
-        gOled.print("Sensor Off");
-      }
-      else { //we only reach this if minimums are turned ON
-        gOled.setCursor(6, cReadoutTextYpos + 4);
-        gOled.print("ON");
-        gOled.writeLine(42, 31, 126, 31, SSD1306_WHITE); //line for selection
-
-        long minimumtsAltitudeLong = gMinimumsAltitudeLong;
-        char* minimumsAltitude = displayNumber(roundNumber(minimumtsAltitudeLong, cTrueAltitudeRoundToNearestFt), false);
-        sprintf(gDisplayBottomContent, "%6s", minimumsAltitude);
-        gOled.setCursor(43, cReadoutTextYpos + 4);
-        gOled.print(gDisplayBottomContent);
-        delete minimumsAltitude;
-
-        gOled.setTextSize(1);
-        gOled.setCursor(116, cReadoutTextYpos + 11);
-        gOled.print(cFtLabel);
-      }
-      break;
-    }
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatCalibration(char *text) {
+  sprintf_P(text, PSTR("%+d" cAltitudeLabel), gFrame->calibratedAltitudeOffset);
+  return 0;
+}
 
-    case CursorSelectTimer:
-      sprintf(gDisplayTopContent, "%s", "Stopwatch");
-      if (gTimerStartTs == 0) {
-        sprintf(gDisplayBottomContent, "00:00");
-      }
-      else {
-        unsigned long seconds = (millis() - gTimerStartTs) / 1000;
-        unsigned long minutes = seconds / 60;
-        while (minutes >= 100) {
-          minutes -= 100;
-        }
-        seconds -= minutes * 60;
-        sprintf(gDisplayBottomContent, "%02d:%02d", (int)minutes, (int)seconds);
-      }
-      break;
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatSensorMode(char *text) {
+  if (gFrame->sensorMode == SensorModeOnShow) {
+    strcpy_P(text, PSTR("ON/SHOW"));
+  }
+  else if (gFrame->sensorMode == SensorModeOnHide) {
+    strcpy_P(text, PSTR("ON/HIDE"));
+  }
+  else if (gFrame->sensorMode == SensorModeSilent) {
+    strcpy_P(text, PSTR("SILENT"));
+  }
+  else {
+    strcpy_P(text, PSTR("OFF"));
+  }
+  return 0;
+}
 
-    case CursorSelectBrightness:
-      sprintf(gDisplayTopContent, "%s", "Brightness");
-      if (gOledDim) {
-        sprintf(gDisplayBottomContent, "%s", "DIM");
-      }
-      else {
-        sprintf(gDisplayBottomContent, "%s", "BRIGHT");
-      }
-      break;
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatTemperature(char *text) {
+  double temperatureFarenheit = gSensorTemperatureDouble;
+  sprintf_P(text, PSTR("%d.%d %c"), (int)temperatureFarenheit, abs((int)(temperatureFarenheit*10)%10), cDegFLabel);
+  return 0;
+}
 
-    case CursorSelectOffset:
-      sprintf(gDisplayTopContent, "%s", "Calibration");
-      sprintf(gDisplayBottomContent, "%+d" cFtLabel, gCalibratedAltitudeOffsetInt);
-      break;
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatTemperatureDegree(char *text) { //the degree symbol goes where the number ends
+  double temperatureFarenheit = gSensorTemperatureDouble;
+  strcpy_P(text, PSTR("\xf7"));
+  if (temperatureFarenheit >= 100 || temperatureFarenheit <= -10) {
+    return 36;
+  }
+  else if (temperatureFarenheit >= 10 || (temperatureFarenheit < 0 && temperatureFarenheit > -10)) {
+    return 18;
+  }
+  return 0;
+}
 
-    case CursorSelectSensor:
-      sprintf(gDisplayTopContent, "%s", "Sensor");
-      if (gSensorMode == SensorModeOnShow) {
-        sprintf(gDisplayBottomContent, "%s", "ON/SHOW");
-      }
-      else if (gSensorMode == SensorModeOnHide) {
-        sprintf(gDisplayBottomContent, "%s", "ON/HIDE");
-      }
-      else if (gSensorMode == SensorModeSilent) {
-        sprintf(gDisplayBottomContent, "%s", "SILENT");
-      }
-      else {
-        sprintf(gDisplayBottomContent, "%s", "OFF");
-      }
-      break;
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatTrueAltitude(char *text) {
+  if (gFrame->sensorMode == SensorModeOff) {
+    sprintf_P(text, PSTR("%6S"), PSTR("OFF")); //%S takes a string in flash
+  }
+  else {
+    char* trueAltitudeReadout = displayNumber(roundNumber(gTrueAltitudeDouble, cTrueAltitudeRoundToNearest), false);
+    sprintf_P(text, PSTR("%6s"), trueAltitudeReadout);
+  }
+  return 0;
+}
 
-    case CursorSelectFlipDevice:
-      sprintf(gDisplayTopContent, "%s", "Orientation");
-      sprintf(gDisplayBottomContent, "UP%c", (char)(24));
-      break;
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatTrueAltitudeFt(char *text) {
+  if (gFrame->sensorMode != SensorModeOff) {
+    strcpy_P(text, PSTR(cAltitudeLabel));
+  }
+  return 0;
+}
 
-    case CursorViewSensorTemp:
-    {
-      sprintf(gDisplayTopContent, "%s", "Temperature");
-
-      overrideBottomContent = true;
-      double temperatureFarenheit = gSensorTemperatureDouble;
-      sprintf(gDisplayBottomContent, "%d.%d %c", (int)temperatureFarenheit, abs((int)(temperatureFarenheit*10)%10), cDegFLabel);
-      gOled.setTextSize(2);
-      if (temperatureFarenheit >= 100 || temperatureFarenheit <= -10) {
-        gOled.setCursor(94, 11);
-      }
-      else if (temperatureFarenheit >= 10 || (temperatureFarenheit < 0 && temperatureFarenheit > -10)) {
-        gOled.setCursor(76, 11);
-      }
-      else if (temperatureFarenheit >= 0) {
-        gOled.setCursor(58, 11);
-      }
-      gOled.print((char)(247));  //degree symbol
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatCharging(char *text) {
+  if (gBatteryCharging) {
+    strcpy_P(text, PSTR("CHARGING"));
+  }
+  return 0;
+}
 
-      gOled.setTextSize(cReadoutTextSize);
-      gOled.setCursor(1, cReadoutTextYpos);
-      gOled.print(gDisplayBottomContent);
-      break;
-    }
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatBatteryLevel(char *text) {
+  if (!gBatteryCharging) {
+    sprintf_P(text, PSTR("%d%%"), gBatteryLevel);
+  }
+  return 0;
+}
 
-    case CursorViewAltitude:
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatMemoryTitle(char *text) {
+  sprintf_P(text, PSTR("Free RAM  heap %u"), gMemoryStats.heapUsed);
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatMemory(char *text) {
+  sprintf_P(text, PSTR("%u"), gMemoryStats.stackFreeMin); //lowest it has been since power-up
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatStatus(char *text) {
+  switch (gRightStatus) {
+    case RightStatusMinimums:
+      strcpy_P(text, PSTR("MINIMUMS"));
+      break;
+    case RightStatusNotArmed:
+      strcpy_P(text, PSTR("-------" cAltitudeLabel));
+      break;
+    case RightStatusCountdown:
     {
-      sprintf(gDisplayTopContent, "%s", "Altitude");
-
-      overrideBottomContent = true;
-      if (gSensorMode == SensorModeOff) {
-        sprintf(gDisplayBottomContent, "%6s", "OFF");
-        gOled.setTextSize(cReadoutTextSize);
-        gOled.setCursor(0, cReadoutTextYpos);
-        gOled.print(gDisplayBottomContent);
-      }
-      else {
-        //show the current altitude top-right
-        char* trueAltitudeReadout = displayNumber(roundNumber(gTrueAltitudeDouble, cTrueAltitudeRoundToNearestFt), false);
-        sprintf(gDisplayBottomContent, "%6s", trueAltitudeReadout);
-        gOled.setTextSize(cReadoutTextSize);
-        gOled.setCursor(0, cReadoutTextYpos);
-        gOled.print(gDisplayBottomContent);
-        delete trueAltitudeReadout;
-
-        //print the "ft" label
-        gOled.setTextSize(2);
-        gOled.setCursor(104, cReadoutTextYpos + 7);
-        gOled.print(cFtLabel);
-      }
+      long altitudeDifference = gTrueAltitudeDouble - gFrame->minimumsAltitude;
+      char* altitudeCountdownReadout = displayNumber(roundNumber(altitudeDifference, cTrueAltitudeRoundToNearest), true);
+      sprintf_P(text, PSTR("%6s"), altitudeCountdownReadout);
       break;
     }
-
-    case CursorViewBatteryLevel:
-      sprintf(gDisplayTopContent, "%s", "Battery");
-
-      if (gBatteryCharging) {
-        overrideBottomContent = true;
-        gOled.setTextSize(2);
-        gOled.setCursor(1, cReadoutTextYpos + 4);
-        sprintf(gDisplayBottomContent, "%s", "CHARGING");
-        gOled.print(gDisplayBottomContent);
-      }
-      else {
-        sprintf(gDisplayBottomContent, "%d%%", gBatteryLevel);
-      }
+    case RightStatusSilent:
+      strcpy_P(text, PSTR("SILENT"));
+      break;
+    case RightStatusLowBattery:
+      strcpy_P(text, PSTR("LOW BATT"));
       break;
   }
-  
-  gOled.setTextSize(cLabelTextSize);
-  gOled.setCursor(1, cLabelTextYpos);
-  gOled.print(gDisplayTopContent);
+  return 0;
+}
 
-  if (!overrideBottomContent) {
-    gOled.setTextSize(cReadoutTextSize);
-    gOled.setCursor(1, cReadoutTextYpos);
-    gOled.print(gDisplayBottomContent);
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatCountdownFt(char *text) {
+  if (gRightStatus == RightStatusCountdown) {
+    strcpy_P(text, PSTR(cAltitudeLabel));
   }
+  return 0;
+}
 
-  gOled.display();
+//////////////////////////////////////////////////////////////////////////
+// the sensor true altitude in the top-right corner, or OFF further right
+//////////////////////////////////////////////////////////////////////////
+bool topAltitudeOff() {
+  return gFrame->sensorMode == SensorModeOff || gFrame->selectedAltitude > cHighestAltitudeAlert || gTrueAltitudeDouble > cHighestAltitudeAlert + cAlarm200ToGo;
 }
 
 //////////////////////////////////////////////////////////////////////////
-void drawRightScreen() {
-  gOled.clearDisplay();
-  
-  if (gDeviceFlipped) {
-    gOled.setRotation(2);
+uint8_t formatTopAltitude(char *text) {
+  if (topAltitudeOff()) {
+    sprintf_P(text, PSTR("%6S"), PSTR("OFF")); //%S takes a string in flash
+    return 22;
   }
-  else {
-    gOled.setRotation(0);
+  else if (gFrame->sensorMode != SensorModeOnHide) {
+    char* trueAltitudeReadout = displayNumber(roundNumber(gTrueAltitudeDouble, cTrueAltitudeRoundToNearest), false);
+    sprintf_P(text, PSTR("%6s"), trueAltitudeReadout);
   }
-  
-  gOled.invertDisplay(gFlashRightScreen);
+  return 0;
+}
 
-  if (gOledDim) {
-    gOled.dim(true, 0);
-  }
-  else {
-    gOled.dim(false, 255);
-  }
-
-  //top-left corner of the right screen shows either minimums info and/or "LOW BATT" message
-  gOled.setTextSize(cLabelTextSize);
-  gOled.setCursor(1, cLabelTextYpos);
-  bool minimumsStatusDisplayed = false;
-  if (gMinimumsOn) {
-    if (gMinimumsTriggered && gAlarmModeEnum == MinimumsAlarm) { //this block prints "MINIMUMS" in large text that covers the entire screen
-      gOled.setTextSize(2);
-      gOled.setCursor(18, 9);
-      gOled.print("MINIMUMS");
-      gOled.display();
-      return;
-    }
-    else if (gMinimumsTriggered) { //this displays "MINIMUMS" in small text in the top-left corner for maybe 30 seconds after minimums were triggered
-      gOled.print("MINIMUMS");
-      minimumsStatusDisplayed = true;
-    }
-    else if (gMinimumsSilenced) { //the user selected minimums higher than their current altitude, so minimums aren't armed yet. Once they climb above the minimums altitude by I think 200ft, the minimums become "armed" and can then trigger. This prints "-------ft" if it's in this "not armed" mode.
-      gOled.print("-------ft");
-      minimumsStatusDisplayed = true;
-    }
-    else {
-      long altitudeDifference = gTrueAltitudeDouble - gMinimumsAltitudeLong;
-      char* altitudeCountdownReadout = displayNumber(roundNumber(altitudeDifference, cTrueAltitudeRoundToNearestFt), true);
-      sprintf(gDisplayTopContent, "%6s", altitudeCountdownReadout);
-      delete altitudeCountdownReadout;
-      
-      gOled.print(gDisplayTopContent);
-      gOled.setCursor(43, cLabelTextYpos);
-      gOled.print(cFtLabel);
-      minimumsStatusDisplayed = true;
-    }
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatTopAltitudeFt(char *text) {
+  if (!topAltitudeOff() && gFrame->sensorMode != SensorModeOnHide) {
+    strcpy_P(text, PSTR(cAltitudeLabel));
   }
+  return 0;
+}
 
-  unsigned long clockTime = millis();
-  gOled.setTextSize(cLabelTextSize);
-  gOled.setCursor(1, cLabelTextYpos);
-  if (millis() < cPowerUpSilence) {
-    gOled.clearDisplay();
-    gOled.print("SILENT");
+//////////////////////////////////////////////////////////////////////////
+uint8_t formatSelectedAltitude(char *text) {
+  long tempSelectedAltitude = gFrame->selectedAltitude;
+  char* selectedAltitudeReadout = displayNumber(tempSelectedAltitude, false);
+  sprintf_P(text, PSTR("%6s"), selectedAltitudeReadout);
+  return 0;
+}
+
+//Screen layouts: x, y, text size (0 for a line), line length, fixed text, format function, what the format function reads
+const char cAltitudeText[]            PROGMEM = cAltitudeLabel;
+const char cDegreeText[]        PROGMEM = "\xf7"; //247 = degree symbol
+const char cHeadingTitle[]      PROGMEM = "Heading";
+const char cAltimeterTitle[]    PROGMEM = "Altimeter";
+const char cMinimumsTitle[]     PROGMEM = "Minimums";
+const char cStopwatchTitle[]    PROGMEM = "Stopwatch";
+const char cBrightnessTitle[]   PROGMEM = "Brightness";
+const char cOffsetTitle[]       PROGMEM = "Calibration";
+const char cSensorTitle[]       PROGMEM = "Sensor";
+const char cFlipTitle[]         PROGMEM = "Orientation";
+const char cFlipText[]          PROGMEM = "UP\x18"; //24 = up arrow
+const char cTemperatureTitle[]  PROGMEM = "Temperature";
+const char cAltitudeTitle[]     PROGMEM = "Altitude";
+const char cBatteryTitle[]      PROGMEM = "Battery";
+const char cMinimumsText[]      PROGMEM = "MINIMUMS";
+
+const Widget cHeadingWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cHeadingTitle, NULL,             0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,          formatTimerBadge, cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,          formatHeading,    cFromState},
+  {56, 11,               2,                0, cDegreeText,   NULL,             0}};
+
+const Widget cAltimeterWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cAltimeterTitle, NULL,                   0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,            formatTimerBadge,       cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,            formatAltimeterSetting, cFromState}};
+
+const Widget cMinimumsOnWidgets[] PROGMEM = {
+  {1,   cLabelTextYpos,        cLabelTextSize, 0,  cMinimumsTitle, NULL,                   0},
+  {98,  cLabelTextYpos,        cLabelTextSize, 0,  NULL,           formatTimerBadge,       cFromState | cFromTimer},
+  {1,   cReadoutTextYpos + 4,  2,              0,  NULL,           formatMinimumsStatus,   cFromState},
+  {0,   31,                    0,              36, NULL,           formatSelectionLine,    cFromState},
+  {43,  cReadoutTextYpos + 4,  2,              0,  NULL,           formatMinimumsAltitude, cFromState},
+  {116, cReadoutTextYpos + 11, 1,              0,  NULL,           formatMinimumsFt,       cFromState}};
+
+const Widget cMinimumsAltitudeWidgets[] PROGMEM = {
+  {1,   cLabelTextYpos,        cLabelTextSize, 0,  cMinimumsTitle, NULL,                   0},
+  {98,  cLabelTextYpos,        cLabelTextSize, 0,  NULL,           formatTimerBadge,       cFromState | cFromTimer},
+  {1,   cReadoutTextYpos + 4,  2,              0,  NULL,           formatMinimumsStatus,   cFromState},
+  {42,  31,                    0,              85, NULL,           formatSelectionLine,    cFromState},
+  {43,  cReadoutTextYpos + 4,  2,              0,  NULL,           formatMinimumsAltitude, cFromState},
+  {116, cReadoutTextYpos + 11, 1,              0,  NULL,           formatMinimumsFt,       cFromState}};
+
+const Widget cStopwatchWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cStopwatchTitle, NULL,            0},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,            formatStopwatch, cFromState | cFromTimer}};
+
+const Widget cBrightnessWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cBrightnessTitle, NULL,             0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,             formatTimerBadge, cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,             formatBrightness, cFromState}};
+
+const Widget cOffsetWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cOffsetTitle, NULL,              0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,         formatTimerBadge,  cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,         formatCalibration, cFromState}};
+
+const Widget cSensorWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cSensorTitle, NULL,             0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,         formatTimerBadge, cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,         formatSensorMode, cFromState}};
+
+const Widget cFlipWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cFlipTitle, NULL,             0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,       formatTimerBadge, cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, cFlipText,  NULL,             0}};
+
+const Widget cTemperatureWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, cTemperatureTitle, NULL,                    0},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL,              formatTimerBadge,        cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL,              formatTemperature,       cFromSample},
+  {58, 11,               2,                0, NULL,              formatTemperatureDegree, cFromSample}};
+
+const Widget cAltitudeWidgets[] PROGMEM = {
+  {1,   cLabelTextYpos,       cLabelTextSize,   0, cAltitudeTitle, NULL,                 0},
+  {98,  cLabelTextYpos,       cLabelTextSize,   0, NULL,           formatTimerBadge,     cFromState | cFromTimer},
+  {0,   cReadoutTextYpos,     cReadoutTextSize, 0, NULL,           formatTrueAltitude,   cFromState | cFromSample},
+  {104, cReadoutTextYpos + 7, 2,                0, NULL,           formatTrueAltitudeFt, cFromState}};
+
+const Widget cBatteryWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,       cLabelTextSize,   0, cBatteryTitle, NULL,               0},
+  {98, cLabelTextYpos,       cLabelTextSize,   0, NULL,          formatTimerBadge,   cFromState | cFromTimer},
+  {1,  cReadoutTextYpos + 4, 2,                0, NULL,          formatCharging,     cFromBattery},
+  {1,  cReadoutTextYpos,     cReadoutTextSize, 0, NULL,          formatBatteryLevel, cFromBattery}};
+
+const Widget cMemoryWidgets[] PROGMEM = {
+  {1,  cLabelTextYpos,   cLabelTextSize,   0, NULL, formatMemoryTitle, cFromMemory},
+  {98, cLabelTextYpos,   cLabelTextSize,   0, NULL, formatTimerBadge,  cFromState | cFromTimer},
+  {1,  cReadoutTextYpos, cReadoutTextSize, 0, NULL, formatMemory,      cFromMemory}};
+
+const WidgetLayout cLeftLayouts[] PROGMEM = { //in the order of enum Cursor
+  WIDGET_LAYOUT(cHeadingWidgets),
+  WIDGET_LAYOUT(cAltimeterWidgets),
+  WIDGET_LAYOUT(cMinimumsOnWidgets),
+  WIDGET_LAYOUT(cMinimumsAltitudeWidgets),
+  WIDGET_LAYOUT(cStopwatchWidgets),
+  WIDGET_LAYOUT(cBrightnessWidgets),
+  WIDGET_LAYOUT(cOffsetWidgets),
+  WIDGET_LAYOUT(cSensorWidgets),
+  WIDGET_LAYOUT(cFlipWidgets),
+  WIDGET_LAYOUT(cTemperatureWidgets),
+  WIDGET_LAYOUT(cAltitudeWidgets),
+  WIDGET_LAYOUT(cBatteryWidgets),
+  WIDGET_LAYOUT(cMemoryWidgets)};
+static_assert(sizeof(cLeftLayouts) / sizeof(cLeftLayouts[0]) == cNumberOfCursorModes, "one left screen layout per cursor mode");
+
+const Widget cRightWidgets[] PROGMEM = {
+  {1,   cLabelTextYpos,       cLabelTextSize,   0, NULL,    formatStatus,           cFromStatus | cFromState | cFromSample},
+  {43,  cLabelTextYpos,       cLabelTextSize,   0, NULL,    formatCountdownFt,      cFromStatus},
+  {70,  cLabelTextYpos,       cLabelTextSize,   0, NULL,    formatTopAltitude,      cFromState | cFromSample},
+  {106, cLabelTextYpos,       cLabelTextSize,   0, NULL,    formatTopAltitudeFt,    cFromState | cFromSample},
+  {0,   cReadoutTextYpos,     cReadoutTextSize, 0, NULL,    formatSelectedAltitude, cFromState},
+  {104, cReadoutTextYpos + 7, 2,                0, cAltitudeText, NULL,                   0}};
+
+const Widget cMinimumsAlarmWidgets[] PROGMEM = {
+  {18, 9, 2, 0, cMinimumsText, NULL, 0}};
+
+const WidgetLayout cRightLayout = WIDGET_LAYOUT(cRightWidgets);
+const WidgetLayout cMinimumsAlarmLayout = WIDGET_LAYOUT(cMinimumsAlarmWidgets);
+
+//////////////////////////////////////////////////////////////////////////
+// the version of each WidgetSource for the frame being drawn. A counter
+// where there is one, otherwise the value itself when it fits in a byte
+//////////////////////////////////////////////////////////////////////////
+void widgetVersions(uint8_t *versions) {
+  memset(versions, 0, cWidgetSources);
+  versions[SourceState] = gFrame->version;
+  versions[SourceSample] = gSampleCount;
+  versions[SourceBattery] = gBatteryLevel | (gBatteryCharging ? 0x80 : 0); //0 to 100%, so bit 7 is free
+  versions[SourceTimer] = gTimerSecondShown;
+  versions[SourceMemory] = gMemoryVersion;
+  versions[SourceStatus] = gRightStatus;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// sends the panel being drawn whichever of its settings changed since
+// the screen last sent them
+//////////////////////////////////////////////////////////////////////////
+void updatePanelSettings(WidgetScreen &screen, bool flipped, bool dim, bool inverted) {
+  uint8_t changed = screen.settingsChanged((flipped ? cPanelFlipped : 0) | (dim ? cPanelDim : 0) | (inverted ? cPanelInverted : 0));
+  if (changed & cPanelFlipped) {
+    gOled.flip(flipped); //the panel turns the picture around itself, so drawing always stays at rotation 0
   }
-  else if (!gBatteryCharging && gBatteryLevel <= cBatteryAlertLevel) { //low battery while not charging
-    if (!minimumsStatusDisplayed || minimumsStatusDisplayed && (clockTime % cAltMessageInterval <= cAltMessageDuration)) {
-      gOled.clearDisplay();
-      gOled.print("LOW BATT");
+  if (changed & cPanelDim) {
+    if (dim) {
+      gOled.dim(true, 0);
     }
-    if (gSensorMode == SensorModeSilent && (clockTime % cAltMessageInterval <= cAltMessageDuration) && (clockTime % cAltMessageInterval > cAltMessageDuration)) {
-      gOled.clearDisplay();
-      gOled.print("SILENT");
+    else {
+      gOled.dim(false, 255);
     }
   }
-  else if (gSensorMode == SensorModeSilent && (!minimumsStatusDisplayed || minimumsStatusDisplayed && (clockTime % cAltMessageInterval <= cAltMessageDuration))) {
-    gOled.clearDisplay();
-    gOled.print("SILENT");
+  if (changed & cPanelInverted) {
+    gOled.invertDisplay(inverted);
   }
+}
 
-  long tempSelectedAltitude = gSelectedAltitudeLong; //doing this here because it's used inside of 2 scopes
-
-  //show the sensor true altitude in top-right corner, show altitude count-down in top-left corner
-  if (gSensorMode == SensorModeOff || gSelectedAltitudeLong > cHighestAltitudeAlert || gTrueAltitudeDouble > cHighestAltitudeAlert + cAlarm200ToGo) {
-    sprintf(gDisplayTopContent, "%6s", "OFF");
-    gOled.setTextSize(cLabelTextSize);
-    gOled.setCursor(92, cLabelTextYpos);
-    gOled.print(gDisplayTopContent);
-  }
-  else if (gSensorMode != SensorModeOnHide) {
-    //show the current altitude top-right
-    char* trueAltitudeReadout = displayNumber(roundNumber(gTrueAltitudeDouble, cTrueAltitudeRoundToNearestFt), false);
-    sprintf(gDisplayTopContent, "%6s", trueAltitudeReadout);
-    gOled.setTextSize(cLabelTextSize);
-    gOled.setCursor(70, cLabelTextYpos);
-    gOled.print(gDisplayTopContent);
-    delete trueAltitudeReadout;
+//////////////////////////////////////////////////////////////////////////
+void drawLeftScreen() {
+  DeviceState frame = deviceStateSnapshot(gState); //the format functions read this, so the whole frame shows one moment
+  gFrame = &frame;
+  gLeftStateVersion = frame.version;
+  updatePanelSettings(gLeftScreen, frame.deviceFlipped, frame.oledDim, gFlashLeftScreen);
+
+  WidgetLayout layout;
+  memcpy_P(&layout, &cLeftLayouts[frame.cursor], sizeof(layout));
+  uint8_t versions[cWidgetSources];
+  widgetVersions(versions);
+  gLeftScreen.draw(gOled, layout, versions);
+}
 
-    //print the "ft" label
-    gOled.setTextSize(cLabelTextSize);
-    gOled.setCursor(106, cLabelTextYpos);
-    gOled.print(cFtLabel);
+//////////////////////////////////////////////////////////////////////////
+void drawRightScreen() {
+  DeviceState frame = deviceStateSnapshot(gState);
+  gFrame = &frame;
+  gRightStateVersion = frame.version;
+  updatePanelSettings(gRightScreen, frame.deviceFlipped, frame.oledDim, gAlarm.flashScreen);
+
+  if (frame.minimumsOn && gAlarm.minimumsTriggered && gAlarm.mode == MinimumsAlarm) { //"MINIMUMS" in large text that covers the entire screen
+    uint8_t versions[cWidgetSources] = {}; //one label, nothing to keep track of
+    gRightScreen.draw(gOled, cMinimumsAlarmLayout, versions, LATENCY_FRAME_DONE);
+    return;
   }
 
-
-  //Selected Altitude
-  char* selectedAltitudeReadout = displayNumber(tempSelectedAltitude, false);
-  sprintf(gDisplayBottomContent, "%6s", selectedAltitudeReadout);
-  delete selectedAltitudeReadout;
-
-  gOled.setTextSize(cReadoutTextSize);
-  gOled.setCursor(0, cReadoutTextYpos);
-  gOled.print(gDisplayBottomContent);
-
-  gOled.setTextSize(2);
-  gOled.setCursor(104, cReadoutTextYpos + 7);
-  gOled.print(cFtLabel);
-  
-  gOled.display();
+  gRightStatus = rightStatus(); //once per frame, both halves of the countdown have to agree
+  uint8_t versions[cWidgetSources];
+  widgetVersions(versions);
+  gRightScreen.draw(gOled, cRightLayout, versions, LATENCY_FRAME_DONE);
 }
 
-
 //////////////////////////////////////////////////////////////////////////
 ISR (PCINT0_vect) {    // handle pin change interrupt for D8 to D13 here
-  if (gDeviceFlipped) {
+  gLastKnobEdgeTs = millis();
+  if (gState.deviceFlipped) {
     handleLeftRotary(cPinRightRotaryButton, cPinRightRotarySignalDt, cPinRightRotarySignalClk);
   }
   else {
@@ -1629,7 +1864,8 @@ ISR (PCINT0_vect) {    // handle pin change interrupt for D8 to D13 here
 
 //////////////////////////////////////////////////////////////////////////
 ISR (PCINT2_vect) {    // handle pin change interrupt for D0 to D7 here
-  if (gDeviceFlipped) {
+  gLastKnobEdgeTs = millis();
+  if (gState.deviceFlipped) {
     handleRightRotary(cPinLeftRotaryButton, cPinLeftRotarySignalDt, cPinLeftRotarySignalClk);
   }
   else {
@@ -1641,7 +1877,9 @@ ISR (PCINT2_vect) {    // handle pin change interrupt for D0 to D7 here
 // we only write data to EEPROM if the value changes, because EEPROM has
 // a limited number of writes, but unlimited reads.
 // we maximize the usage of the EEPROM by moving the data to a new block
-// once we're nearing the limit of that EEPROM's block max writes
+// once we're nearing the limit of that EEPROM's block max writes.
+// loop() only calls this once gState.settingsVersion has moved on from the
+// last save, so nothing is read from EEPROM until a setting has changed
 //
 // byte 0-1           app code 1
 // byte 2-3           app code 2
@@ -1677,204 +1915,64 @@ ISR (PCINT2_vect) {    // handle pin change interrupt for D0 to D7 here
 // byte 61-62         original selected heading EEPROM-write-counter
 // byte 63-66         original selected minimums altitude value
 // byte 67-68         original selected minimums altitude EEPROM-write-counter
+// last byte          units the values are in, cUnits
 //////////////////////////////////////////////////////////////////////////
 void writeValuesToEeprom() {
-  gNeedToWriteToEeprom = false;
-  int eepromIndex;
-  int numOfWrites;
-  int datatypeSize;
-  int dataAddr;
-  
-  //Last Altimeter Setting
-  datatypeSize = sizeof(int);
-  dataAddr = cEepromAltimeterAddr;
-  int altimeterSetting;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, altimeterSetting);
-  if (altimeterSetting != gAltimeterSettingInHgInt) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    altimeterSetting = gAltimeterSettingInHgInt; //this silences a compiler warning
-    EEPROM.put(eepromIndex, altimeterSetting);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
-  }
-
-
-  //Last altitude offset
-  datatypeSize = sizeof(int);
-  dataAddr = cEepromAltitudeOffsetAddr;
-  int altitudeOffset;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, altitudeOffset);
-  if (altitudeOffset != gCalibratedAltitudeOffsetInt) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    altitudeOffset = gCalibratedAltitudeOffsetInt; //this silences a compiler warning
-    EEPROM.put(eepromIndex, altitudeOffset);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
-  }
-
-  
-  //Semi-Permanent altitude offset
-  datatypeSize = sizeof(int);
-  dataAddr = cEepromPermanentAltitutdeOffsetAddr;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, altitudeOffset);
-  if (altitudeOffset != gPermanentCalibratedAltitudeOffsetInt) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    altitudeOffset = gPermanentCalibratedAltitudeOffsetInt; //this silences a compiler warning
-    EEPROM.put(eepromIndex, altitudeOffset);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
-  }
-
-
-  //Sensor Mode - On/Show, On/Hide, Off
-  datatypeSize = sizeof(byte);
-  dataAddr = cEepromSensorModeAddr;
-  byte sensorMode;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, sensorMode);
-  if (sensorMode != static_cast<byte>(gSensorMode)) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    sensorMode = static_cast<byte>(gSensorMode); //this silences a compiler warning
-    EEPROM.put(eepromIndex, sensorMode);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
-  }
-
-
-  //Screen dim
-  datatypeSize = sizeof(bool);
-  dataAddr = cEepromScreenDimAddr;
-  bool dim;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, dim);
-  if (dim != gOledDim) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
+  DeviceState state = deviceStateSnapshot(gState);
+  gSavedSettingsVersion = state.settingsVersion;
+  byte sensorMode = state.sensorMode;
+  bool dim = state.oledDim;
+  bool screenFlip = state.deviceFlipped;
+
+  writeValueToEeprom(cEepromAltimeterAddr, &state.altimeterSetting, sizeof(int));
+  writeValueToEeprom(cEepromAltitudeOffsetAddr, &state.calibratedAltitudeOffset, sizeof(int));
+  writeValueToEeprom(cEepromPermanentAltitutdeOffsetAddr, &state.permanentCalibratedAltitudeOffset, sizeof(int));
+  writeValueToEeprom(cEepromSensorModeAddr, &sensorMode, sizeof(byte));
+  writeValueToEeprom(cEepromScreenDimAddr, &dim, sizeof(bool));
+  writeValueToEeprom(cEepromScreenOrientationAddr, &screenFlip, sizeof(bool));
+  writeValueToEeprom(cEepromSelectedAltitudeAddr, &state.selectedAltitude, sizeof(long));
+  writeValueToEeprom(cEepromSelectedHeadingAddr, &state.selectedHeading, sizeof(int));
+  writeValueToEeprom(cEepromSelectedMinimumsAddr, &state.minimumsAltitude, sizeof(long));
+  EEPROM.update(cEepromUnitsAddr, cUnits); //after the values, they're all in this build's units now
 
-    dim = gOledDim; //this silences a compiler warning
-    EEPROM.put(eepromIndex, dim);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
-  }
-
-
-  //Screen orientation
-  datatypeSize = sizeof(bool);
-  dataAddr = cEepromScreenOrientationAddr;
-  bool screenFlip;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, screenFlip);
-  if (screenFlip != gDeviceFlipped) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-  
-    screenFlip = gDeviceFlipped; //this silences a compiler warning
-    EEPROM.put(eepromIndex, screenFlip);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
+  //Check if we ran out of EEPROM
+  int eepromIndex;
+  EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
+  if (eepromIndex >= cEepromUnitsAddr - 6) { //6 bytes is the biggest chunk of data we use
+    initializeDefaultEeprom(); //start all over again with the EEPROM
   }
+}
 
+//////////////////////////////////////////////////////////////////////////
+// writes one value to its block if it differs from what the block holds,
+// byte by byte so unchanged bytes aren't rewritten, and counts the write. Past cEepromMaxWrites the value moves on to the
+// next available block
+//////////////////////////////////////////////////////////////////////////
+void writeValueToEeprom(int dataAddr, const void *value, int datatypeSize) {
+  const byte *data = (const byte *)value;
+  int eepromIndex;
+  int numOfWrites;
+  bool changed = false;
 
-
-  //Selected Altitude
-  datatypeSize = sizeof(long);
-  dataAddr = cEepromSelectedAltitudeAddr;
-  long selectedAltitude;
   EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, selectedAltitude);
-  if (selectedAltitude != gSelectedAltitudeLong) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    selectedAltitude = gSelectedAltitudeLong; //this silences a compiler warning
-    EEPROM.put(eepromIndex, selectedAltitude);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
+  for (int i = 0; i < datatypeSize; i++) {
+    changed |= (EEPROM.read(eepromIndex + i) != data[i]);
   }
-
-
-
-  //Selected Heading
-  datatypeSize = sizeof(int);
-  dataAddr = cEepromSelectedHeadingAddr;
-  long selectedHeading;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, selectedHeading);
-  if (selectedHeading != gSelectedHeadingInt) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    selectedHeading = gSelectedHeadingInt; //this silences a compiler warning
-    EEPROM.put(eepromIndex, selectedHeading);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
+  if (!changed) {
+    return;
   }
 
-
-
-  //Selected Minimums
-  datatypeSize = sizeof(long);
-  dataAddr = cEepromSelectedMinimumsAddr;
-  long selectedMinimumsAltitude;
-  EEPROM.get(dataAddr, eepromIndex);
-  EEPROM.get(eepromIndex, selectedMinimumsAltitude);
-  if (selectedMinimumsAltitude != gMinimumsAltitudeLong) {
-    EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
-    if (numOfWrites > cEepromMaxWrites) {
-      EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-      EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
-      EEPROM.put(dataAddr, eepromIndex); //reset address
-      EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
-    }
-    selectedMinimumsAltitude = gMinimumsAltitudeLong; //this silences a compiler warning
-    EEPROM.put(eepromIndex, selectedMinimumsAltitude);
-    EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
+  EEPROM.get(eepromIndex + datatypeSize, numOfWrites);
+  if (numOfWrites > cEepromMaxWrites) {
+    EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
+    EEPROM.put(eepromIndex + datatypeSize, 0); //reset write counter
+    EEPROM.put(dataAddr, eepromIndex); //reset address
+    EEPROM.put(cEepromNextAvailableSlot, eepromIndex + datatypeSize + sizeof(int)); //reset next available slot
   }
-
-
-
-  //Check if we ran out of EEPROM
-  EEPROM.get(cEepromNextAvailableSlot, eepromIndex);
-  if (eepromIndex >= cSizeOfEeprom - 6) { //6 bytes is the biggest chunk of data we use
-    initializeDefaultEeprom(); //start all over again with the EEPROM
+  for (int i = 0; i < datatypeSize; i++) {
+    EEPROM.update(eepromIndex + i, data[i]); //only the bytes that differ wear their cells
   }
+  EEPROM.put(eepromIndex + datatypeSize, numOfWrites + 1);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -1904,7 +2002,7 @@ void updateBatteryLevel() {
   }
 
   if (updateDisplay) {
-    if (gCursor == CursorViewBatteryLevel) {
+    if (gState.cursor == CursorViewBatteryLevel) {
       gUpdateLeftScreen = true;
     }
     if (gBatteryLevel <= cBatteryAlertLevel) {
@@ -1915,107 +2013,197 @@ void updateBatteryLevel() {
 
 //////////////////////////////////////////////////////////////////////////
 int getBatteryLevel() {
-  double voltage = (double)(analogRead(cBatteryVoltagePin)) / 1024 * 3.3 * 1.3333;
-  int batteryLevel = 0;
-  bool batteryCharging = voltage > 4.16; //the battery can't be 4.16V, that's only possible when charging
+  int batteryAdc = readBatteryAdc(cBatteryVoltagePin);
+  bool batteryCharging = batteryChargingFromAdc(batteryAdc);
   if (gBatteryCharging != batteryCharging) {
     gBatteryCharging = batteryCharging;
-    if (gCursor == CursorViewBatteryLevel) {
+    if (gState.cursor == CursorViewBatteryLevel) {
       gUpdateLeftScreen = true;
     }
     if (gBatteryLevel <= cBatteryAlertLevel) {
       gUpdateRightScreen = true;
     }
   }
-  
-  for (int i = 0; i < cBatteryCapacityArrayLength; i++) {
-    if (voltage <= cBatteryCapacity[0][i]) {
-      if (i == 0) {
-        batteryLevel = cBatteryCapacity[1][0]; //set to 0% min.
-        break;
-      }
-      else {
-        double interpolation = (voltage - cBatteryCapacity[0][i - 1]) / (cBatteryCapacity[0][i] - cBatteryCapacity[0][i - 1]);
-        batteryLevel = cBatteryCapacity[1][i - 1] + interpolation * cBatteryCapacityArrayInterval;
-        break;
-      }
-    }
-    else if (i == cBatteryCapacityArrayLength - 1) {
-      batteryLevel = cBatteryCapacity[1][cBatteryCapacityArrayLength - 1]; //set to 100% max.
-    }
-  }
-  return batteryLevel;
+
+  return batteryLevelFromAdc(batteryAdc);
 }
 
+//////////////////////////////////////////////////////////////////////////
+// applies the altimeter setting and the calibration offsets. The
+// correction they make is only worked out again when one of them changes,
+// so a sample costs one add instead of a pow()
 //////////////////////////////////////////////////////////////////////////
 double altitudeCorrected(double pressureAltitude) {
-  return (pressureAltitude - (1 - (pow((gAltimeterSettingInHgInt / cSeaLevelPressureInHgDouble) / 100, 0.190284))) * 145366.45) + gCalibratedAltitudeOffsetInt + gPermanentCalibratedAltitudeOffsetInt;
+  DeviceState state = deviceStateSnapshot(gState);
+  if (state.altimeterSetting != gCorrectionAltimeterSettingInt || state.calibratedAltitudeOffset != gCorrectionOffsetInt
+      || state.permanentCalibratedAltitudeOffset != gCorrectionPermanentOffsetInt) {
+    gCorrectionAltimeterSettingInt = state.altimeterSetting;
+    gCorrectionOffsetInt = state.calibratedAltitudeOffset;
+    gCorrectionPermanentOffsetInt = state.permanentCalibratedAltitudeOffset;
+    gAltitudeCorrectionDouble = gCorrectionOffsetInt + gCorrectionPermanentOffsetInt
+      - (1 - pow(gCorrectionAltimeterSettingInt / cAltimeterSettingStandardDouble, 0.190284)) * cAltimeterCorrectionScale;
+  }
+  return pressureAltitude + gAltitudeCorrectionDouble;
 }
 
+#ifdef BENCHMARK
+//Results go into these, so the compiler can't throw away the work being measured
+volatile double gBenchDouble;
+volatile long   gBenchLong;
+char* volatile  gBenchText;
+
 //////////////////////////////////////////////////////////////////////////
-// Prints number with commas, but only supports [0, 99999]
+// the functions that dominate a pass of the loop, with fixed inputs so
+// every run does the same work. See Benchmark.h and scripts/bench.py
 //////////////////////////////////////////////////////////////////////////
-char* displayNumber(const long &number, bool sign) {
-  int thousands = static_cast<int>(number / 1000);
-  int ones = static_cast<int>(number % 1000);
-  char* result = new char[8];
+void runBenchmarks() {
+  benchmarkBegin();
+  benchmark(PSTR("readSample"), 10, benchReadSample);
+  benchmark(PSTR("pressureAltitude"), 100, benchPressureAltitude);
+  benchmark(PSTR("altitudeCorrected"), 100, benchAltitudeCorrected);
+  benchmark(PSTR("displayNumber"), 100, benchDisplayNumber);
+  benchmark(PSTR("roundNumber(long)"), 100, benchRoundNumberLong);
+  benchmark(PSTR("roundNumber(double)"), 100, benchRoundNumberDouble);
+  benchmark(PSTR("drawChar(size 1)"), 100, benchDrawChar1);
+  benchmark(PSTR("drawChar(size 2)"), 100, benchDrawChar2);
+  benchmark(PSTR("drawChar(size 3)"), 100, benchDrawChar3);
+  benchmark(PSTR("drawPixel"), 100, benchDrawPixel);
+  benchmark(PSTR("fillRect(8x8)"), 100, benchFillRectSmall);
+  benchmark(PSTR("fillRect(128x32)"), 100, benchFillRectScreen);
+  benchmark(PSTR("fillRect(8x8, rotated)"), 100, benchFillRectRotated); //rotation 1, plus the two setRotation() calls
+  benchmark(PSTR("drawFastVLine(h 20)"), 100, benchDrawFastVLine);
+  benchmark(PSTR("drawFastVLine(h 20, rotated)"), 100, benchDrawFastVLineRotated);
+  benchmark(PSTR("clearDisplay"), 100, benchClearDisplay);
+  benchmark(PSTR("display"), 10, benchDisplay, benchFlush); //queueing the frame only, the bus sends it in the background
+  benchmark(PSTR("display+flush"), 10, benchDisplayFlush, benchFlush); //until the last byte is out
+  benchmark(PSTR("drawRightScreen(full)"), 10, benchDrawRightScreen, benchInvalidate);
+  benchmark(PSTR("drawRightScreen(same)"), 10, benchDrawRightScreen, benchFlush); //nothing changed, nothing to draw or send
+  benchmark(PSTR("getBatteryLevel"), 10, benchBatteryLevel);
+  benchmarkEnd();
+
+  gOled.clearDisplay(); //the benchmarks drew into the frame buffer
+  gLeftScreen.invalidate(); //and sent it to the panels
+  gRightScreen.invalidate();
+  gUpdateLeftScreen = true;
+  gUpdateRightScreen = true;
+}
 
-  if (number >= 10000) {
-    if (sign) {
-      sprintf(result, "%c%d,%03d", '+', thousands, ones);
-    }
-    else {
-      sprintf(result, "%01d,%03d", thousands, ones);
-    }
-  }
-  else if (number >= 1000) {
-    if (sign) {
-      sprintf(result, "% 2c%d,%03d", '+', thousands, ones);
-    }
-    else {
-      sprintf(result, "% 2d,%03d", thousands, ones);
-    }
-  }
-  else if (number <= -1000) {
-    sprintf(result, "%d,%03d", thousands, abs(ones));
-  }
-  else if (sign && number >= 100) {
-    sprintf(result, "% 4c%d", '+', ones);
-  }
-  else if (sign && number > 0) {
-    sprintf(result, "% 5c%d", '+', ones);
-  }
-  else if (sign && number == 0) {
-    sprintf(result, "% 6c%d", '+', ones);
-  }
-  else {
-    sprintf(result, "% 4d", ones);
-  }
+//////////////////////////////////////////////////////////////////////////
+void benchReadSample() {
+  gSensor.readSample();
+}
 
-  return result;
+//////////////////////////////////////////////////////////////////////////
+void benchPressureAltitude() {
+  gBenchDouble = pressureAltitude(1000.0);
 }
 
 //////////////////////////////////////////////////////////////////////////
-long roundNumber(const long &number, const int &roundNearest) {
-  int sign = (number < 0) ? -1 : 1; //positive or negative number
-  return (number + sign * roundNearest / 2) / roundNearest * roundNearest;
+void benchAltitudeCorrected() {
+  gBenchDouble = altitudeCorrected(4321.0);
 }
 
 //////////////////////////////////////////////////////////////////////////
-long roundNumber(const double &number, const int &roundNearest) {
-  int sign = (number < 0) ? -1 : 1; //positive or negative number
-  return static_cast<long>((number + sign * roundNearest / 2) / roundNearest) * roundNearest;
+void benchDisplayNumber() {
+  long number = -12345;
+  gBenchText = displayNumber(number, true);
 }
 
 //////////////////////////////////////////////////////////////////////////
-int roundNumber(const int &number, const int &roundNearest) {
-  int sign = (number < 0) ? -1 : 1; //positive or negative number
-  return (number + sign * roundNearest / 2) / roundNearest * roundNearest;
+void benchRoundNumberLong() {
+  long number = 12345;
+  gBenchLong = roundNumber(number, cAltitudeSelectIncrement);
 }
 
 //////////////////////////////////////////////////////////////////////////
-void println(String msg) {
-  #ifdef DEBUG
-  Serial.println(msg);
-  #endif
+void benchRoundNumberDouble() {
+  double number = 12345.6;
+  gBenchLong = roundNumber(number, cAltitudeSelectIncrement);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawChar1() {
+  gOled.drawChar(0, 0, '8', WHITE, BLACK, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawChar2() {
+  gOled.drawChar(0, 0, '8', WHITE, BLACK, 2);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawChar3() {
+  gOled.drawChar(0, 0, '8', WHITE, BLACK, 3);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawPixel() {
+  gOled.drawPixel(64, 16, WHITE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchFillRectSmall() {
+  gOled.fillRect(61, 13, 8, 8, INVERSE); //straddles a page boundary, so both partial pages are masked
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchFillRectScreen() {
+  gOled.fillRect(0, 0, cOledWidth, cOledHeight, INVERSE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchFillRectRotated() {
+  gOled.setRotation(1);
+  gOled.fillRect(13, 61, 8, 8, INVERSE);
+  gOled.setRotation(0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawFastVLine() {
+  gOled.drawFastVLine(64, 5, 20, INVERSE);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawFastVLineRotated() {
+  gOled.setRotation(1);
+  gOled.drawFastVLine(16, 54, 20, INVERSE); //a horizontal run of the buffer
+  gOled.setRotation(0);
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchClearDisplay() {
+  gOled.clearDisplay();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDisplay() {
+  gOled.display();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDisplayFlush() {
+  gOled.display();
+  Twi.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchDrawRightScreen() {
+  drawRightScreen();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchInvalidate() {
+  Twi.flush();
+  gRightScreen.invalidate();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchFlush() {
+  Twi.flush();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void benchBatteryLevel() {
+  gBenchLong = getBatteryLevel();
 }
+#endif //BENCHMARK
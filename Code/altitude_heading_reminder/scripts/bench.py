@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+# Microbenchmark report for a BENCHMARK build (see Benchmark.h in the
+# sketch): cycles and I2C bytes per call for each benchmark, compared
+# against a stored baseline. Exits non-zero when something got slower by
+# more than the threshold, or started using more of the bus.
+#
+# Uncomment BENCHMARK in Benchmark.h, upload, and capture the serial port
+# (38400 baud) while the device boots, e.g.
+#   python3 bench.py --port /dev/ttyUSB0
+#   python3 bench.py capture.log --write-baseline
+#
+# sim/bench_host prints the same lines for the benchmarks that are pure
+# arithmetic, timed on the host with a 1GHz "clock" so the cycles are
+# nanoseconds. Its baseline is sim/bench_baseline.json, see "make
+# bench-host" there. A baseline taken at one clock isn't compared with a
+# run at another.
+
+import argparse
+import json
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_BASELINE = os.path.join(HERE, 'bench_baseline.json')
+
+BEGIN = re.compile(r'^BENCH-BEGIN (\d+)\s*$')
+LINE = re.compile(r'^BENCH (.+) (\d+) (\d+) (\d+)\s*$')
+END = re.compile(r'^BENCH-END\s*$')
+HOST_CLOCK = 1000000000 # sim/bench_host's, one cycle per nanosecond
+
+def read_lines(args):
+  if args.port:
+    try:
+      import serial
+    except ImportError:
+      sys.exit('--port needs pyserial (pip install pyserial), or capture to a file first')
+    import time
+    end = time.time() + args.seconds
+    with serial.Serial(args.port, args.baud, timeout=1) as port:
+      while time.time() < end:
+        line = port.readline().decode('ascii', 'replace')
+        yield line
+        if END.match(line.strip()):
+          return
+  else:
+    for name in args.files or ['-']:
+      f = sys.stdin if name == '-' else open(name)
+      for line in f:
+        yield line
+      if f is not sys.stdin:
+        f.close()
+
+def parse(lines):
+  # only the last complete run counts, in case the device reset partway
+  clock, results, run = None, None, None
+  for line in lines:
+    line = line.strip()
+    m = BEGIN.match(line)
+    if m:
+      clock, run = int(m.group(1)), {}
+      continue
+    m = LINE.match(line)
+    if m and run is not None:
+      iterations = int(m.group(2))
+      run[m.group(1)] = {'cycles': float(m.group(3)) / iterations, 'bytes': float(m.group(4)) / iterations}
+      continue
+    if END.match(line) and run is not None:
+      results, run = run, None
+  return clock, results
+
+def main():
+  parser = argparse.ArgumentParser(description='On-target microbenchmark report and regression check')
+  parser.add_argument('files', nargs='*', help='captured serial output (default stdin)')
+  parser.add_argument('--port', help='read live from this serial port instead (needs pyserial)')
+  parser.add_argument('--baud', type=int, default=38400, help='serial baud rate (default 38400)')
+  parser.add_argument('--seconds', type=float, default=30, help='longest to wait on --port (default 30)')
+  parser.add_argument('--baseline', default=DEFAULT_BASELINE, help='baseline JSON to compare against')
+  parser.add_argument('--write-baseline', action='store_true', help='store this run as the new baseline')
+  parser.add_argument('--threshold', type=float, default=5.0,
+                      help='percent a benchmark may slow down past the baseline (default 5)')
+  args = parser.parse_args()
+
+  clock, results = parse(read_lines(args))
+  if not results:
+    sys.exit('no complete benchmark run found, is BENCHMARK uncommented in Benchmark.h?')
+
+  baseline = None
+  if os.path.exists(args.baseline) and not args.write_baseline:
+    with open(args.baseline) as f:
+      stored = json.load(f)
+    if stored['clock'] != clock:
+      sys.exit('{} was taken at {}Hz, this run is at {}Hz'.format(args.baseline, stored['clock'], clock))
+    baseline = stored['results']
+
+  host = clock == HOST_CLOCK
+  print('{:<22} {:>10} {:>8} {:>8} {:>10}'.format('benchmark', 'ns' if host else 'cycles', 'us', 'change', 'i2c bytes'))
+  failures = []
+  for name, r in results.items():
+    change = ''
+    before = baseline.get(name) if baseline else None
+    if before:
+      percent = 100.0 * (r['cycles'] - before['cycles']) / max(before['cycles'], 1)
+      change = '{:+.1f}%'.format(percent)
+      if percent > args.threshold:
+        failures.append('{} is {:.1f}% slower ({:.0f} -> {:.0f} cycles)'.format(name, percent, before['cycles'], r['cycles']))
+      if r['bytes'] > before['bytes']:
+        failures.append('{} uses more of the bus ({:.1f} -> {:.1f} bytes)'.format(name, before['bytes'], r['bytes']))
+    print(('{:<22} {:>10.1f} {:>8.3f} {:>8} {:>10.1f}' if host else '{:<22} {:>10.0f} {:>8.1f} {:>8} {:>10.1f}').format(
+      name, r['cycles'], r['cycles'] * 1e6 / clock, change, r['bytes']))
+  print()
+
+  if args.write_baseline:
+    with open(args.baseline, 'w') as f:
+      json.dump({'clock': clock, 'results': results}, f, indent=2, sort_keys=True)
+      f.write('\n')
+    print('baseline written to {}'.format(args.baseline))
+  elif baseline is None:
+    print('no baseline at {}, run with --write-baseline to create one'.format(args.baseline))
+  else:
+    for name in sorted(set(baseline) - set(results)):
+      print('{} is in the baseline but was not run'.format(name))
+
+  for failure in failures:
+    print('REGRESSION: ' + failure, file=sys.stderr)
+  sys.exit(1 if failures else 0)
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+# Flash/SRAM footprint report for the firmware ELF, broken down by module
+# (sketch, each library, Arduino core, libc/libgcc) and by symbol. Compares
+# against a stored baseline and exits non-zero when a budget is exceeded.
+#
+# Only needs the AVR binutils that come with the Arduino IDE (avr-nm,
+# avr-size). Build the sketch first with debug info (the Arduino IDE and
+# arduino-cli both pass -g), e.g.
+#   arduino-cli compile --build-path /tmp/ahr-build ..
+#   make footprint ELF=/tmp/ahr-build/altitude_heading_reminder.ino.elf
+#
+# The baseline can also keep the totals of a reference build, a checkout
+# from before the flash and SRAM work (36ae9c7), so every report shows what
+# that work has saved so far:
+#   make footprint-baseline ELF=... REF_ELF=/tmp/ahr-ref-build/altitude_heading_reminder.ino.elf
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+BOARDS_TXT = os.path.join(HERE, '..', '..', 'Arduino', 'breadboard', 'breadboard', 'avr', 'boards.txt')
+BOARD = 'atmega328bb'
+SRAM_SIZE = 2048           # ATmega328p, boards.txt only gives the flash limit
+STACK_RESERVE = 512        # SRAM that must stay free for the stack
+DEFAULT_BASELINE = os.path.join(HERE, 'footprint_baseline.json')
+
+# first match wins, tested against the source path avr-nm -l reports
+MODULES = [
+  ('sketch',         re.compile(r'altitude_heading_reminder')),
+  ('SPL06-007',      re.compile(r'SPL06-007')),
+  ('Custom_SSD1306', re.compile(r'Custom_SSD1306')),
+  ('Custom_GFX',     re.compile(r'Custom[-_]GFX|glcdfont')),
+  ('Custom_TWI',     re.compile(r'Custom_TWI')),
+  ('EEPROM',         re.compile(r'EEPROM')),
+  ('core',           re.compile(r'cores[/\\]arduino|variants[/\\]')),
+]
+UNKNOWN_MODULE = 'libc/libgcc' # no line info: avr-libc, libgcc, linker stubs
+
+FLASH_TYPES = set('tTwWvV')    # code
+DATA_TYPES = set('dD')         # initialized data: stored in flash, copied to SRAM
+BSS_TYPES = set('bB')          # zeroed data: SRAM only
+
+def board_flash_limit():
+  with open(BOARDS_TXT) as f:
+    for line in f:
+      if line.startswith(BOARD + '.upload.maximum_size='):
+        return int(line.split('=', 1)[1])
+  sys.exit('{}.upload.maximum_size not found in {}'.format(BOARD, BOARDS_TXT))
+
+def run(tool, *args):
+  try:
+    return subprocess.run([tool] + list(args), check=True, stdout=subprocess.PIPE,
+                          universal_newlines=True).stdout
+  except FileNotFoundError:
+    sys.exit('{} not found, put the Arduino AVR tools on the PATH or use --tools'.format(tool))
+
+def section_totals(prefix, elf):
+  sections = {}
+  for line in run(prefix + 'size', '-A', elf).splitlines():
+    fields = line.split()
+    if len(fields) == 3 and fields[0].startswith('.') and fields[1].isdigit():
+      sections[fields[0]] = int(fields[1])
+  data = sections.get('.data', 0)
+  flash = sections.get('.text', 0) + data
+  sram = data + sections.get('.bss', 0) + sections.get('.noinit', 0)
+  return flash, sram
+
+def module_of(path):
+  for name, pattern in MODULES:
+    if pattern.search(path):
+      return name
+  return UNKNOWN_MODULE
+
+def symbols(prefix, elf):
+  result = []
+  for line in run(prefix + 'nm', '--print-size', '--size-sort', '-C', '-l', elf).splitlines():
+    m = re.match(r'^[0-9a-fA-F]+ ([0-9a-fA-F]+) (\w) (.*)$', line)
+    if not m:
+      continue # no size: labels and linker symbols
+    size, kind, rest = int(m.group(1), 16), m.group(2), m.group(3)
+    name, _, path = rest.partition('\t')
+    if kind in FLASH_TYPES:
+      flash, sram = size, 0
+    elif kind in DATA_TYPES:
+      flash, sram = size, size
+    elif kind in BSS_TYPES:
+      flash, sram = 0, size
+    else:
+      continue
+    result.append({'name': name, 'module': module_of(path), 'flash': flash, 'sram': sram})
+  return result
+
+def by_module(syms):
+  modules = {}
+  for s in syms:
+    m = modules.setdefault(s['module'], {'flash': 0, 'sram': 0})
+    m['flash'] += s['flash']
+    m['sram'] += s['sram']
+  return modules
+
+def delta(now, before):
+  if before is None:
+    return ''
+  return '{:+d}'.format(now - before)
+
+def main():
+  parser = argparse.ArgumentParser(description='Flash/SRAM footprint report and budget check')
+  parser.add_argument('elf', help='firmware ELF from the Arduino build directory')
+  parser.add_argument('--tools', default='avr-', help='binutils prefix (default avr-)')
+  parser.add_argument('--baseline', default=DEFAULT_BASELINE, help='baseline JSON to compare against')
+  parser.add_argument('--write-baseline', action='store_true', help='store this build as the new baseline')
+  parser.add_argument('--reference', metavar='ELF', help='with --write-baseline, a reference build to store next to it')
+  parser.add_argument('--reference-rev', default='36ae9c7', help='the revision the reference build is of (default 36ae9c7)')
+  parser.add_argument('--growth', type=int, default=256,
+                      help='bytes of flash or SRAM a module may grow past the baseline (default 256)')
+  parser.add_argument('--top', type=int, default=20, help='number of largest symbols to list')
+  args = parser.parse_args()
+
+  flash_limit = board_flash_limit()
+  sram_limit = SRAM_SIZE - STACK_RESERVE
+  flash, sram = section_totals(args.tools, args.elf)
+  syms = symbols(args.tools, args.elf)
+  modules = by_module(syms)
+
+  baseline = None
+  if os.path.exists(args.baseline) and not args.write_baseline:
+    with open(args.baseline) as f:
+      baseline = json.load(f)
+
+  def before(module, key):
+    if baseline is None:
+      return None
+    return baseline['modules'].get(module, {}).get(key, 0)
+
+  print('{:<16} {:>7} {:>7} {:>7} {:>7}'.format('module', 'flash', 'delta', 'sram', 'delta'))
+  for name in sorted(modules, key=lambda n: -modules[n]['flash']):
+    m = modules[name]
+    print('{:<16} {:>7} {:>7} {:>7} {:>7}'.format(name, m['flash'], delta(m['flash'], before(name, 'flash')),
+                                                 m['sram'], delta(m['sram'], before(name, 'sram'))))
+  print('{:<16} {:>7} {:>7} {:>7} {:>7}'.format('total', flash, delta(flash, baseline and baseline['flash']),
+                                               sram, delta(sram, baseline and baseline['sram'])))
+  print()
+  print('flash {} of {} bytes ({:.1f}%), static SRAM {} of {} bytes ({} reserved for the stack)'.format(
+    flash, flash_limit, 100.0 * flash / flash_limit, sram, sram_limit, STACK_RESERVE))
+  reference = baseline and baseline.get('reference')
+  if reference:
+    print('since {}: flash {}, static SRAM {}'.format(reference['rev'], delta(flash, reference['flash']),
+                                                      delta(sram, reference['sram'])))
+  print()
+
+  print('largest symbols:')
+  for s in sorted(syms, key=lambda s: -(s['flash'] + s['sram']))[:args.top]:
+    print('  {:>6} {:>5}  {:<16} {}'.format(s['flash'], s['sram'], s['module'], s['name']))
+  print()
+
+  if args.write_baseline:
+    stored = {'flash': flash, 'sram': sram, 'modules': modules}
+    if args.reference:
+      ref_flash, ref_sram = section_totals(args.tools, args.reference)
+      stored['reference'] = {'rev': args.reference_rev, 'flash': ref_flash, 'sram': ref_sram,
+                             'modules': by_module(symbols(args.tools, args.reference))}
+    with open(args.baseline, 'w') as f:
+      json.dump(stored, f, indent=2, sort_keys=True)
+      f.write('\n')
+    print('baseline written to {}'.format(args.baseline))
+
+  failures = []
+  if flash > flash_limit:
+    failures.append('flash {} exceeds the {} byte upload limit'.format(flash, flash_limit))
+  if sram > sram_limit:
+    failures.append('static SRAM {} leaves less than {} bytes for the stack'.format(sram, STACK_RESERVE))
+  if baseline is not None:
+    for name, m in sorted(modules.items()):
+      for key in ('flash', 'sram'):
+        grown = m[key] - before(name, key)
+        if grown > args.growth:
+          failures.append('{} {} grew by {} bytes (budget {})'.format(name, key, grown, args.growth))
+  elif not args.write_baseline:
+    print('no baseline at {}, run with --write-baseline to create one'.format(args.baseline))
+
+  for failure in failures:
+    print('BUDGET EXCEEDED: ' + failure, file=sys.stderr)
+  sys.exit(1 if failures else 0)
+
+if __name__ == '__main__':
+  main()
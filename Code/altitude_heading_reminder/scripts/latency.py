@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+# Knob-to-pixel latency report from a LATENCY build (see LatencyMonitor.h
+# in the sketch), on the device or in the simulator. Prints percentiles
+# and a histogram of the time from a detent of the right knob to the end
+# of the frame that shows it, split into waiting for the frame and the
+# frame itself, and fails when a percentile is over budget.
+#
+#   python3 latency.py --port /dev/ttyUSB0 --seconds 60
+#   ../sim/ahr_sim firmware.elf ../sim/scenarios/knob.txt | python3 latency.py --budget 80
+
+import argparse
+import math
+import re
+import sys
+
+EVENT = re.compile(r'^LATENCY (\d+) (\d+) (\d+)\s*$')
+SUMMARY = re.compile(r'^LATENCY-SUMMARY (\d+) (\d+) (\d+) (\d+) (\d+)\s*$')
+
+def read_lines(args):
+  if args.port:
+    try:
+      import serial
+    except ImportError:
+      sys.exit('--port needs pyserial (pip install pyserial), or capture to a file first')
+    import time
+    end = time.time() + args.seconds
+    with serial.Serial(args.port, args.baud, timeout=1) as port:
+      while time.time() < end:
+        yield port.readline().decode('ascii', 'replace')
+  else:
+    for name in args.files or ['-']:
+      f = sys.stdin if name == '-' else open(name)
+      for line in f:
+        yield line
+      if f is not sys.stdin:
+        f.close()
+
+def parse(lines):
+  events = []
+  summary = None
+  for line in lines:
+    line = line.strip()
+    m = EVENT.match(line)
+    if m:
+      events.append(tuple(int(g) / 1000.0 for g in m.groups())) # ms
+      continue
+    m = SUMMARY.match(line)
+    if m:
+      summary = [int(g) for g in m.groups()] # cumulative, so the last one wins
+  return events, summary
+
+def percentile(values, p):
+  ordered = sorted(values)
+  return ordered[max(0, math.ceil(len(ordered) * p / 100.0) - 1)]
+
+def histogram(values, width, bars=50):
+  buckets = {}
+  for v in values:
+    buckets[int(v // width)] = buckets.get(int(v // width), 0) + 1
+  most = max(buckets.values())
+  for b in range(min(buckets), max(buckets) + 1):
+    count = buckets.get(b, 0)
+    print('{:>5g}-{:<5g} {:>5} {}'.format(b * width, (b + 1) * width, count, '#' * math.ceil(bars * count / most)))
+
+def main():
+  parser = argparse.ArgumentParser(description='knob-to-pixel latency report')
+  parser.add_argument('files', nargs='*', help='captured serial output (default stdin)')
+  parser.add_argument('--port', help='read live from this serial port instead (needs pyserial)')
+  parser.add_argument('--baud', type=int, default=38400, help='serial baud rate (default 38400)')
+  parser.add_argument('--seconds', type=float, default=60, help='how long to read --port for (default 60)')
+  parser.add_argument('--bucket', type=float, default=5, help='histogram bucket width in ms (default 5)')
+  parser.add_argument('--budget', type=float, help='fail when the --percentile latency is over this many ms')
+  parser.add_argument('--percentile', type=float, default=99, help='percentile the budget applies to (default 99)')
+  args = parser.parse_args()
+
+  events, summary = parse(read_lines(args))
+  if not events:
+    sys.exit('no LATENCY lines found, is LATENCY uncommented in LatencyMonitor.h?')
+
+  print('{} detents measured'.format(len(events)))
+  print()
+  print('{:>8} {:>8} {:>8} {:>8} {:>8}'.format('ms', 'p50', 'p90', 'p99', 'max'))
+  for i, name in enumerate(('total', 'wait', 'frame')):
+    values = [e[i] for e in events]
+    print('{:>8} {:>8.1f} {:>8.1f} {:>8.1f} {:>8.1f}'.format(
+      name, percentile(values, 50), percentile(values, 90), percentile(values, 99), max(values)))
+  print()
+  print('total, ms:')
+  histogram([e[0] for e in events], args.bucket)
+  print()
+
+  if summary:
+    count, p50, p99, most, failed = summary
+    print('on the device: {} measured, p50 <= {} ms, p99 <= {} ms, max {:.1f} ms, {} frames failed'.format(
+      count, p50, p99, most / 1000.0, failed))
+    if count > len(events):
+      print('({} measurements weren\'t sent individually because serial was busy)'.format(count - len(events)))
+
+  if args.budget is not None:
+    worst = percentile([e[0] for e in events], args.percentile)
+    if worst > args.budget:
+      print('FAIL: p{:g} latency {:.1f} ms is over the {:g} ms budget'.format(args.percentile, worst, args.budget))
+      sys.exit(1)
+    print('ok: p{:g} latency {:.1f} ms is within the {:g} ms budget'.format(args.percentile, worst, args.budget))
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+# Generates BatteryTable.h: battery percentage for every raw 10-bit ADC code
+# on the battery voltage divider, so the firmware does a single PROGMEM read
+# instead of floating-point interpolation.
+
+import sys
+
+ADC_STEPS = 1024
+ADC_REFERENCE = 3.3        # volts
+DIVIDER_RATIO = 1.3333     # battery voltage / voltage at the ADC pin
+CHARGING_VOLTAGE = 4.16    # the battery can't sit above this, only a charger can
+
+# LiPo discharge curve: voltage at 0%, 5%, 10% ... 100%
+CAPACITY_VOLTAGE = [
+  2.40, 3.41, 3.48, 3.54, 3.58, 3.62, 3.67, 3.71, 3.76, 3.79, 3.82,
+  3.84, 3.87, 3.91, 3.94, 3.98, 4.01, 4.03, 4.06, 4.09, 4.15,
+]
+CAPACITY_INTERVAL = 5      # percent between neighbouring entries
+
+def voltage(adc):
+  return adc / ADC_STEPS * ADC_REFERENCE * DIVIDER_RATIO
+
+def exact_level(v):
+  if v <= CAPACITY_VOLTAGE[0]:
+    return 0.0
+  for i in range(1, len(CAPACITY_VOLTAGE)):
+    if v <= CAPACITY_VOLTAGE[i]:
+      lo, hi = CAPACITY_VOLTAGE[i - 1], CAPACITY_VOLTAGE[i]
+      return (i - 1) * CAPACITY_INTERVAL + (v - lo) / (hi - lo) * CAPACITY_INTERVAL
+  return 100.0
+
+def main():
+  codes = [adc for adc in range(ADC_STEPS)
+           if CAPACITY_VOLTAGE[0] < voltage(adc) <= CAPACITY_VOLTAGE[-1]]
+  start = codes[0]
+  levels = [int(exact_level(voltage(adc))) for adc in codes]  # truncated, like the old int conversion
+  charging = next(adc for adc in range(ADC_STEPS) if voltage(adc) > CHARGING_VOLTAGE)
+
+  worst = max(abs(level - exact_level(voltage(adc))) for adc, level in zip(codes, levels))
+  if worst >= 1.0:
+    print("table is off the discharge curve by {:.2f}%".format(worst), file=sys.stderr)
+    sys.exit(1)
+
+  print("// Generated by scripts/make_battery_table.py, do not edit by hand.")
+  print("// Worst-case error against the discharge curve: {:.2f}%".format(worst))
+  print("#ifndef _BATTERY_TABLE_H_")
+  print("#define _BATTERY_TABLE_H_")
+  print()
+  print("#define cBatteryAdcTableStart  {}  //ADC codes below this are 0%".format(start))
+  print("#define cBatteryAdcTableLength {}  //ADC codes at or past the end are 100%".format(len(levels)))
+  print("#define cBatteryChargingAdc    {}  //{}V, only possible while charging".format(charging, CHARGING_VOLTAGE))
+  print()
+  print("const uint8_t PROGMEM cBatteryLevelTable[cBatteryAdcTableLength] = {")
+  for i in range(0, len(levels), 16):
+    print("  " + ", ".join("{:3d}".format(level) for level in levels[i:i + 16]) + ",")
+  print("};")
+  print()
+  print("#endif //_BATTERY_TABLE_H_")
+
+if __name__ == '__main__':
+  main()
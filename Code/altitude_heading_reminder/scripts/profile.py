@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+# Flat profile from a PROFILE build (see Profiler.h in the sketch): the
+# sampled program counters are matched to the functions in the ELF, and
+# the share of samples each function got is the share of CPU time it
+# used. Also reports what the sampling itself cost.
+#
+# Uncomment PROFILE in Profiler.h, upload, and capture the serial port
+# (38400 baud) through a representative flight, e.g.
+#   python3 profile.py --port /dev/ttyUSB0 --seconds 120 --elf <build dir>/altitude_heading_reminder.ino.elf
+#   python3 profile.py capture.log --elf firmware.elf --lines 10
+# Needs the AVR binutils from the Arduino IDE (avr-nm, avr-addr2line).
+
+import argparse
+import bisect
+import collections
+import re
+import subprocess
+import sys
+
+SAMPLES = re.compile(r'^P((?: [0-9a-fA-F]{4})+)\s*$')
+STATS = re.compile(r'^PROFILE-STATS (\d+) (\d+) (\d+) (\d+) (\d+)\s*$')
+PRESCALER = 8 # timer1 clock divider, cProfilePrescaler in Profiler.cpp
+
+def read_lines(args):
+  if args.port:
+    try:
+      import serial
+    except ImportError:
+      sys.exit('--port needs pyserial (pip install pyserial), or capture to a file first')
+    import time
+    end = time.time() + args.seconds
+    with serial.Serial(args.port, args.baud, timeout=1) as port:
+      while time.time() < end:
+        yield port.readline().decode('ascii', 'replace')
+  else:
+    for name in args.files or ['-']:
+      f = sys.stdin if name == '-' else open(name)
+      for line in f:
+        yield line
+      if f is not sys.stdin:
+        f.close()
+
+def parse(lines):
+  samples = []
+  stats = None
+  for line in lines:
+    line = line.strip()
+    m = SAMPLES.match(line)
+    if m:
+      samples.extend(int(word, 16) * 2 for word in m.group(1).split()) # word address to byte address
+      continue
+    m = STATS.match(line)
+    if m:
+      stats = [int(g) for g in m.groups()] # cumulative, so the last one wins
+  return samples, stats
+
+def run(tool, *args, **kwargs):
+  try:
+    return subprocess.run([tool] + list(args), check=True, stdout=subprocess.PIPE,
+                          universal_newlines=True, **kwargs).stdout
+  except FileNotFoundError:
+    sys.exit('{} not found, put the Arduino AVR tools on the PATH or use --tools'.format(tool))
+
+def functions(prefix, elf):
+  starts, ends, names = [], [], []
+  for line in run(prefix + 'nm', '--numeric-sort', '--print-size', '-C', elf).splitlines():
+    m = re.match(r'^([0-9a-fA-F]+) ([0-9a-fA-F]+) ([tTwW]) (.*)$', line)
+    if m:
+      start = int(m.group(1), 16)
+      starts.append(start)
+      ends.append(start + int(m.group(2), 16))
+      names.append(m.group(4))
+  return starts, ends, names
+
+def symbolize(address, table):
+  starts, ends, names = table
+  i = bisect.bisect_right(starts, address) - 1
+  if i >= 0 and address < ends[i]:
+    return names[i]
+  return '?? 0x{:04x}'.format(address)
+
+def main():
+  parser = argparse.ArgumentParser(description='PC-sampling profile report')
+  parser.add_argument('files', nargs='*', help='captured serial output (default stdin)')
+  parser.add_argument('--elf', required=True, help='the ELF that was running, from the Arduino build directory')
+  parser.add_argument('--tools', default='avr-', help='binutils prefix (default avr-)')
+  parser.add_argument('--port', help='read live from this serial port instead (needs pyserial)')
+  parser.add_argument('--baud', type=int, default=38400, help='serial baud rate (default 38400)')
+  parser.add_argument('--seconds', type=float, default=60, help='how long to read --port for (default 60)')
+  parser.add_argument('--top', type=int, default=30, help='number of functions to list')
+  parser.add_argument('--lines', type=int, default=0, help='also list this many of the hottest source lines')
+  args = parser.parse_args()
+
+  samples, stats = parse(read_lines(args))
+  if not samples:
+    sys.exit('no samples found, is PROFILE uncommented in Profiler.h?')
+  table = functions(args.tools, args.elf)
+
+  counts = collections.Counter(symbolize(a, table) for a in samples)
+  total = len(samples)
+  print('{} samples'.format(total))
+  print()
+  print('{:>7} {:>7} {:>7}  {}'.format('samples', 'self %', 'cum %', 'function'))
+  cumulative = 0
+  for name, count in counts.most_common(args.top):
+    cumulative += count
+    print('{:>7} {:>6.1f}% {:>6.1f}%  {}'.format(count, 100.0 * count / total, 100.0 * cumulative / total, name))
+  print()
+
+  if args.lines:
+    hottest = collections.Counter(samples).most_common(args.lines)
+    where = run(args.tools + 'addr2line', '-e', args.elf, '-f', '-C', '-s',
+                *['0x{:x}'.format(a) for a, _ in hottest]).splitlines()
+    print('hottest addresses:')
+    for i, (address, count) in enumerate(hottest):
+      print('{:>7} {:>6.1f}%  0x{:04x} {} {}'.format(count, 100.0 * count / total, address,
+                                                    where[2 * i], where[2 * i + 1]))
+    print()
+
+  if stats:
+    taken, dropped, isr_ticks, isr_ticks_max, period_ticks = stats
+    average = isr_ticks * PRESCALER / max(taken, 1)
+    print('sampling cost: {:.0f} cycles per sample on average, {} at most, {:.2f}% of the CPU'.format(
+      average, isr_ticks_max * PRESCALER, 100.0 * isr_ticks / max(taken, 1) / period_ticks))
+    print('{} samples taken, {} dropped because serial fell behind ({:.1f}%)'.format(
+      taken, dropped, 100.0 * dropped / max(taken, 1)))
+  else:
+    print('no PROFILE-STATS line in the capture, sampling cost unknown')
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+# I2C bus utilization report from a Custom_TWI transaction trace: how much of
+# each second the bus is busy, which call sites use that time, and the
+# longest stretches it sits idle.
+#
+# Uncomment TWI_TRACE in Custom_TWI.h, upload, and capture the serial port
+# (38400 baud, see cTraceBaudRate in the sketch), e.g.
+#   python3 twi_trace.py --port /dev/ttyUSB0 --seconds 30
+#   python3 twi_trace.py capture.log
+# Lines that don't come from the trace (DEBUG output) are ignored.
+#
+# When the trace buffer fills, the firmware drops transactions and puts a
+# "TWI-DROPPED count" line just before the next one it does trace. The
+# stretch between the transactions either side of it held bus traffic that
+# wasn't recorded, so it is left out of the idle gaps and the utilization
+# rather than counted as idle, and marked in the timeline.
+
+import argparse
+import collections
+import re
+import sys
+
+LINE = re.compile(r'^TWI (\d+) (\d+) ([0-9a-fA-F]{2}) (\d+) (\d+) (\d+) (\S+)\s*$')
+DROPPED = re.compile(r'^TWI-DROPPED (\d+)\s*$')
+WRAP = 1 << 32 # micros() is an unsigned long
+
+DEVICES = {0x3C: 'SSD1306', 0x76: 'SPL06', 0x77: 'SPL06'}
+STATUS = {0: 'ok', 2: 'nack address', 3: 'nack data', 4: 'bus error', 5: 'timeout'}
+
+# dropped: transactions the firmware dropped just before this one
+Transaction = collections.namedtuple('Transaction', 'start duration address written read status tag dropped')
+
+def read_lines(args):
+  if args.port:
+    try:
+      import serial
+    except ImportError:
+      sys.exit('--port needs pyserial (pip install pyserial), or capture to a file first')
+    import time
+    end = time.time() + args.seconds
+    with serial.Serial(args.port, args.baud, timeout=1) as port:
+      while time.time() < end:
+        yield port.readline().decode('ascii', 'replace')
+  else:
+    for name in args.files or ['-']:
+      f = sys.stdin if name == '-' else open(name)
+      for line in f:
+        yield line
+      if f is not sys.stdin:
+        f.close()
+
+def parse(lines):
+  transactions = []
+  dropped = 0
+  pending = 0 # dropped, waiting for the transaction they came before
+  last = None
+  offset = 0
+  for line in lines:
+    m = LINE.match(line.strip())
+    if m:
+      start = int(m.group(1))
+      if last is not None and start + offset < last - WRAP // 2:
+        offset += WRAP # micros() wrapped around, about every 71 minutes
+      start += offset
+      last = start
+      transactions.append(Transaction(start, int(m.group(2)), int(m.group(3), 16), int(m.group(4)),
+                                      int(m.group(5)), int(m.group(6)), m.group(7), pending))
+      pending = 0
+      continue
+    m = DROPPED.match(line.strip())
+    if m:
+      dropped += int(m.group(1))
+      pending += int(m.group(1))
+  return transactions, dropped
+
+def unknown_stretches(transactions):
+  # (start, end) of each stretch that held dropped transactions: from the end
+  # of the last traced transaction before the drops to the start of the first
+  # one after them
+  stretches = []
+  end = None
+  for t in transactions:
+    if t.dropped and end is not None and t.start > end:
+      stretches.append((end, t.start))
+    end = t.start + t.duration if end is None else max(end, t.start + t.duration)
+  return stretches
+
+def device(address):
+  return '{:02x} {}'.format(address, DEVICES.get(address, '?'))
+
+def spread(buckets, start, end, first, bucket_us):
+  # add start..end to the buckets it covers, split where it straddles a boundary
+  while start < end:
+    index = (start - first) // bucket_us
+    bucket_end = first + (index + 1) * bucket_us
+    buckets[index] += min(end, bucket_end) - start
+    start = bucket_end
+
+def timeline(transactions, unknown, first, bucket_us):
+  buckets = collections.defaultdict(int)
+  for t in transactions:
+    spread(buckets, t.start, t.start + t.duration, first, bucket_us)
+  unknown_buckets = collections.defaultdict(int)
+  for start, end in unknown:
+    spread(unknown_buckets, start, end, first, bucket_us)
+  return buckets, unknown_buckets
+
+def main():
+  parser = argparse.ArgumentParser(description='I2C bus utilization from a Custom_TWI trace')
+  parser.add_argument('files', nargs='*', help='captured serial output (default stdin)')
+  parser.add_argument('--port', help='read live from this serial port instead (needs pyserial)')
+  parser.add_argument('--baud', type=int, default=38400, help='serial baud rate (default 38400)')
+  parser.add_argument('--seconds', type=float, default=10, help='how long to read --port for (default 10)')
+  parser.add_argument('--bucket', type=int, default=1000, help='timeline resolution in ms (default 1000)')
+  parser.add_argument('--gaps', type=int, default=5, help='number of longest idle gaps to list')
+  args = parser.parse_args()
+
+  transactions, dropped = parse(read_lines(args))
+  if not transactions:
+    sys.exit('no TWI trace lines found, is TWI_TRACE uncommented in Custom_TWI.h?')
+  transactions.sort(key=lambda t: t.start)
+  unknown = unknown_stretches(transactions)
+  unknown_us = sum(end - start for start, end in unknown)
+
+  first = transactions[0].start
+  span = max(t.start + t.duration for t in transactions) - first
+  busy = sum(t.duration for t in transactions)
+  print('{} transactions over {:.3f} s, bus busy {:.1f}% of the traced time'.format(
+    len(transactions), span / 1e6, 100.0 * busy / max(span - unknown_us, 1)))
+  if dropped:
+    print('{} transactions dropped because the trace buffer was full, totals below are low'.format(dropped))
+    print('{} us in {} stretches around them left out of the utilization and the idle gaps'.format(
+      unknown_us, len(unknown)))
+  print()
+
+  print('{:<22} {:>6} {:>8} {:>10} {:>6} {:>8} {:>8}'.format('call site', 'count', 'bytes', 'busy us', 'share', 'avg us', 'max us'))
+  sites = collections.defaultdict(list)
+  for t in transactions:
+    sites[t.tag].append(t)
+  for tag, ts in sorted(sites.items(), key=lambda item: -sum(t.duration for t in item[1])):
+    site_busy = sum(t.duration for t in ts)
+    print('{:<22} {:>6} {:>8} {:>10} {:>5.1f}% {:>8} {:>8}'.format(
+      tag, len(ts), sum(t.written + t.read for t in ts), site_busy, 100.0 * site_busy / max(busy, 1),
+      site_busy // len(ts), max(t.duration for t in ts)))
+  print()
+
+  print('{:<22} {:>6} {:>8} {:>10}'.format('device', 'count', 'bytes', 'busy us'))
+  devices = collections.defaultdict(list)
+  for t in transactions:
+    devices[t.address].append(t)
+  for address, ts in sorted(devices.items()):
+    print('{:<22} {:>6} {:>8} {:>10}'.format(
+      device(address), len(ts), sum(t.written + t.read for t in ts), sum(t.duration for t in ts)))
+  print()
+
+  failed = [t for t in transactions if t.status != 0]
+  if failed:
+    print('failed transactions:')
+    for t in failed:
+      print('  {:>12} us  {}  {:<12} {}'.format(t.start - first, device(t.address), STATUS.get(t.status, t.status), t.tag))
+    print()
+
+  bucket_us = args.bucket * 1000
+  buckets, unknown_buckets = timeline(transactions, unknown, first, bucket_us)
+  print('utilization per {} ms{}:'.format(args.bucket, ', ? where transactions were dropped' if unknown else ''))
+  for index in range(max(buckets) + 1):
+    traced_us = bucket_us - unknown_buckets[index]
+    share = 100.0 * buckets[index] / max(traced_us, 1)
+    mark = ' ? {:.0f}% untraced'.format(100.0 * unknown_buckets[index] / bucket_us) if unknown_buckets[index] else ''
+    print('  {:>8.1f} s {:>5.1f}% {}{}'.format(index * bucket_us / 1e6, share, '#' * int(round(share / 2)), mark))
+  print()
+
+  gaps = []
+  end = transactions[0].start + transactions[0].duration
+  for t in transactions[1:]:
+    if t.start > end and not t.dropped: # a gap with dropped transactions in it wasn't idle
+      gaps.append((t.start - end, end - first, t.tag))
+    end = max(end, t.start + t.duration)
+  print('longest idle gaps:')
+  for length, at, tag in sorted(gaps, reverse=True)[:args.gaps]:
+    print('  {:>10} us at {:>12} us, ended by {}'.format(length, at, tag))
+
+if __name__ == '__main__':
+  main()
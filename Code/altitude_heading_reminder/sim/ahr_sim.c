@@ -0,0 +1,481 @@
+/*
+ * Runs the firmware ELF, exactly as it would be uploaded, on simavr with
+ * the device's peripherals around it:
+ *   - an SPL06-007 at 0x76 whose pressure and temperature follow a scenario
+ *   - two SSD1306 panels at 0x3C, selected by the control pins 5 and 7
+ *   - both knobs, turned and pressed by the scenario through their pins
+ *   - the battery voltage on A0
+ *   - the buzzer pin, every change logged with its time
+ *   - a current estimate for each power mode, from the CPU's sleep mode,
+ *     the panels' state and lit pixels, and the SPL06's conversions
+ * Timing is cycle accurate at the ELF's clock (8 MHz unless the ELF says
+ * otherwise), so AVR costs like soft-float and the TWI waits all show up.
+ *
+ * The firmware's serial output goes to stdout untouched, so a BENCHMARK,
+ * TWI_TRACE or LATENCY build pipes straight into scripts/bench.py,
+ * scripts/twi_trace.py or scripts/latency.py. Everything the simulator reports goes to stderr.
+ *
+ *   ahr_sim [-s seconds] [-o dir] [-a] firmware.elf [scenario]
+ *
+ * Scenario lines are "<seconds> <event> <arguments>", # starts a comment:
+ *   pressure <hPa> [celsius]   environment at that time, linear in between
+ *   altitude <feet> [celsius]  same, as a standard atmosphere altitude
+ *   battery <volts>            battery voltage from then on
+ *   left|right cw|ccw [detents]
+ *   left|right press|release
+ *   snapshot                   save both panels as PBM (and print them, -a)
+ *   end                        stop the run
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "avr_ioport.h"
+#include "avr_adc.h"
+#include "avr_uart.h"
+#include "avr_twi.h"
+#include "spl06_model.h"
+#include "ssd1306_model.h"
+
+#define DEFAULT_MCU        "atmega328p"
+#define DEFAULT_FREQUENCY  8000000
+#define SUPPLY_MV          3300     // AVCC, the ADC reference
+#define BATTERY_DIVIDER    1.3333   // battery voltage / voltage at A0, see scripts/make_battery_table.py
+#define SPL06_ADDRESS      0x76
+#define OLED_ADDRESS       0x3C
+#define PORTD_ADDRESS      0x2B     // data space address on the ATmega328p
+#define KNOB_STEP          0.002    // seconds between quadrature edges
+#define MAX_EVENTS         1024
+#define MAX_KEYPOINTS      256
+#define SMCR_ADDRESS       0x53     // sleep mode control register, data space
+
+// Rough currents for the estimate, at 3.3 V and 8 MHz. The MCU figures are
+// read off the ATmega328P datasheet's typical curves, the rest come from
+// the SPL06-007 and SSD1306 datasheets and typical 128x32 modules. Tune
+// them against a meter on a real unit
+#define MCU_ACTIVE_MA       3.0
+#define MCU_IDLE_MA         0.8
+#define MCU_ADC_NR_MA       1.1      // idle plus the ADC converting
+#define MCU_POWER_DOWN_MA   0.0001   // watchdog and brown-out detector off
+#define SPL06_STANDBY_MA    0.001
+#define SPL06_CONVERTING_MA 0.47     // the datasheet's 1.7 uA for one 3.6 ms measurement a second
+#define OLED_OFF_MA         0.01     // display off, the driver asleep
+#define OLED_ON_MA          0.4      // driver and charge pump with nothing lit
+#define OLED_PIXEL_MA       0.004    // each lit pixel at full contrast
+
+typedef struct pin_t {
+  char    port;
+  uint8_t bit;
+} pin_t;
+
+typedef struct knob_t {
+  pin_t dt, clk, button;
+} knob_t;
+
+// sketch pins: left knob on 2/3/4, right knob on 8/9/10, buzzer on 6
+static const knob_t knobs[2] = {
+  { { 'D', 2 }, { 'D', 3 }, { 'D', 4 } },
+  { { 'B', 0 }, { 'B', 1 }, { 'B', 2 } },
+};
+static const pin_t buzzer = { 'D', 6 };
+static const pin_t noPin = { 0, 0 };
+
+// (DT, CLK) for each quadrature phase, cEncoderValues in the sketch
+static const uint8_t phases[4][2] = { { 1, 1 }, { 1, 0 }, { 0, 0 }, { 0, 1 } };
+
+typedef enum { PIN, BATTERY, SNAPSHOT, END } event_type_t;
+
+typedef struct event_t {
+  double       time;
+  event_type_t type;
+  pin_t        pin;
+  double       value;
+} event_t;
+
+typedef enum { SCREENS_ON, SCREENS_OFF, POWERED_DOWN, POWER_MODES } power_mode_t;
+
+static const char *const powerModeNames[POWER_MODES] = { "screens on", "screens off", "powered down" };
+
+typedef struct power_t {
+  double time;                       // seconds spent in the mode
+  double mcu, panels, sensor;        // charge drawn in it, mA * s
+} power_t;
+
+typedef struct keypoint_t {
+  double time, pressure, temperature;
+} keypoint_t;
+
+static event_t    events[MAX_EVENTS];
+static int        eventCount;
+static keypoint_t keypoints[MAX_KEYPOINTS];
+static int        keypointCount;
+
+static avr_t     *avr;
+static spl06_t    sensor;
+static ssd1306_t  panels[2];
+static const char *outputDir = ".";
+static int        printPanels;
+static int        snapshots;
+
+static double     buzzerOnSince = -1, buzzerOnTotal;
+static uint32_t   buzzerBeeps;
+
+static power_t    power[POWER_MODES];
+static double     panelsMa;          // both panels, refreshed every millisecond
+static double     sensorBusyTime;    // spl06_t.busyTime already counted
+
+static double now(void) {
+  return (double)avr->cycle / avr->frequency;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// scenario
+//////////////////////////////////////////////////////////////////////////
+static void addEvent(double time, event_type_t type, pin_t pin, double value) {
+  if (eventCount == MAX_EVENTS) {
+    fprintf(stderr, "too many scenario events, the limit is %d\n", MAX_EVENTS);
+    exit(1);
+  }
+  event_t *e = &events[eventCount++];
+  e->time = time;
+  e->type = type;
+  e->pin = pin;
+  e->value = value;
+}
+
+static int compareEvents(const void *a, const void *b) {
+  double d = ((const event_t *)a)->time - ((const event_t *)b)->time;
+  return d < 0 ? -1 : d > 0;
+}
+
+static int compareKeypoints(const void *a, const void *b) {
+  double d = ((const keypoint_t *)a)->time - ((const keypoint_t *)b)->time;
+  return d < 0 ? -1 : d > 0;
+}
+
+static double pressureAtAltitude(double feet) {
+  return 1013.25 * pow(1 - feet / 145366.45, 1 / 0.190284);
+}
+
+static void addKnobTurn(double time, const knob_t *knob, int clockwise, int detents) {
+  int index = 0; // every detent is phase 0
+  for (int step = 0; step < detents * 4; step++) {
+    index = clockwise ? (index + 1) % 4 : (index + 3) % 4;
+    time += KNOB_STEP;
+    addEvent(time, PIN, knob->dt, phases[index][0]);
+    addEvent(time, PIN, knob->clk, phases[index][1]);
+  }
+}
+
+static void readScenario(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  char line[256];
+  int number = 0;
+  while (fgets(line, sizeof(line), f)) {
+    number++;
+    char *hash = strchr(line, '#');
+    if (hash) {
+      *hash = 0;
+    }
+    double time, value = 0, temperature = 20;
+    char what[16] = "", action[16] = "";
+    int fields = sscanf(line, "%lf %15s %15s", &time, what, action);
+    if (fields <= 0) {
+      continue;
+    }
+    if (fields < 2) {
+      fprintf(stderr, "%s:%d: expected \"<seconds> <event> ...\"\n", path, number);
+      exit(1);
+    }
+
+    int side = !strcmp(what, "left") ? 0 : !strcmp(what, "right") ? 1 : -1;
+    if (!strcmp(what, "pressure") || !strcmp(what, "altitude")) {
+      if (sscanf(line, "%*f %*s %lf %lf", &value, &temperature) < 1 || keypointCount == MAX_KEYPOINTS) {
+        fprintf(stderr, "%s:%d: bad or too many %s lines\n", path, number, what);
+        exit(1);
+      }
+      keypoint_t *k = &keypoints[keypointCount++];
+      k->time = time;
+      k->pressure = what[0] == 'a' ? pressureAtAltitude(value) : value;
+      k->temperature = temperature;
+    }
+    else if (!strcmp(what, "battery") && sscanf(line, "%*f %*s %lf", &value) == 1) {
+      addEvent(time, BATTERY, noPin, value);
+    }
+    else if (!strcmp(what, "snapshot")) {
+      addEvent(time, SNAPSHOT, noPin, 0);
+    }
+    else if (!strcmp(what, "end")) {
+      addEvent(time, END, noPin, 0);
+    }
+    else if (side >= 0 && (!strcmp(action, "cw") || !strcmp(action, "ccw"))) {
+      int detents = 1;
+      sscanf(line, "%*f %*s %*s %d", &detents);
+      addKnobTurn(time, &knobs[side], action[1] == 'w', detents);
+    }
+    else if (side >= 0 && (!strcmp(action, "press") || !strcmp(action, "release"))) {
+      addEvent(time, PIN, knobs[side].button, action[0] == 'r'); // the buttons pull down when pressed
+    }
+    else {
+      fprintf(stderr, "%s:%d: unknown event \"%s %s\"\n", path, number, what, action);
+      exit(1);
+    }
+  }
+  fclose(f);
+  qsort(events, eventCount, sizeof(event_t), compareEvents);
+  qsort(keypoints, keypointCount, sizeof(keypoint_t), compareKeypoints);
+}
+
+// environment at time t, linear between the scenario's keypoints
+static void environment(double t, double *pressure, double *temperature) {
+  if (keypointCount == 0) {
+    *pressure = 1013.25;
+    *temperature = 20;
+    return;
+  }
+  int i = 0;
+  while (i < keypointCount - 1 && keypoints[i + 1].time <= t) {
+    i++;
+  }
+  const keypoint_t *a = &keypoints[i];
+  const keypoint_t *b = i < keypointCount - 1 ? &keypoints[i + 1] : a;
+  double f = (b->time > a->time && t > a->time) ? (t - a->time) / (b->time - a->time) : 0;
+  if (f > 1) {
+    f = 1;
+  }
+  *pressure = a->pressure + f * (b->pressure - a->pressure);
+  *temperature = a->temperature + f * (b->temperature - a->temperature);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// peripherals
+//////////////////////////////////////////////////////////////////////////
+static void setPin(pin_t pin, int level) {
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(pin.port), pin.bit), level);
+}
+
+static void setBattery(double volts) {
+  avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0), (uint32_t)(volts * 1000 / BATTERY_DIVIDER));
+}
+
+static void buzzerHook(struct avr_irq_t *irq, uint32_t value, void *param) {
+  double t = now();
+  if (value && buzzerOnSince < 0) {
+    buzzerOnSince = t;
+    buzzerBeeps++;
+  }
+  else if (!value && buzzerOnSince >= 0) {
+    buzzerOnTotal += t - buzzerOnSince;
+    fprintf(stderr, "%10.6f buzzer on for %.3f s\n", buzzerOnSince, t - buzzerOnSince);
+    buzzerOnSince = -1;
+  }
+}
+
+static void uartHook(struct avr_irq_t *irq, uint32_t value, void *param) {
+  putchar(value);
+  if (value == '\n') {
+    fflush(stdout);
+  }
+}
+
+static void snapshot(void) {
+  snapshots++;
+  for (int i = 0; i < 2; i++) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s-%03d.pbm", outputDir, panels[i].name, snapshots);
+    if (ssd1306_write_pbm(&panels[i], path)) {
+      perror(path);
+    }
+    if (printPanels) {
+      fprintf(stderr, "%10.6f ", now());
+      ssd1306_print(&panels[i], stderr);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// current estimate
+//////////////////////////////////////////////////////////////////////////
+static int sleepMode(void) {
+  return (avr->data[SMCR_ADDRESS] >> 1) & 0x07;
+}
+
+static double mcuMa(void) {
+  if (avr->state != cpu_Sleeping) {
+    return MCU_ACTIVE_MA;
+  }
+  switch (sleepMode()) {
+  case 0:  return MCU_IDLE_MA;
+  case 1:  return MCU_ADC_NR_MA;
+  default: return MCU_POWER_DOWN_MA; // the firmware only uses power-down of the deeper modes
+  }
+}
+
+static power_mode_t powerMode(void) {
+  if (avr->state == cpu_Sleeping && sleepMode() == 2) {
+    return POWERED_DOWN;
+  }
+  return panels[0].on || panels[1].on ? SCREENS_ON : SCREENS_OFF;
+}
+
+static void updatePanelsMa(void) {
+  panelsMa = 0;
+  for (int i = 0; i < 2; i++) {
+    panelsMa += panels[i].on ? OLED_ON_MA + ssd1306_lit_pixels(&panels[i]) * OLED_PIXEL_MA * panels[i].contrast / 255
+                             : OLED_OFF_MA;
+  }
+}
+
+// charges the time since the last call to the mode and currents from before it
+static void chargePower(power_mode_t mode, double mcu, double seconds) {
+  power_t *p = &power[mode];
+  p->time += seconds;
+  p->mcu += mcu * seconds;
+  p->panels += panelsMa * seconds;
+  p->sensor += SPL06_STANDBY_MA * seconds + (sensor.busyTime - sensorBusyTime) * SPL06_CONVERTING_MA;
+  sensorBusyTime = sensor.busyTime;
+}
+
+static void printPower(void) {
+  power_t total = { 0, 0, 0, 0 };
+  fprintf(stderr, "current estimate, mA  %8s %8s %8s %8s %8s\n", "seconds", "MCU", "panels", "SPL06", "total");
+  for (int i = 0; i <= POWER_MODES; i++) {
+    const power_t *p = i < POWER_MODES ? &power[i] : &total;
+    if (i < POWER_MODES) {
+      total.time += p->time;
+      total.mcu += p->mcu;
+      total.panels += p->panels;
+      total.sensor += p->sensor;
+    }
+    if (p->time > 0) {
+      fprintf(stderr, "  %-18s %8.3f %8.3f %8.3f %8.3f %8.3f\n", i < POWER_MODES ? powerModeNames[i] : "average",
+        p->time, p->mcu / p->time, p->panels / p->time, p->sensor / p->time, (p->mcu + p->panels + p->sensor) / p->time);
+    }
+  }
+}
+
+// TWI ioctls are numbered on some cores and lettered on others
+static uint32_t twiIoctl(void) {
+  if (avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT)) {
+    return AVR_IOCTL_TWI_GETIRQ(0);
+  }
+  return AVR_IOCTL_TWI_GETIRQ('0');
+}
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-s seconds] [-o dir] [-a] firmware.elf [scenario]\n", name);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = 10;
+  int option;
+  while ((option = getopt(argc, argv, "s:o:a")) != -1) {
+    switch (option) {
+    case 's': seconds = atof(optarg); break;
+    case 'o': outputDir = optarg; break;
+    case 'a': printPanels = 1; break;
+    default: usage(argv[0]);
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+  }
+  if (optind + 1 < argc) {
+    readScenario(argv[optind + 1]);
+  }
+
+  elf_firmware_t firmware;
+  memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(argv[optind], &firmware)) {
+    fprintf(stderr, "%s: can't read the firmware\n", argv[optind]);
+    return 1;
+  }
+  if (!firmware.mmcu[0]) {
+    strcpy(firmware.mmcu, DEFAULT_MCU); // Arduino builds have no .mmcu section
+  }
+  if (!firmware.frequency) {
+    firmware.frequency = DEFAULT_FREQUENCY;
+  }
+  avr = avr_make_mcu_by_name(firmware.mmcu);
+  if (!avr) {
+    fprintf(stderr, "simavr doesn't know the %s\n", firmware.mmcu);
+    return 1;
+  }
+  avr_init(avr);
+  avr_load_firmware(avr, &firmware);
+  avr->vcc = avr->avcc = avr->aref = SUPPLY_MV;
+
+  uint32_t twi = twiIoctl();
+  spl06_attach(&sensor, avr, twi, SPL06_ADDRESS);
+  ssd1306_attach(&panels[0], avr, twi, OLED_ADDRESS, "left", PORTD_ADDRESS, 5);
+  ssd1306_attach(&panels[1], avr, twi, OLED_ADDRESS, "right", PORTD_ADDRESS, 7);
+
+  uint32_t flags = 0;
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO; // we pass the bytes through ourselves, unbuffered by line
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uartHook, NULL);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(buzzer.port), buzzer.bit), buzzerHook, NULL);
+
+  // the knobs rest on a detent with the buttons released, like the pull-ups leave them
+  for (int i = 0; i < 2; i++) {
+    setPin(knobs[i].dt, 1);
+    setPin(knobs[i].clk, 1);
+    setPin(knobs[i].button, 1);
+  }
+  setBattery(3.9);
+
+  int state = cpu_Running, next = 0;
+  double lastEnvironment = -1;
+  while (state != cpu_Done && state != cpu_Crashed) {
+    double t = now();
+    if (t >= seconds) {
+      break;
+    }
+    if (t - lastEnvironment >= 0.001) {
+      double pressure, temperature;
+      environment(t, &pressure, &temperature);
+      spl06_set_environment(&sensor, pressure, temperature);
+      updatePanelsMa();
+      lastEnvironment = t;
+    }
+    while (next < eventCount && events[next].time <= t) {
+      event_t *e = &events[next++];
+      switch (e->type) {
+      case PIN: setPin(e->pin, (int)e->value); break;
+      case BATTERY: setBattery(e->value); break;
+      case SNAPSHOT: snapshot(); break;
+      case END: seconds = t; break;
+      }
+    }
+    power_mode_t mode = powerMode();
+    double mcu = mcuMa();
+    state = avr_run(avr);
+    chargePower(mode, mcu, now() - t);
+  }
+
+  double t = now();
+  if (buzzerOnSince >= 0) {
+    buzzerOnTotal += t - buzzerOnSince;
+  }
+  snapshot();
+  fprintf(stderr, "\n%s after %.3f s, %llu cycles at %u Hz\n",
+    state == cpu_Crashed ? "crashed" : "stopped", t, (unsigned long long)avr->cycle, (unsigned)avr->frequency);
+  fprintf(stderr, "SPL06:  %u bus bytes, %u measurements\n", sensor.bytes, sensor.measurements);
+  for (int i = 0; i < 2; i++) {
+    fprintf(stderr, "%-6s  %u bus bytes, %u GDDRAM bytes, %u full windows written\n",
+      panels[i].name, panels[i].bytes, panels[i].dataBytes, panels[i].frames);
+  }
+  fprintf(stderr, "buzzer: %u beeps, on for %.3f s\n", buzzerBeeps, buzzerOnTotal);
+  printPower();
+  avr_terminate(avr);
+  return state == cpu_Crashed;
+}
@@ -0,0 +1,212 @@
+/*
+ * Replays generated flight profiles through AltitudeAlarm on the host and
+ * prints every change of its outputs, one line each:
+ *   <profile> <ms> <mode> <buzzerOn> <flashScreen> <minimumsTriggered> <updateScreen>
+ * The profiles are pseudo-random but fixed by the seed, so two builds of the
+ * alarm can be compared by diffing their output. "make replay-check" does
+ * that against an older AltitudeAlarm from git.
+ *
+ * The profiles lean on the awkward cases: altitudes exactly on a threshold
+ * and a fraction either side of it, selection and minimums changes while
+ * close by, knob activity, the sensor switched off, and the altitude above
+ * cHighestAltitudeAlert. The inputs are fed the way the sketch feeds them,
+ * including what it does to the alarm state when the knobs move.
+ *
+ *   alarm_replay [-p profiles] [-m minutes] [-s seed]
+ *
+ * Build with -DALARM_DOUBLE_ALTITUDE for an AltitudeAlarm that still takes
+ * the true altitude as a double.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "AltitudeAlarm.h"
+
+// from the sketch
+#define MINIMUMS_SILENCED_AUTO_ON_DIFF  100   // cMinimumsSilencedAutoOnAltitudeDiff
+#define MINIMUMS_TRIGGERED_AUTO_OFF     30000 // cMinimumsTriggeredAutoOffTime
+#define LOWEST_SELECT                   -1000 // cLowestAltitudeSelect
+
+static uint32_t seedState;
+
+static uint32_t random32(void) { // xorshift32, the same sequence on every host
+  seedState ^= seedState << 13;
+  seedState ^= seedState >> 17;
+  seedState ^= seedState << 5;
+  return seedState;
+}
+
+static long randomRange(long low, long high) { // inclusive
+  return low + (long)(random32() % (uint32_t)(high - low + 1));
+}
+
+static bool chance(uint32_t oneIn) {
+  return random32() % oneIn == 0;
+}
+
+typedef struct flight_t {
+  double        altitude;          // ft
+  double        verticalSpeed;     // ft per ms
+  long          selected;
+  long          minimums;
+  bool          minimumsOn;
+  bool          minimumsSilenced;
+  SensorMode    sensorMode;
+  unsigned long lastRightRotaryActionTs;
+  unsigned long lastMinimumsAltitudeTs;
+} flight_t;
+
+// a whole-foot altitude the alarm compares against, picked at random
+static long randomThreshold(const flight_t *f) {
+  switch (random32() % 6) {
+    case 0:  return f->selected - cAlarm1000ToGo;
+    case 1:  return f->selected + cAlarm1000ToGo;
+    case 2:  return f->selected - cAlarm200ToGo;
+    case 3:  return f->selected + cAlarm200ToGo;
+    case 4:  return f->minimums;
+    default: return f->selected;
+  }
+}
+
+static void moveAltitude(flight_t *f, unsigned long step) {
+  static const double fractions[] = { 0, 0, 0.5, -0.5, 0.25, -0.25, 0.001, -0.001, 0.999, -0.999 };
+
+  if (chance(200)) { // new climb or descent, up to 3000 fpm
+    f->verticalSpeed = randomRange(-3000, 3000) / 60000.0;
+  }
+  if (chance(40)) { // sitting right on, or just off, a threshold
+    f->altitude = randomThreshold(f) + randomRange(-2, 2) + fractions[random32() % 10];
+  }
+  else {
+    f->altitude += f->verticalSpeed * step + randomRange(-300, 300) / 100.0; // plus sensor noise
+  }
+  if (chance(50000)) { // somewhere else entirely, sometimes too high to alert
+    f->altitude = randomRange(-500, 30000) + randomRange(0, 99) / 100.0;
+  }
+}
+
+static void replayProfile(int profile, unsigned long duration) {
+  AltitudeAlarm alarm;
+  flight_t f = {};
+  f.altitude = randomRange(0, 20000) + randomRange(0, 99) / 100.0;
+  f.selected = f.altitude - fmod(f.altitude, 100) + randomRange(-30, 30) * 100;
+  f.minimums = f.selected - randomRange(0, 20) * 100;
+  f.sensorMode = SensorModeOnShow;
+  f.minimumsSilenced = true;
+
+  int last[5] = { -1, -1, -1, -1, -1 };
+  unsigned long now = 0;
+
+  while (now < duration) {
+    unsigned long step = randomRange(10, 50); // one loop() pass
+    now += step;
+    moveAltitude(&f, step);
+
+    // knobs, as handleRightRotaryMovement, handleLeftRotaryMovement and friends do it
+    if (chance(1500)) { // new selected altitude, often close by
+      long increment = chance(4) ? 20 : 100;
+      f.selected = chance(2) ? lround(f.altitude / increment) * increment + randomRange(-12, 12) * increment
+                             : f.selected + randomRange(-5, 5) * increment;
+      if (f.selected < LOWEST_SELECT) {
+        f.selected = LOWEST_SELECT;
+      }
+      f.lastRightRotaryActionTs = now;
+      alarm.mode = DetermineAlarmState;
+    }
+    if (chance(6000)) { // right knob long press, sync to the current altitude
+      f.selected = lround(f.altitude / 100) * 100;
+      f.lastRightRotaryActionTs = now;
+      alarm.mode = DetermineAlarmState;
+    }
+    if (chance(4000)) { // new minimums altitude
+      f.minimums = chance(2) ? lround(f.altitude / 10) * 10 - randomRange(-20, 40) * 10 : randomRange(0, 200) * 100;
+      f.lastMinimumsAltitudeTs = now;
+      alarm.minimumsTriggered = false;
+      f.minimumsSilenced = f.minimums > f.altitude;
+    }
+    if (chance(5000) && f.sensorMode != SensorModeOff) { // minimums on or off
+      if (f.minimumsOn) {
+        f.minimumsOn = false;
+        f.minimumsSilenced = false;
+      }
+      else {
+        f.minimumsOn = true;
+        alarm.minimumsTriggered = false;
+        f.lastMinimumsAltitudeTs = now;
+        f.minimumsSilenced = f.minimums > f.altitude;
+      }
+    }
+    if (chance(20000)) { // sensor mode
+      f.sensorMode = static_cast<SensorMode>(random32() % cNumberOfSensorModes);
+      if (f.sensorMode == SensorModeOff) {
+        f.minimumsOn = false;
+        f.minimumsSilenced = false;
+        alarm.mode = DetermineAlarmState;
+      }
+    }
+
+    // what loop() and handlePressureSensor() do on their own
+    if (alarm.minimumsTriggered && now - alarm.minimumsTriggeredTs >= MINIMUMS_TRIGGERED_AUTO_OFF) {
+      f.minimumsOn = false;
+    }
+    if (f.minimumsSilenced && f.altitude - f.minimums >= MINIMUMS_SILENCED_AUTO_ON_DIFF) {
+      f.minimumsSilenced = false;
+    }
+
+    // handleBuzzer()
+#ifdef ALARM_DOUBLE_ALTITUDE
+    alarm.trueAltitude = f.altitude;
+#else
+    alarm.trueAltitudeFloor = floor(f.altitude);
+    alarm.trueAltitudeCeil = ceil(f.altitude);
+#endif
+    alarm.selectedAltitude = f.selected;
+    alarm.minimumsAltitude = f.minimums;
+    alarm.minimumsOn = f.minimumsOn;
+    alarm.minimumsSilenced = f.minimumsSilenced;
+    alarm.sensorMode = f.sensorMode;
+    alarm.lastRightRotaryActionTs = f.lastRightRotaryActionTs;
+    alarm.lastMinimumsAltitudeTs = f.lastMinimumsAltitudeTs;
+    alarm.update(now);
+
+    int outputs[5] = { alarm.mode, alarm.buzzerOn, alarm.flashScreen, alarm.minimumsTriggered, alarm.updateScreen };
+    bool changed = false;
+    for (int i = 0; i < 5; i++) {
+      changed |= outputs[i] != last[i];
+      last[i] = outputs[i];
+    }
+    if (changed) {
+      printf("%d %lu %d %d %d %d %d\n", profile, now, outputs[0], outputs[1], outputs[2], outputs[3], outputs[4]);
+    }
+    alarm.updateScreen = false;
+  }
+}
+
+int main(int argc, char **argv) {
+  int profiles = 200;
+  double minutes = 20;
+  uint32_t seed = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:m:s:")) != -1) {
+    switch (opt) {
+      case 'p': profiles = atoi(optarg); break;
+      case 'm': minutes = atof(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-p profiles] [-m minutes] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  for (int profile = 0; profile < profiles; profile++) {
+    seedState = seed * 2654435761u + profile + 1;
+    if (seedState == 0) {
+      seedState = 1;
+    }
+    replayProfile(profile, minutes * 60000);
+  }
+  return 0;
+}
@@ -0,0 +1,344 @@
+/*
+ * Monte Carlo sweep of AltitudeAlarm on the host, spread over every core.
+ *
+ * Each worker takes the next profile number, builds a fresh AltitudeAlarm
+ * for it and flies a randomized profile through it: climbs and descents at
+ * up to 3000 fpm, level-offs, sensor noise of a different size per flight,
+ * an altimeter setting that is dialled in and changed on the way, knob
+ * activity, the sensor switched off, and a millis() that wraps part way
+ * through some flights. The altitude reaches the alarm the way it does in
+ * the sketch: a noisy pressure turned into an altitude with the altimeter
+ * setting applied.
+ *
+ * The same flight without the noise is the reference. For each transition
+ * into an alert the sweep counts:
+ *   false   the alarm went off while the reference was still more than the
+ *           tolerance short of the threshold
+ *   missed  the reference stayed more than the tolerance past the threshold
+ *           for longer than the latency budget and the alarm did not go off
+ * and it reports how many simulated flight-hours it got through a second.
+ *
+ *   alarm_sweep [-p profiles] [-m minutes] [-s seed] [-j threads] [-t tolerance] [-l latency ms]
+ *
+ * The profiles only depend on the seed and the profile number, so the
+ * counts are the same for any number of threads.
+ */
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "AltitudeAlarm.h"
+
+// from the sketch
+#define MINIMUMS_TRIGGERED_AUTO_OFF     30000 // cMinimumsTriggeredAutoOffTime
+#define SEA_LEVEL_PRESSURE_HPA          1013.25 // cSeaLevelPressureHPa
+
+enum Transition {
+  Climbing1000ToLong, Descending1000ToLong, Climbing200ToUrgent, Descending200ToUrgent,
+  DeviateToUrgent, ToMinimums, cNumberOfTransitions };
+
+static const char *const transitionNames[cNumberOfTransitions] = {
+  "Climbing1000ToGo -> LongAlarm",
+  "Descending1000ToGo -> LongAlarm",
+  "Climbing200ToGo -> UrgentAlarm",
+  "Descending200ToGo -> UrgentAlarm",
+  "AltitudeDeviate -> UrgentAlarm",
+  "* -> MinimumsAlarm",
+};
+
+struct Counts {
+  unsigned long alerts[cNumberOfTransitions];
+  unsigned long falseAlerts[cNumberOfTransitions];
+  unsigned long missed[cNumberOfTransitions];
+  double        flightMs;
+};
+
+struct Options {
+  int      profiles;
+  double   minutes;
+  uint32_t seed;
+  double   tolerance;      // altitude units
+  unsigned long latency;   // ms
+};
+
+// xorshift32, one per flight so the threads never share one
+struct Random {
+  uint32_t state;
+
+  uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+  long range(long low, long high) { // inclusive
+    return low + (long)(next() % (uint32_t)(high - low + 1));
+  }
+  bool chance(uint32_t oneIn) {
+    return next() % oneIn == 0;
+  }
+  double uniform() { // (0, 1]
+    return (next() + 1.0) / 4294967296.0;
+  }
+  double gaussian() { // Box-Muller, one of the pair is plenty
+    return sqrt(-2.0 * log(uniform())) * cos(2 * M_PI * uniform());
+  }
+};
+
+// what altitudeCorrected() in the sketch takes off for an altimeter setting
+static double altimeterCorrection(int altimeterSetting) {
+  return (1 - pow(altimeterSetting / cAltimeterSettingStandardDouble, 0.190284)) * cAltimeterCorrectionScale;
+}
+
+// the sketch's pressureAltitude() and altitudeCorrected()
+static double altitudeFromPressure(double pressure, double correction) {
+  return cPressureAltitudeScale * (1.0 - pow(pressure / SEA_LEVEL_PRESSURE_HPA, 0.1903)) - correction;
+}
+
+// and back, for the pressure the sensor sees at an indicated altitude
+static double pressureFromAltitude(double altitude, double correction) {
+  return SEA_LEVEL_PRESSURE_HPA * pow(1.0 - (altitude + correction) / cPressureAltitudeScale, 1 / 0.1903);
+}
+
+// one transition into an alert being watched for: the mode it leaves, the
+// threshold and which side of it sets it off
+struct Watch {
+  BuzzAlarmMode from;
+  bool          below;        // goes off at or below the threshold, instead of at or above
+  long          threshold;
+  unsigned long pastSinceTs;  // when the reference went past the threshold, 0 while it hasn't
+  bool          counted;      // this stretch past the threshold is already counted as missed
+};
+
+static void flyProfile(const Options &options, int profile, Counts &counts) {
+  Random random;
+  random.state = options.seed * 2654435761u + profile + 1;
+  if (random.state == 0) {
+    random.state = 1;
+  }
+
+  AltitudeAlarm alarm;
+  unsigned long duration = options.minutes * 60000;
+  unsigned long start = random.chance(4) ? 0xFFFFFFFFul - random.range(0, duration) : 0; // millis() wraps during a quarter of the flights
+  unsigned long now = start;
+  double altitude = random.range(0, cHighestAltitudeAlert);  // the reference, indicated altitude without the noise
+  double verticalSpeed = 0;                                  // per ms
+  double noise = random.range(5, 50) / 100.0 * cAlarm200ToGo / 20; // pressure noise, as an altitude, 0.5 to 5 ft
+  long increment = cAltitudeSelectIncrement;
+  long selected = lround(altitude / increment) * increment + random.range(-30, 30) * increment;
+  long minimums = selected - random.range(0, 20) * increment;
+  int altimeterSetting = random.range((cAltimeterSettingMin + 3 * cAltimeterSettingStandard) / 4, (cAltimeterSettingMax + 3 * cAltimeterSettingStandard) / 4);
+  double correction = altimeterCorrection(altimeterSetting);
+  bool minimumsOn = random.chance(2);
+  bool minimumsSilenced = minimums > altitude;
+  SensorMode sensorMode = SensorModeOnShow;
+  unsigned long lastRightRotaryActionTs = start;
+  unsigned long lastMinimumsAltitudeTs = start;
+  BuzzAlarmMode lastMode = alarm.mode;
+
+  Watch watches[cNumberOfTransitions] = {
+    { Climbing1000ToGo,   false, 0, 0, false },
+    { Descending1000ToGo, true,  0, 0, false },
+    { Climbing200ToGo,    false, 0, 0, false },
+    { Descending200ToGo,  true,  0, 0, false },
+    { AltitudeDeviate,    false, 0, 0, false }, // either side, see the thresholds below
+    { AlarmDisabled,      true,  0, 0, false }, // minimums, armed from any mode
+  };
+
+  while (now - start < duration) {
+    unsigned long step = random.range(10, 50); // one loop() pass
+    now += step;
+
+    // the flight
+    if (random.chance(300)) { // new climb, descent or level-off
+      verticalSpeed = random.chance(3) ? 0 : random.range(-3000, 3000) * (cAlarm1000ToGo / 1000.0) / 60000.0;
+    }
+    altitude += verticalSpeed * step;
+    if (altitude > cHighestAltitudeAlert + 2 * cAlarm1000ToGo || altitude < cLowestAltitudeSelect) {
+      verticalSpeed = -verticalSpeed;
+    }
+
+    // knobs, as the sketch handles them
+    if (random.chance(2000)) { // new selected altitude, often close by
+      long knobStep = random.chance(4) ? cAltitudeFineSelectIncrement : increment;
+      selected = random.chance(2) ? lround(altitude / knobStep) * knobStep + random.range(-12, 12) * knobStep
+                                  : selected + random.range(-5, 5) * knobStep;
+      if (selected < cLowestAltitudeSelect) {
+        selected = cLowestAltitudeSelect;
+      }
+      lastRightRotaryActionTs = now;
+      alarm.mode = DetermineAlarmState;
+    }
+    if (random.chance(8000)) { // new altimeter setting, the reference moves with it
+      int newSetting = altimeterSetting + random.range(-30, 30) * cAltimeterSettingInterval;
+      if (newSetting >= cAltimeterSettingMin && newSetting <= cAltimeterSettingMax) {
+        double newCorrection = altimeterCorrection(newSetting);
+        altitude = altitudeFromPressure(pressureFromAltitude(altitude, correction), newCorrection);
+        altimeterSetting = newSetting;
+        correction = newCorrection;
+      }
+    }
+    if (random.chance(5000)) { // new minimums altitude
+      minimums = lround(altitude / cMinimumsSelectIncrement) * cMinimumsSelectIncrement - random.range(-20, 40) * cMinimumsSelectIncrement;
+      lastMinimumsAltitudeTs = now;
+      alarm.minimumsTriggered = false;
+      minimumsSilenced = minimums > altitude;
+    }
+    if (random.chance(6000) && sensorMode != SensorModeOff) { // minimums on or off
+      minimumsOn = !minimumsOn;
+      if (minimumsOn) {
+        alarm.minimumsTriggered = false;
+        lastMinimumsAltitudeTs = now;
+        minimumsSilenced = minimums > altitude;
+      }
+      else {
+        minimumsSilenced = false;
+      }
+    }
+    if (random.chance(30000)) { // sensor mode
+      sensorMode = static_cast<SensorMode>(random.next() % cNumberOfSensorModes);
+      if (sensorMode == SensorModeOff) {
+        minimumsOn = false;
+        minimumsSilenced = false;
+        alarm.mode = DetermineAlarmState;
+      }
+    }
+
+    // what the sensor reports, and what loop() and handlePressureSensor() do with it
+    double measured = altitudeFromPressure(pressureFromAltitude(altitude + noise * random.gaussian(), correction), correction);
+    if (alarm.minimumsTriggered && now - alarm.minimumsTriggeredTs >= MINIMUMS_TRIGGERED_AUTO_OFF) {
+      minimumsOn = false;
+    }
+    if (minimumsSilenced && measured - minimums >= cMinimumsSilencedAutoOnAltitudeDiff) {
+      minimumsSilenced = false;
+    }
+
+    // handleBuzzer()
+    bool minimumsArmed = sensorMode != SensorModeOff && minimumsOn && !minimumsSilenced && !alarm.minimumsTriggered
+      && now - lastMinimumsAltitudeTs >= cDisableAlarmKnobMovementTime;
+    alarm.trueAltitudeFloor = floor(measured);
+    alarm.trueAltitudeCeil = ceil(measured);
+    alarm.selectedAltitude = selected;
+    alarm.minimumsAltitude = minimums;
+    alarm.minimumsOn = minimumsOn;
+    alarm.minimumsSilenced = minimumsSilenced;
+    alarm.sensorMode = sensorMode;
+    alarm.lastRightRotaryActionTs = lastRightRotaryActionTs;
+    alarm.lastMinimumsAltitudeTs = lastMinimumsAltitudeTs;
+    alarm.update(now);
+    alarm.updateScreen = false;
+
+    // the thresholds each watch mode is waiting for
+    watches[Climbing1000ToLong].threshold = selected - cAlarm1000ToGo;
+    watches[Descending1000ToLong].threshold = selected + cAlarm1000ToGo;
+    watches[Climbing200ToUrgent].threshold = selected - cAlarm200ToGo;
+    watches[Descending200ToUrgent].threshold = selected + cAlarm200ToGo;
+    watches[DeviateToUrgent].threshold = selected + cAlarm200ToGo; // the side the reference is on
+    watches[DeviateToUrgent].below = altitude < selected;
+    if (watches[DeviateToUrgent].below) {
+      watches[DeviateToUrgent].threshold = selected - cAlarm200ToGo;
+    }
+    watches[ToMinimums].threshold = minimums;
+
+    for (int t = 0; t < cNumberOfTransitions; t++) {
+      Watch &watch = watches[t];
+      double distance = watch.below ? watch.threshold - altitude : altitude - watch.threshold; // how far past it the reference is
+      bool alerted, waiting;
+      if (t == ToMinimums) {
+        alerted = alarm.mode == MinimumsAlarm && lastMode != MinimumsAlarm;
+        waiting = minimumsArmed && !alarm.minimumsTriggered;
+      }
+      else {
+        BuzzAlarmMode alert = watch.from == Climbing1000ToGo || watch.from == Descending1000ToGo ? LongAlarm : UrgentAlarm;
+        alerted = lastMode == watch.from && alarm.mode == alert;
+        waiting = lastMode == watch.from && alarm.mode == watch.from;
+      }
+
+      if (alerted) {
+        counts.alerts[t]++;
+        if (distance < -options.tolerance) {
+          counts.falseAlerts[t]++;
+        }
+      }
+      if (!waiting || distance <= options.tolerance) {
+        watch.pastSinceTs = 0;
+        watch.counted = false;
+      }
+      else if (!watch.pastSinceTs) {
+        watch.pastSinceTs = now | 1;
+      }
+      else if (!watch.counted && now - watch.pastSinceTs >= options.latency) {
+        counts.missed[t]++;
+        watch.counted = true;
+      }
+    }
+    lastMode = alarm.mode;
+  }
+  counts.flightMs += duration;
+}
+
+static void worker(const Options &options, std::atomic<int> &nextProfile, Counts &counts) {
+  for (int profile = nextProfile++; profile < options.profiles; profile = nextProfile++) {
+    flyProfile(options, profile, counts);
+  }
+}
+
+int main(int argc, char **argv) {
+  Options options = { 2000, 60, 1, cAlarm200ToGo / 10.0, 500 };
+  int threads = std::thread::hardware_concurrency();
+  int opt;
+
+  while ((opt = getopt(argc, argv, "p:m:s:j:t:l:")) != -1) {
+    switch (opt) {
+      case 'p': options.profiles = atoi(optarg); break;
+      case 'm': options.minutes = atof(optarg); break;
+      case 's': options.seed = strtoul(optarg, NULL, 0); break;
+      case 'j': threads = atoi(optarg); break;
+      case 't': options.tolerance = atof(optarg); break;
+      case 'l': options.latency = strtoul(optarg, NULL, 0); break;
+      default:
+        fprintf(stderr, "usage: %s [-p profiles] [-m minutes] [-s seed] [-j threads] [-t tolerance] [-l latency ms]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  std::vector<Counts> counts(threads, Counts());
+  std::vector<std::thread> workers;
+  std::atomic<int> nextProfile(0);
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+  for (int i = 0; i < threads; i++) {
+    workers.push_back(std::thread(worker, std::cref(options), std::ref(nextProfile), std::ref(counts[i])));
+  }
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  Counts total = Counts();
+  for (size_t i = 0; i < counts.size(); i++) {
+    for (int t = 0; t < cNumberOfTransitions; t++) {
+      total.alerts[t] += counts[i].alerts[t];
+      total.falseAlerts[t] += counts[i].falseAlerts[t];
+      total.missed[t] += counts[i].missed[t];
+    }
+    total.flightMs += counts[i].flightMs;
+  }
+
+  printf("%-34s %10s %8s %8s\n", "transition", "alerts", "false", "missed");
+  for (int t = 0; t < cNumberOfTransitions; t++) {
+    printf("%-34s %10lu %8lu %8lu\n", transitionNames[t], total.alerts[t], total.falseAlerts[t], total.missed[t]);
+  }
+  double hours = total.flightMs / 3600000.0;
+  printf("%d profiles, %.0f flight-hours in %.2f s on %d threads: %.0f flight-hours/s\n",
+         options.profiles, hours, seconds, threads, hours / seconds);
+  printf("tolerance %g " cAltitudeLabel ", latency budget %lu ms\n", options.tolerance, options.latency);
+  return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * The battery readings against the discharge curve the sketch used to
+ * interpolate, on the host.
+ *
+ * The real Battery.cpp runs against an ADC that hands back the test's own
+ * conversions, through the stand-ins in host/. Every code from 0 to 1023
+ * goes through readBatteryAdc() and batteryLevelFromAdc(), the path
+ * getBatteryLevel() takes, and has to come out at the percentage and the
+ * charging state the sketch worked out in floating point before
+ * BatteryTable.h. Then noisy bursts, with the CPU woken early now and
+ * then, have to come out at the mean of the conversions they took, and
+ * leave the ADC interrupt off.
+ *
+ *   battery_check [-n bursts] [-s seed]
+ */
+#include <unistd.h>
+#include <avr/sleep.h>
+#include "Battery.h"
+
+// from the sketch
+#define cBatteryVoltagePin A0
+
+#define ADC_CODES 1024
+
+// the sketch's getBatteryLevel() before BatteryTable.h
+#define CAPACITY_LENGTH   21
+#define CAPACITY_INTERVAL 5
+static const double capacity[2][CAPACITY_LENGTH] = {
+  { 2.40, 3.41, 3.48, 3.54, 3.58, 3.62, 3.67, 3.71, 3.76, 3.79, 3.82, 3.84, 3.87, 3.91, 3.94, 3.98, 4.01, 4.03, 4.06, 4.09, 4.15 },
+  { 0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 70, 75, 80, 85, 90, 95, 100 } };
+
+static int baselineLevel(int adc, bool *charging) {
+  double voltage = (double)adc / 1024 * 3.3 * 1.3333;
+  int level = 0;
+  *charging = voltage > 4.16;
+  for (int i = 0; i < CAPACITY_LENGTH; i++) {
+    if (voltage <= capacity[0][i]) {
+      if (i == 0) {
+        level = capacity[1][0];
+        break;
+      }
+      double interpolation = (voltage - capacity[0][i - 1]) / (capacity[0][i] - capacity[0][i - 1]);
+      level = capacity[1][i - 1] + interpolation * CAPACITY_INTERVAL;
+      break;
+    }
+    else if (i == CAPACITY_LENGTH - 1) {
+      level = capacity[1][CAPACITY_LENGTH - 1];
+    }
+  }
+  return level;
+}
+
+static uint32_t seed = 1;
+static unsigned failed;
+static int      conversions[cBatteryOversampleCount]; // what the burst's conversions come out at
+static unsigned converted;
+static unsigned analogReads;
+static unsigned earlyWakes;
+static unsigned wakeChance;                            // 1 in this many sleeps end early, 0 for none
+
+static uint32_t random32(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static unsigned randomBelow(unsigned n) {
+  return random32() % n;
+}
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failed++;
+  }
+}
+
+// the conversion readBatteryAdc() throws away, never one of the burst's
+static int analogReadThrownAway(uint8_t pin) {
+  analogReads++;
+  expect(pin == cBatteryVoltagePin, "analogRead() of the battery pin");
+  return ADC_CODES - 1 - conversions[0];
+}
+
+// sleeping in ADC noise reduction mode starts a conversion. The CPU wakes
+// when it's done if the ADC interrupt is on, or early for another interrupt
+static void sleepConverting(uint8_t mode) {
+  if (mode != SLEEP_MODE_ADC) {
+    expect(false, "asleep in ADC noise reduction mode");
+    return;
+  }
+  ADCSRA |= _BV(ADSC);
+  if (wakeChance && !randomBelow(wakeChance)) {
+    earlyWakes++;
+    return;
+  }
+  if (!(ADCSRA & _BV(ADIE)) || converted >= cBatteryOversampleCount) {
+    expect(false, "the ADC interrupt on for the burst's conversions, and no more of them");
+    ADCSRA &= ~_BV(ADSC);
+    return;
+  }
+  ADC = conversions[converted++];
+  ADCSRA &= ~_BV(ADSC);
+}
+
+static int burst(void) {
+  converted = 0;
+  analogReads = 0;
+  int adc = readBatteryAdc(cBatteryVoltagePin);
+  expect(converted == cBatteryOversampleCount && analogReads == 1,
+    "one thrown-away analogRead() and cBatteryOversampleCount conversions per burst");
+  expect(!(ADCSRA & _BV(ADIE)), "the ADC interrupt off after a burst");
+  return adc;
+}
+
+// every code, steady, against the old floating-point curve
+static void checkCurve(void) {
+  unsigned levelMismatches = 0, chargingMismatches = 0;
+  for (int code = 0; code < ADC_CODES; code++) {
+    for (int &conversion : conversions) {
+      conversion = code;
+    }
+    int adc = burst();
+    bool charging;
+    int level = baselineLevel(code, &charging);
+    if (adc != code || batteryLevelFromAdc(adc) != level) {
+      if (!levelMismatches++) {
+        printf("ADC %d: read %d, %u%% where the curve gives %d%%\n", code, adc, batteryLevelFromAdc(adc), level);
+      }
+    }
+    if (batteryChargingFromAdc(adc) != charging) {
+      if (!chargingMismatches++) {
+        printf("ADC %d: %scharging where the curve has it %scharging\n", code,
+          batteryChargingFromAdc(adc) ? "" : "not ", charging ? "" : "not ");
+      }
+    }
+  }
+  expect(!levelMismatches, "every ADC code at the curve's percentage");
+  expect(!chargingMismatches, "every ADC code at the curve's charging state");
+  printf("%d ADC codes: %u off the curve's percentage, %u off its charging state\n",
+    ADC_CODES, levelMismatches, chargingMismatches);
+}
+
+// noisy bursts, woken early now and then, come out at the mean of their conversions
+static void checkBursts(unsigned bursts) {
+  unsigned wrong = 0;
+  wakeChance = 3;
+  earlyWakes = 0;
+  for (unsigned n = 0; n < bursts; n++) {
+    int centre = randomBelow(ADC_CODES);
+    int sum = 0;
+    for (int &conversion : conversions) {
+      int noisy = centre + (int)randomBelow(9) - 4; // constrain() evaluates its argument more than once
+      conversion = constrain(noisy, 0, ADC_CODES - 1);
+      sum += conversion;
+    }
+    int adc = burst();
+    bool charging;
+    if (adc != sum / cBatteryOversampleCount || batteryLevelFromAdc(adc) != baselineLevel(adc, &charging)) {
+      if (!wrong++) {
+        printf("a burst around ADC %d read %d, not %d\n", centre, adc, sum / cBatteryOversampleCount);
+      }
+    }
+  }
+  wakeChance = 0;
+  expect(!wrong, "every noisy burst at the mean of its conversions");
+  printf("%u noisy bursts, %u early wakes: %u off the mean\n", bursts, earlyWakes, wrong);
+}
+
+int main(int argc, char **argv) {
+  unsigned bursts = 5000;
+  int option;
+  while ((option = getopt(argc, argv, "n:s:")) != -1) {
+    switch (option) {
+      case 'n': bursts = atoi(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-n bursts] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  hostAnalogRead = analogReadThrownAway;
+  hostSleep = sleepConverting;
+  checkCurve();
+  checkBursts(bursts);
+  if (failed) {
+    printf("%u checks failed\n", failed);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * The pure-arithmetic benchmarks from the sketch's BENCHMARK build, timed
+ * on the host.
+ *
+ * pressureAltitude(), displayNumber() and roundNumber() are built from the
+ * sketch's own Numbers.cpp and called with the same fixed inputs as
+ * runBenchmarks() gives them. Each one runs a number of times in a row,
+ * the fastest of several such runs counts, and the fastest of as many runs
+ * of an empty function, timed in between, is taken off. The results go out
+ * as the lines Benchmark.cpp prints, at a clock of 1GHz so the cycles are
+ * nanoseconds, for scripts/bench.py to compare with bench_baseline.json:
+ *   make bench-host
+ *   make bench-host-baseline
+ *
+ * Host nanoseconds say nothing about AVR cycles, and on a shared machine
+ * a whole run can come out 1.5 times slower than the one before, every
+ * benchmark at once, hence the wide threshold. They catch a change that makes the arithmetic itself a lot
+ * slower, quickly and without the device; the cycle counts from the
+ * device are the ones to trust.
+ *
+ *   bench_host [-n iterations] [-r runs]
+ */
+#include <unistd.h>
+#include <time.h>
+#include "Numbers.h"
+#include "Units.h"
+
+#define HOST_CLOCK 1000000000 // one cycle per nanosecond, see scripts/bench.py
+
+typedef void (*BenchFunction)();
+
+// inputs and results, so the compiler can neither fold nor drop the work
+static volatile double gBenchInputDouble = 1000.0;
+static volatile long   gBenchInputLong = 12345;
+static volatile double gBenchDouble;
+static volatile long   gBenchLong;
+static char* volatile  gBenchText;
+
+static unsigned iterations = 200000;
+static unsigned runs = 15;
+
+// as runBenchmarks() in the sketch calls them
+static void benchPressureAltitude() {
+  gBenchDouble = pressureAltitude(gBenchInputDouble);
+}
+
+static void benchDisplayNumber() {
+  long number = -gBenchInputLong;
+  gBenchText = displayNumber(number, true);
+}
+
+static void benchRoundNumberLong() {
+  long number = gBenchInputLong;
+  gBenchLong = roundNumber(number, cAltitudeSelectIncrement);
+}
+
+static void benchRoundNumberDouble() {
+  double number = gBenchInputLong + 0.6;
+  gBenchLong = roundNumber(number, cAltitudeSelectIncrement);
+}
+
+static void benchNothing() {
+}
+
+static uint64_t nowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t timed(BenchFunction volatile &call) {
+  uint64_t start = nowNs();
+  for (unsigned i = 0; i < iterations; i++) {
+    call(); // through a pointer every time, like benchmark()
+  }
+  return nowNs() - start;
+}
+
+// the fastest of the runs, in nanoseconds for all the iterations, less the
+// fastest of as many runs of an empty function taken in between them, so
+// both see the host in the same state
+static void benchmark(const char *name, BenchFunction run) {
+  BenchFunction volatile call = run;
+  BenchFunction volatile nothing = benchNothing;
+  uint64_t best = UINT64_MAX, overhead = UINT64_MAX;
+  for (unsigned r = 0; r < runs; r++) {
+    overhead = min(overhead, timed(nothing));
+    best = min(best, timed(call));
+  }
+  printf("BENCH %s %u %llu 0\n", name, iterations, (unsigned long long)(best > overhead ? best - overhead : 0));
+}
+
+int main(int argc, char **argv) {
+  int option;
+  while ((option = getopt(argc, argv, "n:r:")) != -1) {
+    switch (option) {
+      case 'n': iterations = atoi(optarg); break;
+      case 'r': runs = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-n iterations] [-r runs]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (!iterations || !runs) {
+    fprintf(stderr, "%s: at least one iteration and one run\n", argv[0]);
+    return 2;
+  }
+
+  printf("BENCH-BEGIN %u\n", HOST_CLOCK);
+  benchmark("pressureAltitude", benchPressureAltitude);
+  benchmark("displayNumber", benchDisplayNumber);
+  benchmark("roundNumber(long)", benchRoundNumberLong);
+  benchmark("roundNumber(double)", benchRoundNumberDouble);
+  printf("BENCH-END\n");
+  return 0;
+}
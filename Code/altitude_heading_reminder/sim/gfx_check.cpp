@@ -0,0 +1,179 @@
+/*
+ * Custom_SSD1306's byte-wise fills against drawPixel(), on the host.
+ *
+ * fillRect(), writeFillRect(), drawFastVLine() and writeFastVLine() write
+ * whole buffer bytes at a time. Each is run on random rectangles, clipped
+ * and not, in all three colors and at all four rotations, on a buffer of
+ * random pixels, and the buffer has to come out exactly as drawing the
+ * same pixels one drawPixel() at a time leaves it.
+ *
+ * Then it times each primitive against the per-pixel way. These are host
+ * nanoseconds, good for comparing one against the other; the cycle counts
+ * on the ATmega328 come from the BENCHMARK build, see Benchmark.h.
+ *
+ *   gfx_check [-n rectangles] [-s seed]
+ */
+#include <chrono>
+#include <unistd.h>
+#include <Custom_SSD1306.h>
+
+#define WIDTH  128
+#define HEIGHT 32
+
+typedef Custom_SSD1306_Static<WIDTH, HEIGHT> Oled;
+
+enum Primitive { FillRect, WriteFillRect, DrawFastVLine, WriteFastVLine, cNumberOfPrimitives };
+
+static const char *const primitiveNames[cNumberOfPrimitives] = {
+  "fillRect", "writeFillRect", "drawFastVLine", "writeFastVLine" };
+
+static Oled fast, reference;
+static uint32_t seed = 1;
+
+// xorshift, so every run with the same seed does the same
+static uint32_t random32(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static int16_t randomRange(int16_t low, int16_t high) {
+  return low + (int16_t)(random32() % (uint32_t)(high - low + 1));
+}
+
+static void draw(Oled &oled, Primitive primitive, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  switch (primitive) {
+    case FillRect:       oled.fillRect(x, y, w, h, color); break;
+    case WriteFillRect:  oled.writeFillRect(x, y, w, h, color); break;
+    case DrawFastVLine:  oled.drawFastVLine(x, y, h, color); break;
+    case WriteFastVLine: oled.writeFastVLine(x, y, h, color); break;
+    default: break;
+  }
+}
+
+// what the primitive means, one pixel at a time. drawPixel() clips
+static void drawPixels(Oled &oled, Primitive primitive, int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (primitive == DrawFastVLine || primitive == WriteFastVLine) {
+    w = 1;
+  }
+  for (int16_t i = x; i < x + w; i++) {
+    for (int16_t j = y; j < y + h; j++) {
+      oled.drawPixel(i, j, color);
+    }
+  }
+}
+
+// a rectangle anywhere from fully inside the rotated screen to hanging off
+// every edge of it, now and then empty
+static void randomRect(Oled &oled, int16_t *x, int16_t *y, int16_t *w, int16_t *h) {
+  int16_t width = oled.width(), height = oled.height();
+  *x = randomRange(-8, width + 4);
+  *y = randomRange(-8, height + 4);
+  *w = randomRange(random32() % 16 ? 1 : -2, width + 8);
+  *h = randomRange(random32() % 16 ? 1 : -2, height + 8);
+}
+
+static bool check(unsigned rectangles) {
+  unsigned failed = 0;
+  for (unsigned n = 0; n < rectangles; n++) {
+    Primitive primitive = (Primitive)(n % cNumberOfPrimitives);
+    uint8_t rotation = (n / cNumberOfPrimitives) % 4;
+    uint16_t color = random32() % 3;
+    fast.setRotation(rotation);
+    reference.setRotation(rotation);
+    for (int i = 0; i < WIDTH * HEIGHT / 8; i++) {
+      fast.getBuffer()[i] = reference.getBuffer()[i] = random32();
+    }
+
+    int16_t x, y, w, h;
+    randomRect(fast, &x, &y, &w, &h);
+    draw(fast, primitive, x, y, w, h, color);
+    drawPixels(reference, primitive, x, y, w, h, color);
+    if (memcmp(fast.getBuffer(), reference.getBuffer(), WIDTH * HEIGHT / 8)) {
+      if (failed++ < 10) {
+        printf("%s(%d, %d, %d, %d, color %u) at rotation %u differs from drawPixel()\n",
+          primitiveNames[primitive], x, y, primitive >= DrawFastVLine ? 1 : w, h, color, rotation);
+      }
+    }
+  }
+  fast.setRotation(0);
+  reference.setRotation(0);
+  if (failed) {
+    printf("%u of %u rectangles differ\n", failed, rectangles);
+    return false;
+  }
+  printf("%u rectangles at 4 rotations, every buffer identical to drawPixel()\n", rectangles);
+  return true;
+}
+
+struct Case {
+  const char *name;
+  Primitive   primitive;
+  uint8_t     rotation;
+  int16_t     x, y, w, h;
+};
+
+// the benchmarks in the sketch's runBenchmarks(), and a few more sizes
+static const Case cases[] = {
+  { "fillRect(8x8)",               FillRect,      0, 61, 13,   8,  8 },
+  { "fillRect(8x8, rotated)",      FillRect,      1, 13, 61,   8,  8 },
+  { "fillRect(18x24)",             FillRect,      0, 10,  4,  18, 24 },
+  { "fillRect(128x32)",            FillRect,      0,  0,  0, 128, 32 },
+  { "fillRect(32x128, rotated)",   FillRect,      1,  0,  0,  32, 128 },
+  { "drawFastVLine(h 20)",         DrawFastVLine, 0, 64,  5,   1, 20 },
+  { "drawFastVLine(h 20, rotated)",DrawFastVLine, 1, 16, 54,   1, 20 },
+  { "drawFastVLine(h 128, rotated)",DrawFastVLine, 3, 9,  0,   1, 128 },
+};
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+// nanoseconds a call, over enough calls to take a few milliseconds
+static double timeCalls(const Case &c, bool perPixel) {
+  typedef std::chrono::steady_clock Clock;
+  Oled &oled = perPixel ? reference : fast;
+  oled.setRotation(c.rotation);
+  unsigned calls = 0;
+  Clock::time_point start = Clock::now(), end;
+  do {
+    for (int i = 0; i < 100; i++) {
+      if (perPixel) {
+        drawPixels(oled, c.primitive, c.x, c.y, c.w, c.h, SSD1306_INVERSE);
+      }
+      else {
+        draw(oled, c.primitive, c.x, c.y, c.w, c.h, SSD1306_INVERSE);
+      }
+    }
+    calls += 100;
+    end = Clock::now();
+  } while (end - start < std::chrono::milliseconds(20));
+  oled.setRotation(0);
+  return std::chrono::duration<double, std::nano>(end - start).count() / calls;
+}
+
+static void benchmark(void) {
+  printf("\n%-32s %10s %12s %8s\n", "host ns per call", "byte-wise", "drawPixel()", "speedup");
+  for (unsigned i = 0; i < CASES; i++) {
+    double bytes = timeCalls(cases[i], false), pixels = timeCalls(cases[i], true);
+    printf("%-32s %10.1f %12.1f %7.1fx\n", cases[i].name, bytes, pixels, pixels / bytes);
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned rectangles = 200000;
+  int option;
+  while ((option = getopt(argc, argv, "n:s:")) != -1) {
+    switch (option) {
+      case 'n': rectangles = atoi(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-n rectangles] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if (!check(rectangles)) {
+    return 1;
+  }
+  benchmark();
+  return 0;
+}
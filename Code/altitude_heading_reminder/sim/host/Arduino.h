@@ -0,0 +1,159 @@
+/*
+ * Just enough of the Arduino core, and of the AVR registers the libraries
+ * touch, to build Custom_TWI, Custom_GFX, Custom_SSD1306, the SPL06 driver
+ * and the sketch's widget layer on the host for the tests in sim/.
+ *
+ * Time is simulated. It only moves when the code under test asks for it
+ * (millis(), micros(), the delays) or when a test calls hostAdvance(), so
+ * every wait and timeout plays out the same on every run. The TWI
+ * registers are backed by the bus model in twi_model.cpp, and SREG's
+ * interrupt flag decides when its interrupt is delivered. The ADC has no
+ * model of its own; a test supplies its conversions, see analogRead() and
+ * avr/sleep.h. Nor does SRAM: MemoryMonitor's heap and stack live in
+ * hostSram, laid out by the test, see SP.
+ */
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000UL
+#endif
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH         1
+#define LOW          0
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+#define SDA          18
+#define SCL          19
+#define A0           14
+
+// flash is ordinary memory on the host
+#define PROGMEM
+#define PGM_P                  const char *
+#define PSTR(s)                (s)
+#define pgm_read_byte(addr) (*(const unsigned char *)(addr))
+#define pgm_read_word(addr) (*(const unsigned short *)(addr))
+#define memcpy_P               memcpy
+#define strlen_P               strlen
+#define strcpy_P               strcpy
+#define strncpy_P              strncpy
+#define sprintf_P              sprintf
+#define snprintf_P             snprintf
+class __FlashStringHelper;
+#define F(s)                   ((const __FlashStringHelper *)(s))
+
+#define _BV(b)                 (1 << (b))
+#define bit(b)                 (1UL << (b))
+#define bit_is_set(r, b)       ((r) & _BV(b))
+#define constrain(a, low, high) ((a) < (low) ? (low) : ((a) > (high) ? (high) : (a)))
+
+template <class T, class U> static inline T min(T a, U b) { return a < b ? a : (T)b; }
+template <class T, class U> static inline T max(T a, U b) { return a > b ? a : (T)b; }
+
+// time
+unsigned long millis(void);
+unsigned long micros(void);
+void          delay(unsigned long ms);
+void          delayMicroseconds(unsigned int us);
+void          hostAdvance(uint32_t us);       // let simulated time pass
+uint64_t      hostTime(void);                 // microseconds since the start, never wraps
+extern uint32_t hostCallUs;                   // what each millis()/micros() call costs, so polling loops move time on
+
+// A peripheral model with things to do at set times. hostAdvance() runs it
+// at each of them in turn, delivering interrupts in between
+struct HostModel {
+  virtual ~HostModel() {}
+  virtual uint64_t nextEvent(void) = 0;       // UINT64_MAX for nothing planned
+  virtual void     run(uint64_t now) = 0;     // do whatever is due by now
+};
+extern HostModel *hostModel;
+
+// pins. A model can take over what a pin reads, see hostPinRead
+void    pinMode(uint8_t pin, uint8_t mode);
+void    digitalWrite(uint8_t pin, uint8_t level);
+int     digitalRead(uint8_t pin);
+extern uint8_t hostPinLevel[32];              // last level written
+extern uint8_t hostPinMode[32];
+extern int (*hostPinRead)(uint8_t pin);       // NULL reads back hostPinLevel
+extern void (*hostPinChanged)(uint8_t pin);   // called after every pinMode()/digitalWrite()
+
+// An 8-bit I/O register. Plain ones just hold their value; a model can
+// watch writes to one through written
+struct HostRegister {
+  uint8_t value;
+  void  (*written)(HostRegister &reg, uint8_t value);
+
+  operator uint8_t() const { return value; }
+  HostRegister &operator=(uint8_t v) {
+    if (written) {
+      written(*this, v);
+    }
+    else {
+      value = v;
+    }
+    return *this;
+  }
+  HostRegister &operator=(const HostRegister &other) { return *this = other.value; }
+  // wide like the AVR's own compound assignments, so ~bit(n) masks don't overflow
+  HostRegister &operator|=(unsigned long v) { return *this = value | v; }
+  HostRegister &operator&=(unsigned long v) { return *this = value & v; }
+};
+
+extern HostRegister SREG, TWCR, TWSR, TWDR, TWBR, TWAR, ADCSRA;
+extern uint16_t     ADC;                      // the last conversion's result
+
+// TWCR bits
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+
+// ADCSRA bits
+#define ADEN  7
+#define ADSC  6
+#define ADIE  3
+
+// analog input. A conversion reads hostAnalogRead, 0 when it is NULL
+int     analogRead(uint8_t pin);
+extern int (*hostAnalogRead)(uint8_t pin);
+
+// SRAM as MemoryMonitor sees it. The heap starts at __heap_start and ends
+// at __brkval (NULL until something is allocated), the stack grows down
+// from __stack to SP, the next byte a push would write. All of them point
+// into hostSram, which a test fills and moves SP around in
+#define HOST_SRAM_SIZE 2048
+extern uint8_t  hostSram[HOST_SRAM_SIZE];
+extern uint8_t &__heap_start;
+extern uint8_t &__stack;
+extern char    *__brkval;
+extern uint8_t *hostStackPointer;
+#define SP ((uintptr_t)hostStackPointer)
+
+// interrupts: SREG bit 7, delivered when they are on, see hostDeliverInterrupts()
+#define SREG_I 7
+void cli(void);
+void sei(void);
+#define noInterrupts() cli()
+#define interrupts()   sei()
+void hostDeliverInterrupts(void);
+
+#define ISR(vector, ...) extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) extern "C" void vector(void) {}
+extern "C" void TWI_vect(void);
+
+#include "Print.h"
+
+#endif // _HOST_ARDUINO_H_
@@ -0,0 +1,54 @@
+/*
+ * Host stand-in for the Arduino core's Print, see Arduino.h. Numbers print
+ * in decimal only, which is all the libraries ask of it.
+ */
+#ifndef _HOST_PRINT_H_
+#define _HOST_PRINT_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+class __FlashStringHelper;
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  virtual int availableForWrite() { return 0; }
+
+  size_t print(const char *s) { return write(s); }
+  size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(long n) { return format("%ld", n); }
+  size_t print(unsigned long n) { return format("%lu", n); }
+  size_t print(int n) { return print((long)n); }
+  size_t print(unsigned int n) { return print((unsigned long)n); }
+  size_t print(double n, int digits = 2) { return format("%.*f", digits, n); }
+  template <class T> size_t println(T value) { return print(value) + println(); }
+  size_t println() { return write((uint8_t)'\n'); }
+
+ private:
+  size_t format(const char *pattern, ...) __attribute__((format(printf, 2, 3)));
+};
+
+inline size_t Print::format(const char *pattern, ...) {
+  char text[32];
+  va_list args;
+  va_start(args, pattern);
+  vsnprintf(text, sizeof(text), pattern, args);
+  va_end(args);
+  return write(text);
+}
+
+#endif // _HOST_PRINT_H_
@@ -0,0 +1,16 @@
+/* Host stand-in for the Arduino SPI library. Nothing in sim/ uses SPI, the
+ * SSD1306 driver only needs the type to exist */
+#ifndef _HOST_SPI_H_
+#define _HOST_SPI_H_
+
+#include "Arduino.h"
+
+class SPIClass {
+ public:
+  void    begin(void) {}
+  uint8_t transfer(uint8_t data) { return data; }
+};
+
+extern SPIClass SPI;
+
+#endif // _HOST_SPI_H_
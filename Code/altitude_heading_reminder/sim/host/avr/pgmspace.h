@@ -0,0 +1,2 @@
+/* Host stand-in for avr-libc's <avr/pgmspace.h>, see Arduino.h */
+#include "Arduino.h"
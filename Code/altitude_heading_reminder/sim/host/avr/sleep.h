@@ -0,0 +1,17 @@
+/* Host stand-in for avr-libc's <avr/sleep.h>, see host_arduino.cpp */
+#ifndef _HOST_AVR_SLEEP_H_
+#define _HOST_AVR_SLEEP_H_
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_ADC      1
+#define SLEEP_MODE_PWR_DOWN 2
+
+void set_sleep_mode(uint8_t mode);
+void sleep_enable(void);
+void sleep_disable(void);
+void sleep_cpu(void);
+extern void (*hostSleep)(uint8_t mode);  // called by sleep_cpu() while sleep is enabled, NULL wakes straight away
+
+#endif // _HOST_AVR_SLEEP_H_
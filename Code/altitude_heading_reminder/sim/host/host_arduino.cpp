@@ -0,0 +1,169 @@
+/*
+ * The simulated clock, pins, registers and interrupts behind Arduino.h and
+ * avr/sleep.h.
+ */
+#include "Arduino.h"
+#include "SPI.h"
+#include "avr/sleep.h"
+
+static void sregWritten(HostRegister &reg, uint8_t value);
+
+HostRegister SREG = { _BV(SREG_I), sregWritten }; // on, as the core's init() leaves them
+HostRegister TWCR, TWSR, TWDR, TWBR, TWAR;
+HostRegister ADCSRA = { _BV(ADEN) };           // enabled, as the core's init() leaves it
+uint16_t     ADC;
+SPIClass     SPI;
+
+uint8_t    hostPinLevel[32];
+uint8_t    hostPinMode[32];
+int      (*hostPinRead)(uint8_t pin);
+int      (*hostAnalogRead)(uint8_t pin);
+void     (*hostSleep)(uint8_t mode);
+void     (*hostPinChanged)(uint8_t pin);
+uint32_t   hostCallUs = 1;
+HostModel *hostModel;
+
+// the lower half of SRAM for .data and .bss, the rest for the heap and
+// the stack, which starts out empty
+uint8_t    hostSram[HOST_SRAM_SIZE];
+uint8_t   &__heap_start = hostSram[HOST_SRAM_SIZE / 2];
+uint8_t   &__stack = hostSram[HOST_SRAM_SIZE - 1];
+char      *__brkval;
+uint8_t   *hostStackPointer = &hostSram[HOST_SRAM_SIZE - 1];
+
+static uint64_t now;
+static bool     inInterrupt;
+static uint8_t  sleepMode;
+static bool     sleepEnabled;
+
+//////////////////////////////////////////////////////////////////////////
+// time
+//////////////////////////////////////////////////////////////////////////
+void hostAdvance(uint32_t us) {
+  uint64_t target = now + us;
+  for (;;) {
+    if (hostModel) {
+      hostModel->run(now);
+    }
+    hostDeliverInterrupts(); // may call back in here, and move now on itself
+    uint64_t next = hostModel ? hostModel->nextEvent() : UINT64_MAX;
+    if (next > target) {
+      break;
+    }
+    if (next > now) {
+      now = next;
+    }
+  }
+  if (now < target) {
+    now = target;
+  }
+}
+
+uint64_t hostTime(void) {
+  return now;
+}
+
+unsigned long micros(void) {
+  hostAdvance(hostCallUs);
+  return (unsigned long)now;
+}
+
+unsigned long millis(void) {
+  hostAdvance(hostCallUs);
+  return (unsigned long)(now / 1000);
+}
+
+void delay(unsigned long ms) {
+  hostAdvance(ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  hostAdvance(us);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// pins
+//////////////////////////////////////////////////////////////////////////
+void pinMode(uint8_t pin, uint8_t mode) {
+  hostPinMode[pin] = mode;
+  if (mode == INPUT_PULLUP) {
+    hostPinLevel[pin] = HIGH; // the pull-up is the port bit set
+  }
+  if (hostPinChanged) {
+    hostPinChanged(pin);
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  hostPinLevel[pin] = level;
+  if (hostPinChanged) {
+    hostPinChanged(pin);
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  if (hostPinRead) {
+    return hostPinRead(pin);
+  }
+  return hostPinMode[pin] == OUTPUT ? hostPinLevel[pin] : HIGH;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// analog input and sleep
+//////////////////////////////////////////////////////////////////////////
+int analogRead(uint8_t pin) {
+  ADC = hostAnalogRead ? hostAnalogRead(pin) : 0;
+  return ADC;
+}
+
+void set_sleep_mode(uint8_t mode) {
+  sleepMode = mode;
+}
+
+void sleep_enable(void) {
+  sleepEnabled = true;
+}
+
+void sleep_disable(void) {
+  sleepEnabled = false;
+}
+
+// like the SLEEP instruction, nothing happens unless sleep is enabled
+void sleep_cpu(void) {
+  if (sleepEnabled && hostSleep) {
+    hostSleep(sleepMode);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// interrupts
+//////////////////////////////////////////////////////////////////////////
+static void sregWritten(HostRegister &reg, uint8_t value) {
+  reg.value = value;
+  hostDeliverInterrupts();
+}
+
+void cli(void) {
+  SREG = SREG & ~_BV(SREG_I);
+}
+
+void sei(void) {
+  SREG = SREG | _BV(SREG_I);
+}
+
+// runs the TWI interrupt for as long as it's pending and enabled. Like the
+// real thing, a handler that never clears TWINT gets called again and again
+void hostDeliverInterrupts(void) {
+  unsigned calls = 0;
+  while (!inInterrupt && (SREG & _BV(SREG_I)) && (TWCR & _BV(TWINT)) && (TWCR & _BV(TWIE))) {
+    if (++calls > 1000) {
+      fprintf(stderr, "the TWI interrupt keeps firing, its handler never clears TWINT\n");
+      abort();
+    }
+    inInterrupt = true;
+    SREG.value &= ~_BV(SREG_I);
+    TWI_vect();
+    SREG.value |= _BV(SREG_I);
+    inInterrupt = false;
+  }
+}
@@ -0,0 +1,180 @@
+/*
+ * SPL06-007 and SSD1306 bus models, see twi_devices.h.
+ */
+#include "twi_devices.h"
+
+#define SPL_STARTUP_US 40000 // datasheet, power-on to SENSOR_RDY and COEF_RDY
+
+//////////////////////////////////////////////////////////////////////////
+// SPL06-007
+//////////////////////////////////////////////////////////////////////////
+HostSpl06::HostSpl06(uint8_t address) : HostTwiDevice(address), resets(0) {
+  reset();
+  resets = 0;
+  readyAt = 0;
+}
+
+void HostSpl06::reset(void) {
+  // a plausible sensor, about 790 hPa with these coefficients
+  static const uint8_t PROGMEM power[0x30] = {
+    0xFF, 0xF2, 0x3A, 0x08, 0x2C, 0x7C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
+    0x0C, 0xBF, 0x3B, 0x13, 0x4A, 0x6F, 0x98, 0xF8, 0x41, 0xF4, 0xF4, 0x0C, 0xFE, 0xF5, 0x00, 0x18,
+    0xFB, 0x6F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+  memcpy(regs, power, sizeof(regs));
+  pointer = 0;
+  addressed = false;
+  readyAt = hostTime() + SPL_STARTUP_US;
+  resets++;
+}
+
+bool HostSpl06::configured(void) const {
+  return regs[0x06] && regs[0x07] && (regs[0x08] & 0x07) == 0x07;
+}
+
+bool HostSpl06::start(bool read) {
+  addressed = read; // a read carries on from the pointer
+  return true;
+}
+
+bool HostSpl06::write(uint8_t data) {
+  if (!addressed) {
+    pointer = data;
+    addressed = true;
+  }
+  else if (pointer < sizeof(regs)) {
+    if (pointer == 0x08) {
+      regs[pointer] = (regs[pointer] & 0xF8) | (data & 0x07); // only MEAS_CTRL is writable
+    }
+    else {
+      regs[pointer] = data;
+    }
+    pointer++;
+  }
+  return true;
+}
+
+uint8_t HostSpl06::read(void) {
+  if (pointer >= sizeof(regs)) {
+    return 0;
+  }
+  uint8_t data = regs[pointer];
+  if (pointer == 0x08) {
+    data &= 0x07;
+    if (hostTime() >= readyAt) {
+      data |= 0xC0; // COEF_RDY, SENSOR_RDY
+      if ((regs[0x08] & 0x07) == 0x07) {
+        data |= 0x30; // PRS_RDY, TMP_RDY, a conversion is always waiting
+      }
+    }
+  }
+  pointer++;
+  return data;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// SSD1306
+//////////////////////////////////////////////////////////////////////////
+HostSsd1306::HostSsd1306(uint8_t address) : HostTwiDevice(address) {
+  reset();
+  resets = 0;
+  dataBytes = 0;
+  settingsCommands = 0;
+}
+
+void HostSsd1306::reset(void) {
+  memset(ram, 0, sizeof(ram)); // its contents are undefined, blank is the likeliest
+  displayOn = false;
+  chargePump = false;
+  memoryMode = 0x02; // page addressing
+  contrast = 0x7F;
+  inverted = false;
+  segmentRemap = comScanDec = false;
+  state = Control;
+  cmdLength = cmdNeeds = 0;
+  column = columnStart = 0;
+  columnEnd = WIDTH - 1;
+  page = pageStart = 0;
+  pageEnd = 7;
+  resets++;
+}
+
+bool HostSsd1306::initialized(void) const {
+  return displayOn && chargePump && memoryMode == 0x00;
+}
+
+bool HostSsd1306::start(bool read) {
+  state = Control;
+  return !read; // no status reads on I2C
+}
+
+bool HostSsd1306::write(uint8_t data) {
+  switch (state) {
+    case Control:
+      state = data & 0x40 ? Data : Command;
+      break;
+    case Command:
+      command(data);
+      break;
+    case Data:
+      if (page < PAGES && column < WIDTH) {
+        ram[page * WIDTH + column] = data;
+      }
+      dataBytes++;
+      if (column++ >= columnEnd) {
+        column = columnStart;
+        if (page++ >= pageEnd) {
+          page = pageStart;
+        }
+      }
+      break;
+  }
+  return true;
+}
+
+// collect a command and its arguments, which may be spread over several
+// transfers, and act on it once it's whole
+void HostSsd1306::command(uint8_t c) {
+  if (!cmdLength) {
+    switch (c) {
+      case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        cmdNeeds = 1;
+        break;
+      case 0x21: case 0x22: case 0xA3:
+        cmdNeeds = 2;
+        break;
+      case 0x29: case 0x2A:
+        cmdNeeds = 5;
+        break;
+      case 0x26: case 0x27:
+        cmdNeeds = 6;
+        break;
+      default:
+        cmdNeeds = 0;
+        break;
+    }
+  }
+  cmd[cmdLength++] = c;
+  if (cmdLength <= cmdNeeds) {
+    return;
+  }
+  cmdLength = 0;
+
+  switch (cmd[0]) {
+    case 0xAE: displayOn = false; break;
+    case 0xAF: displayOn = true; break;
+    case 0x8D: chargePump = cmd[1] & 0x04; break;
+    case 0x20: memoryMode = cmd[1] & 0x03; break;
+    case 0x21:
+      column = columnStart = cmd[1] & 0x7F;
+      columnEnd = cmd[2] & 0x7F;
+      break;
+    case 0x22:
+      page = pageStart = cmd[1] & 0x07;
+      pageEnd = cmd[2] & 0x07;
+      break;
+    case 0x81: contrast = cmd[1]; settingsCommands++; break;
+    case 0xA6: case 0xA7: inverted = cmd[0] & 0x01; settingsCommands++; break;
+    case 0xA0: case 0xA1: segmentRemap = cmd[0] & 0x01; settingsCommands++; break;
+    case 0xC0: case 0xC8: comScanDec = cmd[0] & 0x08; settingsCommands++; break;
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ * The sketch's two kinds of device, as seen from the bus, for HostTwiBus.
+ * Only as much of each as it takes to tell whether the firmware has set
+ * it up and whether what it sent arrived.
+ */
+#ifndef _TWI_DEVICES_H_
+#define _TWI_DEVICES_H_
+
+#include "twi_model.h"
+
+// SPL06-007: a register file with an auto-incrementing pointer. After a
+// reset the ready bits in MEAS_CFG take 40ms to come up, as after power-on,
+// and the configuration is back to zero
+class HostSpl06 : public HostTwiDevice {
+ public:
+  explicit HostSpl06(uint8_t address);
+
+  bool    start(bool read);
+  bool    write(uint8_t data);
+  uint8_t read(void);
+  void    reset(void);
+
+  bool    configured(void) const; // measuring continuously with a rate and oversampling set
+
+  uint8_t  regs[0x30];
+  uint32_t resets;
+
+ private:
+  uint8_t  pointer;
+  bool     addressed;   // the first byte written since START was the pointer
+  uint64_t readyAt;
+};
+
+// SSD1306 on I2C: control byte, then commands or GDDRAM data in horizontal
+// addressing mode
+class HostSsd1306 : public HostTwiDevice {
+ public:
+  static const uint8_t WIDTH = 128;
+  static const uint8_t PAGES = 4;
+
+  explicit HostSsd1306(uint8_t address);
+
+  bool    start(bool read);
+  bool    write(uint8_t data);
+  void    reset(void);
+
+  bool    initialized(void) const; // charge pump on, display on, horizontal addressing
+
+  uint8_t  ram[WIDTH * PAGES];
+  bool     displayOn, chargePump;
+  uint8_t  memoryMode;
+  uint8_t  contrast;
+  bool     inverted;    // 0xA7, every pixel shown the other way
+  bool     segmentRemap, comScanDec; // both set for the normal orientation, both clear for upside down
+  uint32_t dataBytes;   // GDDRAM bytes written
+  uint32_t settingsCommands; // contrast, invert, segment remap and COM scan commands
+  uint32_t resets;
+
+ private:
+  void    command(uint8_t c);
+
+  enum { Control, Command, Data } state;
+  uint8_t  cmd[7];      // command being assembled, and its arguments
+  uint8_t  cmdLength, cmdNeeds;
+  uint8_t  column, columnStart, columnEnd;
+  uint8_t  page, pageStart, pageEnd;
+};
+
+#endif // _TWI_DEVICES_H_
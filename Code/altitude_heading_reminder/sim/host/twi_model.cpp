@@ -0,0 +1,249 @@
+/*
+ * TWI peripheral and bus model, see twi_model.h.
+ */
+#include <util/twi.h>
+#include "twi_model.h"
+
+HostTwiBus *HostTwiBus::bus;
+
+HostTwiBus::HostTwiBus() :
+  bytes(0), sclPulses(0), struckAt(0), offAt(0), device(NULL), phase(Idle), faultBytes(0),
+  hung(false), sdaHeld(false), clocksLeft(0), sclHeldUntil(0), pending(false), dueAt(0),
+  dueStatus(0), dueData(0), dueRead(false), stopPending(false), lastScl(HIGH) {
+  memset(devices, 0, sizeof(devices));
+  memset(&fault, 0, sizeof(fault));
+  bus = this;
+  TWCR.value = 0;
+  TWSR.value = TW_NO_INFO;
+  TWCR.written = twcrWritten;
+  hostPinRead = pinRead;
+  hostPinChanged = pinChanged;
+  hostModel = this;
+}
+
+HostTwiBus::~HostTwiBus() {
+  TWCR.written = NULL;
+  hostPinRead = NULL;
+  hostPinChanged = NULL;
+  hostModel = NULL;
+  bus = NULL;
+}
+
+void HostTwiBus::attach(HostTwiDevice *device) {
+  for (int i = 0; i < HOST_TWI_DEVICES; i++) {
+    if (!devices[i]) {
+      devices[i] = device;
+      return;
+    }
+  }
+  fprintf(stderr, "more than %d devices on the bus\n", HOST_TWI_DEVICES);
+  abort();
+}
+
+void HostTwiBus::inject(const HostTwiFault &fault) {
+  this->fault = fault;
+  faultBytes = bytes;
+  struckAt = 0;
+  offAt = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// timing
+//////////////////////////////////////////////////////////////////////////
+
+// SCL period from TWBR with the prescaler at 1, as Custom_TWI sets it
+uint32_t HostTwiBus::bitUs(uint32_t bits) const {
+  return (bits * (16 + 2 * (uint32_t)TWBR) * 1000000UL + F_CPU - 1) / F_CPU;
+}
+
+uint64_t HostTwiBus::nextEvent(void) {
+  uint64_t next = UINT64_MAX;
+  if (pending && !hung) {
+    next = dueAt;
+  }
+  if (stopPending && sclHeldUntil < next) {
+    next = sclHeldUntil;
+  }
+  return next;
+}
+
+void HostTwiBus::run(uint64_t now) {
+  if (stopPending && now >= sclHeldUntil) {
+    stopPending = false;
+    TWCR.value &= ~_BV(TWSTO);
+  }
+  if (pending && !hung && now >= dueAt) {
+    pending = false;
+    TWSR.value = dueStatus;
+    if (dueRead) {
+      TWDR.value = dueData;
+    }
+    TWCR.value |= _BV(TWINT);
+  }
+}
+
+// the current byte or condition ends with status after bits clocks, or
+// later if a device is stretching the clock
+void HostTwiBus::finish(uint8_t status, uint32_t bits) {
+  pending = true;
+  dueStatus = status;
+  dueRead = false;
+  dueAt = hostTime() + bitUs(bits);
+  if (dueAt < sclHeldUntil) {
+    dueAt = sclHeldUntil;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// faults
+//////////////////////////////////////////////////////////////////////////
+
+// called at the start of every byte. true if the byte ends in a bus error
+bool HostTwiBus::strike(void) {
+  bytes++;
+  if (fault.kind == TwiFaultNone || bytes - faultBytes <= fault.afterBytes) {
+    return false;
+  }
+  HostTwiFaultKind kind = fault.kind;
+  fault.kind = TwiFaultNone;
+  struckAt = hostTime();
+  if (fault.resetDevices) {
+    for (int i = 0; i < HOST_TWI_DEVICES && devices[i]; i++) {
+      devices[i]->reset();
+    }
+  }
+  switch (kind) {
+    case TwiFaultLostInterrupt:
+      hung = true;
+      break;
+    case TwiFaultHoldSda:
+      hung = true;
+      sdaHeld = true;
+      clocksLeft = fault.releaseClocks;
+      break;
+    case TwiFaultHoldScl:
+      sclHeldUntil = hostTime() + fault.releaseUs;
+      break;
+    case TwiFaultBusError:
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// TWCR
+//////////////////////////////////////////////////////////////////////////
+void HostTwiBus::twcrWritten(HostRegister &reg, uint8_t value) {
+  bus->control(value);
+}
+
+void HostTwiBus::control(uint8_t value) {
+  uint8_t flag = TWCR.value & _BV(TWINT);
+
+  if (!(value & _BV(TWEN))) { // off: the pins go back to the port and whatever was going on stops
+    TWCR.value = value & ~(_BV(TWINT) | _BV(TWSTA) | _BV(TWSTO));
+    if (struckAt && !offAt) {
+      offAt = hostTime();
+    }
+    pending = false;
+    stopPending = false;
+    hung = false;
+    device = NULL;
+    phase = Idle;
+    return;
+  }
+
+  // writing a one clears TWINT, and that's what sets the TWI going
+  TWCR.value = (value & ~_BV(TWINT)) | (value & _BV(TWINT) ? 0 : flag);
+  if (!(value & _BV(TWINT))) {
+    return;
+  }
+
+  if (value & _BV(TWSTA)) {
+    uint8_t status = phase == Idle ? TW_START : TW_REP_START;
+    TWCR.value &= ~_BV(TWSTA); // the model clears it once the START is out, the hardware leaves that to software
+    phase = Address;
+    if (sdaHeld) {
+      hung = true; // the START can't go out while SDA is low
+    }
+    finish(status, 1);
+  }
+  else if (value & _BV(TWSTO)) {
+    if (device) {
+      device->stop();
+    }
+    device = NULL;
+    phase = Idle;
+    if (hostTime() < sclHeldUntil) {
+      stopPending = true; // TWSTO stays set until the clock is let go
+    }
+    else {
+      TWCR.value &= ~_BV(TWSTO);
+    }
+  }
+  else if (phase == Address) {
+    bool error = strike();
+    uint8_t address = TWDR >> 1;
+    bool read = TWDR & TW_READ;
+    device = NULL;
+    for (int i = 0; i < HOST_TWI_DEVICES && devices[i]; i++) {
+      if (devices[i]->address == address) {
+        device = devices[i];
+      }
+    }
+    bool ack = device && device->start(read);
+    if (!ack) {
+      device = NULL;
+    }
+    phase = read ? Reading : Writing;
+    finish(error ? TW_BUS_ERROR : read ? (ack ? TW_MR_SLA_ACK : TW_MR_SLA_NACK) : (ack ? TW_MT_SLA_ACK : TW_MT_SLA_NACK), 9);
+  }
+  else if (phase == Writing) {
+    bool error = strike();
+    bool ack = device && device->write(TWDR);
+    finish(error ? TW_BUS_ERROR : ack ? TW_MT_DATA_ACK : TW_MT_DATA_NACK, 9);
+  }
+  else if (phase == Reading) {
+    bool error = strike();
+    bool ack = value & _BV(TWEA);
+    finish(error ? TW_BUS_ERROR : ack ? TW_MR_DATA_ACK : TW_MR_DATA_NACK, 9);
+    dueData = device ? device->read() : 0xFF;
+    dueRead = true;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+// pins, while the TWI is off and the port drives them
+//////////////////////////////////////////////////////////////////////////
+int HostTwiBus::sclLevel(void) const {
+  if (hostTime() < sclHeldUntil) {
+    return LOW;
+  }
+  return hostPinMode[SCL] == OUTPUT ? hostPinLevel[SCL] : HIGH; // the bus pull-ups
+}
+
+int HostTwiBus::pinRead(uint8_t pin) {
+  if (pin == SDA && bus->sdaHeld) {
+    return LOW;
+  }
+  if (pin == SCL) {
+    return bus->sclLevel();
+  }
+  return hostPinMode[pin] == OUTPUT ? hostPinLevel[pin] : HIGH;
+}
+
+void HostTwiBus::pinChanged(uint8_t pin) {
+  if (pin != SCL || (TWCR & _BV(TWEN))) {
+    return;
+  }
+  int level = bus->sclLevel();
+  if (level == HIGH && bus->lastScl == LOW) {
+    bus->sclPulses++;
+    if (bus->sdaHeld && --bus->clocksLeft == 0) {
+      bus->sdaHeld = false; // the device has clocked out what it was sending
+    }
+  }
+  bus->lastScl = level;
+}
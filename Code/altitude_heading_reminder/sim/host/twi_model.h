@@ -0,0 +1,98 @@
+/*
+ * The ATmega328's TWI peripheral in master mode and the bus behind it, for
+ * the host tests. Custom_TWI drives it through TWCR, TWDR and TWSR exactly
+ * as it drives the real one, and each byte takes as long as it would at
+ * the TWBR it was sent with.
+ *
+ * The devices are HostTwiDevice models attached by address. A fault can be
+ * injected to strike after a given number of bytes:
+ *   LostInterrupt  the TWI waits for an interrupt that never comes
+ *   HoldSda        a device holds SDA low until SCL has been pulsed
+ *                  releaseClocks times with the TWI off, the "bus clear"
+ *   HoldScl        a device stretches SCL for releaseUs, so everything,
+ *                  the STOP included, waits for it
+ *   BusError       the byte ends in a bus error
+ * Any of them can also reset every device, as a supply glitch would, so
+ * they come back unconfigured.
+ */
+#ifndef _TWI_MODEL_H_
+#define _TWI_MODEL_H_
+
+#include "Arduino.h"
+
+#define HOST_TWI_DEVICES 4
+
+class HostTwiDevice {
+ public:
+  explicit HostTwiDevice(uint8_t address) : address(address) {}
+  virtual ~HostTwiDevice() {}
+
+  virtual bool    start(bool read) { return true; }    // addressed, false to NACK
+  virtual bool    write(uint8_t data) { return true; } // false to NACK
+  virtual uint8_t read(void) { return 0xFF; }
+  virtual void    stop(void) {}
+  virtual void    reset(void) {}                       // back to power-on state
+
+  const uint8_t address;
+};
+
+enum HostTwiFaultKind { TwiFaultNone, TwiFaultLostInterrupt, TwiFaultHoldSda, TwiFaultHoldScl, TwiFaultBusError };
+
+struct HostTwiFault {
+  HostTwiFaultKind kind;
+  uint32_t         afterBytes;    // bytes on the bus from inject(), addresses included, before it strikes
+  uint16_t         releaseClocks; // HoldSda
+  uint32_t         releaseUs;     // HoldScl
+  bool             resetDevices;
+};
+
+class HostTwiBus : public HostModel {
+ public:
+  HostTwiBus();
+  ~HostTwiBus();
+
+  void     attach(HostTwiDevice *device);
+  void     inject(const HostTwiFault &fault);
+
+  uint64_t nextEvent(void);
+  void     run(uint64_t now);
+
+  uint32_t bytes;      // bytes on the bus, addresses included
+  uint32_t sclPulses;  // SCL rising edges made by hand with the TWI off
+  uint64_t struckAt;   // hostTime() the injected fault struck, 0 while it hasn't
+  uint64_t offAt;      // hostTime() the TWI was first turned off after that, 0 while it hasn't
+
+ private:
+  enum Phase { Idle, Address, Writing, Reading };
+
+  static void twcrWritten(HostRegister &reg, uint8_t value);
+  static int  pinRead(uint8_t pin);
+  static void pinChanged(uint8_t pin);
+
+  void     control(uint8_t value);
+  void     finish(uint8_t status, uint32_t bits);
+  bool     strike(void);
+  uint32_t bitUs(uint32_t bits) const;
+  int      sclLevel(void) const;
+
+  static HostTwiBus *bus;
+
+  HostTwiDevice *devices[HOST_TWI_DEVICES];
+  HostTwiDevice *device;            // addressed one
+  Phase          phase;
+  HostTwiFault   fault;             // armed while kind isn't TwiFaultNone
+  uint32_t       faultBytes;        // bytes when it was injected
+  bool           hung;              // no more interrupts until the TWI is turned off
+  bool           sdaHeld;
+  uint16_t       clocksLeft;
+  uint64_t       sclHeldUntil;
+  bool           pending;           // a byte or condition finishes at dueAt
+  uint64_t       dueAt;
+  uint8_t        dueStatus;
+  uint8_t        dueData;           // TWDR when it finishes, for reads
+  bool           dueRead;
+  bool           stopPending;       // TWSTO clears once the clock is let go
+  int            lastScl;
+};
+
+#endif // _TWI_MODEL_H_
@@ -0,0 +1,10 @@
+/* Host stand-in for avr-libc's <util/delay.h> */
+#ifndef _HOST_UTIL_DELAY_H_
+#define _HOST_UTIL_DELAY_H_
+
+#include "Arduino.h"
+
+#define _delay_ms(ms) delay(ms)
+#define _delay_us(us) delayMicroseconds(us)
+
+#endif // _HOST_UTIL_DELAY_H_
@@ -0,0 +1,181 @@
+/*
+ * MemoryMonitor's stack and heap figures against a model of SRAM, on the
+ * host.
+ *
+ * The real MemoryMonitor.cpp runs over hostSram, the stand-in from host/,
+ * painted with the canary the way paintStack() paints SRAM at boot. Calls
+ * push the stack down to random depths and leave their frames behind when
+ * they return, malloc() and realloc() move the heap end up, and after each
+ * step updateMemoryStats() has to report the gap the model worked out for
+ * itself: the smallest there has been between the heap and the lowest
+ * byte the stack ever wrote, what is free right now, the heap in use and
+ * where it ends, and one allocation per malloc() or realloc() call.
+ *
+ *   memory_check [-n steps] [-s seed]
+ */
+#include <unistd.h>
+#include "MemoryMonitor.h"
+
+#define STACK_IN_USE 64 // what setup() and loop() leave on the stack for good
+
+static uint32_t seed = 1;
+static unsigned failed;
+static uint8_t *lowestWritten; // the deepest the stack has been
+static unsigned calls;         // malloc() and realloc() calls made
+
+// avr-libc's allocators, as far as the heap end goes: --wrap sends
+// __wrap_malloc() and __wrap_realloc() to these. Blocks are never reused
+extern "C" void *__real_malloc(size_t size) {
+  uint8_t *block = __brkval ? (uint8_t *)__brkval : &__heap_start;
+  __brkval = (char *)(block + size);
+  memset(block, 0, size);
+  return block;
+}
+
+extern "C" void *__real_realloc(void *ptr, size_t size) {
+  void *block = __real_malloc(size);
+  if (ptr) {
+    memmove(block, ptr, size); // the model's blocks only grow, so this reads no further than the heap end
+  }
+  return block;
+}
+
+extern "C" void *__wrap_malloc(size_t size);
+extern "C" void *__wrap_realloc(void *ptr, size_t size);
+
+static uint32_t random32(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static unsigned randomBelow(unsigned n) {
+  return random32() % n;
+}
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failed++;
+  }
+}
+
+static uint8_t *heapEnd(void) {
+  return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+// power-up: paintStack() over SRAM, then the stack setup() and loop() keep
+static void boot(void) {
+  memset(hostSram, 0, sizeof(hostSram));
+  memset(&__heap_start, cStackCanary, &__stack - &__heap_start + 1);
+  __brkval = NULL;
+  hostStackPointer = &__stack - STACK_IN_USE;
+  memset(hostStackPointer + 1, 0, STACK_IN_USE);
+  lowestWritten = hostStackPointer + 1;
+  gMemoryStats = { 0xFFFF, 0, 0, 0, 0 };
+  calls = 0;
+}
+
+// a call chain depth bytes below loop() that writes all of its frames,
+// none of them with the canary, and returns
+static void call(unsigned depth) {
+  uint8_t *bottom = hostStackPointer + 1 - depth;
+  for (uint8_t *p = bottom; p <= hostStackPointer; p++) {
+    *p = (uint8_t)(cStackCanary + 1 + randomBelow(255));
+  }
+  if (bottom < lowestWritten) {
+    lowestWritten = bottom;
+  }
+}
+
+// what updateMemoryStats() should say now, with stackFreeMin carried over
+static bool statsAsModelled(unsigned *stackFreeMin) {
+  uint8_t *end = heapEnd();
+  uint8_t *stop = min(lowestWritten, hostStackPointer);
+  unsigned stackFree = stop > end ? stop - end : 0;
+  if (stackFree < *stackFreeMin) {
+    *stackFreeMin = stackFree;
+  }
+  updateMemoryStats();
+  return gMemoryStats.stackFreeMin == *stackFreeMin &&
+    gMemoryStats.freeNow == (unsigned)(hostStackPointer - end) &&
+    gMemoryStats.heapUsed == (unsigned)(end - &__heap_start) &&
+    gMemoryStats.heapEnd == (uintptr_t)end &&
+    gMemoryStats.allocations == calls;
+}
+
+// nothing allocated and nothing called yet
+static void checkBoot(void) {
+  boot();
+  unsigned stackFreeMin = 0xFFFF;
+  expect(statsAsModelled(&stackFreeMin), "the figures straight after boot");
+  expect(gMemoryStats.heapUsed == 0 && gMemoryStats.heapEnd == (uintptr_t)&__heap_start,
+    "no heap before the first malloc()");
+  expect(gMemoryStats.stackFreeMin == (unsigned)(hostStackPointer - &__heap_start),
+    "all of the canary free straight after boot");
+}
+
+// random calls and allocations, checked after every one
+static void checkSteps(unsigned steps) {
+  boot();
+  unsigned stackFreeMin = 0xFFFF;
+  unsigned wrong = 0;
+  uint8_t *block = NULL;
+  size_t blockSize = 0;
+  for (unsigned n = 0; n < steps; n++) {
+    unsigned room = hostStackPointer - heapEnd();
+    switch (randomBelow(4)) {
+      case 0:
+        if (room > 32) {
+          __wrap_malloc(1 + randomBelow(8));
+          calls++;
+        }
+        break;
+      case 1:
+        if (room > 32 + blockSize + 8) {
+          blockSize += 1 + randomBelow(8);
+          block = (uint8_t *)__wrap_realloc(block, blockSize);
+          calls++;
+        }
+        break;
+      default:
+        call(randomBelow(room > 16 ? min(room - 16, 400u) : 1u));
+        break;
+    }
+    if (!statsAsModelled(&stackFreeMin) && !wrong++) {
+      printf("step %u: stack free min %u, free %u, heap %u at %#lx, %u allocations;"
+        " the model has %u, %u, %u at %#lx, %u\n", n,
+        gMemoryStats.stackFreeMin, gMemoryStats.freeNow, gMemoryStats.heapUsed,
+        (unsigned long)gMemoryStats.heapEnd, gMemoryStats.allocations,
+        stackFreeMin, (unsigned)(hostStackPointer - heapEnd()),
+        (unsigned)(heapEnd() - &__heap_start), (unsigned long)(uintptr_t)heapEnd(), calls);
+    }
+  }
+  expect(!wrong, "the figures after every call and allocation");
+  printf("%u steps: %u allocations, %u bytes of heap, stack free min %u; %u off the model\n",
+    steps, calls, gMemoryStats.heapUsed, gMemoryStats.stackFreeMin, wrong);
+}
+
+int main(int argc, char **argv) {
+  unsigned steps = 5000;
+  int option;
+  while ((option = getopt(argc, argv, "n:s:")) != -1) {
+    switch (option) {
+      case 'n': steps = atoi(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-n steps] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  checkBoot();
+  checkSteps(steps);
+  if (failed) {
+    printf("%u checks failed\n", failed);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
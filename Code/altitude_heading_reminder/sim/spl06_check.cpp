@@ -0,0 +1,225 @@
+/*
+ * The SPL06 driver template against a mock bus, on the host.
+ *
+ * The mock is a register file behind SPL06's transfer(), millis() and
+ * traceTag(), with its own clock that moves as bytes go over it. Nothing
+ * else is linked in, not the Arduino core stand-ins and not Custom_TWI, so
+ * this also shows the driver needs nothing from either.
+ *
+ * It checks
+ *   - what begin() writes to the configuration registers, for two setups
+ *   - begin() waiting for the sensor to come up, and giving up after
+ *     SPL_STARTUP_TIMEOUT when it never does
+ *   - newData() and readSample() on good and failed transfers
+ *   - the compensated pressure and temperature against the datasheet's
+ *     formula worked out here separately
+ *   - that every transaction carries the tag of the call that made it, and
+ *     the caller's tag is back afterwards
+ *
+ *   spl06_check
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <SPL06-007.h>
+
+#define BYTE_US     25  // a byte and its ACK at 400kHz, near enough
+#define NACK        2   // a status that isn't SPL_BUS_OK
+
+class MockBus {
+ public:
+  MockBus() : us(0), readyAtMs(0), neverReady(false), failing(false), tag(NULL), transactions(0), untagged(0) {
+    memset(regs, 0, sizeof(regs));
+    memset(tags, 0, sizeof(tags));
+  }
+
+  uint8_t transfer(uint8_t address, uint8_t twbr, const uint8_t *out, uint8_t outLength,
+                   uint8_t *in=NULL, uint8_t inLength=0) {
+    us += (1 + outLength + (inLength ? 1 + inLength : 0)) * BYTE_US;
+    transactions++;
+    if (!tag) {
+      untagged++;
+    }
+    else {
+      seen(tag);
+    }
+    if (failing || address != SPL_ADDRESS || twbr != SPL_TWBR) {
+      return NACK;
+    }
+    uint8_t pointer = out[0];
+    for (uint8_t i = 1; i < outLength; i++, pointer++) {
+      if (pointer == 0x08) {
+        regs[pointer] = (regs[pointer] & 0xF8) | (out[i] & 0x07);
+      }
+      else {
+        regs[pointer] = out[i];
+      }
+    }
+    for (uint8_t i = 0; i < inLength; i++, pointer++) {
+      in[i] = regs[pointer];
+      if (pointer == 0x08) {
+        in[i] = (regs[pointer] & 0x37) | (!neverReady && millis() >= readyAtMs ? 0xC0 : 0);
+      }
+      if (pointer <= 0x05) {
+        regs[0x08] &= ~(pointer <= 0x02 ? 0x10 : 0x20); // reading a result clears its ready flag
+      }
+    }
+    return SPL_BUS_OK;
+  }
+
+  unsigned long millis() { return us / 1000; }
+
+  PGM_P traceTag(PGM_P tag) {
+    PGM_P previous = this->tag;
+    this->tag = tag;
+    return previous;
+  }
+
+  bool tagged(const char *name) const {
+    for (unsigned i = 0; i < sizeof(tags) / sizeof(tags[0]) && tags[i]; i++) {
+      if (!strcmp(tags[i], name)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint8_t       regs[0x30];
+  unsigned long us;
+  unsigned long readyAtMs;
+  bool          neverReady;
+  bool          failing;
+  PGM_P         tag;
+  unsigned      transactions;
+  unsigned      untagged;
+
+ private:
+  void seen(PGM_P name) {
+    for (unsigned i = 0; i < sizeof(tags) / sizeof(tags[0]); i++) {
+      if (!tags[i] || !strcmp(tags[i], name)) {
+        tags[i] = name;
+        return;
+      }
+    }
+  }
+
+  PGM_P tags[8];
+};
+
+typedef SPL06<MockBus, SPL_RATE_2, SPL_OVERSAMPLE_8, SPL_RATE_1, SPL_OVERSAMPLE_8> Sensor;     // the sketch's
+typedef SPL06<MockBus, SPL_RATE_4, SPL_OVERSAMPLE_16, SPL_RATE_1, SPL_OVERSAMPLE_2> Sensor16; // result shifts on
+
+// a sensor's coefficients and one conversion, registers 0x00-0x05 and 0x10-0x21
+static const uint8_t results[6] = { 0xFF, 0xF2, 0x3A, 0x08, 0x2C, 0x7C };
+static const uint8_t coefficients[18] = {
+  0x0C, 0xBF, 0x3B, 0x13, 0x4A, 0x6F, 0x98, 0xF8, 0x41, 0xF4, 0xF4, 0x0C, 0xFE, 0xF5, 0x00, 0x18, 0xFB, 0x6F };
+
+static unsigned failed;
+
+static void expect(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    failed++;
+  }
+}
+
+static void powerOn(MockBus &bus) {
+  memset(bus.regs, 0, sizeof(bus.regs));
+  memcpy(bus.regs, results, sizeof(results));
+  memcpy(bus.regs + 0x10, coefficients, sizeof(coefficients));
+  bus.readyAtMs = bus.millis() + 30;
+}
+
+// bits of the big-endian register block starting at bit first, two's complement
+static long field(const uint8_t *bytes, unsigned first, unsigned bits) {
+  long value = 0;
+  for (unsigned i = first; i < first + bits; i++) {
+    value = value * 2 + ((bytes[i / 8] >> (7 - i % 8)) & 1);
+  }
+  return value >= 1L << (bits - 1) ? value - (1L << bits) : value;
+}
+
+// datasheet section 4.9, pressure in hPa and temperature in C
+static void compensate(double kP, double kT, double *pressure, double *temperature) {
+  double c0 = field(coefficients, 0, 12), c1 = field(coefficients, 12, 12);
+  double c00 = field(coefficients, 24, 20), c10 = field(coefficients, 44, 20);
+  double c01 = field(coefficients, 64, 16), c11 = field(coefficients, 80, 16);
+  double c20 = field(coefficients, 96, 16), c21 = field(coefficients, 112, 16), c30 = field(coefficients, 128, 16);
+  double praw = field(results, 0, 24) / kP, traw = field(results, 24, 24) / kT;
+  *temperature = c0 * 0.5 + c1 * traw;
+  *pressure = (c00 + praw * (c10 + praw * (c20 + praw * c30)) + traw * c01 + traw * praw * (c11 + praw * c21)) / 100;
+}
+
+static bool close(double a, double b) {
+  return fabs(a - b) <= 1e-9 * fabs(b);
+}
+
+template <class S> static void checkSetup(const char *name, uint8_t cfgReg, double kP, double kT) {
+  MockBus bus;
+  S sensor(bus);
+  char what[96];
+  powerOn(bus);
+
+  bus.traceTag("caller");
+  snprintf(what, sizeof(what), "%s: begin() with a sensor that comes up in 30ms", name);
+  expect(sensor.begin(), what);
+  snprintf(what, sizeof(what), "%s: begin() waits for the sensor, and no longer", name);
+  expect(bus.millis() >= 30 && bus.millis() <= 31, what);
+  snprintf(what, sizeof(what), "%s: PRS_CFG, TMP_CFG, MEAS_CFG and CFG_REG", name);
+  expect(bus.regs[0x06] == S::PRS_CFG && bus.regs[0x07] == S::TMP_CFG && (bus.regs[0x08] & 0x07) == SPL_MEAS_CONT_PRS_TEMP
+    && bus.regs[0x09] == cfgReg, what);
+  snprintf(what, sizeof(what), "%s: every transaction tagged with its call, the caller's tag back after", name);
+  expect(!bus.untagged && bus.tagged("SPL06::begin") && bus.tagged("SPL06::waitStatus") && bus.tagged("SPL06::setMeasCtrl")
+    && bus.tagged("SPL06::readCoefficients") && !bus.tagged("caller") && !strcmp(bus.tag, "caller"), what);
+
+  snprintf(what, sizeof(what), "%s: newData() with nothing waiting", name);
+  expect(sensor.newData() == 0, what);
+  bus.regs[0x08] |= SPL_PRS_RDY | SPL_TMP_RDY;
+  snprintf(what, sizeof(what), "%s: newData() with a conversion waiting", name);
+  expect(sensor.newData() == (SPL_PRS_RDY | SPL_TMP_RDY), what);
+
+  double pressure, temperature;
+  compensate(kP, kT, &pressure, &temperature);
+  snprintf(what, sizeof(what), "%s: readSample() gives the datasheet's pressure and temperature", name);
+  expect(sensor.readSample() && close(sensor.pressure(), pressure) && close(sensor.tempC(), temperature)
+    && close(sensor.tempF(), temperature * 9 / 5 + 32), what);
+  snprintf(what, sizeof(what), "%s: reading the results clears the ready flags", name);
+  expect(sensor.newData() == 0, what);
+  printf("%s: %.3f hPa, %.3f C, %u transactions\n", name, sensor.pressure(), sensor.tempC(), bus.transactions);
+
+  bus.failing = true;
+  bus.regs[0x08] |= SPL_PRS_RDY;
+  snprintf(what, sizeof(what), "%s: newData() on a failed read is 0, not the 0xFF it reads as", name);
+  expect(sensor.newData() == 0, what);
+  snprintf(what, sizeof(what), "%s: readSample() on a failed read keeps the last sample", name);
+  expect(!sensor.readSample() && close(sensor.pressure(), pressure) && close(sensor.tempC(), temperature), what);
+}
+
+static void checkNeverReady(void) {
+  MockBus bus;
+  Sensor sensor(bus);
+  powerOn(bus);
+  bus.neverReady = true;
+  expect(!sensor.begin(), "begin() with a sensor that never comes up is false");
+  expect(bus.millis() >= SPL_STARTUP_TIMEOUT && bus.millis() <= SPL_STARTUP_TIMEOUT + 1,
+    "begin() gives up after SPL_STARTUP_TIMEOUT");
+  expect(bus.regs[0x06] == Sensor::PRS_CFG && (bus.regs[0x08] & 0x07) == SPL_MEAS_CONT_PRS_TEMP,
+    "begin() still configures a sensor that never reported ready");
+  printf("never ready: begin() gave up after %lu ms\n", bus.millis());
+
+  bus.failing = true;
+  unsigned long start = bus.millis();
+  expect(!sensor.begin() && bus.millis() - start >= SPL_STARTUP_TIMEOUT, "begin() with no sensor on the bus is false");
+}
+
+int main(void) {
+  checkSetup<Sensor>("8x oversampling", 0, 7864320.0, 7864320.0);
+  checkSetup<Sensor16>("16x pressure oversampling", SPL_P_SHIFT, 253952.0, 1572864.0);
+  checkNeverReady();
+  if (failed) {
+    printf("%u checks failed\n", failed);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,240 @@
+/*
+ * SPL06-007 register model for simavr, see spl06_model.h.
+ */
+#include <math.h>
+#include <string.h>
+#include "avr_twi.h"
+#include "spl06_model.h"
+
+#define REG_PSR_B2    0x00
+#define REG_TMP_B2    0x03
+#define REG_PRS_CFG   0x06
+#define REG_TMP_CFG   0x07
+#define REG_MEAS_CFG  0x08
+#define REG_RESET     0x0C
+#define REG_ID        0x0D
+#define REG_COEF      0x10
+
+#define COEF_RDY      0x80
+#define SENSOR_RDY    0x40
+#define TMP_RDY       0x20
+#define PRS_RDY       0x10
+
+#define MEAS_STANDBY  0
+#define MEAS_PRS      1
+#define MEAS_TMP      2
+#define MEAS_CONT_PRS 5
+#define MEAS_CONT_TMP 6
+#define MEAS_CONT_ALL 7
+
+#define SENSOR_RDY_DELAY 0.012   // seconds after power-on, datasheet
+#define COEF_RDY_DELAY   0.040
+
+// A plausible calibration. Any set works as long as the firmware decodes
+// the same numbers that are used to encode the results
+static const int32_t c0 = 200, c1 = -266;
+static const int32_t c00 = 80000, c10 = -54000;
+static const int32_t c01 = -2000, c11 = 1300, c20 = -10000, c21 = 100, c30 = -1000;
+
+// scale factor and measurement time (ms) for each oversampling setting
+static const double scale[8] = { 524288, 1572864, 3670016, 7864320, 253952, 516096, 1040384, 2088960 };
+static const double measureMs[8] = { 3.6, 5.2, 8.4, 14.8, 27.6, 53.2, 104.4, 206.8 };
+
+static double now(spl06_t *p) {
+  return (double)p->avr->cycle / p->avr->frequency;
+}
+
+static void put24(uint8_t *r, int32_t v) {
+  r[0] = v >> 16;
+  r[1] = v >> 8;
+  r[2] = v;
+}
+
+static void reset(spl06_t *p) {
+  uint8_t *c = p->regs + REG_COEF;
+  memset(p->regs, 0, sizeof(p->regs));
+  p->regs[REG_ID] = 0x10;
+  c[0]  = c0 >> 4;
+  c[1]  = ((c0 & 0x0F) << 4) | ((c1 >> 8) & 0x0F);
+  c[2]  = c1;
+  c[3]  = c00 >> 12;
+  c[4]  = c00 >> 4;
+  c[5]  = ((c00 & 0x0F) << 4) | ((c10 >> 16) & 0x0F);
+  c[6]  = c10 >> 8;
+  c[7]  = c10;
+  c[8]  = c01 >> 8;  c[9]  = c01;
+  c[10] = c11 >> 8;  c[11] = c11;
+  c[12] = c20 >> 8;  c[13] = c20;
+  c[14] = c21 >> 8;  c[15] = c21;
+  c[16] = c30 >> 8;  c[17] = c30;
+  p->powerOnTime = now(p);
+}
+
+static double period(uint8_t cfg) {
+  return 1.0 / (1 << ((cfg >> 4) & 0x07));
+}
+
+static double measureTime(uint8_t cfg) {
+  return measureMs[cfg & 0x07] / 1000;
+}
+
+// raw value the firmware turns back into the current temperature
+static double temperatureScaled(spl06_t *p) {
+  return (p->temperature - c0 * 0.5) / c1;
+}
+
+static void latchTemperature(spl06_t *p) {
+  put24(p->regs + REG_TMP_B2, lround(temperatureScaled(p) * scale[p->regs[REG_TMP_CFG] & 0x07]));
+  p->regs[REG_MEAS_CFG] |= TMP_RDY;
+  p->measurements++;
+  p->busyTime += measureTime(p->regs[REG_TMP_CFG]);
+}
+
+// invert the compensation polynomial with Newton's method. It is close to
+// linear over the sensor's range, so a few steps are plenty
+static void latchPressure(spl06_t *p) {
+  double target = p->pressure * 100, t = temperatureScaled(p), x = 0;
+  for (int i = 0; i < 20; i++) {
+    double f = c00 + x * (c10 + x * (c20 + x * c30)) + t * c01 + t * x * (c11 + x * c21) - target;
+    double df = c10 + x * (2 * c20 + x * 3 * c30) + t * (c11 + 2 * x * c21);
+    double step = f / df;
+    x -= step;
+    if (fabs(step) < 1e-9) {
+      break;
+    }
+  }
+  put24(p->regs + REG_PSR_B2, lround(x * scale[p->regs[REG_PRS_CFG] & 0x07]));
+  p->regs[REG_MEAS_CFG] |= PRS_RDY;
+  p->measurements++;
+  p->busyTime += measureTime(p->regs[REG_PRS_CFG]);
+}
+
+// catch up on everything that happened since the last bus access
+static void update(spl06_t *p) {
+  double t = now(p);
+  uint8_t *meas = &p->regs[REG_MEAS_CFG];
+
+  if (t - p->powerOnTime >= SENSOR_RDY_DELAY) {
+    *meas |= SENSOR_RDY;
+  }
+  if (t - p->powerOnTime >= COEF_RDY_DELAY) {
+    *meas |= COEF_RDY;
+  }
+
+  switch (*meas & 0x07) {
+  case MEAS_PRS:
+    if (t >= p->nextPressure) {
+      latchPressure(p);
+      *meas &= ~0x07; // back to standby after a single measurement
+    }
+    break;
+  case MEAS_TMP:
+    if (t >= p->nextTemperature) {
+      latchTemperature(p);
+      *meas &= ~0x07;
+    }
+    break;
+  case MEAS_CONT_PRS:
+  case MEAS_CONT_TMP:
+  case MEAS_CONT_ALL:
+    if ((*meas & 0x07) != MEAS_CONT_TMP && t >= p->nextPressure) {
+      latchPressure(p);
+      while (p->nextPressure <= t) {
+        p->nextPressure += period(p->regs[REG_PRS_CFG]);
+      }
+    }
+    if ((*meas & 0x07) != MEAS_CONT_PRS && t >= p->nextTemperature) {
+      latchTemperature(p);
+      while (p->nextTemperature <= t) {
+        p->nextTemperature += period(p->regs[REG_TMP_CFG]);
+      }
+    }
+    break;
+  }
+}
+
+static void writeRegister(spl06_t *p, uint8_t reg, uint8_t value) {
+  if (reg == REG_MEAS_CFG) {
+    double t = now(p);
+    p->regs[reg] = (p->regs[reg] & 0xF8) | (value & 0x07);
+    p->nextPressure = t + measureTime(p->regs[REG_PRS_CFG]);
+    p->nextTemperature = t + measureTime(p->regs[REG_TMP_CFG]);
+  }
+  else if (reg == REG_RESET) {
+    if ((value & 0x0F) == 0x09) {
+      reset(p);
+    }
+  }
+  else if (reg == REG_PRS_CFG || reg == REG_TMP_CFG || reg == 0x09) {
+    p->regs[reg] = value;
+  }
+  // everything else is read-only
+}
+
+static uint8_t readRegister(spl06_t *p, uint8_t reg) {
+  if (reg >= SPL06_REGISTERS) {
+    return 0;
+  }
+  uint8_t value = p->regs[reg];
+  if (reg == REG_PSR_B2) {
+    p->regs[REG_MEAS_CFG] &= ~PRS_RDY;
+  }
+  else if (reg == REG_TMP_B2) {
+    p->regs[REG_MEAS_CFG] &= ~TMP_RDY;
+  }
+  return value;
+}
+
+static void twiHook(struct avr_irq_t *irq, uint32_t value, void *param) {
+  spl06_t *p = (spl06_t *)param;
+  avr_twi_msg_irq_t v;
+  v.u.v = value;
+
+  if (v.u.twi.msg & TWI_COND_STOP) {
+    p->selected = 0;
+  }
+  if (v.u.twi.msg & TWI_COND_START) {
+    p->selected = (v.u.twi.addr >> 1) == p->address;
+    p->written = 0;
+    if (p->selected) {
+      update(p);
+      avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, v.u.twi.addr, 1));
+    }
+  }
+  if (!p->selected) {
+    return;
+  }
+  if (v.u.twi.msg & TWI_COND_WRITE) {
+    avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, v.u.twi.addr, 1));
+    if (p->written++ == 0) {
+      p->pointer = v.u.twi.data;
+    }
+    else {
+      writeRegister(p, p->pointer++, v.u.twi.data);
+    }
+    p->bytes++;
+  }
+  if (v.u.twi.msg & TWI_COND_READ) {
+    avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_READ, v.u.twi.addr, readRegister(p, p->pointer++)));
+    p->bytes++;
+  }
+}
+
+void spl06_attach(spl06_t *p, avr_t *avr, uint32_t twiIoctl, uint8_t address) {
+  memset(p, 0, sizeof(*p));
+  p->avr = avr;
+  p->address = address;
+  p->pressure = 1013.25;
+  p->temperature = 20;
+  reset(p);
+
+  p->irq = avr_alloc_irq(&avr->irq_pool, 0, 2, NULL);
+  avr_irq_register_notify(p->irq + TWI_IRQ_OUTPUT, twiHook, p);
+  avr_connect_irq(p->irq + TWI_IRQ_INPUT, avr_io_getirq(avr, twiIoctl, TWI_IRQ_INPUT));
+  avr_connect_irq(avr_io_getirq(avr, twiIoctl, TWI_IRQ_OUTPUT), p->irq + TWI_IRQ_OUTPUT);
+}
+
+void spl06_set_environment(spl06_t *p, double pressure, double temperature) {
+  p->pressure = pressure;
+  p->temperature = temperature;
+}
@@ -0,0 +1,42 @@
+/*
+ * SPL06-007 register model for simavr, on the TWI bus.
+ *
+ * Holds the register file, reports SENSOR_RDY/COEF_RDY once the power-on
+ * delays are over, and produces measurements at the rate and oversampling
+ * the firmware configured. Each result is the raw value that the real
+ * compensation formula turns back into the current pressure and
+ * temperature. The harness sets those through spl06_set_environment().
+ *
+ * Reading PSR_B2 clears PRS_RDY and reading TMP_B2 clears TMP_RDY, the
+ * same as on the real part.
+ */
+#ifndef _SPL06_MODEL_H_
+#define _SPL06_MODEL_H_
+
+#include <stdint.h>
+#include "sim_avr.h"
+
+#define SPL06_REGISTERS 0x29
+
+typedef struct spl06_t {
+  avr_t      *avr;
+  avr_irq_t  *irq;
+  uint8_t     address;           // 7-bit
+  uint8_t     selected;          // acknowledged its address in this transaction
+  uint8_t     written;           // bytes written since the (repeated) START
+  uint8_t     pointer;           // register the next read or write goes to
+  uint8_t     regs[SPL06_REGISTERS];
+  double      pressure;          // hPa
+  double      temperature;       // Celsius
+  double      powerOnTime;       // seconds, from the last reset
+  double      nextPressure;      // when the next pressure result is due
+  double      nextTemperature;   // when the next temperature result is due
+  uint32_t    bytes;             // bytes moved on the bus, for the summary
+  uint32_t    measurements;
+  double      busyTime;          // seconds spent converting, for the current estimate
+} spl06_t;
+
+void spl06_attach(spl06_t *p, avr_t *avr, uint32_t twiIoctl, uint8_t address);
+void spl06_set_environment(spl06_t *p, double pressure, double temperature);
+
+#endif // _SPL06_MODEL_H_
@@ -0,0 +1,202 @@
+/*
+ * SSD1306 128x32 model for simavr, see ssd1306_model.h.
+ */
+#include <string.h>
+#include "avr_twi.h"
+#include "ssd1306_model.h"
+
+#define HEIGHT (SSD1306_PAGES * 8)
+
+// how many argument bytes follow each command that takes any
+static uint8_t argumentCount(uint8_t c) {
+  switch (c) {
+  case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+  case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+    return 1;
+  case 0x21: case 0x22: case 0xA3:
+    return 2;
+  case 0x29: case 0x2A:
+    return 5;
+  case 0x26: case 0x27:
+    return 6;
+  default:
+    return 0;
+  }
+}
+
+static void runCommand(ssd1306_t *p) {
+  uint8_t *c = p->command;
+  switch (c[0]) {
+  case 0x20: p->memoryMode = c[1] & 0x03; break;
+  case 0x21:
+    p->columnStart = p->column = c[1] & 0x7F;
+    p->columnEnd = c[2] & 0x7F;
+    break;
+  case 0x22:
+    p->pageStart = p->page = c[1] & (SSD1306_PAGES - 1);
+    p->pageEnd = c[2] & (SSD1306_PAGES - 1); // 0xFF wraps like on a 32-row panel
+    break;
+  case 0x81: p->contrast = c[1]; break;
+  case 0xA0: case 0xA1: p->segmentRemap = c[0] & 1; break;
+  case 0xA6: case 0xA7: p->inverted = c[0] & 1; break;
+  case 0xAE: case 0xAF: p->on = c[0] & 1; break;
+  case 0xC0: p->comScanDec = 0; break;
+  case 0xC8: p->comScanDec = 1; break;
+  default:
+    if (p->memoryMode == 2) { // page addressing mode commands
+      if (c[0] >= 0xB0 && c[0] <= 0xB7) p->page = c[0] & (SSD1306_PAGES - 1);
+      else if (c[0] <= 0x0F) p->column = (p->column & 0xF0) | c[0];
+      else if (c[0] <= 0x1F) p->column = (p->column & 0x0F) | ((c[0] & 0x07) << 4);
+    }
+    break;
+  }
+}
+
+static void command(ssd1306_t *p, uint8_t b) {
+  p->command[p->commandLength++] = b;
+  if (p->commandLength > argumentCount(p->command[0])) {
+    runCommand(p);
+    p->commandLength = 0;
+  }
+}
+
+static void data(ssd1306_t *p, uint8_t b) {
+  p->ram[p->page][p->column] = b;
+  p->dataBytes++;
+
+  if (p->memoryMode == 2) {
+    if (p->column < SSD1306_WIDTH - 1) p->column++;
+    return;
+  }
+  if (p->memoryMode == 1) { // vertical
+    if (p->page < p->pageEnd) {
+      p->page++;
+      return;
+    }
+    p->page = p->pageStart;
+    p->column = p->column < p->columnEnd ? p->column + 1 : p->columnStart;
+  }
+  else { // horizontal
+    if (p->column < p->columnEnd) {
+      p->column++;
+      return;
+    }
+    p->column = p->columnStart;
+    p->page = p->page < p->pageEnd ? p->page + 1 : p->pageStart;
+  }
+  if (p->column == p->columnStart && p->page == p->pageStart) {
+    p->frames++;
+  }
+}
+
+static int listening(ssd1306_t *p) {
+  uint8_t ddr = p->avr->data[p->portAddress - 1];  // DDRx sits just below PORTx
+  uint8_t port = p->avr->data[p->portAddress];
+  return (ddr & (1 << p->pin)) && !(port & (1 << p->pin));
+}
+
+static void twiHook(struct avr_irq_t *irq, uint32_t value, void *param) {
+  ssd1306_t *p = (ssd1306_t *)param;
+  avr_twi_msg_irq_t v;
+  v.u.v = value;
+
+  if (v.u.twi.msg & TWI_COND_STOP) {
+    p->selected = 0;
+  }
+  if (v.u.twi.msg & TWI_COND_START) {
+    p->selected = (v.u.twi.addr >> 1) == p->address && !(v.u.twi.addr & 1) && listening(p);
+    p->control = 0xFF;
+    p->commandLength = 0;
+    if (p->selected) {
+      avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, v.u.twi.addr, 1));
+    }
+  }
+  if (!p->selected || !(v.u.twi.msg & TWI_COND_WRITE)) {
+    return;
+  }
+  avr_raise_irq(p->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, v.u.twi.addr, 1));
+  p->bytes++;
+
+  uint8_t b = v.u.twi.data;
+  if (p->control == 0xFF) {
+    p->control = b & 0xC0;       // Co and D/C
+  }
+  else {
+    if (p->control & 0x40) data(p, b);
+    else command(p, b);
+    if (p->control & 0x80) {
+      p->control = 0xFF;         // Co set: a new control byte follows every byte
+    }
+  }
+}
+
+void ssd1306_attach(ssd1306_t *p, avr_t *avr, uint32_t twiIoctl, uint8_t address,
+  const char *name, uint16_t portAddress, uint8_t pin) {
+  memset(p, 0, sizeof(*p));
+  p->avr = avr;
+  p->address = address;
+  p->name = name;
+  p->portAddress = portAddress;
+  p->pin = pin;
+  p->columnEnd = SSD1306_WIDTH - 1;
+  p->pageEnd = SSD1306_PAGES - 1;
+  p->memoryMode = 2; // the reset default
+  p->contrast = 0x7F;
+
+  p->irq = avr_alloc_irq(&avr->irq_pool, 0, 2, NULL);
+  avr_irq_register_notify(p->irq + TWI_IRQ_OUTPUT, twiHook, p);
+  avr_connect_irq(p->irq + TWI_IRQ_INPUT, avr_io_getirq(avr, twiIoctl, TWI_IRQ_INPUT));
+  avr_connect_irq(avr_io_getirq(avr, twiIoctl, TWI_IRQ_OUTPUT), p->irq + TWI_IRQ_OUTPUT);
+}
+
+// pixel as it appears on the glass. The firmware's upright orientation is
+// segment remap on (0xA1) with the COM scan reversed (0xC8)
+int ssd1306_pixel(const ssd1306_t *p, int x, int y) {
+  if (!p->on) {
+    return 0;
+  }
+  int column = p->segmentRemap ? x : SSD1306_WIDTH - 1 - x;
+  int row = p->comScanDec ? y : HEIGHT - 1 - y;
+  int lit = (p->ram[row / 8][column] >> (row & 7)) & 1;
+  return lit ^ p->inverted;
+}
+
+// pixels lit on the glass, for the current estimate
+int ssd1306_lit_pixels(const ssd1306_t *p) {
+  if (!p->on) {
+    return 0;
+  }
+  int lit = 0;
+  for (int page = 0; page < SSD1306_PAGES; page++) {
+    for (int column = 0; column < SSD1306_WIDTH; column++) {
+      lit += __builtin_popcount(p->ram[page][column]);
+    }
+  }
+  return p->inverted ? SSD1306_WIDTH * HEIGHT - lit : lit;
+}
+
+void ssd1306_print(const ssd1306_t *p, FILE *out) {
+  fprintf(out, "%s%s:\n", p->name, p->on ? "" : " (off)");
+  for (int y = 0; y < HEIGHT; y += 2) { // two rows per line keeps the aspect ratio
+    for (int x = 0; x < SSD1306_WIDTH; x++) {
+      int top = ssd1306_pixel(p, x, y), bottom = ssd1306_pixel(p, x, y + 1);
+      fputc(top ? (bottom ? '#' : '"') : (bottom ? '.' : ' '), out);
+    }
+    fputc('\n', out);
+  }
+}
+
+int ssd1306_write_pbm(const ssd1306_t *p, const char *path) {
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return -1;
+  }
+  fprintf(f, "P1\n%d %d\n", SSD1306_WIDTH, HEIGHT);
+  for (int y = 0; y < HEIGHT; y++) {
+    for (int x = 0; x < SSD1306_WIDTH; x++) {
+      fputc(ssd1306_pixel(p, x, y) ? '1' : '0', f);
+    }
+    fputc('\n', f);
+  }
+  return fclose(f);
+}
@@ -0,0 +1,48 @@
+/*
+ * SSD1306 128x32 model for simavr, on the TWI bus.
+ *
+ * Decodes the control byte, the command stream (addressing, display
+ * on/off, segment remap, COM scan direction, contrast, invert) and writes
+ * data into its own GDDRAM. The device has two panels at the same address,
+ * each only listening while its control pin is driven LOW, so every model
+ * is given the port and bit of its control pin.
+ */
+#ifndef _SSD1306_MODEL_H_
+#define _SSD1306_MODEL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sim_avr.h"
+
+#define SSD1306_WIDTH 128
+#define SSD1306_PAGES 4
+
+typedef struct ssd1306_t {
+  avr_t      *avr;
+  avr_irq_t  *irq;
+  const char *name;
+  uint8_t     address;          // 7-bit
+  uint16_t    portAddress;      // data space address of the control pin's PORTx
+  uint8_t     pin;              // bit in that port
+  uint8_t     selected;         // acknowledged its address in this transaction
+  uint8_t     control;          // 0x00 commands, 0x40 data, 0xFF expecting a control byte
+  uint8_t     command[8];       // command being collected, with its arguments
+  uint8_t     commandLength;
+  uint8_t     columnStart, columnEnd, pageStart, pageEnd;
+  uint8_t     column, page;
+  uint8_t     memoryMode;       // 0 horizontal, 1 vertical, 2 page addressing
+  uint8_t     on, segmentRemap, comScanDec, inverted, contrast;
+  uint8_t     ram[SSD1306_PAGES][SSD1306_WIDTH];
+  uint32_t    bytes;            // bytes moved on the bus, for the summary
+  uint32_t    dataBytes;        // GDDRAM bytes written
+  uint32_t    frames;           // times the write pointer wrapped back to the start
+} ssd1306_t;
+
+void ssd1306_attach(ssd1306_t *p, avr_t *avr, uint32_t twiIoctl, uint8_t address,
+  const char *name, uint16_t portAddress, uint8_t pin);
+int  ssd1306_pixel(const ssd1306_t *p, int x, int y);
+int  ssd1306_lit_pixels(const ssd1306_t *p);
+void ssd1306_print(const ssd1306_t *p, FILE *out);
+int  ssd1306_write_pbm(const ssd1306_t *p, const char *path);
+
+#endif // _SSD1306_MODEL_H_
@@ -0,0 +1,216 @@
+/*
+ * Fault injection for Custom_TWI's timeout and bus recovery, on the host.
+ *
+ * The real Custom_TWI, SPL06 driver and Custom_SSD1306 run against the TWI
+ * and bus model in host/, with an SPL06 and an SSD1306 on the bus. Each
+ * scenario starts from a working system, runs the sketch's traffic (a
+ * frame pushed every 50ms, the sensor polled every 5ms, Twi.poll() every
+ * 1ms) and injects one fault part way through. Whenever the recoveries
+ * counter moves, the loop sets the devices up again the way the sketch's
+ * handleBusFault() does.
+ *
+ * For each scenario it checks
+ *   - that the fault was detected and the TWI restarted within
+ *     TWI_TIMEOUT_MS plus a loop pass or two of it striking
+ *   - that both devices were set up again and a sensor read and a whole
+ *     frame went through within IN_SERVICE_MS of it striking
+ *   - the fault counters
+ * and prints the times, the worst of them last.
+ *
+ *   twi_fault [-v]
+ */
+#include <Custom_TWI.h>
+#include <Custom_SSD1306.h>
+#include <SPL06-007.h>
+#include "host/twi_devices.h"
+
+#define LOOP_US        1000  // a pass of loop() when there's nothing to do
+#define FRAME_MS       50    // the screens at 20 frames a second
+#define SENSOR_MS      5     // newData() polls
+#define DETECT_MS      (TWI_TIMEOUT_MS + 2)
+#define IN_SERVICE_MS  100   // SPL06 startup is 40ms of that
+#define SETTLE_MS      200   // how long a scenario runs before giving up
+
+// what the sketch builds
+typedef SPL06<Custom_TWI, SPL_RATE_2, SPL_OVERSAMPLE_8, SPL_RATE_1, SPL_OVERSAMPLE_8> Sensor;
+typedef Custom_SSD1306_Static<HostSsd1306::WIDTH, HostSsd1306::PAGES * 8> Oled;
+
+struct Scenario {
+  const char  *name;
+  HostTwiFault fault;
+  uint8_t      recoveries;  // expected
+  uint8_t      busErrors;   // expected
+};
+
+static const Scenario scenarios[] = {
+  { "lost interrupt, frame",              { TwiFaultLostInterrupt, 200, 0, 0, false },     1, 0 },
+  { "lost interrupt, sensor read",        { TwiFaultLostInterrupt, 520, 0, 0, false },     1, 0 },
+  { "SDA held 5 clocks",                  { TwiFaultHoldSda, 300, 5, 0, false },           1, 0 },
+  { "SDA held 9 clocks",                  { TwiFaultHoldSda, 100, 9, 0, false },           1, 0 },
+  { "SDA held 12 clocks",                 { TwiFaultHoldSda, 100, 12, 0, false },          2, 0 },
+  { "SCL stretched 10ms",                 { TwiFaultHoldScl, 150, 0, 10000, false },       0, 0 },
+  { "SCL stretched 40ms",                 { TwiFaultHoldScl, 150, 0, 40000, false },       1, 0 },
+  { "bus error",                          { TwiFaultBusError, 250, 0, 0, false },          0, 1 },
+  { "lost interrupt, devices reset",      { TwiFaultLostInterrupt, 400, 0, 0, true },      1, 0 },
+  { "SDA held 8 clocks, devices reset",   { TwiFaultHoldSda, 60, 8, 0, true },             1, 0 },
+};
+#define SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+static HostTwiBus bus;
+static HostSpl06  spl(SPL_ADDRESS);
+static HostSsd1306 panel(0x3C);
+static Sensor     sensor(Twi, SPL_ADDRESS);
+static Oled       oled;
+static uint8_t    recoveries;
+static bool       verbose;
+
+static double ms(uint64_t us) {
+  return us / 1000.0;
+}
+
+// a frame that changes every time, so a stale one shows
+static void drawFrame(unsigned n) {
+  oled.clearDisplay();
+  for (int16_t x = 0; x < HostSsd1306::WIDTH; x++) {
+    oled.drawPixel(x, (x + n) % (HostSsd1306::PAGES * 8), SSD1306_WHITE);
+  }
+}
+
+// the sketch's handleBusFault()
+static bool handleBusFault(void) {
+  if (Twi.faults().recoveries == recoveries) {
+    return false;
+  }
+  recoveries = Twi.faults().recoveries;
+  sensor.begin();
+  oled.begin(SSD1306_SWITCHCAPVCC, 0x3C, false, false);
+  return true;
+}
+
+// everything working: both devices set up, a sensor read and a frame through
+static bool inService(unsigned n) {
+  Twi.flush(); // the set up commands may still be going out
+  if (!spl.configured() || !panel.initialized() || !sensor.readSample() || sensor.pressure() < 300 || sensor.pressure() > 1100) {
+    return false;
+  }
+  drawFrame(n);
+  oled.display();
+  Twi.flush();
+  return !memcmp(panel.ram, oled.getBuffer(), sizeof(panel.ram));
+}
+
+static bool run(const Scenario &s, uint64_t *detect, uint64_t *service) {
+  TWIFaults before = Twi.faults();
+  uint64_t start = hostTime(), lastFrame = 0, lastSensor = 0, struck = 0;
+  unsigned frames = 0;
+  bool ok = true;
+
+  bus.inject(s.fault);
+  *detect = *service = 0;
+  while (hostTime() - start < SETTLE_MS * 1000ULL) {
+    uint64_t now = hostTime();
+    if (now - lastFrame >= FRAME_MS * 1000ULL) {
+      lastFrame = now;
+      drawFrame(frames++);
+      oled.display();
+    }
+    if (now - lastSensor >= SENSOR_MS * 1000ULL) {
+      lastSensor = now;
+      if (sensor.newData()) {
+        sensor.readSample();
+      }
+    }
+    Twi.poll();
+    handleBusFault();
+    if (bus.struckAt && !struck) {
+      struck = bus.struckAt;
+    }
+    // once it has struck and the bus is quiet, see whether everything works
+    if (struck && !*service && (!s.recoveries || bus.offAt) && !Twi.busy()) {
+      if (inService(frames++)) {
+        *service = hostTime() - struck;
+      }
+    }
+    if (*service && Twi.faults().recoveries - before.recoveries >= s.recoveries) {
+      break;
+    }
+    hostAdvance(LOOP_US);
+  }
+  Twi.flush();
+  handleBusFault();
+
+  if (!struck) {
+    printf("%s: the fault never struck\n", s.name);
+    return false;
+  }
+  *detect = bus.offAt ? bus.offAt - struck : 0;
+  if (s.recoveries && !bus.offAt) {
+    printf("%s: the TWI was never restarted\n", s.name);
+    ok = false;
+  }
+  if (*detect > DETECT_MS * 1000ULL) {
+    printf("%s: %.2fms to detect, more than %dms\n", s.name, ms(*detect), DETECT_MS);
+    ok = false;
+  }
+  if (!*service) {
+    printf("%s: not back in service after %dms\n", s.name, SETTLE_MS);
+    ok = false;
+  }
+  else if (*service > IN_SERVICE_MS * 1000ULL) {
+    printf("%s: %.2fms to get back in service, more than %dms\n", s.name, ms(*service), IN_SERVICE_MS);
+    ok = false;
+  }
+  uint8_t recovered = Twi.faults().recoveries - before.recoveries;
+  uint16_t busErrors = Twi.faults().busErrors - before.busErrors;
+  if (recovered != s.recoveries || busErrors != s.busErrors) {
+    printf("%s: %u recoveries and %u bus errors, expected %u and %u\n",
+      s.name, recovered, busErrors, s.recoveries, s.busErrors);
+    ok = false;
+  }
+  if (s.fault.resetDevices && (spl.resets != 1 || panel.resets != 1)) {
+    printf("%s: the devices weren't reset\n", s.name);
+    ok = false;
+  }
+  spl.resets = panel.resets = 0;
+  if (verbose) {
+    printf("%s: %u timeouts, %u nacks, %u SCL pulses by hand\n", s.name,
+      Twi.faults().timeouts - before.timeouts, Twi.faults().nacks - before.nacks, bus.sclPulses);
+  }
+  bus.sclPulses = 0;
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  verbose = argc > 1 && !strcmp(argv[1], "-v");
+
+  bus.attach(&spl);
+  bus.attach(&panel);
+  Twi.begin();
+  if (!sensor.begin() || !oled.begin(SSD1306_SWITCHCAPVCC, 0x3C, false, false) || !inService(0)) {
+    printf("the devices don't come up without a fault\n");
+    return 1;
+  }
+  if (Twi.faults().total()) {
+    printf("%u faults without one being injected\n", Twi.faults().total());
+    return 1;
+  }
+
+  unsigned failed = 0;
+  uint64_t worstDetect = 0, worstService = 0;
+  printf("%-36s %10s %12s\n", "scenario", "detect ms", "service ms");
+  for (unsigned i = 0; i < SCENARIOS; i++) {
+    uint64_t detect, service;
+    bool ok = run(scenarios[i], &detect, &service);
+    printf("%-36s %10.2f %12.2f%s\n", scenarios[i].name, ms(detect), ms(service), ok ? "" : "  FAILED");
+    failed += !ok;
+    worstDetect = max(worstDetect, detect);
+    worstService = max(worstService, service);
+  }
+  printf("%-36s %10.2f %12.2f\n", "worst case", ms(worstDetect), ms(worstService));
+  printf("limits %dms to detect, %dms back in service\n", DETECT_MS, IN_SERVICE_MS);
+  if (failed) {
+    printf("%u of %u scenarios failed\n", failed, (unsigned)SCENARIOS);
+    return 1;
+  }
+  return 0;
+}
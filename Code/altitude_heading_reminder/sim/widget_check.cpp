@@ -0,0 +1,366 @@
+/*
+ * WidgetScreen's partial updates against full redraws, on the host.
+ *
+ * Two SSD1306 panels share address 0x3C behind the sketch's two control
+ * pins, and one Custom_SSD1306_Static frame buffer, as on the device. The
+ * real Widgets.cpp, Custom_SSD1306 and Custom_TWI drive them through the
+ * TWI and bus model in host/.
+ *
+ * Each panel gets a few random layouts: text widgets of sizes 1 to 3 and
+ * rules, anywhere on the panel and overlapping, some with fixed labels and
+ * some formatted from slots whose text and offset the test changes. Each
+ * slot is one of draw()'s inputs, with a version that moves with every
+ * change, the way the sketch's sources do; a change can leave the text as
+ * it was. Each step changes a few slots, now and then switches a layout,
+ * flips, dims or inverts a panel or invalidates a screen, lets some time
+ * pass, and draws one panel the way the sketch's loop does. Once the bus is
+ * idle, both panels' memory has to match what a full redraw of their
+ * current layout puts in a frame buffer, and both have to be set up the
+ * way their screen was last told, with no setting sent again unless it
+ * changed or the screen was invalidated.
+ *
+ *   widget_check [-n steps] [-s seed]
+ */
+#include <unistd.h>
+#include "Widgets.h"
+#include "host/twi_devices.h"
+
+// from the sketch
+#define cPinLeftDisplayControl  5
+#define cPinRightDisplayControl 7
+#define CONTROL_ON              LOW
+#define cOledAddr               0x3C
+
+#define PANEL_WIDTH   HostSsd1306::WIDTH
+#define PANEL_HEIGHT  (HostSsd1306::PAGES * 8)
+#define LAYOUTS       3   // per panel
+#define SLOTS         cWidgetSources
+
+// the sketch's panel settings, see updatePanelSettings()
+#define cPanelFlipped  0x01
+#define cPanelDim      0x02
+#define cPanelInverted 0x04
+
+// the two panels answer to the same address, each only while its control pin is on
+class PanelPair : public HostTwiDevice {
+ public:
+  PanelPair() : HostTwiDevice(cOledAddr), left(cOledAddr), right(cOledAddr) {}
+
+  bool start(bool read) {
+    bool ack = false;
+    if (selected(cPinLeftDisplayControl)) {
+      ack |= left.start(read);
+    }
+    if (selected(cPinRightDisplayControl)) {
+      ack |= right.start(read);
+    }
+    return ack;
+  }
+  bool write(uint8_t data) {
+    bool ack = false;
+    if (selected(cPinLeftDisplayControl)) {
+      ack |= left.write(data);
+    }
+    if (selected(cPinRightDisplayControl)) {
+      ack |= right.write(data);
+    }
+    return ack;
+  }
+  void stop(void) {
+    left.stop();
+    right.stop();
+  }
+  void reset(void) {
+    left.reset();
+    right.reset();
+  }
+
+  HostSsd1306 left, right;
+
+ private:
+  static bool selected(uint8_t pin) { return hostPinLevel[pin] == CONTROL_ON; }
+};
+
+// a frame buffer that is never sent, for the full redraws to compare against
+class Reference : public Custom_SSD1306_Static<PANEL_WIDTH, PANEL_HEIGHT> {
+ public:
+  const uint8_t *frame(void) const { return buffer; }
+  void display(TWICallback done=NULL) override {
+    if (done) {
+      done(TWI_OK);
+    }
+  }
+};
+
+class Oled : public Custom_SSD1306_Static<PANEL_WIDTH, PANEL_HEIGHT> {
+ public:
+  Oled() : Custom_SSD1306_Static(&Twi) {}
+};
+
+struct Slot {
+  char    text[cWidgetTextLength];
+  uint8_t offset;
+  uint8_t version; // moves with every change, like one of the sketch's sources
+};
+
+struct Panel {
+  const char   *name;
+  uint8_t       pin;
+  HostSsd1306  *memory;
+  Widget        layouts[LAYOUTS][cWidgetMax];
+  uint8_t       counts[LAYOUTS];
+  uint8_t       current;
+  Slot          slots[SLOTS];
+  uint8_t       settings;    // cPanel bits
+  uint8_t       sent;        // the settings as of its last draw()
+  bool          invalidated; // since its last draw()
+  WidgetScreen  screen;
+  uint8_t       expected[PANEL_WIDTH * PANEL_HEIGHT / 8];
+};
+
+static HostTwiBus bus;
+static PanelPair  panels;
+static Oled       oled;
+static Reference  reference;
+static Panel      left = { "left", cPinLeftDisplayControl, &panels.left };
+static Panel      right = { "right", cPinRightDisplayControl, &panels.right };
+static Panel     *formatting; // the panel whose slots the format functions read
+static uint32_t   seed = 1;
+static char       labels[LAYOUTS * 2 * cWidgetMax][cWidgetTextLength];
+static unsigned   labelCount;
+
+static uint32_t random32(void) {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static unsigned randomBelow(unsigned n) {
+  return random32() % n;
+}
+
+template <int N> static uint8_t formatSlot(char *text) {
+  strcpy(text, formatting->slots[N].text);
+  return formatting->slots[N].offset;
+}
+
+static const WidgetFormat formats[SLOTS] = {
+  formatSlot<0>, formatSlot<1>, formatSlot<2>, formatSlot<3>,
+  formatSlot<4>, formatSlot<5>, formatSlot<6>, formatSlot<7> };
+
+static void randomText(char *text) {
+  static const char characters[] = "0123456789 -ABCDEFHLMNOPRSTUVW:.";
+  unsigned length = randomBelow(4) ? randomBelow(8) : randomBelow(cWidgetTextLength);
+  for (unsigned i = 0; i < length; i++) {
+    text[i] = characters[randomBelow(sizeof(characters) - 1)];
+  }
+  text[length] = 0;
+}
+
+// a new text and offset for a slot, now and then the same ones again
+static void changeSlot(Slot &slot) {
+  if (randomBelow(8)) {
+    randomText(slot.text);
+    slot.offset = randomBelow(4) ? 0 : randomBelow(12);
+  }
+  slot.version++;
+}
+
+static void randomLayout(Widget *widgets, uint8_t *count) {
+  *count = 1 + randomBelow(cWidgetMax);
+  for (uint8_t i = 0; i < *count; i++) {
+    Widget &w = widgets[i];
+    w.size = randomBelow(6) ? 1 + randomBelow(3) : 0;
+    w.x = randomBelow(PANEL_WIDTH - 6);
+    w.y = randomBelow(w.size ? PANEL_HEIGHT - 7 : PANEL_HEIGHT);
+    w.width = w.size ? 0 : 1 + randomBelow(PANEL_WIDTH - w.x);
+    if (randomBelow(4)) {
+      uint8_t slot = randomBelow(SLOTS);
+      w.label = NULL;
+      w.format = formats[slot];
+      w.sources = 1 << slot;
+      if (!randomBelow(4)) {
+        w.sources |= 1 << randomBelow(SLOTS); // an input it doesn't need costs a redraw, nothing more
+      }
+    }
+    else {
+      randomText(labels[labelCount]);
+      w.label = labels[labelCount++];
+      w.format = NULL;
+      w.sources = 0;
+    }
+  }
+}
+
+static WidgetLayout layoutOf(Panel &panel) {
+  WidgetLayout layout = { panel.layouts[panel.current], panel.counts[panel.current] };
+  return layout;
+}
+
+static void versionsOf(const Panel &panel, uint8_t *versions) {
+  for (uint8_t n = 0; n < SLOTS; n++) {
+    versions[n] = panel.slots[n].version;
+  }
+}
+
+// what a full redraw of the panel's layout and slots puts in a frame buffer
+static void expect(Panel &panel) {
+  WidgetScreen fresh;
+  uint8_t versions[cWidgetSources];
+  versionsOf(panel, versions);
+  formatting = &panel;
+  fresh.draw(reference, layoutOf(panel), versions);
+  memcpy(panel.expected, reference.frame(), sizeof(panel.expected));
+}
+
+// the sketch's updatePanelSettings()
+static void updatePanelSettings(WidgetScreen &screen, uint8_t settings) {
+  uint8_t changed = screen.settingsChanged(settings);
+  if (changed & cPanelFlipped) {
+    oled.flip(settings & cPanelFlipped);
+  }
+  if (changed & cPanelDim) {
+    if (settings & cPanelDim) {
+      oled.dim(true, 0);
+    }
+    else {
+      oled.dim(false, 255);
+    }
+  }
+  if (changed & cPanelInverted) {
+    oled.invertDisplay(settings & cPanelInverted);
+  }
+}
+
+// one pass of the sketch's screen update: select the panel, send the
+// settings that changed, draw, send. False if the settings took more
+// commands than the ones that changed, or all of them after invalidate()
+static bool draw(Panel &panel) {
+  digitalWrite(cPinLeftDisplayControl, &panel == &left ? CONTROL_ON : !CONTROL_ON);
+  digitalWrite(cPinRightDisplayControl, &panel == &right ? CONTROL_ON : !CONTROL_ON);
+  uint8_t due = panel.invalidated ? 0xFF : panel.settings ^ panel.sent;
+  uint32_t needed = (due & cPanelFlipped ? 2 : 0) + (due & cPanelDim ? 1 : 0) + (due & cPanelInverted ? 1 : 0);
+  uint32_t settingsCommands = panel.memory->settingsCommands;
+  updatePanelSettings(panel.screen, panel.settings);
+  panel.sent = panel.settings;
+  panel.invalidated = false;
+
+  uint8_t versions[cWidgetSources];
+  versionsOf(panel, versions);
+  formatting = &panel;
+  panel.screen.draw(oled, layoutOf(panel), versions);
+  Twi.flush();
+  expect(panel);
+  return panel.memory->settingsCommands - settingsCommands == needed;
+}
+
+static bool matches(Panel &panel, unsigned step) {
+  bool flipped = panel.settings & cPanelFlipped;
+  if (panel.memory->contrast != (panel.settings & cPanelDim ? 0 : 255) || panel.memory->inverted != !!(panel.settings & cPanelInverted)
+      || panel.memory->segmentRemap == flipped || panel.memory->comScanDec == flipped) {
+    printf("step %u: the %s panel isn't set up the way its screen was last told\n", step, panel.name);
+    return false;
+  }
+  if (!memcmp(panel.memory->ram, panel.expected, sizeof(panel.expected))) {
+    return true;
+  }
+  for (unsigned i = 0; i < sizeof(panel.expected); i++) {
+    if (panel.memory->ram[i] != panel.expected[i]) {
+      printf("step %u: the %s panel differs from a full redraw, first at column %u page %u\n",
+        step, panel.name, i % PANEL_WIDTH, i / PANEL_WIDTH);
+      break;
+    }
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+  unsigned steps = 20000;
+  int option;
+  while ((option = getopt(argc, argv, "n:s:")) != -1) {
+    switch (option) {
+      case 'n': steps = atoi(optarg); break;
+      case 's': seed = strtoul(optarg, NULL, 0) | 1; break;
+      default:
+        fprintf(stderr, "usage: %s [-n steps] [-s seed]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  uint32_t firstSeed = seed;
+  Panel *both[2] = { &left, &right };
+  for (Panel *panel : both) {
+    for (uint8_t i = 0; i < LAYOUTS; i++) {
+      randomLayout(panel->layouts[i], &panel->counts[i]);
+    }
+    for (Slot &slot : panel->slots) {
+      changeSlot(slot);
+    }
+  }
+
+  bus.attach(&panels);
+  pinMode(cPinLeftDisplayControl, OUTPUT);
+  pinMode(cPinRightDisplayControl, OUTPUT);
+  digitalWrite(cPinLeftDisplayControl, CONTROL_ON);
+  digitalWrite(cPinRightDisplayControl, CONTROL_ON);
+  Twi.begin();
+  oled.begin(SSD1306_SWITCHCAPVCC, cOledAddr, false, false);
+  Twi.flush();
+  if (!panels.left.initialized() || !panels.right.initialized()) {
+    printf("the panels don't come up\n");
+    return 1;
+  }
+
+  unsigned long full = 0, partial = 0, skipped = 0;
+  for (Panel *panel : both) { // the screens start out knowing nothing of the panels
+    panel->invalidated = true;
+    draw(*panel);
+  }
+  uint32_t settingsCommands = panels.left.settingsCommands + panels.right.settingsCommands;
+  for (unsigned step = 0; step < steps; step++) {
+    Panel &panel = *both[randomBelow(2)];
+    unsigned changes = randomBelow(5) ? randomBelow(3) : randomBelow(SLOTS);
+    for (unsigned i = 0; i < changes; i++) {
+      changeSlot(panel.slots[randomBelow(SLOTS)]);
+    }
+    if (!randomBelow(40)) {
+      panel.current = randomBelow(LAYOUTS);
+    }
+    if (!randomBelow(30)) {
+      panel.settings ^= 1 << randomBelow(3);
+    }
+    if (!randomBelow(100)) {
+      panel.screen.invalidate();
+      panel.invalidated = true;
+    }
+    hostAdvance(randomBelow(4) ? randomBelow(200000) : randomBelow(2000000));
+
+    uint32_t sent = panel.memory->dataBytes;
+    if (!draw(panel)) {
+      printf("step %u: the %s panel was sent settings that hadn't changed\n", step, panel.name);
+      printf("-s %lu\n", (unsigned long)firstSeed);
+      return 1;
+    }
+    sent = panel.memory->dataBytes - sent;
+    if (sent == PANEL_WIDTH * PANEL_HEIGHT / 8) {
+      full++;
+    }
+    else if (sent) {
+      partial++;
+    }
+    else {
+      skipped++;
+    }
+
+    if (!matches(left, step) || !matches(right, step) || Twi.faults().total()) {
+      printf("-s %lu, %u bus faults\n", (unsigned long)firstSeed, Twi.faults().total());
+      return 1;
+    }
+  }
+  settingsCommands = panels.left.settingsCommands + panels.right.settingsCommands - settingsCommands;
+  printf("%u steps, %lu full frames, %lu partial, %lu with nothing to send: both panels always matched a full redraw\n",
+    steps, full, partial, skipped);
+  printf("%lu settings commands, only for settings that changed\n", (unsigned long)settingsCommands);
+  return 0;
+}